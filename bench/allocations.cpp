@@ -0,0 +1,53 @@
+// Matrix storage allocations made by common operations on 100-element matrices and vals.
+// Operands passed by reference and updated in place should show 0, results 1.
+// g++ -std=c++17 -O2 -I.. allocations.cpp -o allocations && ./allocations
+#include "physics.h"
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+using namespace physics;
+
+const int repetitions = 1000;
+
+// Heap allocations of matrix storage per call of f
+template <typename F>
+void count(const char* name, F f) {
+    f();
+    long before = allocation_report().heap_allocations;
+    for(int r = 0; r < repetitions; r++) f();
+    double per_call = (double)(allocation_report().heap_allocations - before) / repetitions;
+    std::printf("%-36s %5.1f\n", name, per_call);
+}
+
+int main() {
+    std::vector<scalar> elements(100);
+    for(int i = 0; i < 100; i++) elements[i] = i + 1;
+    const matrix big(elements);
+    const val q = big * M / S;
+    matrix a = big;
+    val p = q;
+
+    std::printf("%-36s %5s\n", "operation", "allocations");
+    count("val p = big * M / S", [&] { val x = big * M / S; });
+    count("val p = matrix(big) * M / S (moved)", [&] { val x = matrix(big) * M / S; });
+    count("p += q", [&] { p += q; });
+    count("p -= q", [&] { p -= q; });
+    count("a += big", [&] { a += big; });
+    count("a *= 2", [&] { a *= (scalar)2; });
+    count("a = a + big * 2 - big", [&] { a = a + big * (scalar)2 - big; });
+    count("a == big", [&] { volatile bool x = a == big; (void)x; });
+    count("p == q", [&] { volatile bool x = p == q; (void)x; });
+    count("val t = abs(p * 2)", [&] { val t = abs(p * (scalar)2); });
+    count("matrix b = big (copy)", [&] { matrix b = big; });
+    count("matrix b = std::move(a2)", [&] {
+        matrix a2 = big;
+        matrix b = std::move(a2);
+    });
+    count("steady state loop in an arena_scope", [&] {
+        arena_scope scope;
+        val x = big * M / S;
+        val y = abs(x * (scalar)2) + q;
+        matrix b = big + big;
+    });
+}
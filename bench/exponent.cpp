@@ -0,0 +1,79 @@
+// Time to construct a val, which normalises its exponent, for log-uniform values in 1e-30..1e30,
+// next to the decade loop calculate_exponent used before.
+// g++ -std=c++17 -O2 -I.. exponent.cpp -o exponent && ./exponent
+#include "physics.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace physics;
+
+// The previous algorithm, on a 1x1 matrix as it was, or on a scalar, which leaves only the loop itself
+template <typename T>
+scalar magnitude(const T& v) { return std::abs((scalar)v); }
+scalar magnitude(const matrix& v) { return std::abs(v.first()); }
+
+template <typename T>
+void decade_loop(T& v, int& e) {
+    if(magnitude(v) > 1) {
+        while(magnitude(v) >= 10) {
+            e++;
+            v /= (scalar)10;
+        }
+    }
+    else if(magnitude(v) < 1) {
+        while(magnitude(v) <= 1) {
+            e--;
+            v *= (scalar)10;
+        }
+    }
+    if(e > 3 || e < -3) {
+        if(e % 3 == 1 || e % 3 == -2) {
+            e--;
+            v *= (scalar)10;
+        }
+        if(e % 3 == 2 || e % 3 == -1) {
+            e++;
+            v /= (scalar)10;
+        }
+    }
+}
+
+int main() {
+    std::mt19937_64 rng(1);
+    std::uniform_real_distribution<double> exponent(-30, 30);
+    std::vector<scalar> values(1000000);
+    for(scalar& x : values) x = (scalar)std::pow(10.0, exponent(rng));
+
+    auto start = std::chrono::steady_clock::now();
+    scalar sum = 0;
+    for(scalar x : values) {
+        val v(matrix(x), M);
+        sum += v.v.first() + v.e;
+    }
+    double constant = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / values.size();
+
+    start = std::chrono::steady_clock::now();
+    for(scalar x : values) {
+        int e = 0;
+        decade_loop(x, e);
+        sum += x + e;
+    }
+    double loop = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / values.size();
+
+    start = std::chrono::steady_clock::now();
+    for(scalar x : values) {
+        matrix m(x);
+        int e = 0;
+        decade_loop(m, e);
+        sum += m.first() + e;
+    }
+    double matrix_loop = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / values.size();
+
+    std::printf("val construction:               %6.1f ns\n", constant);
+    std::printf("decade loop on a 1x1 matrix:    %6.1f ns\n", matrix_loop);
+    std::printf("decade loop on a scalar:        %6.1f ns\n", loop);
+    std::printf("(checksum %g)\n", (double)sum);
+}
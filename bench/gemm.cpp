@@ -0,0 +1,38 @@
+// Throughput of square matrix products, from 3x3 to 2048x2048, on one thread unless a count is given.
+// g++ -std=c++17 -O3 -march=native -DPHYSICS_SCALAR=double -I.. gemm.cpp -o gemm && ./gemm [threads]
+#include "physics.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+using namespace physics;
+
+matrix random_matrix(int n, std::mt19937& rng) {
+    std::uniform_real_distribution<double> d(-1, 1);
+    matrix m = matrix::zeros(n, n);
+    for(int i = 0; i < n; i++) {
+        for(int j = 0; j < n; j++) m(i, j) = d(rng);
+    }
+    return m;
+}
+
+int main(int argc, char** argv) {
+    set_threads(argc > 1 ? std::atoi(argv[1]) : 1);
+    std::mt19937 rng(1);
+
+    std::printf("%6s %12s\n", "n", "GFLOP/s");
+    for(int n : {3, 4, 8, 16, 32, 64, 128, 256, 512, 1024, 2048}) {
+        matrix a = random_matrix(n, rng), b = random_matrix(n, rng), c;
+        double flops = 2.0 * n * n * n;
+        // About 2 GFLOP per size, at least one product
+        int reps = std::max(1, (int)(2e9 / flops));
+
+        c = a * b;
+        auto start = std::chrono::steady_clock::now();
+        for(int r = 0; r < reps; r++) c = a * b;
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::printf("%6d %12.2f\n", n, flops * reps / seconds / 1e9);
+    }
+}
@@ -0,0 +1,74 @@
+// Scaling of parallel_for and parallel_map from 1 to N threads, N being the hardware threads unless given.
+// g++ -std=c++17 -O2 -pthread -I.. parallel.cpp -o parallel && ./parallel [N]
+#include "physics.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using namespace physics;
+
+// Best of a few runs of f, in milliseconds
+template <typename F>
+double time_ms(F f) {
+    double best = 1e300;
+    for(int r = 0; r < 3; r++) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    int max_threads = argc > 1 ? std::atoi(argv[1]) : (int)std::max(1u, std::thread::hardware_concurrency());
+
+    // Numeric loop over plain numbers
+    const int n = 1 << 24;
+    std::vector<double> x(n), y(n);
+    for(int i = 0; i < n; i++) x[i] = i * 1e-6;
+    auto numeric = [&] {
+        parallel_for(n, [&](int begin, int end) {
+            for(int i = begin; i < end; i++) y[i] = std::sqrt(x[i]) * std::sin(x[i]);
+        });
+    };
+
+    // Parallel resistors as vals, through parallel_map
+    std::vector<scalar> r(200000);
+    for(size_t i = 0; i < r.size(); i++) r[i] = 1 + i % 1000;
+    val_array r_1(r, OHM);
+    const val r_2 = 2.0_k * OHM;
+    auto resistors = [&] {
+        val_array total = parallel_map(r_1, [&](const val& a) { return (a * r_2) / (a + r_2); });
+    };
+
+    // Matrix products nested in a parallel_map, sharing the pool
+    matrix a = matrix::zeros(96, 96);
+    for(int i = 0; i < 96; i++) {
+        for(int j = 0; j < 96; j++) a(i, j) = std::sin(i + 2.0 * j);
+    }
+    auto nested = [&] {
+        std::vector<scalar> traces = parallel_map(64, [&](int i) { return (a * (a * (scalar)i))(0, 0); });
+    };
+
+    // Dispatch cost of an empty loop: 1000 calls, so milliseconds are microseconds per call
+    auto empty = [&] {
+        for(int k = 0; k < 1000; k++) parallel_for(1000, [](int, int) {});
+    };
+
+    std::printf("%8s %14s %14s %14s %16s\n", "threads", "numeric ms", "resistors ms", "nested ms", "empty loop us");
+    double base[3] = {0, 0, 0};
+    for(int threads = 1; threads <= max_threads; threads++) {
+        set_threads(threads);
+        double t[3] = {time_ms(numeric), time_ms(resistors), time_ms(nested)};
+        double dispatch = time_ms(empty);
+        if(threads == 1) {
+            for(int i = 0; i < 3; i++) base[i] = t[i];
+        }
+        std::printf("%8d %8.1f (%3.1fx) %8.1f (%3.1fx) %8.1f (%3.1fx) %16.2f\n", threads, t[0], base[0] / t[0], t[1], base[1] / t[1],
+                    t[2], base[2] / t[2], dispatch);
+    }
+}
@@ -1,448 +1,1533 @@
 
 
-// begin --- matrix.cpp --- 
+// begin --- buffer.cpp --- 
 
 
 
-// begin --- matrix.h --- 
+// begin --- buffer.h --- 
 
 #pragma once
 
-#include <string>
-#include <vector>
+
+
+// begin --- scalar.h --- 
+
+#pragma once
+
+
+// The floating point type used for all values, selected at build time.
+// Define PHYSICS_SCALAR as float, double or long double before including physics.h.
+// long double is the default; double and float allow the compiler to vectorise matrix loops.
+#ifndef PHYSICS_SCALAR
+#define PHYSICS_SCALAR long double
+#endif
 
 namespace physics {
+    typedef PHYSICS_SCALAR scalar;
+}
 
-    struct matrix {
+
+// end --- scalar.h --- 
+
+
+#include <cstddef>
+
+
+namespace physics {
+    class allocator;
+
+    // Contiguous array of elements with small buffer optimisation.
+    // Up to inline_capacity elements are stored inside the object itself, so scalars, 3D vectors
+    // and matrices up to 4x4 never touch the heap.
+    // Larger storage comes from the allocator that was current on the thread when the buffer was created,
+    // if it still is when the buffer grows, and from the heap otherwise. It always goes back where it came from.
+    class buffer {
     public:
-        std::vector<std::vector<long double>> data;
+        static const int inline_capacity = 16;
+
+    private:
+        scalar* ptr;
+        int n;
+        int capacity;
+        allocator* home; // Allocator current when the buffer was created. Only compared, it may be gone.
+        allocator* source; // Allocator holding the storage, nullptr for the heap
+        scalar local[inline_capacity];
+
+    public:
+        buffer();
+        explicit buffer(int size, scalar value = 0);
+        buffer(const scalar* first, const scalar* last);
+        buffer(const buffer& b);
+        buffer(buffer&& b) noexcept;
+        ~buffer();
+
+        buffer& operator=(const buffer& b);
+        buffer& operator=(buffer&& b) noexcept;
 
-        int rows() const;
-        int cols() const;
-        long double first() const;
         int size() const;
+        bool is_inline() const;
+        scalar* data();
+        const scalar* data() const;
 
-        bool is_scalar() const;
-        bool is_vector() const;
-        bool is_square() const;
+        scalar& operator[](int i);
+        scalar operator[](int i) const;
 
-    public:
-        matrix();
-        matrix(long double value);
-        matrix(std::vector<long double> values);
-        matrix(std::vector<std::vector<long double>> values);
+        scalar* begin();
+        scalar* end();
+        const scalar* begin() const;
+        const scalar* end() const;
 
-        std::string operator+(std::string x) const;
-        operator std::string() const;
-        explicit operator int() const;
-        explicit operator float() const;
-        explicit operator double() const;
-        explicit operator long double() const;
+        // Resizes to the given size, setting every element to value.
+        void assign(int size, scalar value);
 
-        matrix operator+(matrix m) const;
-        matrix operator-(matrix m) const;
-        matrix operator*(long double x) const;
-        matrix operator*(matrix m) const;
-        matrix operator/(long double x) const;
-        matrix operator/(matrix m) const;
-        matrix operator^(double) const;
+    private:
+        void allocate(int size);
+        void release();
+    };
+}
 
-        matrix operator+=(matrix m);
-        matrix operator-=(matrix m);
-        matrix operator*=(long double x);
-        matrix operator*=(matrix m);
-        matrix operator/=(long double x);
 
-        bool operator==(matrix m) const;
-        bool operator!=(matrix m) const;
+// end --- buffer.h --- 
 
-        // Transpose
-        matrix T() const;
+
+
+
+// begin --- allocator.h --- 
+
+#pragma once
+
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+
+namespace physics {
+    // Source of the storage of matrices too large to be stored inline.
+    // Each thread has a current allocator, which new matrices created on it draw from for as long as they
+    // live, and their storage goes back to the same allocator, whichever thread frees it.
+    // The default, nullptr, is the heap.
+    class allocator {
+    public:
+        virtual ~allocator() = default;
+
+        virtual scalar* allocate(int n) = 0;
+        // Called with the size passed to allocate. May be called from any thread.
+        virtual void deallocate(scalar* p, int n) = 0;
     };
 
-    matrix operator*(long double x, matrix m);
+    // Returns the current allocator of the calling thread.
+    allocator* current_allocator();
+    // Sets the current allocator of the calling thread, and returns the previous one.
+    allocator* set_allocator(allocator* a);
 
-    std::string operator+(std::string x, matrix m);
-    std::ostream& operator<<(std::ostream &os, const matrix &m);
+    // Storage of n elements from an allocator, or the heap if it is nullptr
+    scalar* allocate_storage(allocator* a, int n);
+    void deallocate_storage(allocator* a, scalar* p, int n);
 
-    matrix abs(matrix m);
-    matrix cross(matrix m1, matrix m2);
-}
+    // Chunks an arena hands out consecutive pieces of, which are only given back all at once.
+    // Allocating is a pointer increment, and freeing a piece only counts it. Matrices allocated from a
+    // block refer to it rather than to its arena, and keep it alive after the arena has moved on to another
+    // block or been destroyed: the last one to let go frees it.
+    class arena_block : public allocator {
+    private:
+        struct chunk {
+            scalar* data;
+            size_t size;
+        };
 
-// end --- matrix.h --- 
+        std::vector<chunk> chunks;
+        size_t current = 0; // Chunk being allocated from
+        size_t used = 0; // Elements used in it
+        size_t next_chunk; // Size of the first chunk to add
+        std::atomic<long> references; // Pieces in use, plus one while the arena uses the block
 
+        friend class arena;
 
-#include <stdexcept>
-#include <math.h>
+        explicit arena_block(size_t first_chunk);
+        ~arena_block();
 
+    public:
+        arena_block(const arena_block&) = delete;
+        arena_block& operator=(const arena_block&) = delete;
 
-inline int physics::matrix::rows() const { return data.size(); }
-inline int physics::matrix::cols() const { return data[0].size(); }
-inline long double physics::matrix::first() const { return data[0][0]; }
-inline int physics::matrix::size() const { return data.size() * data[0].size(); }
+        scalar* allocate(int n) override;
+        void deallocate(scalar* p, int n) override;
 
-inline bool physics::matrix::is_scalar() const { return rows() == 1 && cols() == 1; }
-inline bool physics::matrix::is_vector() const { return rows() == 1 || cols() == 1; }
-inline bool physics::matrix::is_square() const { return rows() == cols(); }
+        // Drops a reference, freeing the block with the last one
+        void release();
+    };
 
+    // Source of short-lived matrix storage, used through arena_scope. Once it has grown to fit a repeated
+    // workload, it serves it without touching the heap.
+    // Only the thread using an arena may allocate from or reset it.
+    class arena {
+    private:
+        arena_block* block; // Block being allocated from
+        int scopes = 0; // Open arena_scopes
 
-inline physics::matrix::matrix() {}
-inline physics::matrix::matrix(long double value) { data.push_back({value}); }
-inline physics::matrix::matrix(std::vector<long double> values) { data.push_back({values}); }
-inline physics::matrix::matrix(std::vector<std::vector<long double>> values) { data = values; }
+        friend class arena_scope;
 
+    public:
+        arena();
+        ~arena();
+        arena(const arena&) = delete;
+        arena& operator=(const arena&) = delete;
+
+        // Makes all the storage of the arena available again, in O(1). If pieces are still in use, their
+        // block is left to them and the arena starts a new one of the same size.
+        // Throws if an arena_scope is using the arena.
+        void reset();
+        // Elements in the current block
+        size_t capacity() const;
+    };
 
-inline std::string physics::matrix::operator+(std::string x) const {
-    return (std::string)*this + x;
-}
+    // Makes the calling thread allocate from an arena until the scope ends, e.g. for one step of a
+    // simulation. Without an argument, the thread's own arena is used.
+    // The arena is reset when the outermost scope using it ends, so the step's temporaries cost no heap
+    // allocations once it has grown to fit them. Matrices created before the scope keep their storage, and
+    // copying or moving a result into them copies it there, so results can be kept across the reset. Matrices
+    // created within the scope that outlive it stay valid, but keep all the storage of their step alive and
+    // make the next step start a new block, so copy results out instead where possible.
+    class arena_scope {
+    private:
+        arena& a;
+        allocator* previous;
 
-inline physics::matrix::operator std::string() const {
-    std::string string;
-    if(rows() > 1) string = "[";
-    for(std::vector<long double> row : data) {
-        if(cols() > 1) string += "[ ";
-        for(long double value : row) {
-            string += std::to_string(value) + " ";
-        }
-        if(cols() > 1) string += "]";
-    }
-    if(rows() > 1) string += "]";
-    return string;
-}
+    public:
+        arena_scope();
+        explicit arena_scope(arena& a);
+        ~arena_scope();
+        arena_scope(const arena_scope&) = delete;
+        arena_scope& operator=(const arena_scope&) = delete;
+    };
 
-inline physics::matrix::operator int() const { return (long double)*this; }
-inline physics::matrix::operator float() const { return (long double)*this; }
-inline physics::matrix::operator double() const { return (long double)*this; }
-inline physics::matrix::operator long double() const {
-    if(!is_scalar()) throw std::invalid_argument("Only 1x1 matrices can be converted to scalar values.");
-    return first();
+    // Counts of the storage allocated for matrices since the program started, over all threads
+    struct allocation_stats {
+        long heap_allocations = 0; // Calls to the heap, including for arena chunks
+        long heap_bytes = 0;
+        long arena_allocations = 0; // Pieces handed out by arenas
+        long arena_bytes = 0;
+    };
+
+    allocation_stats allocation_report();
 }
 
-inline physics::matrix physics::matrix::operator+(matrix m) const {
-    if(rows() != m.rows() || cols() != m.cols()) throw std::invalid_argument("Incompatible matrices.");
 
-    matrix out;
-    for(int i = 0; i < data.size(); i++) {
-        std::vector<long double> newRow;
-        for(int j = 0; j < data[0].size(); j++) {
-            newRow.push_back(data[i][j] + m.data[i][j]);
-        }
-        out.data.push_back(newRow);
-    }
-    return out;
-}
+// end --- allocator.h --- 
+
 
-inline physics::matrix physics::matrix::operator-(matrix m) const {
-    return *this + -1 * m;
+#include <algorithm>
+#include <utility>
+
+
+inline physics::buffer::buffer() : ptr(local), n(0), capacity(inline_capacity), home(current_allocator()), source(nullptr) {}
+inline physics::buffer::buffer(int size, scalar value) : buffer() {
+    assign(size, value);
+}
+inline physics::buffer::buffer(const scalar* first, const scalar* last) : buffer() {
+    allocate(last - first);
+    std::copy(first, last, ptr);
+}
+inline physics::buffer::buffer(const buffer& b) : buffer(b.begin(), b.end()) {}
+// A buffer moved into a new one takes over its storage, wherever it came from
+inline physics::buffer::buffer(buffer&& b) noexcept : buffer() {
+    home = b.is_inline() ? b.home : b.source;
+    *this = std::move(b);
+}
+inline physics::buffer::~buffer() {
+    release();
 }
 
-inline physics::matrix physics::matrix::operator*(long double x) const {
-    matrix out;
-    for(std::vector<long double> row : data) {
-        std::vector<long double> newRow;
-        for(long double value : row) {
-            newRow.push_back(value * x);
-        }
-        out.data.push_back(newRow);
+inline physics::buffer& physics::buffer::operator=(const buffer& b) {
+    if(this == &b) return *this;
+    allocate(b.n);
+    std::copy(b.begin(), b.end(), ptr);
+    return *this;
+}
+inline physics::buffer& physics::buffer::operator=(buffer&& b) noexcept {
+    if(this == &b) return *this;
+
+    // Allocated storage changes owner if it came from this buffer's allocator, otherwise it has to be copied,
+    // e.g. when a result from an arena is kept in a matrix created before the arena_scope
+    if(!b.is_inline() && b.source == home) {
+        release();
+        ptr = b.ptr;
+        source = b.source;
+        n = b.n;
+        capacity = b.capacity;
+        b.ptr = b.local;
+        b.source = nullptr;
+        b.capacity = inline_capacity;
     }
-    return out;
+    else {
+        allocate(b.n);
+        std::copy(b.begin(), b.end(), ptr);
+    }
+    b.n = 0;
+    return *this;
 }
 
-inline physics::matrix physics::matrix::operator*(matrix x) const {
-    // Multiplication by 1x1 matrix should be regarded as scalar multiplication
-    if(x.is_scalar()) return *this * x.first();
-    if(is_scalar()) return first() * x;
+inline int physics::buffer::size() const { return n; }
+inline bool physics::buffer::is_inline() const { return ptr == local; }
+inline physics::scalar* physics::buffer::data() { return ptr; }
+inline const physics::scalar* physics::buffer::data() const { return ptr; }
 
-    // Automatically transpose vectors
-    if(x.is_vector() && cols() != x.rows()) x = x.T();
+inline physics::scalar& physics::buffer::operator[](int i) { return ptr[i]; }
+inline physics::scalar physics::buffer::operator[](int i) const { return ptr[i]; }
 
-    if(cols() != x.rows()) throw std::invalid_argument("Incompatible matrices.");
+inline physics::scalar* physics::buffer::begin() { return ptr; }
+inline physics::scalar* physics::buffer::end() { return ptr + n; }
+inline const physics::scalar* physics::buffer::begin() const { return ptr; }
+inline const physics::scalar* physics::buffer::end() const { return ptr + n; }
 
-    matrix out;
-    for(int i = 0; i < rows(); i++) {
-        std::vector<long double> newRow;
-        for(int j = 0; j < x.cols(); j++) {
-            long double sum = 0;
-            for(int k = 0; k < cols(); k++) {
-                sum += data[i][k] * x.data[k][j];
-            }
-            newRow.push_back(sum);
-        }
-        out.data.push_back(newRow);
-    }
-    return out.T();
+inline void physics::buffer::assign(int size, scalar value) {
+    allocate(size);
+    std::fill(ptr, ptr + n, value);
 }
 
-inline physics::matrix physics::matrix::operator/(long double x) const {
-    return *this * (1/x);
+// Makes room for size elements. Existing contents are not preserved.
+inline void physics::buffer::allocate(int size) {
+    if(size > capacity) {
+        release();
+        // The allocator the buffer was created under is only used while it is current, so it is alive and
+        // belongs to this thread
+        allocator* a = current_allocator();
+        if(a != home) a = nullptr;
+        ptr = allocate_storage(a, size);
+        source = a;
+        capacity = size;
+    }
+    n = size;
 }
 
-inline physics::matrix physics::matrix::operator/(matrix m) const {
-    if(!m.is_scalar()) throw std::invalid_argument("Dividing by matrix of size other than 1x1 is undefined.");
-    return *this * (1/m.first());
+inline void physics::buffer::release() {
+    if(!is_inline()) deallocate_storage(source, ptr, capacity);
+    source = nullptr;
+    ptr = local;
+    capacity = inline_capacity;
+    n = 0;
 }
 
-inline physics::matrix physics::matrix::operator^(double x) const {
-    if(is_scalar()) return pow(first(), x);
-    if(!is_square()) throw std::invalid_argument("Exponentiation only possible for square matrices");
 
-    matrix out = *this;
-    for(int i = 0; i < x-1; i++) {
-        out *= *this;
-    }
-    return out;
-}
+// end --- buffer.cpp --- 
 
 
-inline physics::matrix physics::matrix::operator+=(matrix m) {
-    *this = *this + m;
-    return *this;
-}
 
-inline physics::matrix physics::matrix::operator-=(matrix m) {
-    *this = *this - m;
-    return *this;
+// begin --- allocator.cpp --- 
+
+
+#include <algorithm>
+#include <new>
+#include <stdexcept>
+
+
+inline thread_local physics::allocator* thread_allocator = nullptr;
+
+inline std::atomic<long> heap_allocations(0);
+inline std::atomic<long> heap_bytes(0);
+inline std::atomic<long> arena_allocations(0);
+inline std::atomic<long> arena_bytes(0);
+
+inline physics::allocator* physics::current_allocator() { return thread_allocator; }
+
+inline physics::allocator* physics::set_allocator(allocator* a) {
+    allocator* previous = thread_allocator;
+    thread_allocator = a;
+    return previous;
 }
 
-inline physics::matrix physics::matrix::operator*=(long double x) {
-    *this = *this * x;
-    return *this;
+inline physics::allocation_stats physics::allocation_report() {
+    allocation_stats stats;
+    stats.heap_allocations = heap_allocations.load(std::memory_order_relaxed);
+    stats.heap_bytes = heap_bytes.load(std::memory_order_relaxed);
+    stats.arena_allocations = arena_allocations.load(std::memory_order_relaxed);
+    stats.arena_bytes = arena_bytes.load(std::memory_order_relaxed);
+    return stats;
 }
 
-inline physics::matrix physics::matrix::operator*=(matrix m) {
-    *this = *this * m;
-    return *this;
+// Heap allocations of matrix storage, counted for allocation_report
+inline physics::scalar* heap_allocate(size_t n, std::align_val_t alignment = std::align_val_t(alignof(physics::scalar))) {
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    heap_bytes.fetch_add(n * sizeof(physics::scalar), std::memory_order_relaxed);
+    return static_cast<physics::scalar*>(::operator new(n * sizeof(physics::scalar), alignment));
 }
 
-inline physics::matrix physics::matrix::operator/=(long double x) {
-    *this = *this / x;
-    return *this;
+inline void heap_deallocate(physics::scalar* p, std::align_val_t alignment = std::align_val_t(alignof(physics::scalar))) {
+    ::operator delete(p, alignment);
 }
 
 
-inline bool physics::matrix::operator==(matrix x) const {
-    // Size check
-    if(rows() != x.rows() || cols() != x.cols()) return false;
+// Pieces start on cache lines, so they line up for SIMD loads like heap storage does
+inline constexpr size_t arena_alignment = 64;
+inline constexpr size_t arena_granule = std::max<size_t>(1, arena_alignment / sizeof(physics::scalar));
+inline constexpr size_t arena_first_chunk = 1 << 14;
 
-    // Value check
-    for(int i = 0; i < data.size(); i++) {
-        for(int j = 0; j < data.size(); j++) {
-            if(data[i][j] != x.data[i][j]) return false;
-        }
-    }
+inline physics::arena_block::arena_block(size_t first_chunk) : next_chunk(first_chunk), references(1) {}
 
-    return true;
+inline physics::arena_block::~arena_block() {
+    for(chunk& c : chunks) heap_deallocate(c.data, std::align_val_t(arena_alignment));
 }
 
-inline bool physics::matrix::operator!=(matrix x) const {
-    return !(*this == x);
+inline physics::scalar* physics::arena_block::allocate(int n) {
+    size_t size = (n + arena_granule - 1) / arena_granule * arena_granule;
+
+    // Later chunks are tried before adding one, they are empty after a reset
+    while(current < chunks.size() && used + size > chunks[current].size) {
+        current++;
+        used = 0;
+    }
+    if(current == chunks.size()) {
+        size_t chunk_size = std::max(next_chunk, size);
+        chunks.push_back(chunk{heap_allocate(chunk_size, std::align_val_t(arena_alignment)), chunk_size});
+        next_chunk = 2 * chunk_size;
+        used = 0;
+    }
+
+    scalar* p = chunks[current].data + used;
+    used += size;
+    references.fetch_add(1, std::memory_order_relaxed);
+    arena_allocations.fetch_add(1, std::memory_order_relaxed);
+    arena_bytes.fetch_add(size * sizeof(scalar), std::memory_order_relaxed);
+    return p;
 }
 
+inline void physics::arena_block::deallocate(scalar*, int) {
+    release();
+}
 
-inline physics::matrix physics::matrix::T() const {
-    matrix out;
-    for(int i = 0; i < data[0].size(); i++) {
-        std::vector<long double> newRow;
-        for(int j = 0; j < data.size(); j++) {
-            newRow.push_back(data[j][i]);
-        }
-        out.data.push_back(newRow);
-    }
-    return out;
+inline void physics::arena_block::release() {
+    if(references.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this;
 }
 
 
-inline physics::matrix physics::operator*(long double x, matrix m) {
-    return m * x;
+inline physics::arena::arena() : block(new arena_block(arena_first_chunk)) {}
+
+inline physics::arena::~arena() {
+    block->release();
 }
 
-inline std::string physics::operator+(std::string x, matrix m) {
-    return x + (std::string)m;
+inline void physics::arena::reset() {
+    if(scopes != 0) throw std::invalid_argument("Arena is in use.");
+    // Only the arena holds the block, so nothing else can take a reference while it is rewound
+    if(block->references.load(std::memory_order_acquire) == 1) {
+        block->current = 0;
+        block->used = 0;
+        return;
+    }
+    size_t size = std::max(arena_first_chunk, capacity());
+    block->release();
+    block = new arena_block(size);
 }
-inline std::ostream& physics::operator<<(std::ostream &os, const matrix &m) {
-    os << (std::string)m;
-    return os;
+
+inline size_t physics::arena::capacity() const {
+    size_t total = 0;
+    for(const arena_block::chunk& c : block->chunks) total += c.size;
+    return total;
 }
 
-inline physics::matrix physics::abs(matrix m) {
-    matrix out;
-    for(std::vector<long double> row : m.data) {
-        std::vector<long double> newRow;
-        for(long double value : row) {
-            newRow.push_back(std::abs(value));
-        }
-        out.data.push_back(newRow);
-    }
-    return out;
+
+// Arena of the calling thread, used by arena_scopes without an argument
+inline physics::arena& thread_arena() {
+    thread_local physics::arena a;
+    return a;
 }
 
-inline physics::matrix physics::cross(matrix m1, matrix m2) {
-    if(!m1.is_vector() || !m2.is_vector() || m1.size() != 3 || m2.size() != 3) throw std::invalid_argument("Cross product only possible for 3D vectors");
+inline physics::arena_scope::arena_scope() : arena_scope(thread_arena()) {}
 
-    std::vector<long double> result(3);
-    std::vector<long double> a = m1.rows() == 1 ? m1.data[0] : m1.T().data[0];
-    std::vector<long double> b = m2.rows() == 1 ? m2.data[0] : m2.T().data[0];
+inline physics::arena_scope::arena_scope(arena& a) : a(a) {
+    // Whatever the last step left behind may have been freed since
+    if(a.scopes == 0) a.reset();
+    a.scopes++;
+    previous = set_allocator(a.block);
+}
 
-    result[0] = a[1] * b[2] - a[2] * b[1];
-    result[1] = a[2] * b[0] - a[0] * b[2];
-    result[2] = a[0] * b[1] - a[1] * b[0];
+inline physics::arena_scope::~arena_scope() {
+    set_allocator(previous);
+    if(--a.scopes == 0) a.reset();
+}
 
-    return matrix(result);
+// Matrix storage comes from the thread's allocator, or the heap
+inline physics::scalar* physics::allocate_storage(allocator* a, int n) {
+    if(a) return a->allocate(n);
+    return heap_allocate(n);
 }
 
-// end --- matrix.cpp --- 
+inline void physics::deallocate_storage(allocator* a, scalar* p, int n) {
+    if(a) a->deallocate(p, n);
+    else heap_deallocate(p);
+}
 
 
+// end --- allocator.cpp --- 
 
-// begin --- value.cpp --- 
 
 
+// begin --- thread_pool.cpp --- 
 
-// begin --- value.h --- 
 
-#pragma once
 
-// begin --- unit.h --- 
+// begin --- thread_pool.h --- 
 
 #pragma once
 
-#include <string>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
 #include <vector>
 
 
 namespace physics {
-    // Represents a physical dimension.
-    // Holds an int8_t array with the exponents of each SI unit.
-    class unit {
+    // Pool of worker threads used to split large operations across cores.
+    // Every thread has its own deque of tasks. A thread works through its own deque from the back and
+    // steals from the front of the others when it runs out, so load balances without a central queue.
+    // The library owns one shared pool, and nested parallel loops run on the same threads.
+    class thread_pool {
     private:
-        int8_t si[7];
+        // A parallel_for call in progress
+        struct job {
+            const std::function<void(int, int)>* f;
+            int grain;
+            std::atomic<int> remaining;
+            std::atomic<bool> failed;
+            std::mutex error_mutex;
+            std::exception_ptr error;
+        };
+
+        // A range of a job waiting to run
+        struct task {
+            job* owner;
+            int begin;
+            int end;
+        };
+
+        // Tasks of one thread. Threads outside the pool share the first deque.
+        struct task_queue {
+            std::mutex mutex;
+            std::deque<task> tasks;
+        };
+
+        std::vector<std::thread> workers;
+        std::vector<std::unique_ptr<task_queue>> queues;
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::atomic<int> queued;
+        int sleeping;
+        bool stopping;
 
     public:
-        explicit unit(std::vector<int8_t> si_units = {0,0,0,0,0,0,0});
+        explicit thread_pool(int threads = 0);
+        ~thread_pool();
 
-        // Conversions
-        operator std::string() const;
-        explicit operator std::vector<int8_t>() const;
+        // Number of threads working on a parallel_for, including the calling thread.
+        int size() const;
 
-        // Operators
-        unit operator*(unit x) const;
-        unit operator/(unit x) const;
-        unit operator^(int x) const;
+        // Sets the number of threads. 0 uses one per hardware thread.
+        // Must not be called while the pool is running work.
+        void resize(int threads);
+
+        // Calls f(begin, end) on ranges covering [0, n) in parallel and waits for all of them.
+        // Ranges are halved, leaving the upper half for other threads to steal, down to about a quarter of an
+        // even share per thread.
+        // While waiting, the calling thread runs tasks itself. The first exception thrown by f is rethrown here,
+        // and ranges that have not started by then are skipped.
+        void parallel_for(int n, const std::function<void(int, int)>& f);
+
+        // Returns the pool shared by the library.
+        static thread_pool& shared();
 
-        bool operator<(unit x) const;
-        bool operator==(unit x) const;
-        bool operator!=(unit x) const;
+    private:
+        void start(int threads);
+        void stop();
+        void work(int index);
+
+        int queue_index() const;
+        void push(const task& t);
+        bool pop(task& t);
+        void run(task t);
     };
-    std::ostream& operator<<(std::ostream& os, const unit& u);
 
-    // SI Units
-    const unit M = unit(std::vector<int8_t>{1,0,0,0,0,0,0}); // Metre
-    const unit KG = unit(std::vector<int8_t>{0,1,0,0,0,0,0}); // Kilogram
-    const unit S = unit(std::vector<int8_t>{0,0,1,0,0,0,0}); // Second
-    const unit A = unit(std::vector<int8_t>{0,0,0,1,0,0,0}); // Ampere
-    const unit K = unit(std::vector<int8_t>{0,0,0,0,1,0,0}); // Kelvin
-    const unit CD = unit(std::vector<int8_t>{0,0,0,0,0,1,0}); // Candela
-    const unit MOL = unit(std::vector<int8_t>{0,0,0,0,0,0,1}); // Mole
+    // Sets the number of threads used by the library. 0 uses one per hardware thread.
+    void set_threads(int threads);
+    int get_threads();
 
-    // Derived units
-    const unit HZ = S^-1; // Hertz
-    const unit N = KG * M / (S^2); // Newton
-    const unit J = N * M; // Joule
-    const unit W = J / S; // Watt
-    const unit PA = N / (M^2); // Pascal
-    const unit V = W / A; // Volt
-    const unit C = A * S; // Coulomb
-    const unit OHM = V / A; // Ohm
-    const unit F = C / V; // Farad
-    const unit H = OHM * S; // Henry
-    const unit SIEMENS = A / V; // Siemens
-    const unit WB = V * S; // Weber
-    const unit T = WB / (M^2); // Tesla
+    // Operations doing less work than this run on the calling thread.
+    // Work is counted in elements for element-wise operations and in multiply-adds for products.
+    void set_parallel_threshold(long work);
+    long get_parallel_threshold();
+
+    // Runs f(begin, end) over [0, n) on the shared pool if work reaches the parallel threshold,
+    // and as a single call f(0, n) on the calling thread otherwise.
+    template <typename F>
+    void parallel_for(int n, long work, F&& f);
+
+    // Runs f(begin, end) over [0, n) on the shared pool.
+    template <typename F>
+    void parallel_for(int n, F&& f);
+
+    // Calls f(i) for every i in [0, n) on the shared pool and returns the results in order.
+    template <typename F>
+    auto parallel_map(int n, F&& f) -> std::vector<typename std::decay<decltype(f(0))>::type>;
 }
 
-// end --- unit.h --- 
 
+// end --- thread_pool.h --- 
 
 
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <optional>
 
-namespace physics {
-    // Represents a physical value with dimension.
-    class val {
-    public:
-        matrix v; // Value
-        int8_t e; // Exponent
-        unit u; // Unit
 
-    public:
-        val(long double v);
-        val(matrix v);
-        val(matrix v, unit u = unit());
-        val(matrix v, int8_t e, unit u = unit());
+// Pool the current thread works for, and the index of its task queue in that pool
+inline thread_local const physics::thread_pool* current_pool = nullptr;
+inline thread_local int current_queue = 0;
+inline std::atomic<long> parallel_threshold(1 << 18);
 
-        // Conversions
-        std::string operator+(std::string x) const;
-        operator std::string() const;
-        explicit operator int() const;
-        explicit operator float() const;
-        explicit operator double() const;
-        explicit operator long double() const;
-        explicit operator unit() const;
+inline physics::thread_pool::thread_pool(int threads) : queued(0), sleeping(0), stopping(false) {
+    start(threads);
+}
+inline physics::thread_pool::~thread_pool() {
+    stop();
+}
 
-        // Operators
-        val operator+(val x) const;
-        val operator-(val x) const;
-        val operator*(val x) const;
-        val operator*(unit x) const;
-        val operator/(val x) const;
-        val operator/(unit x) const;
-        val operator^(double x) const;
+inline int physics::thread_pool::size() const { return workers.size() + 1; }
 
-        val operator+=(val x);
-        val operator-=(val x);
+inline void physics::thread_pool::resize(int threads) {
+    stop();
+    start(threads);
+}
 
-        bool operator<(val x) const;
-        bool operator>(val x) const;
-        bool operator<=(val x) const;
-        bool operator>=(val x) const;
-        bool operator==(val x) const;
-        bool operator!=(val x) const;
+inline void physics::thread_pool::parallel_for(int n, const std::function<void(int, int)>& f) {
+    if(n <= 0) return;
+    if(size() == 1) {
+        f(0, n);
+        return;
+    }
 
-        // Transpose
-        val T();
+    job j;
+    j.f = &f;
+    j.grain = std::max(1, n / (4 * size()));
+    j.remaining = n;
+    j.failed = false;
+    run(task{&j, 0, n});
+
+    // Helps with any queued work until the job is done
+    while(j.remaining > 0) {
+        task t;
+        if(pop(t)) {
+            run(t);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        sleeping++;
+        wake.wait(lock, [&]() { return j.remaining == 0 || queued > 0; });
+        sleeping--;
+    }
+    if(j.error) std::rethrow_exception(j.error);
+}
 
-    private:
-        void calculate_exponent();
-        std::string get_prefix() const;
-    };
+inline physics::thread_pool& physics::thread_pool::shared() {
+    static thread_pool pool;
+    return pool;
+}
 
-    // Additional operators
-    val operator*(val x, long double y);
-    val operator*(long double x, val y);
-    val operator/(val x, long double y);
-    val operator/(long double x, val y);
+inline void physics::thread_pool::start(int threads) {
+    if(threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    stopping = false;
+    queues.clear();
+    for(int i = 0; i < threads; i++) queues.emplace_back(new task_queue());
+    for(int i = 1; i < threads; i++) workers.emplace_back([this, i]() { work(i); });
+}
 
-    // Conversion operators
-    val operator*(matrix x, unit y);
-    val operator/(matrix x, unit y);
-    std::string operator+(std::string x, val y);
-    std::ostream& operator<<(std::ostream& os, const val& v);
+inline void physics::thread_pool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for(std::thread& worker : workers) worker.join();
+    workers.clear();
+}
 
-    val abs(val v);
-    val cross(val v1, val v2);
+inline void physics::thread_pool::work(int index) {
+    current_pool = this;
+    current_queue = index;
+    while(true) {
+        task t;
+        if(pop(t)) {
+            run(t);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        sleeping++;
+        wake.wait(lock, [this]() { return stopping || queued > 0; });
+        sleeping--;
+        if(stopping) return;
+    }
+}
 
-    // Suffixes
-    val operator ""_Y(long double); // Yotta
-    val operator ""_Z(long double); // Zetta
-    val operator ""_E(long double); // Exa
-    val operator ""_P(long double); // Peta
-    val operator ""_T(long double); // Tera
-    val operator ""_G(long double); // Giga
-    val operator ""_M(long double); // Mega
-    val operator ""_k(long double); // Kilo
-    val operator ""_h(long double); // Hecto
-    val operator ""_da(long double); // Deca
-    val operator ""_d(long double); // Deci
-    val operator ""_c(long double); // Centi
+inline int physics::thread_pool::queue_index() const {
+    return current_pool == this ? current_queue : 0;
+}
+
+inline void physics::thread_pool::push(const task& t) {
+    task_queue& q = *queues[queue_index()];
+    {
+        std::lock_guard<std::mutex> lock(q.mutex);
+        q.tasks.push_back(t);
+        queued++;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    if(sleeping > 0) wake.notify_one();
+}
+
+inline bool physics::thread_pool::pop(task& t) {
+    // Newest task of this thread first, which is the smallest and most likely in cache
+    int own = queue_index();
+    {
+        task_queue& q = *queues[own];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if(!q.tasks.empty()) {
+            t = q.tasks.back();
+            q.tasks.pop_back();
+            queued--;
+            return true;
+        }
+    }
+
+    // Otherwise the oldest, and largest, task of another thread
+    if(queued == 0) return false;
+    for(int i = 1; i < (int)queues.size(); i++) {
+        task_queue& q = *queues[(own + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if(!q.tasks.empty()) {
+            t = q.tasks.front();
+            q.tasks.pop_front();
+            queued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+inline void physics::thread_pool::run(task t) {
+    job& j = *t.owner;
+
+    // Leaves the upper half of large ranges for other threads to steal
+    while(t.end - t.begin > j.grain) {
+        int middle = t.begin + (t.end - t.begin) / 2;
+        push(task{&j, middle, t.end});
+        t.end = middle;
+    }
+    int n = t.end - t.begin;
+
+    if(!j.failed) {
+        try {
+            (*j.f)(t.begin, t.end);
+        }
+        catch(...) {
+            std::lock_guard<std::mutex> lock(j.error_mutex);
+            if(!j.error) j.error = std::current_exception();
+            j.failed = true;
+        }
+    }
+
+    // The job may be gone once the last range is counted
+    if(j.remaining.fetch_sub(n) == n) {
+        std::lock_guard<std::mutex> lock(mutex);
+        wake.notify_all();
+    }
+}
+
+
+inline void physics::set_threads(int threads) { thread_pool::shared().resize(threads); }
+inline int physics::get_threads() { return thread_pool::shared().size(); }
+
+inline void physics::set_parallel_threshold(long work) { parallel_threshold = work; }
+inline long physics::get_parallel_threshold() { return parallel_threshold; }
+
+template <typename F>
+inline void physics::parallel_for(int n, long work, F&& f) {
+    if(work < parallel_threshold) {
+        f(0, n);
+        return;
+    }
+    thread_pool::shared().parallel_for(n, std::ref(f));
+}
+
+template <typename F>
+inline void physics::parallel_for(int n, F&& f) {
+    thread_pool::shared().parallel_for(n, std::ref(f));
+}
+
+template <typename F>
+inline auto physics::parallel_map(int n, F&& f) -> std::vector<typename std::decay<decltype(f(0))>::type> {
+    typedef typename std::decay<decltype(f(0))>::type result;
+
+    // Results are collected out of order, so they are held in optionals until all are done
+    std::vector<std::optional<result>> results(std::max(n, 0));
+    thread_pool::shared().parallel_for(n, [&](int begin, int end) {
+        for(int i = begin; i < end; i++) results[i].emplace(f(i));
+    });
+
+    std::vector<result> out;
+    out.reserve(results.size());
+    for(std::optional<result>& x : results) out.push_back(std::move(*x));
+    return out;
+}
+
+
+// end --- thread_pool.cpp --- 
+
+
+
+// begin --- gemm.cpp --- 
+
+
+
+// begin --- gemm.h --- 
+
+#pragma once
+
+
+
+
+namespace physics {
+    // Computes c = a * b, where a is m x k, b is k x n and c is m x n.
+    // All arrays are row-major, with lda, ldb and ldc the distances between the starts of their rows.
+    // Large products are cache-blocked into packed panels and computed by a register-blocked micro-kernel,
+    // which uses AVX2 or AVX-512 when scalar is double or float and the compiler targets them.
+    // Products above the parallel threshold are split across the shared thread pool by blocks of rows.
+    // With transpose_a, a is read as the transpose of the k x m array at a, and likewise b with transpose_b.
+    // Transposes cost nothing extra, as they are read while packing.
+    void gemm(int m, int n, int k, const scalar* a, int lda, const scalar* b, int ldb, scalar* c, int ldc,
+              bool transpose_a = false, bool transpose_b = false);
+
+    // Computes c += alpha * a * b, with the same layout as gemm.
+    void gemm_update(int m, int n, int k, scalar alpha, const scalar* a, int lda, const scalar* b, int ldb, scalar* c, int ldc,
+                     bool transpose_a = false, bool transpose_b = false);
+}
+
+
+// end --- gemm.h --- 
+
+
+
+#include <algorithm>
+#include <vector>
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#endif
+
+
+namespace physics {
+    namespace kernel {
+        // Register block (mr x nr) of the micro-kernel, and cache blocks of the packed panels.
+        // An mc x kc panel of a is sized for L2, a kc x nr sliver of b for L1.
+        template <typename T>
+        struct blocking {
+            static constexpr int mr = 4;
+            static constexpr int nr = 4;
+            static constexpr int mc = 64;
+            static constexpr int kc = 128;
+            static constexpr int nc = 1024;
+        };
+
+        // Computes the tile c += a * b from an mr wide panel of a and an nr wide panel of b.
+        template <typename T>
+        inline void micro_kernel(int kc, const T* a, const T* b, T* c, int ldc) {
+            const int mr = blocking<T>::mr;
+            const int nr = blocking<T>::nr;
+
+            T acc[mr][nr] = {};
+            for(int p = 0; p < kc; p++) {
+                for(int i = 0; i < mr; i++) {
+                    for(int j = 0; j < nr; j++) {
+                        acc[i][j] += a[i] * b[j];
+                    }
+                }
+                a += mr;
+                b += nr;
+            }
+
+            for(int i = 0; i < mr; i++) {
+                for(int j = 0; j < nr; j++) {
+                    c[i * ldc + j] += acc[i][j];
+                }
+            }
+        }
+
+        // Same as micro_kernel, keeping the tile in SIMD registers of type V.
+        template <typename V, typename T>
+        inline void simd_micro_kernel(int kc, const T* a, const T* b, T* c, int ldc) {
+            const int mr = blocking<T>::mr;
+            const int nv = blocking<T>::nr / V::width;
+
+            typename V::reg acc[mr][nv];
+            for(int i = 0; i < mr; i++) {
+                for(int v = 0; v < nv; v++) acc[i][v] = V::zero();
+            }
+
+            for(int p = 0; p < kc; p++) {
+                typename V::reg bv[nv];
+                for(int v = 0; v < nv; v++) bv[v] = V::load(b + v * V::width);
+                for(int i = 0; i < mr; i++) {
+                    typename V::reg ai = V::broadcast(a[i]);
+                    for(int v = 0; v < nv; v++) acc[i][v] = V::fma(ai, bv[v], acc[i][v]);
+                }
+                a += mr;
+                b += blocking<T>::nr;
+            }
+
+            for(int i = 0; i < mr; i++) {
+                for(int v = 0; v < nv; v++) {
+                    T* ci = c + i * ldc + v * V::width;
+                    V::store(ci, V::add(V::load(ci), acc[i][v]));
+                }
+            }
+        }
+
+#if defined(__AVX512F__)
+        struct simd_double {
+            typedef __m512d reg;
+            static constexpr int width = 8;
+            static reg zero() { return _mm512_setzero_pd(); }
+            static reg load(const double* p) { return _mm512_loadu_pd(p); }
+            static void store(double* p, reg x) { _mm512_storeu_pd(p, x); }
+            static reg broadcast(double x) { return _mm512_set1_pd(x); }
+            static reg add(reg x, reg y) { return _mm512_add_pd(x, y); }
+            static reg fma(reg x, reg y, reg z) { return _mm512_fmadd_pd(x, y, z); }
+        };
+        struct simd_float {
+            typedef __m512 reg;
+            static constexpr int width = 16;
+            static reg zero() { return _mm512_setzero_ps(); }
+            static reg load(const float* p) { return _mm512_loadu_ps(p); }
+            static void store(float* p, reg x) { _mm512_storeu_ps(p, x); }
+            static reg broadcast(float x) { return _mm512_set1_ps(x); }
+            static reg add(reg x, reg y) { return _mm512_add_ps(x, y); }
+            static reg fma(reg x, reg y, reg z) { return _mm512_fmadd_ps(x, y, z); }
+        };
+
+        template <> struct blocking<double> {
+            static constexpr int mr = 8, nr = 16, mc = 96, kc = 256, nc = 4096;
+        };
+        template <> struct blocking<float> {
+            static constexpr int mr = 8, nr = 32, mc = 96, kc = 384, nc = 4096;
+        };
+#define PHYSICS_GEMM_SIMD
+#elif defined(__AVX2__) && defined(__FMA__)
+        struct simd_double {
+            typedef __m256d reg;
+            static constexpr int width = 4;
+            static reg zero() { return _mm256_setzero_pd(); }
+            static reg load(const double* p) { return _mm256_loadu_pd(p); }
+            static void store(double* p, reg x) { _mm256_storeu_pd(p, x); }
+            static reg broadcast(double x) { return _mm256_set1_pd(x); }
+            static reg add(reg x, reg y) { return _mm256_add_pd(x, y); }
+            static reg fma(reg x, reg y, reg z) { return _mm256_fmadd_pd(x, y, z); }
+        };
+        struct simd_float {
+            typedef __m256 reg;
+            static constexpr int width = 8;
+            static reg zero() { return _mm256_setzero_ps(); }
+            static reg load(const float* p) { return _mm256_loadu_ps(p); }
+            static void store(float* p, reg x) { _mm256_storeu_ps(p, x); }
+            static reg broadcast(float x) { return _mm256_set1_ps(x); }
+            static reg add(reg x, reg y) { return _mm256_add_ps(x, y); }
+            static reg fma(reg x, reg y, reg z) { return _mm256_fmadd_ps(x, y, z); }
+        };
+
+        template <> struct blocking<double> {
+            static constexpr int mr = 6, nr = 8, mc = 72, kc = 256, nc = 4096;
+        };
+        template <> struct blocking<float> {
+            static constexpr int mr = 6, nr = 16, mc = 72, kc = 384, nc = 4096;
+        };
+#define PHYSICS_GEMM_SIMD
+#endif
+
+#ifdef PHYSICS_GEMM_SIMD
+#undef PHYSICS_GEMM_SIMD
+        template <>
+        inline void micro_kernel<double>(int kc, const double* a, const double* b, double* c, int ldc) {
+            simd_micro_kernel<simd_double>(kc, a, b, c, ldc);
+        }
+        template <>
+        inline void micro_kernel<float>(int kc, const float* a, const float* b, float* c, int ldc) {
+            simd_micro_kernel<simd_float>(kc, a, b, c, ldc);
+        }
+#endif
+
+        // Element (i, j) of an operand is at i * row_step + j * col_step, which reads transposes in place
+        struct operand {
+            const scalar* data;
+            int row_step;
+            int col_step;
+
+            operand(const scalar* data, int ld, bool transposed) : data(data), row_step(transposed ? 1 : ld), col_step(transposed ? ld : 1) {}
+            const scalar* at(int i, int j) const { return data + (long)i * row_step + (long)j * col_step; }
+            // The block starting at element (i, j)
+            operand from(int i, int j) const { operand o = *this; o.data = at(i, j); return o; }
+        };
+
+        // Copies an m x k block of alpha * a into panels of mr rows, each stored column by column.
+        // Rows past the end of the block are padded with zeros.
+        inline void pack_a(int m, int k, scalar alpha, operand a, scalar* out) {
+            const int mr = blocking<scalar>::mr;
+            for(int ir = 0; ir < m; ir += mr) {
+                int rows = std::min(mr, m - ir);
+                if(a.row_step == 1) {
+                    // Transposed: the rows of a panel are contiguous
+                    for(int p = 0; p < k; p++) {
+                        const scalar* ap = a.at(ir, p);
+                        for(int i = 0; i < rows; i++) *out++ = alpha * ap[i];
+                        for(int i = rows; i < mr; i++) *out++ = 0;
+                    }
+                    continue;
+                }
+                for(int p = 0; p < k; p++) {
+                    for(int i = 0; i < rows; i++) *out++ = alpha * *a.at(ir + i, p);
+                    for(int i = rows; i < mr; i++) *out++ = 0;
+                }
+            }
+        }
+
+        // Copies a k x n block of b into panels of nr columns, each stored row by row.
+        // Columns past the end of the block are padded with zeros.
+        inline void pack_b(int k, int n, operand b, scalar* out) {
+            const int nr = blocking<scalar>::nr;
+            for(int jr = 0; jr < n; jr += nr) {
+                int cols = std::min(nr, n - jr);
+                if(b.col_step != 1) {
+                    // Transposed: each column is contiguous, so the panel is written a column at a time
+                    for(int j = 0; j < cols; j++) {
+                        const scalar* bj = b.at(0, jr + j);
+                        for(int p = 0; p < k; p++) out[p * nr + j] = bj[p];
+                    }
+                    for(int p = 0; p < k; p++) {
+                        for(int j = cols; j < nr; j++) out[p * nr + j] = 0;
+                    }
+                    out += k * nr;
+                    continue;
+                }
+                for(int p = 0; p < k; p++) {
+                    const scalar* bp = b.at(p, jr);
+                    for(int j = 0; j < cols; j++) *out++ = bp[j];
+                    for(int j = cols; j < nr; j++) *out++ = 0;
+                }
+            }
+        }
+
+        // Accumulates c += alpha * a * b through packed panels.
+        inline void gemm_blocked(int m, int n, int k, scalar alpha, operand a, operand b, scalar* c, int ldc) {
+            typedef blocking<scalar> block;
+
+            // Packed panels are kept per thread between calls
+            thread_local std::vector<scalar> a_pack(block::mc * block::kc);
+            thread_local std::vector<scalar> b_pack(block::kc * block::nc);
+
+            for(int jc = 0; jc < n; jc += block::nc) {
+                int nc = std::min(block::nc, n - jc);
+                for(int pc = 0; pc < k; pc += block::kc) {
+                    int kc = std::min(block::kc, k - pc);
+                    pack_b(kc, nc, b.from(pc, jc), b_pack.data());
+
+                    for(int ic = 0; ic < m; ic += block::mc) {
+                        int mc = std::min(block::mc, m - ic);
+                        pack_a(mc, kc, alpha, a.from(ic, pc), a_pack.data());
+
+                        for(int jr = 0; jr < nc; jr += block::nr) {
+                            for(int ir = 0; ir < mc; ir += block::mr) {
+                                const scalar* ap = a_pack.data() + ir * kc;
+                                const scalar* bp = b_pack.data() + jr * kc;
+                                scalar* ct = c + (ic + ir) * ldc + jc + jr;
+
+                                // Edge tiles are computed into a full tile and copied out
+                                int rows = std::min(block::mr, mc - ir);
+                                int cols = std::min(block::nr, nc - jr);
+                                if(rows == block::mr && cols == block::nr) {
+                                    micro_kernel<scalar>(kc, ap, bp, ct, ldc);
+                                    continue;
+                                }
+
+                                scalar tile[block::mr * block::nr] = {};
+                                micro_kernel<scalar>(kc, ap, bp, tile, block::nr);
+                                for(int i = 0; i < rows; i++) {
+                                    for(int j = 0; j < cols; j++) ct[i * ldc + j] += tile[i * block::nr + j];
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+inline void physics::gemm(int m, int n, int k, const scalar* a, int lda, const scalar* b, int ldb, scalar* c, int ldc,
+                          bool transpose_a, bool transpose_b) {
+    for(int i = 0; i < m; i++) std::fill(c + i * ldc, c + i * ldc + n, 0);
+    gemm_update(m, n, k, 1, a, lda, b, ldb, c, ldc, transpose_a, transpose_b);
+}
+
+inline void physics::gemm_update(int m, int n, int k, scalar alpha, const scalar* a, int lda, const scalar* b, int ldb, scalar* c, int ldc,
+                                 bool transpose_a, bool transpose_b) {
+    typedef kernel::blocking<scalar> block;
+
+    if(m == 0 || n == 0 || k == 0) return;
+    kernel::operand ao(a, lda, transpose_a), bo(b, ldb, transpose_b);
+
+    // Packing does not pay off for small products
+    if((long)m * n * k <= 32 * 32 * 32) {
+        for(int i = 0; i < m; i++) {
+            scalar* ci = c + i * ldc;
+            if(transpose_b) {
+                // Columns of b are contiguous, so each element is a dot product
+                for(int j = 0; j < n; j++) {
+                    const scalar* bj = bo.at(0, j);
+                    scalar sum = 0;
+                    for(int p = 0; p < k; p++) sum += *ao.at(i, p) * bj[p];
+                    ci[j] += alpha * sum;
+                }
+                continue;
+            }
+            for(int p = 0; p < k; p++) {
+                scalar x = alpha * *ao.at(i, p);
+                const scalar* bp = bo.at(p, 0);
+                for(int j = 0; j < n; j++) ci[j] += x * bp[j];
+            }
+        }
+        return;
+    }
+
+    // Threads take whole mc row blocks, so every element is computed the same way on any number of threads
+    int blocks = (m + block::mc - 1) / block::mc;
+    parallel_for(blocks, (long)m * n * k, [&](int begin, int end) {
+        int row = begin * block::mc;
+        int rows = std::min(end * block::mc, m) - row;
+        kernel::gemm_blocked(rows, n, k, alpha, ao.from(row, 0), bo, c + row * ldc, ldc);
+    });
+}
+
+
+// end --- gemm.cpp --- 
+
+
+
+// begin --- matrix.cpp --- 
+
+
+
+// begin --- matrix.h --- 
+
+#pragma once
+
+
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace physics {
+    // Base of the lazily evaluated element-wise matrix expressions in expression.h.
+    struct matrix_expression {};
+    struct matrix_transpose;
+    struct matrix_view;
+
+    // Represents a dense matrix.
+    // Elements are stored contiguously in row-major order, with row i starting at data[i * stride].
+    // Any number of threads may read the same matrix at once, but not while another thread modifies it.
+    struct matrix {
+    public:
+        buffer data;
+        int n_rows = 0;
+        int n_cols = 0;
+        int stride = 0;
+
+        int rows() const;
+        int cols() const;
+        scalar first() const;
+        int size() const;
+
+        bool is_scalar() const;
+        bool is_vector() const;
+        bool is_square() const;
+
+        // Element access
+        scalar& operator()(int i, int j);
+        scalar operator()(int i, int j) const;
+        scalar* row(int i);
+        const scalar* row(int i) const;
+
+    public:
+        matrix();
+        matrix(scalar value);
+        matrix(std::vector<scalar> values);
+        matrix(std::vector<std::vector<scalar>> values);
+
+        // Evaluates an element-wise expression in a single pass.
+        template <typename E, typename = typename std::enable_if<std::is_base_of<matrix_expression, E>::value>::type>
+        matrix(const E& e);
+        template <typename E, typename = typename std::enable_if<std::is_base_of<matrix_expression, E>::value>::type>
+        matrix& operator=(const E& e);
+
+        // Returns a rows x cols matrix filled with zeros.
+        static matrix zeros(int rows, int cols);
+        // Returns the n x n identity matrix.
+        static matrix identity(int n);
+
+        std::string operator+(const std::string& x) const;
+        operator std::string() const;
+        explicit operator int() const;
+        explicit operator float() const;
+        explicit operator double() const;
+        explicit operator long double() const;
+
+        // Sums, differences and scaling are lazy, see expression.h
+        matrix operator*(const matrix& m) const;
+        matrix operator/(const matrix& m) const;
+        // Integer powers by repeated squaring. Negative powers are powers of the inverse, and half-integer
+        // ones powers of sqrtm.
+        matrix operator^(double) const;
+
+        // Compound assignment updates the matrix in place
+        matrix& operator+=(const matrix& m);
+        matrix& operator-=(const matrix& m);
+        matrix& operator*=(scalar x);
+        matrix& operator*=(const matrix& m);
+        matrix& operator/=(scalar x);
+
+        bool operator==(const matrix& m) const;
+        bool operator!=(const matrix& m) const;
+
+        // Transpose, as a view of this matrix, see expression.h
+        matrix_transpose T() const;
+
+        // Writable views of part of this matrix, see view.h
+        matrix_view block(int i, int j, int rows, int cols);
+        matrix_view row_view(int i);
+        matrix_view column_view(int j);
+    };
+
+    std::string operator+(const std::string& x, const matrix& m);
+    std::ostream& operator<<(std::ostream &os, const matrix &m);
+
+    // Takes m by value so that an expiring matrix is updated in place
+    matrix abs(matrix m);
+    matrix cross(const matrix& m1, const matrix& m2);
+}
+
+
+// end --- matrix.h --- 
+
+
+
+
+// begin --- fixed_matrix.h --- 
+
+#pragma once
+
+
+#include <initializer_list>
+#include <type_traits>
+
+
+namespace physics {
+    // Represents a matrix whose size is known at compile time.
+    // Elements are stored inline in row-major order, so no operation allocates, and loops
+    // over the fixed bounds are unrolled by the compiler.
+    template <int R, int C>
+    struct fixed_matrix {
+    public:
+        scalar data[R * C];
+
+        static constexpr int rows() { return R; }
+        static constexpr int cols() { return C; }
+        static constexpr int size() { return R * C; }
+
+        scalar& operator()(int i, int j);
+        scalar operator()(int i, int j) const;
+        scalar& operator[](int i);
+        scalar operator[](int i) const;
+
+    public:
+        fixed_matrix();
+        fixed_matrix(std::initializer_list<scalar> values);
+        fixed_matrix(std::initializer_list<std::initializer_list<scalar>> values);
+        explicit fixed_matrix(const matrix& m);
+
+        // Conversions
+        operator matrix() const;
+
+        // Operators
+        fixed_matrix operator+(const fixed_matrix& m) const;
+        fixed_matrix operator-(const fixed_matrix& m) const;
+        fixed_matrix operator*(scalar x) const;
+        fixed_matrix operator/(scalar x) const;
+
+        bool operator==(const fixed_matrix& m) const;
+        bool operator!=(const fixed_matrix& m) const;
+
+        // Transpose
+        fixed_matrix<C, R> T() const;
+    };
+
+    template <int R, int K, int C>
+    fixed_matrix<R, C> operator*(const fixed_matrix<R, K>& a, const fixed_matrix<K, C>& b);
+    // Vectors are automatically transposed. A 1x1 matrix times a 1x1 matrix is the ordinary product above.
+    template <int N, typename = typename std::enable_if<(N > 1)>::type>
+    fixed_matrix<1, N> operator*(const fixed_matrix<N, N>& a, const fixed_matrix<1, N>& v);
+    template <int R, int C>
+    fixed_matrix<R, C> operator*(scalar x, const fixed_matrix<R, C>& m);
+
+    template <int R, int C>
+    fixed_matrix<R, C> abs(const fixed_matrix<R, C>& m);
+    template <int R, int C>
+    fixed_matrix<R, C> cross(const fixed_matrix<R, C>& a, const fixed_matrix<R, C>& b);
+
+    typedef fixed_matrix<1, 1> mat1;
+    typedef fixed_matrix<1, 3> vec3;
+    typedef fixed_matrix<3, 3> mat3;
+    typedef fixed_matrix<1, 4> vec4;
+    typedef fixed_matrix<4, 4> mat4;
+}
+
+
+// end --- fixed_matrix.h --- 
+
+
+
+
+// begin --- decomposition.h --- 
+
+#pragma once
+
+
+
+
+// begin --- unit.h --- 
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace physics {
+    // Represents a physical dimension.
+    // Packs the int8_t exponents of each SI unit into one 64-bit word, with the exponent of unit i in
+    // byte 6 - i. Arithmetic works on all exponents at once, and comparisons are single word compares.
+    // Units hold no shared state, so they can be used from any number of threads at once.
+    class unit {
+    private:
+        uint64_t bits;
+
+        static constexpr uint64_t high = 0x0080808080808080; // Sign bit of each exponent
+
+        static constexpr uint64_t lane(int exponent, int i) { return (uint64_t)(uint8_t)exponent << (8 * (6 - i)); }
+        static constexpr unit from_bits(uint64_t bits) { unit u; u.bits = bits; return u; }
+
+    public:
+        constexpr unit() : bits(0) {}
+        constexpr unit(int m, int kg, int s, int a, int k, int cd, int mol)
+            : bits(lane(m, 0) | lane(kg, 1) | lane(s, 2) | lane(a, 3) | lane(k, 4) | lane(cd, 5) | lane(mol, 6)) {}
+        explicit unit(const std::vector<int8_t>& si_units);
+
+        // Exponent of SI unit i, in the order m, kg, s, A, K, cd, mol
+        constexpr int8_t exponent(int i) const { return (int8_t)(bits >> (8 * (6 - i))); }
+
+        // Returns the name of the unit, e.g. "N" or "ms⁻¹".
+        // Named units are looked up in a fixed table, and names built from base units are cached per thread.
+        // The view stays valid while the calling thread runs, or, once a thread has built 4096 names,
+        // until its next call.
+        std::string_view name() const;
+
+        // Conversions
+        operator std::string() const;
+        explicit operator std::vector<int8_t>() const;
+
+        // Operators
+        // Exponents are added and subtracted without carries crossing into their neighbours
+        constexpr unit operator*(const unit& x) const {
+            return from_bits(((bits & ~high) + (x.bits & ~high)) ^ ((bits ^ x.bits) & high));
+        }
+        constexpr unit operator/(const unit& x) const {
+            return from_bits(((bits | high) - (x.bits & ~high)) ^ ((bits ^ ~x.bits) & high));
+        }
+        constexpr unit operator^(int x) const {
+            uint64_t out = 0;
+            for(int i = 0; i < 7; i++) out |= lane(exponent(i) * x, i);
+            return from_bits(out);
+        }
+
+        // Flipping the sign bits orders units like their lists of exponents
+        constexpr bool operator<(const unit& x) const { return (bits ^ high) < (x.bits ^ high); }
+        constexpr bool operator==(const unit& x) const { return bits == x.bits; }
+        constexpr bool operator!=(const unit& x) const { return bits != x.bits; }
+
+        constexpr size_t hash() const { return (size_t)(bits ^ (bits >> 32)); }
+    };
+    std::ostream& operator<<(std::ostream& os, const unit& u);
+
+    // SI Units
+    inline constexpr unit M = unit(1,0,0,0,0,0,0); // Metre
+    inline constexpr unit KG = unit(0,1,0,0,0,0,0); // Kilogram
+    inline constexpr unit S = unit(0,0,1,0,0,0,0); // Second
+    inline constexpr unit A = unit(0,0,0,1,0,0,0); // Ampere
+    inline constexpr unit K = unit(0,0,0,0,1,0,0); // Kelvin
+    inline constexpr unit CD = unit(0,0,0,0,0,1,0); // Candela
+    inline constexpr unit MOL = unit(0,0,0,0,0,0,1); // Mole
+
+    // Derived units
+    inline constexpr unit HZ = S^-1; // Hertz
+    inline constexpr unit N = KG * M / (S^2); // Newton
+    inline constexpr unit J = N * M; // Joule
+    inline constexpr unit W = J / S; // Watt
+    inline constexpr unit PA = N / (M^2); // Pascal
+    inline constexpr unit V = W / A; // Volt
+    inline constexpr unit C = A * S; // Coulomb
+    inline constexpr unit OHM = V / A; // Ohm
+    inline constexpr unit F = C / V; // Farad
+    inline constexpr unit H = OHM * S; // Henry
+    inline constexpr unit SIEMENS = A / V; // Siemens
+    inline constexpr unit WB = V * S; // Weber
+    inline constexpr unit T = WB / (M^2); // Tesla
+}
+
+namespace std {
+    template <>
+    struct hash<physics::unit> {
+        size_t operator()(const physics::unit& u) const { return u.hash(); }
+    };
+}
+
+
+// end --- unit.h --- 
+
+
+
+
+// begin --- value.h --- 
+
+#pragma once
+
+
+
+#include <charconv>
+
+
+namespace physics {
+    template <typename E> struct val_expr;
+    class val_view;
+
+    // Represents a physical value with dimension.
+    // The value is stored as a mantissa and a decimal exponent matching an SI prefix.
+    // Define PHYSICS_RAW_SI to store plain SI values instead (e is always 0): the prefix is then
+    // only worked out when printing, and arithmetic on vals needs no rescaling.
+    // Like matrices, vals may be read by any number of threads at once, including printing them.
+    class val {
+    public:
+        matrix v; // Value
+        int8_t e; // Exponent
+        unit u; // Unit
+
+    public:
+        val(scalar v);
+        val(matrix v);
+        val(matrix v, unit u = unit());
+        val(matrix v, int8_t e, unit u = unit());
+
+        // Evaluates a lazy sum, difference or scaling of vals, see expression.h
+        template <typename E>
+        val(const val_expr<E>& x);
+
+        // Conversions
+        std::string operator+(const std::string& x) const;
+        operator std::string() const;
+        explicit operator int() const;
+        explicit operator float() const;
+        explicit operator double() const;
+        explicit operator long double() const;
+        explicit operator unit() const;
+
+        // Operators
+        // Sums, differences and scaling are lazy, see expression.h
+        // Expiring vals hand their matrix over to the result
+        val operator*(const unit& x) const &;
+        val operator*(const unit& x) &&;
+        val operator/(const unit& x) const &;
+        val operator/(const unit& x) &&;
+        val operator^(double x) const;
+
+        // Compound assignment updates the value in place
+        val& operator+=(const val& x);
+        val& operator-=(const val& x);
+
+        bool operator<(const val& x) const;
+        bool operator>(const val& x) const;
+        bool operator<=(const val& x) const;
+        bool operator>=(const val& x) const;
+        bool operator==(const val& x) const;
+        bool operator!=(const val& x) const;
+
+        // Transpose, as a view of this value's matrix, see expression.h
+        val_expr<matrix_transpose> T() const;
+
+        // Writable views of part of this value, see view.h
+        val_view block(int i, int j, int rows, int cols);
+        val_view row_view(int i);
+        val_view column_view(int j);
+
+    private:
+        void calculate_exponent();
+        void normalise_exponent();
+
+        friend std::to_chars_result to_chars(char* first, char* last, const val& v, int precision);
+    };
+
+    // Additional operators
+    val operator*(const val& x, const val& y);
+    val operator/(const val& x, const val& y);
+    val operator/(scalar x, const val& y);
+
+    // Conversion operators
+    val operator*(matrix x, const unit& y);
+    val operator/(matrix x, const unit& y);
+    std::string operator+(const std::string& x, const val& y);
+    std::ostream& operator<<(std::ostream& os, const val& v);
+
+    val abs(val v);
+    val cross(const val& v1, const val& v2);
+
+    // 10^n, looked up in a table of exact powers and rounded once. Scaling by it gives the same
+    // results as converting between prefixes of a val.
+    scalar power_of_ten(int n);
+
+    // Suffixes
+    val operator ""_Y(long double); // Yotta
+    val operator ""_Z(long double); // Zetta
+    val operator ""_E(long double); // Exa
+    val operator ""_P(long double); // Peta
+    val operator ""_T(long double); // Tera
+    val operator ""_G(long double); // Giga
+    val operator ""_M(long double); // Mega
+    val operator ""_k(long double); // Kilo
+    val operator ""_h(long double); // Hecto
+    val operator ""_da(long double); // Deca
+    val operator ""_d(long double); // Deci
+    val operator ""_c(long double); // Centi
     val operator ""_m(long double); // Milli
     val operator ""_mu(long double); // Micro
     val operator ""_n(long double); // Nano
@@ -455,355 +1540,4443 @@ namespace physics {
 
 
 
-// end --- value.h --- 
+// end --- value.h --- 
+
+
+#include <vector>
+
+
+namespace physics {
+    // LU factorization with partial pivoting, P A = L U, of a square matrix.
+    // Columns are factorized in panels and the rest of the matrix is updated with gemm, so large
+    // matrices are factorized cache-blocked and in parallel.
+    // A factorization can be kept to solve for any number of right-hand sides.
+    class lu {
+    public:
+        matrix factors; // L below the diagonal, with an implied diagonal of ones, and U on and above it
+        std::vector<int> pivots; // Row i of P A is row pivots[i] of A
+        int sign; // Determinant of P
+        int8_t e; // Exponent of A
+        unit u; // Unit of A
+
+    public:
+        explicit lu(matrix a);
+        explicit lu(const val& a);
+
+        int size() const;
+        bool is_singular() const;
+
+        // Solves A x = b for a vector b, or A X = B for every column of B.
+        // Vector results are returned as row vectors.
+        matrix solve(const matrix& b) const;
+        val solve(const val& b) const;
+
+        scalar det() const;
+        matrix inverse() const;
+    };
+
+    // Cholesky factorization A = L L^T of a symmetric positive definite matrix.
+    // Only the lower triangle of A is read. Blocked like lu, and about twice as fast.
+    class cholesky {
+    public:
+        matrix factors; // L on and below the diagonal, zeros above it
+        int8_t e; // Exponent of A
+        unit u; // Unit of A
+
+    private:
+        matrix transposed; // L^T, for solving against it row by row
+
+    public:
+        explicit cholesky(matrix a);
+        explicit cholesky(const val& a);
+
+        int size() const;
+
+        // Solves A x = b for a vector b, or A X = B for every column of B.
+        matrix solve(const matrix& b) const;
+        val solve(const val& b) const;
+
+        scalar det() const;
+        matrix inverse() const;
+    };
+
+    // Solves L x = b, or L X = B, where L is lower triangular. unit_diagonal treats its diagonal as ones.
+    matrix solve_lower(const matrix& l, const matrix& b, bool unit_diagonal = false);
+    // Solves U x = b, or U X = B, where U is upper triangular.
+    matrix solve_upper(const matrix& u, const matrix& b);
+
+    // Solves A x = b through an LU factorization. The result has the unit of b divided by that of A.
+    matrix solve(const matrix& a, const matrix& b);
+    val solve(const val& a, const val& b);
+
+    scalar det(const matrix& a);
+    val det(const val& a);
+
+    matrix inverse(const matrix& a);
+    val inverse(const val& a);
+
+    // Matrix exponential, by a Pade approximant with scaling and squaring (Higham, 2005), accurate to double
+    // precision. Values must be dimensionless, e.g. A t for a propagator of dx/dt = A x.
+    matrix expm(const matrix& a);
+    val expm(const val& a);
+
+    // Principal square root, for matrices with no eigenvalues on the closed negative real axis, by the
+    // scaled Denman-Beavers iteration. Values take the square root of their unit, which must exist.
+    matrix sqrtm(const matrix& a);
+    val sqrtm(const val& a);
+}
+
+
+// end --- decomposition.h --- 
+
+
+
+
+// begin --- expression.h --- 
+
+#pragma once
+
+
+
+
+#include <algorithm>
+#include <math.h>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+
+namespace physics {
+    // Element-wise arithmetic on matrices and vals builds expressions instead of results.
+    // An expression is evaluated in one pass over the output when it is assigned to a matrix or val,
+    // so a formula like a + b * 2 - c allocates and normalises once rather than at every step.
+    // Expressions refer to their operands, so store them in a matrix or val rather than in auto variables.
+
+    template <typename E>
+    struct is_matrix_expression : std::integral_constant<bool, std::is_same<E, matrix>::value || std::is_base_of<matrix_expression, E>::value> {};
+
+    // Matrices are held by reference, nested expressions by value.
+    template <typename E> struct expression_operand { typedef E type; };
+    template <> struct expression_operand<matrix> { typedef const matrix& type; };
+
+    template <typename L, typename R>
+    struct matrix_sum : matrix_expression {
+        typename expression_operand<L>::type l;
+        typename expression_operand<R>::type r;
+
+        matrix_sum(const L& l, const R& r) : l(l), r(r) {
+            if(l.rows() != r.rows() || l.cols() != r.cols()) throw std::invalid_argument("Incompatible matrices.");
+        }
+        int rows() const { return l.rows(); }
+        int cols() const { return l.cols(); }
+        scalar operator()(int i, int j) const { return l(i, j) + r(i, j); }
+    };
+
+    template <typename L, typename R>
+    struct matrix_difference : matrix_expression {
+        typename expression_operand<L>::type l;
+        typename expression_operand<R>::type r;
+
+        matrix_difference(const L& l, const R& r) : l(l), r(r) {
+            if(l.rows() != r.rows() || l.cols() != r.cols()) throw std::invalid_argument("Incompatible matrices.");
+        }
+        int rows() const { return l.rows(); }
+        int cols() const { return l.cols(); }
+        scalar operator()(int i, int j) const { return l(i, j) - r(i, j); }
+    };
+
+    template <typename E>
+    struct matrix_scaled : matrix_expression {
+        typename expression_operand<E>::type e;
+        scalar x;
+
+        matrix_scaled(const E& e, scalar x) : e(e), x(x) {}
+        int rows() const { return e.rows(); }
+        int cols() const { return e.cols(); }
+        scalar operator()(int i, int j) const { return e(i, j) * x; }
+    };
+
+    // Transpose of a matrix, read in place. Products with it go straight to gemm, and it is only
+    // copied when stored in a matrix, by a blocked transpose.
+    struct matrix_transpose : matrix_expression {
+        const matrix& m;
+
+        explicit matrix_transpose(const matrix& m) : m(m) {}
+        int rows() const { return m.cols(); }
+        int cols() const { return m.rows(); }
+        scalar operator()(int i, int j) const { return m(j, i); }
+
+        // Transpose
+        const matrix& T() const { return m; }
+    };
+
+    // Whether an expression reads elements at other positions than the one it computes, in which case
+    // it can't be evaluated into one of its own operands
+    template <typename E> struct reads_across : std::false_type {};
+    template <> struct reads_across<matrix_transpose> : std::true_type {};
+    template <typename L, typename R> struct reads_across<matrix_sum<L, R>> : std::integral_constant<bool, reads_across<L>::value || reads_across<R>::value> {};
+    template <typename L, typename R> struct reads_across<matrix_difference<L, R>> : std::integral_constant<bool, reads_across<L>::value || reads_across<R>::value> {};
+    template <typename E> struct reads_across<matrix_scaled<E>> : reads_across<E> {};
+
+    // Writes every element of an expression to out, which must have the same size.
+    template <typename E>
+    void evaluate(const E& e, matrix& out) {
+        parallel_for(out.rows(), out.size(), [&](int begin, int end) {
+            for(int i = begin; i < end; i++) {
+                scalar* o = out.row(i);
+                for(int j = 0; j < out.cols(); j++) o[j] = e(i, j);
+            }
+        });
+    }
+
+    // Copies a transpose in square tiles, so both matrices are read and written a cache line at a time.
+    void evaluate(const matrix_transpose& e, matrix& out);
+
+    template <typename L, typename R, typename = typename std::enable_if<is_matrix_expression<L>::value && is_matrix_expression<R>::value>::type>
+    matrix_sum<L, R> operator+(const L& l, const R& r) { return matrix_sum<L, R>(l, r); }
+    template <typename L, typename R, typename = typename std::enable_if<is_matrix_expression<L>::value && is_matrix_expression<R>::value>::type>
+    matrix_difference<L, R> operator-(const L& l, const R& r) { return matrix_difference<L, R>(l, r); }
+    template <typename E, typename = typename std::enable_if<is_matrix_expression<E>::value>::type>
+    matrix_scaled<E> operator*(const E& e, scalar x) { return matrix_scaled<E>(e, x); }
+    template <typename E, typename = typename std::enable_if<is_matrix_expression<E>::value>::type>
+    matrix_scaled<E> operator*(scalar x, const E& e) { return matrix_scaled<E>(e, x); }
+    template <typename E, typename = typename std::enable_if<is_matrix_expression<E>::value>::type>
+    matrix_scaled<E> operator/(const E& e, scalar x) { return matrix_scaled<E>(e, 1/x); }
+
+    // Matrix products need their operands evaluated
+    template <typename L, typename R, typename = typename std::enable_if<is_matrix_expression<L>::value && is_matrix_expression<R>::value &&
+        !(std::is_same<L, matrix>::value && std::is_same<R, matrix>::value)>::type>
+    matrix operator*(const L& l, const R& r) { return matrix(l) * matrix(r); }
+    // except transposes, which gemm reads in place
+    matrix operator*(const matrix_transpose& l, const matrix& r);
+    matrix operator*(const matrix& l, const matrix_transpose& r);
+    matrix operator*(const matrix_transpose& l, const matrix_transpose& r);
+
+    template <typename E, typename = typename std::enable_if<std::is_base_of<matrix_expression, E>::value>::type>
+    std::ostream& operator<<(std::ostream& os, const E& e) { return os << matrix(e); }
+
+
+    // Represents a val whose matrix is an unevaluated expression.
+    // Sums, differences and scaling of vals combine units and exponents as they are built, and the
+    // matrix is computed and normalised once, when the expression is converted to a val.
+    template <typename E>
+    struct val_expr {
+        typename expression_operand<E>::type v; // Value
+        int e; // Exponent
+        unit u; // Unit
+
+        // Conversions
+        operator std::string() const { return (std::string)val(*this); }
+
+        // Operators
+        val operator*(const unit& x) const { return val(*this) * x; }
+        val operator/(const unit& x) const { return val(*this) / x; }
+    };
+
+    template <typename E>
+    val_expr<E> make_val_expr(const E& v, int e, unit u) { return val_expr<E>{v, e, u}; }
+
+    template <typename E> struct is_val_expression : std::false_type {};
+    template <> struct is_val_expression<val> : std::true_type {};
+    template <typename E> struct is_val_expression<val_expr<E>> : std::true_type {};
+
+    template <typename L, typename R, typename = typename std::enable_if<is_val_expression<L>::value && is_val_expression<R>::value>::type>
+    auto operator+(const L& x, const R& y) {
+        if(x.u != y.u) throw std::invalid_argument("Unit Error");
+#ifdef PHYSICS_RAW_SI
+        return make_val_expr(x.v + y.v, 0, x.u);
+#else
+        int exp = std::max<int>(x.e, y.e);
+        return make_val_expr(x.v * pow(10, x.e - exp) + y.v * pow(10, y.e - exp), exp, x.u);
+#endif
+    }
+    template <typename L, typename R, typename = typename std::enable_if<is_val_expression<L>::value && is_val_expression<R>::value>::type>
+    auto operator-(const L& x, const R& y) {
+        if(x.u != y.u) throw std::invalid_argument("Unit Error");
+#ifdef PHYSICS_RAW_SI
+        return make_val_expr(x.v - y.v, 0, x.u);
+#else
+        int exp = std::max<int>(x.e, y.e);
+        return make_val_expr(x.v * pow(10, x.e - exp) - y.v * pow(10, y.e - exp), exp, x.u);
+#endif
+    }
+    template <typename E, typename = typename std::enable_if<is_val_expression<E>::value>::type>
+    auto operator*(const E& x, scalar y) { return make_val_expr(x.v * y, x.e, x.u); }
+    template <typename E, typename = typename std::enable_if<is_val_expression<E>::value>::type>
+    auto operator*(scalar x, const E& y) { return make_val_expr(y.v * x, y.e, y.u); }
+    template <typename E, typename = typename std::enable_if<is_val_expression<E>::value>::type>
+    auto operator/(const E& x, scalar y) { return make_val_expr(x.v / y, x.e, x.u); }
+
+    template <typename E>
+    std::ostream& operator<<(std::ostream& os, const val_expr<E>& x) { return os << val(x); }
+}
+
+
+// end --- expression.h --- 
+
+
+
+
+// begin --- format.h --- 
+
+#pragma once
+
+
+
+#include <charconv>
+#include <string_view>
+
+
+namespace physics {
+    // Digits written after the decimal point by default, the same as std::to_string.
+    inline constexpr int default_precision = 6;
+
+    // Writes the text of a matrix or val to [first, last), like std::to_chars.
+    // precision is the number of digits after the decimal point. A negative precision writes the
+    // shortest text that reads back as the same number. Returns {last, std::errc::value_too_large}
+    // if the text does not fit.
+    std::to_chars_result to_chars(char* first, char* last, const matrix& m, int precision = default_precision);
+    std::to_chars_result to_chars(char* first, char* last, const val& v, int precision = default_precision);
+
+    // Returns the text of a matrix or val, formatted in a buffer owned by the calling thread.
+    // The view is valid until the next call on the same thread. Does not allocate once the buffer
+    // has grown to fit the longest text formatted on the thread.
+    template <typename T>
+    std::string_view format(const T& x, int precision = default_precision);
+
+    // Writes the text of a matrix or val to an output iterator and returns the iterator past the end.
+    template <typename OutputIt, typename T>
+    OutputIt format_to(OutputIt out, const T& x, int precision = default_precision);
+}
+
+
+// end --- format.h --- 
+
+
+
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+#include <math.h>
+
+
+inline int physics::matrix::rows() const { return n_rows; }
+inline int physics::matrix::cols() const { return n_cols; }
+inline physics::scalar physics::matrix::first() const { return data[0]; }
+inline int physics::matrix::size() const { return n_rows * n_cols; }
+
+inline bool physics::matrix::is_scalar() const { return rows() == 1 && cols() == 1; }
+inline bool physics::matrix::is_vector() const { return rows() == 1 || cols() == 1; }
+inline bool physics::matrix::is_square() const { return rows() == cols(); }
+
+inline physics::scalar& physics::matrix::operator()(int i, int j) { return data[i * stride + j]; }
+inline physics::scalar physics::matrix::operator()(int i, int j) const { return data[i * stride + j]; }
+inline physics::scalar* physics::matrix::row(int i) { return data.data() + i * stride; }
+inline const physics::scalar* physics::matrix::row(int i) const { return data.data() + i * stride; }
+
+
+inline physics::matrix::matrix() {}
+inline physics::matrix::matrix(scalar value) : data(1, value), n_rows(1), n_cols(1), stride(1) {}
+inline physics::matrix::matrix(std::vector<scalar> values) : data(values.data(), values.data() + values.size()), n_rows(1) {
+    n_cols = stride = values.size();
+}
+inline physics::matrix::matrix(std::vector<std::vector<scalar>> values) {
+    n_rows = values.size();
+    n_cols = stride = n_rows > 0 ? values[0].size() : 0;
+    data.assign(n_rows * n_cols, 0);
+    for(int i = 0; i < n_rows; i++) {
+        if((int)values[i].size() != n_cols) throw std::invalid_argument("All rows of a matrix must have the same length.");
+        std::copy(values[i].begin(), values[i].end(), row(i));
+    }
+}
+
+template <typename E, typename>
+inline physics::matrix::matrix(const E& e) : data(e.rows() * e.cols()), n_rows(e.rows()), n_cols(e.cols()), stride(e.cols()) {
+    evaluate(e, *this);
+}
+
+template <typename E, typename>
+inline physics::matrix& physics::matrix::operator=(const E& e) {
+    // Elements only depend on the same position of their operands, so the expression may refer to this
+    // matrix, unless it contains a transpose
+    if(reads_across<E>::value || rows() != e.rows() || cols() != e.cols()) return *this = matrix(e);
+    evaluate(e, *this);
+    return *this;
+}
+
+inline physics::matrix physics::matrix::zeros(int rows, int cols) {
+    matrix out;
+    out.data.assign(rows * cols, 0);
+    out.n_rows = rows;
+    out.n_cols = cols;
+    out.stride = cols;
+    return out;
+}
+
+inline physics::matrix physics::matrix::identity(int n) {
+    matrix out = zeros(n, n);
+    for(int i = 0; i < n; i++) out(i, i) = 1;
+    return out;
+}
+
+
+inline std::string physics::matrix::operator+(const std::string& x) const {
+    return (std::string)*this + x;
+}
+
+inline physics::matrix::operator std::string() const {
+    return std::string(format(*this));
+}
+
+inline physics::matrix::operator int() const { return (long double)*this; }
+inline physics::matrix::operator float() const { return (long double)*this; }
+inline physics::matrix::operator double() const { return (long double)*this; }
+inline physics::matrix::operator long double() const {
+    if(!is_scalar()) throw std::invalid_argument("Only 1x1 matrices can be converted to scalar values.");
+    return first();
+}
+
+inline physics::matrix physics::matrix::operator*(const matrix& x) const {
+    // Multiplication by 1x1 matrix should be regarded as scalar multiplication
+    if(x.is_scalar()) return *this * x.first();
+    if(is_scalar()) return first() * x;
+
+    // Automatically transpose vectors
+    if(x.is_vector() && cols() != x.rows() && cols() == x.cols()) return *this * x.T();
+
+    if(cols() != x.rows()) throw std::invalid_argument("Incompatible matrices.");
+
+    // Small products are dispatched to the unrolled fixed size kernels
+    matrix out;
+    if(rows() == 3 && cols() == 3 && x.cols() == 1) out = fixed_matrix<3, 3>(*this) * fixed_matrix<3, 1>(x);
+    else if(rows() == 3 && cols() == 3 && x.cols() == 3) out = fixed_matrix<3, 3>(*this) * fixed_matrix<3, 3>(x);
+    else if(rows() == 4 && cols() == 4 && x.cols() == 4) out = fixed_matrix<4, 4>(*this) * fixed_matrix<4, 4>(x);
+    else {
+        out = zeros(rows(), x.cols());
+        gemm(rows(), x.cols(), cols(), row(0), stride, x.row(0), x.stride, out.row(0), out.stride);
+    }
+
+    // Vector results are returned as row vectors
+    if(out.cols() == 1) {
+        out.n_cols = out.stride = out.n_rows;
+        out.n_rows = 1;
+    }
+    return out;
+}
+
+inline physics::matrix physics::matrix::operator/(const matrix& m) const {
+    if(!m.is_scalar()) throw std::invalid_argument("Dividing by matrix of size other than 1x1 is undefined.");
+    return *this * (1/m.first());
+}
+
+inline physics::matrix physics::matrix::operator^(double x) const {
+    if(is_scalar()) return pow(first(), x);
+    if(!is_square()) throw std::invalid_argument("Exponentiation only possible for square matrices");
+    if(x != std::floor(x)) {
+        if(2 * x != std::floor(2 * x)) throw std::invalid_argument("Only integer and half-integer powers of matrices are defined.");
+        return sqrtm(*this) ^ (2 * x);
+    }
+    // Powers of 2^64 and up don't fit the bit loop below
+    if(std::abs(x) >= std::ldexp(1.0, 64)) throw std::invalid_argument("Matrix power out of range.");
+    if(x < 0) return inverse(*this) ^ -x;
+
+    // Binary exponentiation: the matrix is squared once per bit of x, and multiplied into the result for
+    // each set bit. Each product is written into a spare buffer, which then swaps places with its input.
+    int n = rows();
+    if(x == 0) return identity(n);
+    matrix base = *this, out, scratch = zeros(n, n);
+    bool started = false;
+    for(unsigned long long k = (unsigned long long)x; ; k >>= 1) {
+        if(k & 1) {
+            if(!started) out = base;
+            else {
+                gemm(n, n, n, out.row(0), out.stride, base.row(0), base.stride, scratch.row(0), scratch.stride);
+                std::swap(out, scratch);
+            }
+            started = true;
+        }
+        if(k == 1) return out;
+        gemm(n, n, n, base.row(0), base.stride, base.row(0), base.stride, scratch.row(0), scratch.stride);
+        std::swap(base, scratch);
+    }
+}
+
+
+inline physics::matrix& physics::matrix::operator+=(const matrix& m) {
+    *this = *this + m;
+    return *this;
+}
+
+inline physics::matrix& physics::matrix::operator-=(const matrix& m) {
+    *this = *this - m;
+    return *this;
+}
+
+inline physics::matrix& physics::matrix::operator*=(scalar x) {
+    *this = *this * x;
+    return *this;
+}
+
+inline physics::matrix& physics::matrix::operator*=(const matrix& m) {
+    *this = *this * m;
+    return *this;
+}
+
+inline physics::matrix& physics::matrix::operator/=(scalar x) {
+    *this = *this / x;
+    return *this;
+}
+
+
+inline bool physics::matrix::operator==(const matrix& x) const {
+    // Size check
+    if(rows() != x.rows() || cols() != x.cols()) return false;
+
+    // Value check
+    for(int i = 0; i < rows(); i++) {
+        const scalar* a = row(i);
+        const scalar* b = x.row(i);
+        for(int j = 0; j < cols(); j++) {
+            if(a[j] != b[j]) return false;
+        }
+    }
+
+    return true;
+}
+
+inline bool physics::matrix::operator!=(const matrix& x) const {
+    return !(*this == x);
+}
+
+
+inline physics::matrix_transpose physics::matrix::T() const { return matrix_transpose(*this); }
+
+// Side of the tiles copied by a transpose. A tile of the input and one of the output fit in L1 together.
+inline constexpr int transpose_tile = 32;
+
+inline void physics::evaluate(const matrix_transpose& e, matrix& out) {
+    // Each thread writes its own rows of tiles of the output
+    int tiles = (out.rows() + transpose_tile - 1) / transpose_tile;
+    parallel_for(tiles, out.size(), [&](int begin, int end) {
+        for(int i0 = begin * transpose_tile; i0 < std::min(end * transpose_tile, out.rows()); i0 += transpose_tile) {
+            int i1 = std::min(i0 + transpose_tile, out.rows());
+            for(int j0 = 0; j0 < out.cols(); j0 += transpose_tile) {
+                int j1 = std::min(j0 + transpose_tile, out.cols());
+                for(int j = j0; j < j1; j++) {
+                    const scalar* a = e.m.row(j);
+                    for(int i = i0; i < i1; i++) out(i, j) = a[i];
+                }
+            }
+        }
+    });
+}
+
+// Computes a * b, reading either operand transposed in place
+inline physics::matrix transposed_product(const physics::matrix& a, bool transpose_a, const physics::matrix& b, bool transpose_b) {
+    // Scalars and vectors, which are transposed automatically, and small matrices go through the usual product
+    if(a.is_vector() || b.is_vector() || (a.size() <= physics::buffer::inline_capacity && b.size() <= physics::buffer::inline_capacity)) {
+        return (transpose_a ? physics::matrix(a.T()) : a) * (transpose_b ? physics::matrix(b.T()) : b);
+    }
+    int m = transpose_a ? a.cols() : a.rows(), k = transpose_a ? a.rows() : a.cols();
+    int n = transpose_b ? b.rows() : b.cols();
+    if(k != (transpose_b ? b.cols() : b.rows())) throw std::invalid_argument("Incompatible matrices.");
+
+    physics::matrix out = physics::matrix::zeros(m, n);
+    physics::gemm(m, n, k, a.row(0), a.stride, b.row(0), b.stride, out.row(0), out.stride, transpose_a, transpose_b);
+    return out;
+}
+
+inline physics::matrix physics::operator*(const matrix_transpose& l, const matrix& r) { return transposed_product(l.m, true, r, false); }
+inline physics::matrix physics::operator*(const matrix& l, const matrix_transpose& r) { return transposed_product(l, false, r.m, true); }
+inline physics::matrix physics::operator*(const matrix_transpose& l, const matrix_transpose& r) { return transposed_product(l.m, true, r.m, true); }
+
+
+inline std::string physics::operator+(const std::string& x, const matrix& m) {
+    return x + (std::string)m;
+}
+inline std::ostream& physics::operator<<(std::ostream &os, const matrix &m) {
+    os << format(m);
+    return os;
+}
+
+inline physics::matrix physics::abs(matrix m) {
+    parallel_for(m.rows(), m.size(), [&](int begin, int end) {
+        for(int i = begin; i < end; i++) {
+            scalar* r = m.row(i);
+            for(int j = 0; j < m.cols(); j++) {
+                r[j] = std::abs(r[j]);
+            }
+        }
+    });
+    return m;
+}
+
+inline physics::matrix physics::cross(const matrix& m1, const matrix& m2) {
+    if(!m1.is_vector() || !m2.is_vector() || m1.size() != 3 || m2.size() != 3) throw std::invalid_argument("Cross product only possible for 3D vectors");
+
+    // Read the components regardless of whether the vectors are rows or columns
+    auto at = [](const matrix& m, int k) { return m.rows() == 1 ? m(0, k) : m(k, 0); };
+    scalar a[3] = { at(m1, 0), at(m1, 1), at(m1, 2) };
+    scalar b[3] = { at(m2, 0), at(m2, 1), at(m2, 2) };
+
+    return matrix({
+        a[1] * b[2] - a[2] * b[1],
+        a[2] * b[0] - a[0] * b[2],
+        a[0] * b[1] - a[1] * b[0]
+    });
+}
+
+// end --- matrix.cpp --- 
+
+
+
+// begin --- fixed_matrix.cpp --- 
+
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+
+template <int R, int C>
+inline physics::scalar& physics::fixed_matrix<R, C>::operator()(int i, int j) { return data[i * C + j]; }
+template <int R, int C>
+inline physics::scalar physics::fixed_matrix<R, C>::operator()(int i, int j) const { return data[i * C + j]; }
+template <int R, int C>
+inline physics::scalar& physics::fixed_matrix<R, C>::operator[](int i) { return data[i]; }
+template <int R, int C>
+inline physics::scalar physics::fixed_matrix<R, C>::operator[](int i) const { return data[i]; }
+
+
+template <int R, int C>
+inline physics::fixed_matrix<R, C>::fixed_matrix() : data() {}
+
+template <int R, int C>
+inline physics::fixed_matrix<R, C>::fixed_matrix(std::initializer_list<scalar> values) : data() {
+    if((int)values.size() != R * C) throw std::invalid_argument("Incompatible matrices.");
+    std::copy(values.begin(), values.end(), data);
+}
+
+template <int R, int C>
+inline physics::fixed_matrix<R, C>::fixed_matrix(std::initializer_list<std::initializer_list<scalar>> values) : data() {
+    if((int)values.size() != R) throw std::invalid_argument("Incompatible matrices.");
+    int i = 0;
+    for(std::initializer_list<scalar> row : values) {
+        if((int)row.size() != C) throw std::invalid_argument("Incompatible matrices.");
+        std::copy(row.begin(), row.end(), data + i++ * C);
+    }
+}
+
+template <int R, int C>
+inline physics::fixed_matrix<R, C>::fixed_matrix(const matrix& m) {
+    // Vectors may be given in either orientation
+    bool vector = (R == 1 || C == 1) && m.is_vector() && m.size() == R * C;
+    if(!vector && (m.rows() != R || m.cols() != C)) throw std::invalid_argument("Incompatible matrices.");
+
+    for(int i = 0; i < m.rows(); i++) {
+        std::copy(m.row(i), m.row(i) + m.cols(), data + i * m.cols());
+    }
+}
+
+
+template <int R, int C>
+inline physics::fixed_matrix<R, C>::operator matrix() const {
+    matrix out = matrix::zeros(R, C);
+    std::copy(data, data + R * C, out.row(0));
+    return out;
+}
+
+
+template <int R, int C>
+inline physics::fixed_matrix<R, C> physics::fixed_matrix<R, C>::operator+(const fixed_matrix& m) const {
+    fixed_matrix out;
+    for(int i = 0; i < R * C; i++) out.data[i] = data[i] + m.data[i];
+    return out;
+}
+
+template <int R, int C>
+inline physics::fixed_matrix<R, C> physics::fixed_matrix<R, C>::operator-(const fixed_matrix& m) const {
+    fixed_matrix out;
+    for(int i = 0; i < R * C; i++) out.data[i] = data[i] - m.data[i];
+    return out;
+}
+
+template <int R, int C>
+inline physics::fixed_matrix<R, C> physics::fixed_matrix<R, C>::operator*(scalar x) const {
+    fixed_matrix out;
+    for(int i = 0; i < R * C; i++) out.data[i] = data[i] * x;
+    return out;
+}
+
+template <int R, int C>
+inline physics::fixed_matrix<R, C> physics::fixed_matrix<R, C>::operator/(scalar x) const {
+    return *this * (1/x);
+}
+
+
+template <int R, int C>
+inline bool physics::fixed_matrix<R, C>::operator==(const fixed_matrix& m) const {
+    return std::equal(data, data + R * C, m.data);
+}
+
+template <int R, int C>
+inline bool physics::fixed_matrix<R, C>::operator!=(const fixed_matrix& m) const {
+    return !(*this == m);
+}
+
+
+template <int R, int C>
+inline physics::fixed_matrix<C, R> physics::fixed_matrix<R, C>::T() const {
+    fixed_matrix<C, R> out;
+    for(int i = 0; i < R; i++) {
+        for(int j = 0; j < C; j++) {
+            out(j, i) = (*this)(i, j);
+        }
+    }
+    return out;
+}
+
+
+template <int R, int K, int C>
+inline physics::fixed_matrix<R, C> physics::operator*(const fixed_matrix<R, K>& a, const fixed_matrix<K, C>& b) {
+    fixed_matrix<R, C> out;
+    for(int i = 0; i < R; i++) {
+        for(int k = 0; k < K; k++) {
+            for(int j = 0; j < C; j++) {
+                out(i, j) += a(i, k) * b(k, j);
+            }
+        }
+    }
+    return out;
+}
+
+template <int N, typename>
+inline physics::fixed_matrix<1, N> physics::operator*(const fixed_matrix<N, N>& a, const fixed_matrix<1, N>& v) {
+    fixed_matrix<1, N> out;
+    for(int i = 0; i < N; i++) {
+        for(int k = 0; k < N; k++) {
+            out[i] += a(i, k) * v[k];
+        }
+    }
+    return out;
+}
+
+template <int R, int C>
+inline physics::fixed_matrix<R, C> physics::operator*(scalar x, const fixed_matrix<R, C>& m) {
+    return m * x;
+}
+
+
+template <int R, int C>
+inline physics::fixed_matrix<R, C> physics::abs(const fixed_matrix<R, C>& m) {
+    fixed_matrix<R, C> out;
+    for(int i = 0; i < R * C; i++) out[i] = std::abs(m[i]);
+    return out;
+}
+
+template <int R, int C>
+inline physics::fixed_matrix<R, C> physics::cross(const fixed_matrix<R, C>& a, const fixed_matrix<R, C>& b) {
+    static_assert((R == 1 || C == 1) && R * C == 3, "Cross product only possible for 3D vectors");
+
+    fixed_matrix<R, C> out;
+    out[0] = a[1] * b[2] - a[2] * b[1];
+    out[1] = a[2] * b[0] - a[0] * b[2];
+    out[2] = a[0] * b[1] - a[1] * b[0];
+    return out;
+}
+
+
+// end --- fixed_matrix.cpp --- 
+
+
+
+// begin --- value.cpp --- 
+
+
+
+
+
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <math.h>
+#include <utility>
+
+
+// Powers of ten that are exact in a long double
+inline constexpr long double powers_of_ten[] = {
+    1e0L, 1e1L, 1e2L, 1e3L, 1e4L, 1e5L, 1e6L, 1e7L, 1e8L, 1e9L, 1e10L, 1e11L, 1e12L, 1e13L,
+    1e14L, 1e15L, 1e16L, 1e17L, 1e18L, 1e19L, 1e20L, 1e21L, 1e22L, 1e23L, 1e24L, 1e25L, 1e26L, 1e27L
+};
+
+// Returns x / 10^n with a single rounding while |n| <= 27
+inline long double divide_by_power_of_ten(long double x, int n) {
+    const int last = 27;
+    while(n > last) { x /= powers_of_ten[last]; n -= last; }
+    while(n < -last) { x *= powers_of_ten[last]; n += last; }
+    return n >= 0 ? x / powers_of_ten[n] : x * powers_of_ten[-n];
+}
+
+inline physics::scalar physics::power_of_ten(int n) { return (scalar)divide_by_power_of_ten(1, -n); }
+
+inline physics::val::val(scalar v) : v(v), e(0), u() {}
+inline physics::val::val(matrix v) : v(std::move(v)), e(0), u() {}
+inline physics::val::val(matrix v, unit u) : v(std::move(v)), e(0), u(u) {
+    calculate_exponent();
+}
+inline physics::val::val(matrix v, int8_t e, unit u) : v(std::move(v)), e(e), u(u) {
+    calculate_exponent();
+}
+template <typename E>
+inline physics::val::val(const val_expr<E>& x) : v(x.v), e(x.e), u(x.u) {
+    calculate_exponent();
+}
+
+inline std::string physics::val::operator+(const std::string& x) const {
+    return (std::string)*this + x;
+}
+inline physics::val::operator std::string() const {
+    return std::string(format(*this));
+}
+inline physics::val::operator int() const { return (int)v; }
+inline physics::val::operator float() const { return (float)v; }
+inline physics::val::operator double() const { return (double)v; }
+inline physics::val::operator long double() const { return (long double)v; }
+inline physics::val::operator unit() const { return u; }
+
+inline physics::val physics::val::operator*(const unit& x) const & { return val(v, e, u * x); }
+inline physics::val physics::val::operator*(const unit& x) && { return val(std::move(v), e, u * x); }
+inline physics::val physics::val::operator/(const unit& x) const & { return val(v, e, u / x); }
+inline physics::val physics::val::operator/(const unit& x) && { return val(std::move(v), e, u / x); }
+inline physics::val physics::val::operator^(double x) const {
+    // Fractional powers need whole exponents in the unit, and move the fraction of the decimal exponent into v
+    int exponents[7];
+    for(int i = 0; i < 7; i++) {
+        double p = u.exponent(i) * x;
+        if(p != std::floor(p)) throw std::invalid_argument("Unit Error");
+        exponents[i] = (int)p;
+    }
+    unit power(exponents[0], exponents[1], exponents[2], exponents[3], exponents[4], exponents[5], exponents[6]);
+    double shift = e * x;
+    int whole = (int)std::floor(shift);
+    if(shift == whole) return val(v^x, whole, power);
+    return val((v^x) * (scalar)std::pow(10.0L, shift - whole), whole, power);
+}
+
+inline physics::val& physics::val::operator+=(const val& x) {
+    // The sum is written straight into v, which it may refer to element by element
+    auto sum = *this + x;
+    v = sum.v;
+    e = sum.e;
+    calculate_exponent();
+    return *this;
+}
+inline physics::val& physics::val::operator-=(const val& x) {
+    auto difference = *this - x;
+    v = difference.v;
+    e = difference.e;
+    calculate_exponent();
+    return *this;
+}
+
+inline bool physics::val::operator<(const val& x) const { return (e != x.e) ? e < x.e : (scalar)v < (scalar)x.v; }
+inline bool physics::val::operator>(const val& x) const { return (e != x.e) ? e > x.e : (scalar)v > (scalar)x.v; }
+inline bool physics::val::operator<=(const val& x) const { return (e != x.e) ? e <= x.e : (scalar)v <= (scalar)x.v; }
+inline bool physics::val::operator>=(const val& x) const { return (e != x.e) ? e >= x.e : (scalar)v >= (scalar)x.v; }
+inline bool physics::val::operator==(const val& x) const { return v == x.v && e == x.e && u == x.u; }
+inline bool physics::val::operator!=(const val& x) const { return v != x.v || e != x.e || u != x.u; }
+
+inline physics::val_expr<physics::matrix_transpose> physics::val::T() const {
+    return make_val_expr(v.T(), e, u);
+}
+
+inline physics::val physics::operator*(const val& x, const val& y) { return val(x.v * y.v, x.e + y.e, x.u * y.u); }
+inline physics::val physics::operator/(const val& x, const val& y) { return val(x.v / y.v, x.e - y.e, x.u / y.u); }
+inline physics::val physics::operator/(scalar x, const val& y) { return val(x / (scalar)y.v, -y.e, y.u ^ -1); }
+
+inline physics::val physics::operator*(matrix x, const unit& y) { return val(std::move(x), y); }
+inline physics::val physics::operator/(matrix x, const unit& y) { return val(std::move(x), y^-1); }
+inline std::string physics::operator+(const std::string& x, const val& y) { return x + (std::string)y; }
+inline std::ostream& physics::operator<<(std::ostream &os, const val &v) {
+    os << format(v);
+    return os;
+}
+
+inline physics::val physics::abs(physics::val v) { return val(abs(std::move(v.v)), v.e, v.u); }
+inline physics::val physics::cross(const val& v1, const val& v2) { return val(cross(v1.v, v2.v), v1.e + v2.e, v1.u * v2.u); }
+
+inline physics::val physics::operator""_Y(long double v) { return val(v, 24); }
+inline physics::val physics::operator""_Z(long double v) { return val(v, 21); }
+inline physics::val physics::operator""_E(long double v) { return val(v, 18); }
+inline physics::val physics::operator""_P(long double v) { return val(v, 15); }
+inline physics::val physics::operator""_T(long double v) { return val(v, 12); }
+inline physics::val physics::operator""_G(long double v) { return val(v, 9); }
+inline physics::val physics::operator""_M(long double v) { return val(v, 6); }
+inline physics::val physics::operator""_k(long double v) { return val(v, 3); }
+inline physics::val physics::operator""_h(long double v) { return val(v, 2); }
+inline physics::val physics::operator""_da(long double v) { return val(v, 1); }
+inline physics::val physics::operator""_d(long double v) { return val(v, -1); }
+inline physics::val physics::operator""_c(long double v) { return val(v, -2); }
+inline physics::val physics::operator""_m(long double v) { return val(v, -3); }
+inline physics::val physics::operator""_mu(long double v) { return val(v, -6); }
+inline physics::val physics::operator""_n(long double v) { return val(v, -9); }
+inline physics::val physics::operator""_p(long double v) { return val(v, -12); }
+inline physics::val physics::operator""_f(long double v) { return val(v, -15); }
+inline physics::val physics::operator""_a(long double v) { return val(v, -18); }
+inline physics::val physics::operator""_z(long double v) { return val(v, -21); }
+inline physics::val physics::operator""_y(long double v) { return val(v, -24); }
+
+inline void physics::val::calculate_exponent() {
+#ifdef PHYSICS_RAW_SI
+    // Values are kept in SI units, the prefix is only worked out when printing
+    if(e != 0) v *= power_of_ten(e);
+    e = 0;
+#else
+    normalise_exponent();
+#endif
+}
+
+inline void physics::val::normalise_exponent() {
+    if(v.rows() != 1 || v.cols() != 1) {
+        if(e != 0) v *= power_of_ten(e);
+        e = 0;
+        return;
+    }
+
+    scalar x = v.first();
+    if(x == 0) e = 0;
+    if(x == 0 || !std::isfinite(x)) return;
+
+    // Moves x into [1, 10), correcting for rounding in log10
+    int shift = std::floor(std::log10(std::abs((long double)x)));
+    long double mantissa = divide_by_power_of_ten(x, shift);
+    if(std::abs(mantissa) >= 10) shift++;
+    else if(std::abs(mantissa) < 1) shift--;
+
+    // Exponents beyond milli and kilo are rounded to a multiple of three
+    int exponent = e + shift;
+    if(exponent > 3 || exponent < -3) {
+        if(exponent % 3 == 1 || exponent % 3 == -2) exponent--;
+        else if(exponent % 3 == 2 || exponent % 3 == -1) exponent++;
+    }
+
+    v(0, 0) = divide_by_power_of_ten(x, exponent - e);
+    e = exponent;
+}
+
+
+// end --- value.cpp --- 
+
+
+
+// begin --- unit.cpp --- 
+
+
+
+
+// begin --- superscript.h --- 
+
+#pragma once
+
+#include <string>
+#include <string_view>
+
+
+namespace super {
+    // Superscript digits, indexed by digit
+    inline constexpr std::string_view superdigits[10] = {
+        "\u2070", "\u00b9", "\u00b2", "\u00b3", "\u2074", "\u2075", "\u2076", "\u2077", "\u2078", "\u2079"
+    };
+
+    // Returns the superscript character corresponding to c, or an empty string if there is none.
+    inline constexpr std::string_view supertable(char c) {
+        if(c >= '0' && c <= '9') return superdigits[c - '0'];
+        if(c == '+') return "\u207A";
+        if(c == '-') return "\u207B";
+        return "";
+    }
+
+    // Returns a string of exponent characters corresponding to the input char or int.
+    inline std::string super(char c) {
+        return std::string(supertable(c));
+    }
+    inline std::string super(int n) {
+        std::string out;
+        if(n < 0) {
+            out += supertable('-');
+            n *= -1;
+        }
+        for(char c : std::to_string(n)) {
+            out += superdigits[c - '0'];
+        }
+        return out;
+    }
+};
+
+
+// end --- superscript.h --- 
+
+
+#include <algorithm>
+#include <array>
+#include <unordered_map>
+
+
+inline constexpr std::string_view si_strings[7] = {"m","kg","s","A","K","cd","mol"};
+
+struct unit_name {
+    physics::unit u;
+    std::string_view name;
+};
+
+// Names of units by their exponents. Special names come first and take precedence over derived ones.
+inline constexpr unit_name listed_unit_names[] = {
+    { physics::J * physics::S, "Js" },
+    { physics::N * physics::S, "Ns" },
+    { physics::J / physics::K, "JK\u207B\u00b9" },
+    { physics::J / (physics::KG * physics::K), "Jkg\u207B\u00b9K\u207B\u00b9" },
+    { physics::C / physics::M, "Cm\u207B\u00b9" },
+    { physics::C / (physics::M^2), "Cm\u207B\u00b2" },
+    { physics::C / (physics::M^3), "Cm\u207B\u00b3" },
+    { physics::T * physics::M, "Tm" },
+    { physics::A / (physics::V * physics::M), "AV\u207B\u00b9m\u207B\u00b9" },
+    { physics::V / physics::M, "Vm\u207B\u00b9" },
+    { physics::W / (physics::M^2), "Wm\u207B\u00b2" },
+
+    { physics::HZ, "Hz" },
+    { physics::N, "N" },
+    { physics::J, "J" },
+    { physics::W, "W" },
+    { physics::PA, "Pa" },
+    { physics::V, "V" },
+    { physics::C, "C" },
+    { physics::OHM, "Ω" },
+    { physics::F, "F" },
+    { physics::H, "H" },
+    { physics::SIEMENS, "S" },
+    { physics::WB, "Wb" },
+    { physics::T, "T" },
+
+    { physics::unit(), "" }
+};
+
+// Slot of a unit in unit_names
+inline constexpr size_t unit_name_slot(const physics::unit& u) {
+    return ((uint64_t)u.hash() * 0x9E3779B97F4A7C15) >> 58;
+}
+
+// Hash table of indices into the names above, built at compile time with linear probing. Empty slots are -1.
+// A unit listed twice keeps its first name.
+inline constexpr auto unit_names = [] {
+    std::array<int8_t, 64> out{};
+    for(int8_t& slot : out) slot = -1;
+    for(size_t k = 0; k < std::size(listed_unit_names); k++) {
+        size_t i = unit_name_slot(listed_unit_names[k].u);
+        while(out[i] >= 0 && listed_unit_names[out[i]].u != listed_unit_names[k].u) i = (i + 1) % out.size();
+        if(out[i] < 0) out[i] = (int8_t)k;
+    }
+    return out;
+}();
+
+// Names built from base units are kept per thread, up to this many
+inline constexpr size_t max_built_unit_names = 4096;
+
+inline physics::unit::unit(const std::vector<int8_t>& si_units) : bits(0) {
+    int size = si_units.size();
+    for(int i = 0; i < std::min(7, size); i++) {
+        bits |= lane(si_units[i], i);
+    }
+}
+
+inline std::string_view physics::unit::name() const {
+    for(size_t i = unit_name_slot(*this); unit_names[i] >= 0; i = (i + 1) % unit_names.size()) {
+        if(listed_unit_names[unit_names[i]].u == *this) return listed_unit_names[unit_names[i]].name;
+    }
+
+    thread_local std::unordered_map<unit, std::string> built_names;
+    thread_local std::string uncached;
+    auto built = built_names.find(*this);
+    if(built != built_names.end()) return built->second;
+
+    // Constructs name from base units
+    std::string output;
+    for(int i = 0; i < 7; i++) {
+        int8_t u = exponent(i);
+        if(u != 0) {
+            output += si_strings[i];
+            if(u != 1) {
+                output += super::super(u);
+            }
+        }
+    }
+
+    if(built_names.size() < max_built_unit_names) return built_names.emplace(*this, std::move(output)).first->second;
+    uncached = std::move(output);
+    return uncached;
+}
+
+inline physics::unit::operator std::string() const {
+    return std::string(name());
+}
+inline physics::unit::operator std::vector<int8_t>() const {
+    std::vector<int8_t> si_units(7);
+    for(int i = 0; i < 7; i++) si_units[i] = exponent(i);
+    return si_units;
+}
+
+inline std::ostream& physics::operator<<(std::ostream& os, const unit& u) {
+    os << u.name();
+    return os;
+}
+
+// end --- unit.cpp --- 
+
+
+
+// begin --- format.cpp --- 
+
+
+
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+
+
+// Returns the SI prefix for a decimal exponent, or an empty string if it has none
+inline constexpr std::string_view prefix_name(int e) {
+    switch(e) {
+        case 24: return "Y";
+        case 21: return "Z";
+        case 18: return "E";
+        case 15: return "P";
+        case 12: return "T";
+        case 9: return "G";
+        case 6: return "M";
+        case 3: return "k";
+        case 2: return "h";
+        case 1: return "dc";
+        case -1: return "d";
+        case -2: return "c";
+        case -3: return "m";
+        case -6: return "μ";
+        case -9: return "n";
+        case -12: return "p";
+        case -15: return "f";
+        case -18: return "a";
+        case -21: return "z";
+        case -24: return "y";
+        default: return "";
+    }
+}
+
+// Appends text to out, unless an earlier piece did not fit
+inline void format_text(std::to_chars_result& out, char* last, std::string_view text) {
+    if(out.ec != std::errc()) return;
+    if(last - out.ptr < (long)text.size()) out = {last, std::errc::value_too_large};
+    else out.ptr = std::copy(text.begin(), text.end(), out.ptr);
+}
+
+inline void format_number(std::to_chars_result& out, char* last, physics::scalar x, int precision) {
+    if(out.ec != std::errc()) return;
+    if(precision < 0) out = std::to_chars(out.ptr, last, x);
+    else out = std::to_chars(out.ptr, last, x, std::chars_format::fixed, precision);
+}
+
+inline std::to_chars_result physics::to_chars(char* first, char* last, const matrix& m, int precision) {
+    std::to_chars_result out = {first, std::errc()};
+    if(m.rows() > 1) format_text(out, last, "[");
+    for(int i = 0; i < m.rows(); i++) {
+        if(m.cols() > 1) format_text(out, last, "[ ");
+        const scalar* r = m.row(i);
+        for(int j = 0; j < m.cols(); j++) {
+            format_number(out, last, r[j], precision);
+            format_text(out, last, " ");
+        }
+        if(m.cols() > 1) format_text(out, last, "]");
+    }
+    if(m.rows() > 1) format_text(out, last, "]");
+    return out;
+}
+
+inline std::to_chars_result physics::to_chars(char* first, char* last, const val& v, int precision) {
+#ifdef PHYSICS_RAW_SI
+    // Values are stored in SI units, so the prefix is only worked out here
+    if(v.v.is_scalar() && v.e == 0) {
+        val shown = v;
+        shown.normalise_exponent();
+        if(shown.e != 0) return to_chars(first, last, shown, precision);
+    }
+#endif
+
+    std::to_chars_result out = to_chars(first, last, v.v, precision);
+    bool dimensionless = v.u == unit();
+    if(v.e == 0) {
+        if(!dimensionless) format_text(out, last, " ");
+    }
+    else if(dimensionless || std::abs(v.e) > 24) {
+        format_text(out, last, "e");
+        if(out.ec == std::errc()) out = std::to_chars(out.ptr, last, (int)v.e);
+        format_text(out, last, " ");
+    }
+    else {
+        format_text(out, last, " ");
+        format_text(out, last, prefix_name(v.e));
+    }
+    format_text(out, last, v.u.name());
+    return out;
+}
+
+template <typename T>
+inline std::string_view physics::format(const T& x, int precision) {
+    // Grows until the text fits, and is reused by later calls
+    thread_local std::string buffer(256, '\0');
+    while(true) {
+        std::to_chars_result out = to_chars(buffer.data(), buffer.data() + buffer.size(), x, precision);
+        if(out.ec == std::errc()) return std::string_view(buffer.data(), out.ptr - buffer.data());
+        buffer.resize(buffer.size() * 2);
+    }
+}
+
+template <typename OutputIt, typename T>
+inline OutputIt physics::format_to(OutputIt out, const T& x, int precision) {
+    std::string_view text = format(x, precision);
+    return std::copy(text.begin(), text.end(), out);
+}
+
+
+// end --- format.cpp --- 
+
+
+
+// begin --- val_array.cpp --- 
+
+
+
+// begin --- val_array.h --- 
+
+#pragma once
+
+
+
+
+#include <vector>
+
+
+namespace physics {
+    // Represents many scalar physical values with the same unit.
+    // The values are stored as plain SI numbers in one contiguous buffer, so every operation checks
+    // units once for the whole array and runs as a simple loop the compiler can vectorise.
+    class val_array {
+    public:
+        buffer data; // Values in SI units
+        unit u; // Unit
+
+    public:
+        val_array();
+        explicit val_array(int size, unit u = unit());
+        val_array(const std::vector<scalar>& values, unit u = unit());
+        // All values must be scalars with the same unit.
+        explicit val_array(const std::vector<val>& values);
+
+        int size() const;
+        val operator[](int i) const;
+
+        // Conversions
+        explicit operator std::vector<val>() const;
+        // Returns a 1xN vector value.
+        explicit operator val() const;
+
+        // Operators
+        val_array operator+(const val_array& x) const;
+        val_array operator-(const val_array& x) const;
+        val_array operator*(const val_array& x) const;
+        val_array operator/(const val_array& x) const;
+
+        val_array operator+(const val& x) const;
+        val_array operator-(const val& x) const;
+        val_array operator*(const val& x) const;
+        val_array operator/(const val& x) const;
+
+        val_array operator*(scalar x) const;
+        val_array operator/(scalar x) const;
+        val_array operator*(const unit& x) const;
+        val_array operator/(const unit& x) const;
+
+        // Compound assignment updates the array in place
+        val_array& operator+=(const val_array& x);
+        val_array& operator-=(const val_array& x);
+        val_array& operator+=(const val& x);
+        val_array& operator-=(const val& x);
+        val_array& operator*=(scalar x);
+        val_array& operator/=(scalar x);
+    };
+
+    // Additional operators
+    val_array operator+(const val& x, const val_array& y);
+    val_array operator-(const val& x, const val_array& y);
+    val_array operator*(const val& x, const val_array& y);
+    val_array operator/(const val& x, const val_array& y);
+    val_array operator*(scalar x, const val_array& y);
+    val_array operator/(scalar x, const val_array& y);
+
+    std::ostream& operator<<(std::ostream& os, const val_array& x);
+
+    // Calls f on every value of x on the shared thread pool and collects the results.
+    // f takes and returns a val, and its results must be scalar values with the same unit.
+    template <typename F>
+    val_array parallel_map(const val_array& x, F&& f);
+}
+
+
+// end --- val_array.h --- 
+
+
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+
+// Returns the value of a scalar val in SI units
+inline physics::scalar si_value(const physics::val& x) {
+    if(!x.v.is_scalar()) throw std::invalid_argument("Only scalar values can be used with a val_array.");
+    return x.v.first() * physics::power_of_ten(x.e);
+}
+
+// Computes out[i] = f(a[i]) for n elements, splitting large arrays across the thread pool
+template <typename F>
+inline void transform_values(int n, const physics::scalar* a, physics::scalar* out, F f) {
+    physics::parallel_for(n, n, [&](int begin, int end) {
+        for(int i = begin; i < end; i++) out[i] = f(a[i]);
+    });
+}
+
+// Computes out[i] = f(a[i], b[i]) for n elements
+template <typename F>
+inline void transform_values(int n, const physics::scalar* a, const physics::scalar* b, physics::scalar* out, F f) {
+    physics::parallel_for(n, n, [&](int begin, int end) {
+        for(int i = begin; i < end; i++) out[i] = f(a[i], b[i]);
+    });
+}
+
+inline void check_sizes(const physics::val_array& x, const physics::val_array& y) {
+    if(x.size() != y.size()) throw std::invalid_argument("Incompatible arrays.");
+}
+
+inline physics::val_array::val_array() {}
+inline physics::val_array::val_array(int size, unit u) : data(size), u(u) {}
+inline physics::val_array::val_array(const std::vector<scalar>& values, unit u) : data(values.data(), values.data() + values.size()), u(u) {}
+inline physics::val_array::val_array(const std::vector<val>& values) : data(values.size()) {
+    if(!values.empty()) u = values[0].u;
+    for(int i = 0; i < size(); i++) {
+        if(values[i].u != u) throw std::invalid_argument("Unit Error");
+        data[i] = si_value(values[i]);
+    }
+}
+
+inline int physics::val_array::size() const { return data.size(); }
+inline physics::val physics::val_array::operator[](int i) const { return val(matrix(data[i]), u); }
+
+inline physics::val_array::operator std::vector<val>() const {
+    std::vector<val> out;
+    out.reserve(size());
+    for(int i = 0; i < size(); i++) out.push_back((*this)[i]);
+    return out;
+}
+inline physics::val_array::operator val() const {
+    matrix m = matrix::zeros(1, size());
+    std::copy(data.begin(), data.end(), m.row(0));
+    return val(std::move(m), u);
+}
+
+inline physics::val_array physics::val_array::operator+(const val_array& x) const {
+    if(u != x.u) throw std::invalid_argument("Unit Error");
+    check_sizes(*this, x);
+    val_array out(size(), u);
+    transform_values(size(), data.data(), x.data.data(), out.data.data(), [](scalar a, scalar b) { return a + b; });
+    return out;
+}
+inline physics::val_array physics::val_array::operator-(const val_array& x) const {
+    if(u != x.u) throw std::invalid_argument("Unit Error");
+    check_sizes(*this, x);
+    val_array out(size(), u);
+    transform_values(size(), data.data(), x.data.data(), out.data.data(), [](scalar a, scalar b) { return a - b; });
+    return out;
+}
+inline physics::val_array physics::val_array::operator*(const val_array& x) const {
+    check_sizes(*this, x);
+    val_array out(size(), u * x.u);
+    transform_values(size(), data.data(), x.data.data(), out.data.data(), [](scalar a, scalar b) { return a * b; });
+    return out;
+}
+inline physics::val_array physics::val_array::operator/(const val_array& x) const {
+    check_sizes(*this, x);
+    val_array out(size(), u / x.u);
+    transform_values(size(), data.data(), x.data.data(), out.data.data(), [](scalar a, scalar b) { return a / b; });
+    return out;
+}
+
+inline physics::val_array physics::val_array::operator+(const val& x) const {
+    if(u != x.u) throw std::invalid_argument("Unit Error");
+    scalar b = si_value(x);
+    val_array out(size(), u);
+    transform_values(size(), data.data(), out.data.data(), [b](scalar a) { return a + b; });
+    return out;
+}
+inline physics::val_array physics::val_array::operator-(const val& x) const {
+    if(u != x.u) throw std::invalid_argument("Unit Error");
+    scalar b = si_value(x);
+    val_array out(size(), u);
+    transform_values(size(), data.data(), out.data.data(), [b](scalar a) { return a - b; });
+    return out;
+}
+inline physics::val_array physics::val_array::operator*(const val& x) const {
+    scalar b = si_value(x);
+    val_array out(size(), u * x.u);
+    transform_values(size(), data.data(), out.data.data(), [b](scalar a) { return a * b; });
+    return out;
+}
+inline physics::val_array physics::val_array::operator/(const val& x) const {
+    scalar b = 1 / si_value(x);
+    val_array out(size(), u / x.u);
+    transform_values(size(), data.data(), out.data.data(), [b](scalar a) { return a * b; });
+    return out;
+}
+
+inline physics::val_array physics::val_array::operator*(scalar x) const {
+    val_array out(size(), u);
+    transform_values(size(), data.data(), out.data.data(), [x](scalar a) { return a * x; });
+    return out;
+}
+inline physics::val_array physics::val_array::operator/(scalar x) const {
+    return *this * (1 / x);
+}
+inline physics::val_array physics::val_array::operator*(const unit& x) const {
+    val_array out = *this;
+    out.u = u * x;
+    return out;
+}
+inline physics::val_array physics::val_array::operator/(const unit& x) const {
+    val_array out = *this;
+    out.u = u / x;
+    return out;
+}
+
+inline physics::val_array& physics::val_array::operator+=(const val_array& x) {
+    if(u != x.u) throw std::invalid_argument("Unit Error");
+    check_sizes(*this, x);
+    transform_values(size(), data.data(), x.data.data(), data.data(), [](scalar a, scalar b) { return a + b; });
+    return *this;
+}
+inline physics::val_array& physics::val_array::operator-=(const val_array& x) {
+    if(u != x.u) throw std::invalid_argument("Unit Error");
+    check_sizes(*this, x);
+    transform_values(size(), data.data(), x.data.data(), data.data(), [](scalar a, scalar b) { return a - b; });
+    return *this;
+}
+inline physics::val_array& physics::val_array::operator+=(const val& x) {
+    if(u != x.u) throw std::invalid_argument("Unit Error");
+    scalar b = si_value(x);
+    transform_values(size(), data.data(), data.data(), [b](scalar a) { return a + b; });
+    return *this;
+}
+inline physics::val_array& physics::val_array::operator-=(const val& x) {
+    if(u != x.u) throw std::invalid_argument("Unit Error");
+    scalar b = si_value(x);
+    transform_values(size(), data.data(), data.data(), [b](scalar a) { return a - b; });
+    return *this;
+}
+inline physics::val_array& physics::val_array::operator*=(scalar x) {
+    transform_values(size(), data.data(), data.data(), [x](scalar a) { return a * x; });
+    return *this;
+}
+inline physics::val_array& physics::val_array::operator/=(scalar x) {
+    return *this *= 1 / x;
+}
+
+
+inline physics::val_array physics::operator+(const val& x, const val_array& y) { return y + x; }
+inline physics::val_array physics::operator-(const val& x, const val_array& y) {
+    if(x.u != y.u) throw std::invalid_argument("Unit Error");
+    scalar a = si_value(x);
+    val_array out(y.size(), y.u);
+    transform_values(y.size(), y.data.data(), out.data.data(), [a](scalar b) { return a - b; });
+    return out;
+}
+inline physics::val_array physics::operator*(const val& x, const val_array& y) { return y * x; }
+inline physics::val_array physics::operator/(const val& x, const val_array& y) {
+    scalar a = si_value(x);
+    val_array out(y.size(), x.u / y.u);
+    transform_values(y.size(), y.data.data(), out.data.data(), [a](scalar b) { return a / b; });
+    return out;
+}
+inline physics::val_array physics::operator*(scalar x, const val_array& y) { return y * x; }
+inline physics::val_array physics::operator/(scalar x, const val_array& y) {
+    val_array out(y.size(), unit() / y.u);
+    transform_values(y.size(), y.data.data(), out.data.data(), [x](scalar b) { return x / b; });
+    return out;
+}
+
+inline std::ostream& physics::operator<<(std::ostream& os, const val_array& x) {
+    os << (val)x;
+    return os;
+}
+
+template <typename F>
+inline physics::val_array physics::parallel_map(const val_array& x, F&& f) {
+    val_array out(x.size());
+    if(x.size() == 0) return out;
+
+    // The first result sets the unit the others are checked against
+    val first = f(x[0]);
+    out.u = first.u;
+    out.data[0] = si_value(first);
+    thread_pool::shared().parallel_for(x.size() - 1, [&](int begin, int end) {
+        for(int i = begin + 1; i <= end; i++) {
+            val result = f(x[i]);
+            if(result.u != out.u) throw std::invalid_argument("Unit Error");
+            out.data[i] = si_value(result);
+        }
+    });
+    return out;
+}
+
+
+// end --- val_array.cpp --- 
+
+
+
+// begin --- view.cpp --- 
+
+
+
+// begin --- view.h --- 
+
+#pragma once
+
+
+
+
+
+#include <ostream>
+
+
+namespace physics {
+    // Refers to elements of a matrix, or of any array, without owning them.
+    // Element (i, j) is at data[i * row_step + j * col_step], so rows, columns, blocks, transposes and
+    // strided slices are all views of the same kind. A view is an expression, so it can be used in any
+    // formula, and assigning to it writes the elements it refers to in place.
+    // Views don't keep their matrix alive, and are invalidated when it is resized or reassigned.
+    // Copying a view gives another view of the same elements.
+    struct matrix_view : matrix_expression {
+    public:
+        scalar* data;
+        int n_rows;
+        int n_cols;
+        int row_step;
+        int col_step;
+
+        int rows() const;
+        int cols() const;
+        int size() const;
+
+        // Element access
+        scalar& operator()(int i, int j) const;
+
+    public:
+        explicit matrix_view(matrix& m);
+        // Wraps an array owned elsewhere, e.g. a memory-mapped file or another library's buffer
+        matrix_view(scalar* data, int rows, int cols, int row_step, int col_step = 1);
+        matrix_view(const matrix_view& v) = default;
+
+        // Writes the elements of x, which must have the same size, into the viewed ones.
+        // They are written element by element unless x reads memory the view refers to at other positions,
+        // like an overlapping block or transpose, in which case x is evaluated before anything is written.
+        matrix_view& operator=(const matrix_view& x);
+        matrix_view& operator=(const matrix& x);
+        template <typename E, typename = typename std::enable_if<std::is_base_of<matrix_expression, E>::value>::type>
+        matrix_view& operator=(const E& e);
+        matrix_view& operator=(scalar x);
+
+        // Compound assignment updates the viewed elements in place
+        matrix_view& operator+=(const matrix& x);
+        matrix_view& operator-=(const matrix& x);
+        matrix_view& operator*=(scalar x);
+        matrix_view& operator/=(scalar x);
+
+        // Views of part of this view
+        matrix_view block(int i, int j, int rows, int cols) const;
+        matrix_view row_view(int i) const;
+        matrix_view column_view(int j) const;
+        // count elements of a vector view, starting at first and step elements apart
+        matrix_view slice(int first, int count, int step = 1) const;
+
+        // Transpose, by swapping the steps
+        matrix_view T() const;
+    };
+
+    template <> struct reads_across<matrix_view> : std::true_type {};
+
+    // Products of views that are row-major or transposed go straight to gemm, others are copied first
+    matrix operator*(const matrix_view& l, const matrix_view& r);
+    matrix operator*(const matrix& l, const matrix_view& r);
+    matrix operator*(const matrix_view& l, const matrix& r);
+
+    // Refers to elements of a value without owning them, like matrix_view, along with its exponent and unit.
+    // Writing to it checks the unit, and scales to the exponent of the viewed value, which it keeps.
+    class val_view {
+    public:
+        matrix_view v; // Value
+        int8_t e; // Exponent
+        unit u; // Unit
+
+    public:
+        explicit val_view(val& x);
+        // Views of plain numbers, in SI units unless e is given
+        val_view(matrix_view v, unit u = unit());
+        val_view(matrix_view v, int8_t e, unit u);
+
+        // Conversions
+        operator val() const;
+
+        // Operators
+        val operator*(const unit& x) const;
+        val operator/(const unit& x) const;
+
+        // Writes a value with the same unit into the viewed elements
+        val_view& operator=(const val_view& x);
+        val_view& operator=(const val& x);
+        val_view& operator+=(const val& x);
+        val_view& operator-=(const val& x);
+        val_view& operator*=(scalar x);
+        val_view& operator/=(scalar x);
+
+        // Views of part of this view
+        val_view block(int i, int j, int rows, int cols) const;
+        val_view row_view(int i) const;
+        val_view column_view(int j) const;
+        val_view slice(int first, int count, int step = 1) const;
+        val_view T() const;
+    };
+
+    // Views take part in lazy formulas of vals like vals do
+    template <> struct is_val_expression<val_view> : std::true_type {};
+
+    std::ostream& operator<<(std::ostream& os, const val_view& v);
+}
+
+
+// end --- view.h --- 
+
+
+
+
+#include <functional>
+#include <stdexcept>
+#include <utility>
+
+
+inline int physics::matrix_view::rows() const { return n_rows; }
+inline int physics::matrix_view::cols() const { return n_cols; }
+inline int physics::matrix_view::size() const { return n_rows * n_cols; }
+
+inline physics::scalar& physics::matrix_view::operator()(int i, int j) const { return data[(long)i * row_step + (long)j * col_step]; }
+
+
+inline physics::matrix_view::matrix_view(matrix& m) : data(m.size() == 0 ? nullptr : m.row(0)), n_rows(m.rows()), n_cols(m.cols()), row_step(m.stride), col_step(1) {}
+
+inline physics::matrix_view::matrix_view(scalar* data, int rows, int cols, int row_step, int col_step)
+    : data(data), n_rows(rows), n_cols(cols), row_step(row_step), col_step(col_step) {}
+
+
+// Writes every element of an expression into a view of the same size, each thread taking its own rows
+template <typename E>
+inline void assign_view(const physics::matrix_view& out, const E& e) {
+    if(out.rows() != e.rows() || out.cols() != e.cols()) throw std::invalid_argument("Incompatible matrices.");
+    physics::parallel_for(out.rows(), out.size(), [&](int begin, int end) {
+        for(int i = begin; i < end; i++) {
+            for(int j = 0; j < out.cols(); j++) out(i, j) = e(i, j);
+        }
+    });
+}
+
+// First and last element a view refers to, whatever the signs of its steps
+inline std::pair<const physics::scalar*, const physics::scalar*> view_range(const physics::matrix_view& v) {
+    long low = 0, high = 0;
+    (v.row_step < 0 ? low : high) += (long)(v.n_rows - 1) * v.row_step;
+    (v.col_step < 0 ? low : high) += (long)(v.n_cols - 1) * v.col_step;
+    return {v.data + low, v.data + high};
+}
+
+// Whether writing the elements of out in place could change an element of an operand before it is read.
+// Operands laid out exactly like out only read the element being written, others must not share memory with it.
+template <typename L, typename R>
+bool view_aliases(const physics::matrix_view& out, const physics::matrix_sum<L, R>& e);
+template <typename L, typename R>
+bool view_aliases(const physics::matrix_view& out, const physics::matrix_difference<L, R>& e);
+template <typename E>
+bool view_aliases(const physics::matrix_view& out, const physics::matrix_scaled<E>& e);
+
+inline bool view_aliases(const physics::matrix_view& out, const physics::matrix_view& v) {
+    if(out.size() == 0 || v.size() == 0) return false;
+    if(v.data == out.data && v.row_step == out.row_step && v.col_step == out.col_step) return false;
+    auto a = view_range(out), b = view_range(v);
+    std::less<const physics::scalar*> before;
+    return !(before(a.second, b.first) || before(b.second, a.first));
+}
+inline bool view_aliases(const physics::matrix_view& out, const physics::matrix& m) {
+    return view_aliases(out, physics::matrix_view(const_cast<physics::matrix&>(m)));
+}
+inline bool view_aliases(const physics::matrix_view& out, const physics::matrix_transpose& t) {
+    return view_aliases(out, physics::matrix_view(const_cast<physics::matrix&>(t.m)).T());
+}
+template <typename L, typename R>
+inline bool view_aliases(const physics::matrix_view& out, const physics::matrix_sum<L, R>& e) { return view_aliases(out, e.l) || view_aliases(out, e.r); }
+template <typename L, typename R>
+inline bool view_aliases(const physics::matrix_view& out, const physics::matrix_difference<L, R>& e) { return view_aliases(out, e.l) || view_aliases(out, e.r); }
+template <typename E>
+inline bool view_aliases(const physics::matrix_view& out, const physics::matrix_scaled<E>& e) { return view_aliases(out, e.e); }
+
+// Writes an expression into a view, through a temporary if it reads the view's memory at other positions
+template <typename E>
+inline void update_view(const physics::matrix_view& out, const E& e) {
+    if(view_aliases(out, e)) assign_view(out, physics::matrix(e));
+    else assign_view(out, e);
+}
+
+inline physics::matrix_view& physics::matrix_view::operator=(const matrix_view& x) {
+    update_view(*this, x);
+    return *this;
+}
+
+inline physics::matrix_view& physics::matrix_view::operator=(const matrix& x) {
+    update_view(*this, x);
+    return *this;
+}
+
+template <typename E, typename>
+inline physics::matrix_view& physics::matrix_view::operator=(const E& e) {
+    update_view(*this, e);
+    return *this;
+}
+
+inline physics::matrix_view& physics::matrix_view::operator=(scalar x) {
+    for(int i = 0; i < rows(); i++) {
+        for(int j = 0; j < cols(); j++) (*this)(i, j) = x;
+    }
+    return *this;
+}
+
+// The view itself only reads the element being written, so these work in place unless x overlaps it
+inline physics::matrix_view& physics::matrix_view::operator+=(const matrix& x) {
+    update_view(*this, *this + x);
+    return *this;
+}
+inline physics::matrix_view& physics::matrix_view::operator-=(const matrix& x) {
+    update_view(*this, *this - x);
+    return *this;
+}
+inline physics::matrix_view& physics::matrix_view::operator*=(scalar x) {
+    assign_view(*this, *this * x);
+    return *this;
+}
+inline physics::matrix_view& physics::matrix_view::operator/=(scalar x) {
+    assign_view(*this, *this / x);
+    return *this;
+}
+
+
+inline physics::matrix_view physics::matrix_view::block(int i, int j, int rows, int cols) const {
+    if(i < 0 || j < 0 || rows < 0 || cols < 0 || i + rows > n_rows || j + cols > n_cols) throw std::invalid_argument("Index out of range.");
+    return matrix_view(&(*this)(i, j), rows, cols, row_step, col_step);
+}
+
+inline physics::matrix_view physics::matrix_view::row_view(int i) const { return block(i, 0, 1, n_cols); }
+inline physics::matrix_view physics::matrix_view::column_view(int j) const { return block(0, j, n_rows, 1); }
+
+inline physics::matrix_view physics::matrix_view::slice(int first, int count, int step) const {
+    if(n_rows != 1 && n_cols != 1) throw std::invalid_argument("Only vectors can be sliced.");
+    // Element k of a vector view, whichever way it lies
+    int element_step = n_rows == 1 ? col_step : row_step;
+    if(first < 0 || count < 0 || step < 1 || (count > 0 && first + (count - 1) * step >= size())) throw std::invalid_argument("Index out of range.");
+    if(n_rows == 1) return matrix_view(data + (long)first * element_step, 1, count, row_step, step * element_step);
+    return matrix_view(data + (long)first * element_step, count, 1, step * element_step, col_step);
+}
+
+inline physics::matrix_view physics::matrix_view::T() const { return matrix_view(data, n_cols, n_rows, col_step, row_step); }
+
+
+// A view as an operand of gemm: row-major if its rows are contiguous, transposed if its columns are
+inline bool gemm_operand(const physics::matrix_view& v, int& ld, bool& transposed) {
+    if(v.col_step == 1) {
+        ld = v.row_step;
+        transposed = false;
+        return true;
+    }
+    if(v.row_step == 1) {
+        ld = v.col_step;
+        transposed = true;
+        return true;
+    }
+    return false;
+}
+
+inline physics::matrix physics::operator*(const matrix_view& l, const matrix_view& r) {
+    int lda, ldb;
+    bool transpose_a, transpose_b;
+    // Scalars and vectors, which are transposed automatically, and small views go through the usual product
+    bool small = l.size() <= buffer::inline_capacity && r.size() <= buffer::inline_capacity;
+    if(small || l.rows() == 1 || l.cols() == 1 || r.rows() == 1 || r.cols() == 1 ||
+       !gemm_operand(l, lda, transpose_a) || !gemm_operand(r, ldb, transpose_b)) return matrix(l) * matrix(r);
+    if(l.cols() != r.rows()) throw std::invalid_argument("Incompatible matrices.");
+
+    matrix out = matrix::zeros(l.rows(), r.cols());
+    gemm(l.rows(), r.cols(), l.cols(), l.data, lda, r.data, ldb, out.row(0), out.stride, transpose_a, transpose_b);
+    return out;
+}
+
+// The matrix is only read through the view
+inline physics::matrix physics::operator*(const matrix& l, const matrix_view& r) { return matrix_view(const_cast<matrix&>(l)) * r; }
+inline physics::matrix physics::operator*(const matrix_view& l, const matrix& r) { return l * matrix_view(const_cast<matrix&>(r)); }
+
+
+inline physics::val_view::val_view(val& x) : v(x.v), e(x.e), u(x.u) {}
+inline physics::val_view::val_view(matrix_view v, unit u) : v(v), e(0), u(u) {}
+inline physics::val_view::val_view(matrix_view v, int8_t e, unit u) : v(v), e(e), u(u) {}
+
+inline physics::val_view::operator val() const { return val(matrix(v), e, u); }
+
+inline physics::val physics::val_view::operator*(const unit& x) const { return val(matrix(v), e, u * x); }
+inline physics::val physics::val_view::operator/(const unit& x) const { return val(matrix(v), e, u / x); }
+
+inline physics::val_view& physics::val_view::operator=(const val_view& x) { return *this = (val)x; }
+
+inline physics::val_view& physics::val_view::operator=(const val& x) {
+    if(x.u != u) throw std::invalid_argument("Unit Error");
+    if(x.e == e) v = x.v;
+    else v = x.v * power_of_ten(x.e - e);
+    return *this;
+}
+
+inline physics::val_view& physics::val_view::operator+=(const val& x) { return *this = *this + x; }
+inline physics::val_view& physics::val_view::operator-=(const val& x) { return *this = *this - x; }
+inline physics::val_view& physics::val_view::operator*=(scalar x) {
+    v *= x;
+    return *this;
+}
+inline physics::val_view& physics::val_view::operator/=(scalar x) {
+    v /= x;
+    return *this;
+}
+
+inline physics::val_view physics::val_view::block(int i, int j, int rows, int cols) const { return val_view(v.block(i, j, rows, cols), e, u); }
+inline physics::val_view physics::val_view::row_view(int i) const { return val_view(v.row_view(i), e, u); }
+inline physics::val_view physics::val_view::column_view(int j) const { return val_view(v.column_view(j), e, u); }
+inline physics::val_view physics::val_view::slice(int first, int count, int step) const { return val_view(v.slice(first, count, step), e, u); }
+inline physics::val_view physics::val_view::T() const { return val_view(v.T(), e, u); }
+
+inline std::ostream& physics::operator<<(std::ostream& os, const val_view& v) { return os << (val)v; }
+
+
+// Views of matrices and values
+inline physics::matrix_view physics::matrix::block(int i, int j, int rows, int cols) { return matrix_view(*this).block(i, j, rows, cols); }
+inline physics::matrix_view physics::matrix::row_view(int i) { return matrix_view(*this).row_view(i); }
+inline physics::matrix_view physics::matrix::column_view(int j) { return matrix_view(*this).column_view(j); }
+
+inline physics::val_view physics::val::block(int i, int j, int rows, int cols) { return val_view(*this).block(i, j, rows, cols); }
+inline physics::val_view physics::val::row_view(int i) { return val_view(*this).row_view(i); }
+inline physics::val_view physics::val::column_view(int j) { return val_view(*this).column_view(j); }
+
+
+// end --- view.cpp --- 
+
+
+
+// begin --- decomposition.cpp --- 
+
+
+
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+
+
+// Width of the panels factorized between the matrix products of the blocked algorithms
+inline constexpr int factorization_block = 64;
+
+// Returns b as a matrix of n rows, turning a vector of length n into a column
+inline physics::matrix as_columns(const physics::matrix& b, int n) {
+    if(b.rows() == n) return b;
+    if(b.is_vector() && b.size() == n) return b.T();
+    throw std::invalid_argument("Incompatible matrices.");
+}
+
+// Returns single columns as row vectors, like matrix products do
+inline physics::matrix as_result(physics::matrix x) {
+    if(x.cols() == 1) {
+        x.n_cols = x.stride = x.n_rows;
+        x.n_rows = 1;
+    }
+    return x;
+}
+
+// Solves rows [begin, end) of L X = B in place, once the rows before them have been subtracted
+inline void solve_lower_block(const physics::matrix& l, physics::matrix& x, int begin, int end, bool unit_diagonal) {
+    long work = (long)(end - begin) * (end - begin) * x.cols() / 2;
+    physics::parallel_for(x.cols(), work, [&](int c0, int c1) {
+        for(int i = begin; i < end; i++) {
+            const physics::scalar* li = l.row(i);
+            physics::scalar* xi = x.row(i);
+            for(int p = begin; p < i; p++) {
+                physics::scalar f = li[p];
+                const physics::scalar* xp = x.row(p);
+                for(int c = c0; c < c1; c++) xi[c] -= f * xp[c];
+            }
+            if(!unit_diagonal) {
+                for(int c = c0; c < c1; c++) xi[c] /= li[i];
+            }
+        }
+    });
+}
+
+// Solves rows [begin, end) of U X = B in place, once the rows after them have been subtracted
+inline void solve_upper_block(const physics::matrix& u, physics::matrix& x, int begin, int end) {
+    long work = (long)(end - begin) * (end - begin) * x.cols() / 2;
+    physics::parallel_for(x.cols(), work, [&](int c0, int c1) {
+        for(int i = end - 1; i >= begin; i--) {
+            const physics::scalar* ui = u.row(i);
+            physics::scalar* xi = x.row(i);
+            for(int p = i + 1; p < end; p++) {
+                physics::scalar f = ui[p];
+                const physics::scalar* xp = x.row(p);
+                for(int c = c0; c < c1; c++) xi[c] -= f * xp[c];
+            }
+            for(int c = c0; c < c1; c++) xi[c] /= ui[i];
+        }
+    });
+}
+
+// Solves L X = B in place. Many right-hand sides are solved in blocks of rows, leaving most of the work to gemm.
+inline void solve_lower_in_place(const physics::matrix& l, physics::matrix& x, bool unit_diagonal) {
+    int n = l.rows();
+    int block = x.cols() < 16 ? n : factorization_block;
+    for(int k0 = 0; k0 < n; k0 += block) {
+        int k1 = std::min(k0 + block, n);
+        solve_lower_block(l, x, k0, k1, unit_diagonal);
+        if(k1 < n) physics::gemm_update(n - k1, x.cols(), k1 - k0, -1, l.row(k1) + k0, l.stride, x.row(k0), x.stride, x.row(k1), x.stride);
+    }
+}
+
+// Solves U X = B in place, from the last block of rows up
+inline void solve_upper_in_place(const physics::matrix& u, physics::matrix& x) {
+    int n = u.rows();
+    int block = x.cols() < 16 ? n : factorization_block;
+    for(int k1 = n; k1 > 0; k1 -= block) {
+        int k0 = std::max(0, k1 - block);
+        solve_upper_block(u, x, k0, k1);
+        if(k0 > 0) physics::gemm_update(k0, x.cols(), k1 - k0, -1, u.row(0) + k0, u.stride, x.row(k0), x.stride, x.row(0), x.stride);
+    }
+}
+
+
+inline physics::lu::lu(matrix a) : factors(std::move(a)), pivots(factors.rows()), sign(1), e(0), u() {
+    if(!factors.is_square()) throw std::invalid_argument("Only square matrices can be factorized.");
+    int n = size();
+    matrix& f = factors;
+    std::iota(pivots.begin(), pivots.end(), 0);
+
+    for(int k0 = 0; k0 < n; k0 += factorization_block) {
+        int k1 = std::min(k0 + factorization_block, n);
+
+        // Factorizes the panel of columns [k0, k1), swapping whole rows
+        for(int j = k0; j < k1; j++) {
+            int p = j;
+            for(int i = j + 1; i < n; i++) {
+                if(std::abs(f(i, j)) > std::abs(f(p, j))) p = i;
+            }
+            if(p != j) {
+                std::swap_ranges(f.row(p), f.row(p) + n, f.row(j));
+                std::swap(pivots[p], pivots[j]);
+                sign = -sign;
+            }
+
+            scalar pivot = f(j, j);
+            if(pivot == 0) continue;
+            const scalar* fj = f.row(j);
+            for(int i = j + 1; i < n; i++) {
+                scalar* fi = f.row(i);
+                scalar l = fi[j] /= pivot;
+                for(int c = j + 1; c < k1; c++) fi[c] -= l * fj[c];
+            }
+        }
+        if(k1 == n) break;
+
+        // Rows of U right of the panel, U12 = L11^-1 A12
+        parallel_for(n - k1, (long)(n - k1) * (k1 - k0) * (k1 - k0) / 2, [&](int begin, int end) {
+            for(int i = k0 + 1; i < k1; i++) {
+                scalar* fi = f.row(i);
+                for(int p = k0; p < i; p++) {
+                    scalar l = fi[p];
+                    const scalar* fp = f.row(p);
+                    for(int c = k1 + begin; c < k1 + end; c++) fi[c] -= l * fp[c];
+                }
+            }
+        });
+
+        // Rest of the matrix, A22 -= L21 U12
+        gemm_update(n - k1, n - k1, k1 - k0, -1, f.row(k1) + k0, f.stride, f.row(k0) + k1, f.stride, f.row(k1) + k1, f.stride);
+    }
+}
+inline physics::lu::lu(const val& a) : lu(a.v) {
+    e = a.e;
+    u = a.u;
+}
+
+inline int physics::lu::size() const { return factors.rows(); }
+
+inline bool physics::lu::is_singular() const {
+    for(int i = 0; i < size(); i++) {
+        if(factors(i, i) == 0) return true;
+    }
+    return false;
+}
+
+inline physics::matrix physics::lu::solve(const matrix& b) const {
+    if(is_singular()) throw std::invalid_argument("Matrix is singular.");
+    matrix columns = as_columns(b, size());
+
+    matrix x = matrix::zeros(size(), columns.cols());
+    for(int i = 0; i < size(); i++) {
+        std::copy(columns.row(pivots[i]), columns.row(pivots[i]) + x.cols(), x.row(i));
+    }
+    solve_lower_in_place(factors, x, true);
+    solve_upper_in_place(factors, x);
+    return as_result(std::move(x));
+}
+inline physics::val physics::lu::solve(const val& b) const {
+    return val(solve(b.v), b.e - e, b.u / u);
+}
+
+inline physics::scalar physics::lu::det() const {
+    scalar out = sign;
+    for(int i = 0; i < size(); i++) out *= factors(i, i);
+    return out;
+}
+
+inline physics::matrix physics::lu::inverse() const {
+    if(is_singular()) throw std::invalid_argument("Matrix is singular.");
+
+    // Solves against the columns of P
+    matrix x = matrix::zeros(size(), size());
+    for(int i = 0; i < size(); i++) x(i, pivots[i]) = 1;
+    solve_lower_in_place(factors, x, true);
+    solve_upper_in_place(factors, x);
+    return x;
+}
+
+
+inline physics::cholesky::cholesky(matrix a) : factors(std::move(a)), e(0), u() {
+    if(!factors.is_square()) throw std::invalid_argument("Only square matrices can be factorized.");
+    int n = size();
+    matrix& l = factors;
+
+    for(int k0 = 0; k0 < n; k0 += factorization_block) {
+        int k1 = std::min(k0 + factorization_block, n);
+
+        // Factorizes the diagonal block
+        for(int j = k0; j < k1; j++) {
+            scalar* lj = l.row(j);
+            scalar d = lj[j];
+            for(int p = k0; p < j; p++) d -= lj[p] * lj[p];
+            if(!(d > 0)) throw std::invalid_argument("Matrix is not positive definite.");
+            lj[j] = std::sqrt(d);
+
+            for(int i = j + 1; i < k1; i++) {
+                scalar* li = l.row(i);
+                scalar s = li[j];
+                for(int p = k0; p < j; p++) s -= li[p] * lj[p];
+                li[j] = s / lj[j];
+            }
+        }
+        if(k1 == n) break;
+
+        // Columns below it, L21 = A21 L11^-T, one row at a time.
+        // Each row is solved against the columns of L11, which are the rows of its transpose.
+        int m = n - k1;
+        matrix diagonal = matrix::zeros(k1 - k0, k1 - k0); // L11^T
+        for(int i = k0; i < k1; i++) {
+            for(int j = k0; j <= i; j++) diagonal(j - k0, i - k0) = l(i, j);
+        }
+        parallel_for(m, (long)m * (k1 - k0) * (k1 - k0) / 2, [&](int begin, int end) {
+            for(int i = k1 + begin; i < k1 + end; i++) {
+                scalar* li = l.row(i) + k0;
+                for(int j = 0; j < k1 - k0; j++) {
+                    const scalar* dj = diagonal.row(j);
+                    scalar x = li[j] /= dj[j];
+                    for(int q = j + 1; q < k1 - k0; q++) li[q] -= x * dj[q];
+                }
+            }
+        });
+
+        // Lower half of the rest of the matrix, A22 -= L21 L21^T, in blocks of rows
+        matrix t = matrix::zeros(k1 - k0, m);
+        for(int i = 0; i < m; i++) {
+            for(int j = k0; j < k1; j++) t(j - k0, i) = l(k1 + i, j);
+        }
+        int blocks = (m + factorization_block - 1) / factorization_block;
+        parallel_for(blocks, (long)m * m * (k1 - k0) / 2, [&](int begin, int end) {
+            for(int r = begin; r < end; r++) {
+                int r0 = r * factorization_block;
+                int r1 = std::min(r0 + factorization_block, m);
+                gemm_update(r1 - r0, r1, k1 - k0, -1, l.row(k1 + r0) + k0, l.stride, t.row(0), t.stride, l.row(k1 + r0) + k1, l.stride);
+            }
+        });
+    }
+
+    // The upper triangle still holds A
+    for(int i = 0; i < n; i++) {
+        std::fill(l.row(i) + i + 1, l.row(i) + n, 0);
+    }
+    transposed = factors.T();
+}
+inline physics::cholesky::cholesky(const val& a) : cholesky(a.v) {
+    e = a.e;
+    u = a.u;
+}
+
+inline int physics::cholesky::size() const { return factors.rows(); }
+
+inline physics::matrix physics::cholesky::solve(const matrix& b) const {
+    matrix x = as_columns(b, size());
+    solve_lower_in_place(factors, x, false);
+    solve_upper_in_place(transposed, x);
+    return as_result(std::move(x));
+}
+inline physics::val physics::cholesky::solve(const val& b) const {
+    return val(solve(b.v), b.e - e, b.u / u);
+}
+
+inline physics::scalar physics::cholesky::det() const {
+    scalar out = 1;
+    for(int i = 0; i < size(); i++) out *= factors(i, i) * factors(i, i);
+    return out;
+}
+
+inline physics::matrix physics::cholesky::inverse() const {
+    matrix x = matrix::identity(size());
+    solve_lower_in_place(factors, x, false);
+    solve_upper_in_place(transposed, x);
+    return x;
+}
+
+
+inline physics::matrix physics::solve_lower(const matrix& l, const matrix& b, bool unit_diagonal) {
+    if(!l.is_square()) throw std::invalid_argument("Only square matrices can be solved against.");
+    matrix x = as_columns(b, l.rows());
+    solve_lower_in_place(l, x, unit_diagonal);
+    return as_result(std::move(x));
+}
+inline physics::matrix physics::solve_upper(const matrix& u, const matrix& b) {
+    if(!u.is_square()) throw std::invalid_argument("Only square matrices can be solved against.");
+    matrix x = as_columns(b, u.rows());
+    solve_upper_in_place(u, x);
+    return as_result(std::move(x));
+}
+
+inline physics::matrix physics::solve(const matrix& a, const matrix& b) { return lu(a).solve(b); }
+inline physics::val physics::solve(const val& a, const val& b) { return lu(a).solve(b); }
+
+inline physics::scalar physics::det(const matrix& a) { return lu(a).det(); }
+inline physics::val physics::det(const val& a) {
+    // Only scalars carry an exponent, so it is never multiplied by more than one row
+    int n = a.v.rows();
+    return val(det(a.v), a.e * n, a.u ^ n);
+}
+
+inline physics::matrix physics::inverse(const matrix& a) { return lu(a).inverse(); }
+inline physics::val physics::inverse(const val& a) { return val(inverse(a.v), -a.e, a.u ^ -1); }
+
+
+// Largest column sum of absolute values
+inline physics::scalar norm_1(const physics::matrix& a) {
+    std::vector<physics::scalar> sums(a.cols());
+    for(int i = 0; i < a.rows(); i++) {
+        const physics::scalar* r = a.row(i);
+        for(int j = 0; j < a.cols(); j++) sums[j] += std::abs(r[j]);
+    }
+    return sums.empty() ? 0 : *std::max_element(sums.begin(), sums.end());
+}
+
+// Coefficients of the [m/m] Pade approximants of exp for m = 3, 5, 7, 9 and 13, and the largest 1-norm
+// for which each is accurate to double precision
+inline constexpr double pade_3[] = {120, 60, 12, 1};
+inline constexpr double pade_5[] = {30240, 15120, 3360, 420, 30, 1};
+inline constexpr double pade_7[] = {17297280, 8648640, 1995840, 277200, 25200, 1512, 56, 1};
+inline constexpr double pade_9[] = {17643225600, 8821612800, 2075673600, 302702400, 30270240, 2162160, 110880, 3960, 90, 1};
+inline constexpr double pade_13[] = {64764752532480000, 32382376266240000, 7771770303897600, 1187353796428800,
+                                     129060195264000, 10559470521600, 670442572800, 33522128640, 1323241920,
+                                     40840800, 960960, 16380, 182, 1};
+inline constexpr double pade_limits[] = {1.495585217958292e-2, 2.539398330063230e-1, 9.504178996162932e-1,
+                                         2.097847961257068e0, 5.371920351148152e0};
+
+inline physics::matrix physics::expm(const matrix& a) {
+    if(!a.is_square()) throw std::invalid_argument("Exponentiation only possible for square matrices");
+    if(a.is_scalar()) return std::exp(a.first());
+    int n = a.rows();
+    matrix id = matrix::identity(n);
+    scalar norm = norm_1(a);
+
+    // exp(A) ~ (V - U)^-1 (V + U), with U and V the odd and even terms of the approximant
+    matrix u, v;
+    if(norm <= pade_limits[3]) {
+        int m = norm <= pade_limits[0] ? 3 : norm <= pade_limits[1] ? 5 : norm <= pade_limits[2] ? 7 : 9;
+        const double* b = m == 3 ? pade_3 : m == 5 ? pade_5 : m == 7 ? pade_7 : pade_9;
+        // Even powers of A
+        matrix a2 = a * a, power = a2;
+        matrix odd = (scalar)b[1] * id + (scalar)b[3] * power;
+        v = (scalar)b[0] * id + (scalar)b[2] * power;
+        for(int j = 4; j <= m; j += 2) {
+            power = power * a2;
+            odd += (scalar)b[j + 1] * power;
+            v += (scalar)b[j] * power;
+        }
+        u = a * odd;
+    }
+    else {
+        // A is scaled by 2^-s into the range of the degree 13 approximant, whose result is squared s times
+        int s = std::max(0, (int)std::ceil(std::log2(norm / pade_limits[4])));
+        matrix scaled = a * (scalar)std::ldexp(1.0, -s);
+        matrix a2 = scaled * scaled, a4 = a2 * a2, a6 = a4 * a2;
+        const double* b = pade_13;
+        matrix high = a6 * matrix((scalar)b[13] * a6 + (scalar)b[11] * a4 + (scalar)b[9] * a2);
+        u = scaled * matrix(high + (scalar)b[7] * a6 + (scalar)b[5] * a4 + (scalar)b[3] * a2 + (scalar)b[1] * id);
+        high = a6 * matrix((scalar)b[12] * a6 + (scalar)b[10] * a4 + (scalar)b[8] * a2);
+        v = high + (scalar)b[6] * a6 + (scalar)b[4] * a4 + (scalar)b[2] * a2 + (scalar)b[0] * id;
+
+        matrix r = solve(v - u, v + u);
+        for(int i = 0; i < s; i++) r = r * r;
+        return r;
+    }
+    return solve(v - u, v + u);
+}
+
+inline physics::val physics::expm(const val& a) {
+    if(a.u != unit()) throw std::invalid_argument("Unit Error");
+    return val(expm(a.e == 0 ? a.v : a.v * power_of_ten(a.e)), 0, unit());
+}
+
+inline physics::matrix physics::sqrtm(const matrix& a) {
+    if(!a.is_square()) throw std::invalid_argument("Exponentiation only possible for square matrices");
+    if(a.is_scalar()) return std::sqrt(a.first());
+    int n = a.rows();
+    matrix id = matrix::identity(n);
+
+    // Product form: X converges to A^1/2 and M to I. Scaling by |det M|^(-1/2n) evens out the
+    // eigenvalues of M, which speeds up the first steps.
+    matrix x = a, m = a;
+    const scalar tolerance = std::sqrt((scalar)n) * std::numeric_limits<scalar>::epsilon();
+    scalar last = std::numeric_limits<scalar>::infinity();
+    bool scaling = true;
+    for(int step = 0; step < 100; step++) {
+        lu f(m);
+        // Later steps only become singular for eigenvalues on the negative real axis
+        if(f.is_singular() && step == 0) throw std::invalid_argument("Matrix is singular.");
+        if(f.is_singular()) break;
+        matrix mi = f.inverse();
+        scalar mu = 1;
+        if(scaling) {
+            scalar log_det = 0;
+            for(int i = 0; i < n; i++) log_det += std::log(std::abs(f.factors(i, i)));
+            mu = std::exp(-log_det / (2 * n));
+        }
+        x = x * matrix(mu / 2 * id + 1 / (2 * mu) * mi);
+        m = matrix((scalar)0.5 * id + mu * mu / 4 * m + 1 / (4 * mu * mu) * mi);
+
+        scalar change = norm_1(m - id);
+        if(!std::isfinite(change)) break;
+        // Past the tolerance, or once rounding stops it improving
+        if(change <= tolerance || (!scaling && change >= last && change < std::sqrt(tolerance))) return x;
+        if(change < (scalar)0.01) scaling = false;
+        last = change;
+    }
+    throw std::invalid_argument("Square root did not converge.");
+}
+
+inline physics::val physics::sqrtm(const val& a) { return a ^ 0.5; }
+
+
+// end --- decomposition.cpp --- 
+
+
+
+// begin --- sparse.cpp --- 
+
+
+
+// begin --- sparse.h --- 
+
+#pragma once
+
+
+
+
+#include <vector>
+
+
+namespace physics {
+    // Entries of a sparse matrix collected in any order, to be compressed into a sparse_matrix.
+    // Entries added at the same position are summed, as when assembling stiffness matrices element by element.
+    struct triplets {
+    public:
+        int n_rows = 0;
+        int n_cols = 0;
+        std::vector<int> row_indices;
+        std::vector<int> col_indices;
+        std::vector<scalar> values;
+
+    public:
+        triplets(int rows, int cols);
+
+        void reserve(int entries);
+        void add(int i, int j, scalar x);
+    };
+
+    // Represents a sparse matrix in compressed sparse row (CSR) form.
+    // The entries of row i are at [row_starts[i], row_starts[i + 1]) in columns and values, sorted by column.
+    // The compressed sparse column (CSC) form of a matrix has the same arrays as the CSR form of its transpose.
+    struct sparse_matrix {
+    public:
+        int n_rows = 0;
+        int n_cols = 0;
+        std::vector<int> row_starts;
+        std::vector<int> columns;
+        std::vector<scalar> values;
+
+        int rows() const;
+        int cols() const;
+        int non_zeros() const;
+
+        // Element access, zero for entries that are not stored
+        scalar operator()(int i, int j) const;
+
+    public:
+        sparse_matrix();
+        sparse_matrix(int rows, int cols);
+        explicit sparse_matrix(const triplets& t);
+        // Stores the non-zero elements of m.
+        explicit sparse_matrix(const matrix& m);
+
+        static sparse_matrix identity(int n);
+
+        // Conversions
+        explicit operator matrix() const;
+
+        // Products with a vector, or with every column of a dense matrix, split across the thread pool by rows.
+        // Vector results are returned as row vectors.
+        matrix operator*(const matrix& x) const;
+        sparse_matrix operator*(scalar x) const;
+        sparse_matrix operator/(scalar x) const;
+
+        // Transpose
+        sparse_matrix T() const;
+    };
+
+    sparse_matrix operator*(scalar x, const sparse_matrix& m);
+
+    // A sparse matrix whose entries all have the same unit.
+    struct sparse_val {
+    public:
+        sparse_matrix v; // Values in SI units
+        unit u; // Unit
+
+    public:
+        sparse_val();
+        sparse_val(sparse_matrix v, unit u = unit());
+
+        val operator*(const val& x) const;
+        sparse_val T() const;
+    };
+
+    sparse_val operator*(sparse_matrix m, const unit& u);
+    sparse_val operator/(sparse_matrix m, const unit& u);
+
+    // Sparse LU factorization P A Q = L U of a square matrix.
+    // Columns are ordered by nested dissection of the pattern of A + A^T to reduce fill-in, and factorized
+    // left-looking one at a time (Gilbert-Peierls). Rows are pivoted, preferring the diagonal when it
+    // is at least a tenth of the largest candidate, so the ordering is kept for well-behaved matrices.
+    class sparse_lu {
+    public:
+        sparse_matrix lower; // L in CSC form (the CSR form of L^T), unit diagonal first in each column
+        sparse_matrix upper; // U in CSC form, diagonal last in each column
+        std::vector<int> row_order; // Row k of P A is row row_order[k] of A
+        std::vector<int> col_order; // Column k of A Q is column col_order[k] of A
+        unit u; // Unit of A
+
+    public:
+        explicit sparse_lu(const sparse_matrix& a);
+        explicit sparse_lu(const sparse_val& a);
+
+        int size() const;
+
+        // Solves A x = b for a vector b, or A X = B for every column of B.
+        matrix solve(const matrix& b) const;
+        val solve(const val& b) const;
+    };
+
+    // Sparse Cholesky factorization P A P^T = L L^T of a symmetric positive definite matrix.
+    // Only the lower triangle of A is read. Rows are ordered by nested dissection, and L is computed
+    // one row at a time along the elimination tree.
+    class sparse_cholesky {
+    public:
+        sparse_matrix lower; // L in CSC form (the CSR form of L^T), diagonal first in each column
+        std::vector<int> order; // Row k of P A P^T is row order[k] of A
+        unit u; // Unit of A
+
+    public:
+        explicit sparse_cholesky(const sparse_matrix& a);
+        explicit sparse_cholesky(const sparse_val& a);
+
+        int size() const;
+
+        // Solves A x = b for a vector b, or A X = B for every column of B.
+        matrix solve(const matrix& b) const;
+        val solve(const val& b) const;
+    };
+
+    // Solves A x = b through a sparse LU factorization. The result has the unit of b divided by that of A.
+    matrix solve(const sparse_matrix& a, const matrix& b);
+    val solve(const sparse_val& a, const val& b);
+}
+
+
+// end --- sparse.h --- 
+
+
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <numeric>
+#include <set>
+#include <stdexcept>
+#include <utility>
+
+
+// Neighbours of every node in the graph of A + A^T, sorted
+inline std::vector<std::vector<int>> symmetric_graph(const physics::sparse_matrix& a) {
+    std::vector<std::vector<int>> adjacent(a.rows());
+    for(int i = 0; i < a.rows(); i++) {
+        for(int p = a.row_starts[i]; p < a.row_starts[i + 1]; p++) {
+            int j = a.columns[p];
+            if(i == j) continue;
+            adjacent[i].push_back(j);
+            adjacent[j].push_back(i);
+        }
+    }
+    for(std::vector<int>& x : adjacent) {
+        std::sort(x.begin(), x.end());
+        x.erase(std::unique(x.begin(), x.end()), x.end());
+    }
+    return adjacent;
+}
+
+// Appends nodes to order by minimum degree within the part of the graph they make up.
+// Eliminating a node joins its neighbours into a clique, so eliminating the node with the fewest
+// neighbours first keeps the fill-in small.
+// position[v] is the index of node v in nodes.
+inline void minimum_degree_order(const std::vector<std::vector<int>>& graph, const std::vector<int>& nodes, const std::vector<int>& part, const std::vector<int>& position, std::vector<int>& order) {
+    int id = part[nodes[0]];
+    int n = nodes.size();
+
+    // Neighbours are kept as sorted lists of graph nodes
+    std::vector<std::vector<int>> adjacent(n);
+    std::set<std::pair<int, int>> queue; // Degree and position in nodes
+    for(int k = 0; k < n; k++) {
+        for(int w : graph[nodes[k]]) {
+            if(part[w] == id) adjacent[k].push_back(w);
+        }
+        queue.emplace(adjacent[k].size(), k);
+    }
+
+    std::vector<int> merged;
+    while(!queue.empty()) {
+        int v = queue.begin()->second;
+        queue.erase(queue.begin());
+        order.push_back(nodes[v]);
+
+        for(int node : adjacent[v]) {
+            int w = position[node];
+            std::vector<int>& neighbours = adjacent[w];
+            queue.erase({(int)neighbours.size(), w});
+            merged.clear();
+            std::set_union(neighbours.begin(), neighbours.end(), adjacent[v].begin(), adjacent[v].end(), std::back_inserter(merged));
+            merged.erase(std::remove_if(merged.begin(), merged.end(), [&](int x) { return x == nodes[v] || x == node; }), merged.end());
+            neighbours.swap(merged);
+            queue.emplace(neighbours.size(), w);
+        }
+        std::vector<int>().swap(adjacent[v]);
+    }
+}
+
+// Appends nodes to order by nested dissection. Each connected part is split in two by the middle level
+// of a breadth first search from a far away node, and both halves are ordered before the separator
+// between them, so eliminating one half doesn't fill in the other. Small parts are ordered by minimum degree.
+// part and position are kept for every node of the graph, with the part a node was last split into and
+// its index there.
+inline void nested_dissection_order(const std::vector<std::vector<int>>& graph, const std::vector<int>& nodes, std::vector<int>& part, int& parts, std::vector<int>& position, std::vector<int>& order) {
+    if(nodes.empty()) return;
+    int id = parts++;
+    for(size_t k = 0; k < nodes.size(); k++) {
+        part[nodes[k]] = id;
+        position[nodes[k]] = k;
+    }
+    if(nodes.size() <= 64) {
+        minimum_degree_order(graph, nodes, part, position, order);
+        return;
+    }
+
+    // Levels of a breadth first search from start over the nodes without a level yet, returning the
+    // depth of the last level
+    std::vector<int> level(nodes.size(), -1), queue;
+    auto search = [&](int start) {
+        queue.assign(1, start);
+        level[position[start]] = 0;
+        for(size_t q = 0; q < queue.size(); q++) {
+            int depth = level[position[queue[q]]];
+            for(int w : graph[queue[q]]) {
+                if(part[w] != id || level[position[w]] >= 0) continue;
+                level[position[w]] = depth + 1;
+                queue.push_back(w);
+            }
+        }
+        return level[position[queue.back()]];
+    };
+
+    // Connected components are ordered one after the other
+    int depth = search(nodes[0]);
+    if(queue.size() < nodes.size()) {
+        std::vector<std::vector<int>> components(1, queue);
+        for(size_t k = 0; k < nodes.size(); k++) {
+            if(level[k] >= 0) continue;
+            search(nodes[k]);
+            components.push_back(queue);
+        }
+        for(const std::vector<int>& component : components) nested_dissection_order(graph, component, part, parts, position, order);
+        return;
+    }
+
+    // Restarts from the far end, at its node with the fewest neighbours, while that gets deeper
+    int start = nodes[0];
+    for(int tries = 0; tries < 4; tries++) {
+        int far = queue.back();
+        for(auto q = queue.rbegin(); q != queue.rend() && level[position[*q]] == depth; q++) {
+            if(graph[*q].size() < graph[far].size()) far = *q;
+        }
+        std::fill(level.begin(), level.end(), -1);
+        int next = search(far);
+        if(next <= depth) {
+            std::fill(level.begin(), level.end(), -1);
+            search(start);
+            break;
+        }
+        start = far;
+        depth = next;
+    }
+    if(depth < 2) {
+        // Too tightly connected to split
+        minimum_degree_order(graph, nodes, part, position, order);
+        return;
+    }
+
+    // The separator is the level holding the middle node, but never the first or last level
+    std::vector<int> counts(depth + 1, 0);
+    for(int x : level) counts[x]++;
+    int middle = 0;
+    for(int below = 0; below + counts[middle] < (int)nodes.size() / 2; middle++) below += counts[middle];
+    middle = std::min(std::max(middle, 1), depth - 1);
+
+    std::vector<int> lower, upper, separator;
+    for(size_t k = 0; k < nodes.size(); k++) {
+        if(level[k] < middle) lower.push_back(nodes[k]);
+        else if(level[k] > middle) upper.push_back(nodes[k]);
+        else separator.push_back(nodes[k]);
+    }
+    nested_dissection_order(graph, lower, part, parts, position, order);
+    nested_dissection_order(graph, upper, part, parts, position, order);
+    order.insert(order.end(), separator.begin(), separator.end());
+}
+
+// Orders the rows and columns of a square matrix to reduce the fill-in of its factorization
+inline std::vector<int> fill_reducing_order(const physics::sparse_matrix& a) {
+    std::vector<std::vector<int>> graph = symmetric_graph(a);
+    std::vector<int> nodes(a.rows()), part(a.rows(), -1), position(a.rows()), order;
+    std::iota(nodes.begin(), nodes.end(), 0);
+    int parts = 0;
+    order.reserve(a.rows());
+    nested_dissection_order(graph, nodes, part, parts, position, order);
+    return order;
+}
+
+// Sorts the entries of every row of m by column
+inline void sort_rows(physics::sparse_matrix& m) {
+    std::vector<std::pair<int, physics::scalar>> entries;
+    for(int i = 0; i < m.rows(); i++) {
+        int first = m.row_starts[i];
+        entries.clear();
+        for(int p = first; p < m.row_starts[i + 1]; p++) entries.emplace_back(m.columns[p], m.values[p]);
+        std::sort(entries.begin(), entries.end(), [](const std::pair<int, physics::scalar>& x, const std::pair<int, physics::scalar>& y) { return x.first < y.first; });
+        for(size_t q = 0; q < entries.size(); q++) {
+            m.columns[first + q] = entries[q].first;
+            m.values[first + q] = entries[q].second;
+        }
+    }
+}
+
+// Calls solve_one on every right-hand side of b, each copied to a contiguous array of n values.
+// A vector b gives a row vector, and a matrix of n rows a matrix of the same size.
+template <typename F>
+inline physics::matrix solve_each_column(const physics::matrix& b, int n, long work, F solve_one) {
+    if(b.is_vector() && b.size() == n) {
+        physics::matrix x = b;
+        x.n_rows = 1;
+        x.n_cols = x.stride = n;
+        solve_one(x.row(0));
+        return x;
+    }
+    if(b.rows() != n) throw std::invalid_argument("Incompatible matrices.");
+
+    physics::matrix x = b;
+    physics::parallel_for(x.cols(), work * x.cols(), [&](int begin, int end) {
+        std::vector<physics::scalar> column(n);
+        for(int c = begin; c < end; c++) {
+            for(int i = 0; i < n; i++) column[i] = x(i, c);
+            solve_one(column.data());
+            for(int i = 0; i < n; i++) x(i, c) = column[i];
+        }
+    });
+    return x;
+}
+
+
+inline physics::triplets::triplets(int rows, int cols) : n_rows(rows), n_cols(cols) {}
+
+inline void physics::triplets::reserve(int entries) {
+    row_indices.reserve(entries);
+    col_indices.reserve(entries);
+    values.reserve(entries);
+}
+
+inline void physics::triplets::add(int i, int j, scalar x) {
+    if(i < 0 || i >= n_rows || j < 0 || j >= n_cols) throw std::invalid_argument("Index out of range.");
+    row_indices.push_back(i);
+    col_indices.push_back(j);
+    values.push_back(x);
+}
+
+
+inline int physics::sparse_matrix::rows() const { return n_rows; }
+inline int physics::sparse_matrix::cols() const { return n_cols; }
+inline int physics::sparse_matrix::non_zeros() const { return values.size(); }
+
+inline physics::scalar physics::sparse_matrix::operator()(int i, int j) const {
+    auto first = columns.begin() + row_starts[i];
+    auto last = columns.begin() + row_starts[i + 1];
+    auto it = std::lower_bound(first, last, j);
+    return it != last && *it == j ? values[it - columns.begin()] : 0;
+}
+
+
+inline physics::sparse_matrix::sparse_matrix() : row_starts(1, 0) {}
+inline physics::sparse_matrix::sparse_matrix(int rows, int cols) : n_rows(rows), n_cols(cols), row_starts(rows + 1, 0) {}
+
+inline physics::sparse_matrix::sparse_matrix(const triplets& t) : sparse_matrix(t.n_rows, t.n_cols) {
+    // Sorts the entries into rows
+    for(int i : t.row_indices) row_starts[i + 1]++;
+    std::partial_sum(row_starts.begin(), row_starts.end(), row_starts.begin());
+    std::vector<int> next(row_starts.begin(), row_starts.end() - 1);
+    std::vector<std::pair<int, scalar>> entries(t.values.size());
+    for(size_t p = 0; p < t.values.size(); p++) {
+        entries[next[t.row_indices[p]]++] = {t.col_indices[p], t.values[p]};
+    }
+
+    // Sorts every row by column, summing entries in the same place
+    columns.reserve(entries.size());
+    values.reserve(entries.size());
+    for(int i = 0; i < n_rows; i++) {
+        auto first = entries.begin() + row_starts[i];
+        auto last = entries.begin() + row_starts[i + 1];
+        std::sort(first, last, [](const std::pair<int, scalar>& x, const std::pair<int, scalar>& y) { return x.first < y.first; });
+
+        row_starts[i] = columns.size();
+        for(auto it = first; it != last; it++) {
+            if((int)columns.size() > row_starts[i] && columns.back() == it->first) {
+                values.back() += it->second;
+                continue;
+            }
+            columns.push_back(it->first);
+            values.push_back(it->second);
+        }
+    }
+    row_starts[n_rows] = columns.size();
+}
+
+inline physics::sparse_matrix::sparse_matrix(const matrix& m) : sparse_matrix(m.rows(), m.cols()) {
+    for(int i = 0; i < n_rows; i++) {
+        const scalar* r = m.row(i);
+        for(int j = 0; j < n_cols; j++) {
+            if(r[j] == 0) continue;
+            columns.push_back(j);
+            values.push_back(r[j]);
+        }
+        row_starts[i + 1] = columns.size();
+    }
+}
+
+inline physics::sparse_matrix physics::sparse_matrix::identity(int n) {
+    sparse_matrix out(n, n);
+    std::iota(out.row_starts.begin(), out.row_starts.end(), 0);
+    out.columns.resize(n);
+    std::iota(out.columns.begin(), out.columns.end(), 0);
+    out.values.assign(n, 1);
+    return out;
+}
+
+
+inline physics::sparse_matrix::operator matrix() const {
+    matrix out = matrix::zeros(n_rows, n_cols);
+    for(int i = 0; i < n_rows; i++) {
+        for(int p = row_starts[i]; p < row_starts[i + 1]; p++) out(i, columns[p]) = values[p];
+    }
+    return out;
+}
+
+
+inline physics::matrix physics::sparse_matrix::operator*(const matrix& x) const {
+    // Vectors are taken as columns, and both shapes are stored contiguously
+    if(x.is_vector() && x.size() == cols()) {
+        matrix out = matrix::zeros(1, rows());
+        const scalar* in = x.row(0);
+        scalar* result = out.row(0);
+        parallel_for(rows(), non_zeros(), [&](int begin, int end) {
+            for(int i = begin; i < end; i++) {
+                scalar sum = 0;
+                for(int p = row_starts[i]; p < row_starts[i + 1]; p++) sum += values[p] * in[columns[p]];
+                result[i] = sum;
+            }
+        });
+        return out;
+    }
+
+    if(x.rows() != cols()) throw std::invalid_argument("Incompatible matrices.");
+    matrix out = matrix::zeros(rows(), x.cols());
+    parallel_for(rows(), (long)non_zeros() * x.cols(), [&](int begin, int end) {
+        for(int i = begin; i < end; i++) {
+            scalar* result = out.row(i);
+            for(int p = row_starts[i]; p < row_starts[i + 1]; p++) {
+                scalar a = values[p];
+                const scalar* in = x.row(columns[p]);
+                for(int c = 0; c < x.cols(); c++) result[c] += a * in[c];
+            }
+        }
+    });
+    return out;
+}
+
+inline physics::sparse_matrix physics::sparse_matrix::operator*(scalar x) const {
+    sparse_matrix out = *this;
+    for(scalar& value : out.values) value *= x;
+    return out;
+}
+inline physics::sparse_matrix physics::sparse_matrix::operator/(scalar x) const {
+    return *this * (1 / x);
+}
+
+inline physics::sparse_matrix physics::sparse_matrix::T() const {
+    // Entries are counted into columns, and filled in row by row so every row of the transpose stays sorted
+    sparse_matrix out(n_cols, n_rows);
+    for(int j : columns) out.row_starts[j + 1]++;
+    std::partial_sum(out.row_starts.begin(), out.row_starts.end(), out.row_starts.begin());
+    out.columns.resize(non_zeros());
+    out.values.resize(non_zeros());
+
+    std::vector<int> next(out.row_starts.begin(), out.row_starts.end() - 1);
+    for(int i = 0; i < n_rows; i++) {
+        for(int p = row_starts[i]; p < row_starts[i + 1]; p++) {
+            int q = next[columns[p]]++;
+            out.columns[q] = i;
+            out.values[q] = values[p];
+        }
+    }
+    return out;
+}
+
+inline physics::sparse_matrix physics::operator*(scalar x, const sparse_matrix& m) { return m * x; }
+
+
+inline physics::sparse_val::sparse_val() {}
+inline physics::sparse_val::sparse_val(sparse_matrix v, unit u) : v(std::move(v)), u(u) {}
+
+inline physics::val physics::sparse_val::operator*(const val& x) const { return val(v * x.v, x.e, u * x.u); }
+inline physics::sparse_val physics::sparse_val::T() const { return sparse_val(v.T(), u); }
+
+inline physics::sparse_val physics::operator*(sparse_matrix m, const unit& u) { return sparse_val(std::move(m), u); }
+inline physics::sparse_val physics::operator/(sparse_matrix m, const unit& u) { return sparse_val(std::move(m), u ^ -1); }
+
+
+inline physics::sparse_lu::sparse_lu(const sparse_matrix& a) : u() {
+    if(a.rows() != a.cols()) throw std::invalid_argument("Only square matrices can be factorized.");
+    int n = a.rows();
+    sparse_matrix columns_of_a = a.T(); // A in CSC form
+    col_order = fill_reducing_order(a);
+
+    // Position of each row of A among the pivots, -1 until it is chosen
+    std::vector<int> pivot_of(n, -1);
+    lower = sparse_matrix(n, n);
+    upper = sparse_matrix(n, n);
+    std::vector<int>& lp = lower.row_starts;
+    std::vector<int>& li = lower.columns;
+    std::vector<scalar>& lx = lower.values;
+
+    std::vector<scalar> x(n, 0);
+    std::vector<int> reached(n), path(n), next_entry(n), mark(n, -1);
+    for(int k = 0; k < n; k++) {
+        lp[k] = li.size();
+        upper.row_starts[k] = upper.columns.size();
+        int col = col_order[k];
+
+        // Finds the rows of x = L \ A(:, col) by a depth first search from the rows of A(:, col) through
+        // the columns of L found so far. reached[top, n) lists every row before the rows it updates.
+        int top = n;
+        for(int p = columns_of_a.row_starts[col]; p < columns_of_a.row_starts[col + 1]; p++) {
+            int start = columns_of_a.columns[p];
+            if(mark[start] == k) continue;
+            int head = 0;
+            path[0] = start;
+            while(head >= 0) {
+                int j = path[head];
+                int column = pivot_of[j];
+                if(mark[j] != k) {
+                    mark[j] = k;
+                    next_entry[head] = column < 0 ? 0 : lp[column] + 1;
+                }
+                int end = column < 0 ? 0 : lp[column + 1];
+                bool done = true;
+                for(int q = next_entry[head]; q < end; q++) {
+                    if(mark[li[q]] == k) continue;
+                    next_entry[head] = q + 1;
+                    path[++head] = li[q];
+                    done = false;
+                    break;
+                }
+                if(done) {
+                    head--;
+                    reached[--top] = j;
+                }
+            }
+        }
+
+        // Solves for x along the reached rows
+        for(int p = columns_of_a.row_starts[col]; p < columns_of_a.row_starts[col + 1]; p++) {
+            x[columns_of_a.columns[p]] = columns_of_a.values[p];
+        }
+        for(int t = top; t < n; t++) {
+            int j = reached[t];
+            int column = pivot_of[j];
+            if(column < 0) continue;
+            for(int q = lp[column] + 1; q < lp[column + 1]; q++) x[li[q]] -= lx[q] * x[j];
+        }
+
+        // Rows already pivoted go to U, the largest of the others becomes the pivot
+        int pivot_row = -1;
+        scalar largest = -1;
+        for(int t = top; t < n; t++) {
+            int j = reached[t];
+            if(pivot_of[j] < 0) {
+                if(std::abs(x[j]) > largest) {
+                    largest = std::abs(x[j]);
+                    pivot_row = j;
+                }
+                continue;
+            }
+            upper.columns.push_back(pivot_of[j]);
+            upper.values.push_back(x[j]);
+        }
+        if(pivot_row < 0 || largest == 0) throw std::invalid_argument("Matrix is singular.");
+        if(pivot_of[col] < 0 && std::abs(x[col]) >= largest / 10) pivot_row = col;
+
+        scalar pivot = x[pivot_row];
+        upper.columns.push_back(k);
+        upper.values.push_back(pivot);
+        pivot_of[pivot_row] = k;
+        li.push_back(pivot_row);
+        lx.push_back(1);
+        for(int t = top; t < n; t++) {
+            int j = reached[t];
+            if(pivot_of[j] < 0) {
+                li.push_back(j);
+                lx.push_back(x[j] / pivot);
+            }
+            x[j] = 0;
+        }
+    }
+    lp[n] = li.size();
+    upper.row_starts[n] = upper.columns.size();
+
+    // Rows of L were kept as rows of A while pivots were chosen
+    for(int& i : li) i = pivot_of[i];
+    row_order.resize(n);
+    for(int i = 0; i < n; i++) row_order[pivot_of[i]] = i;
+
+    // Rows within a column are in the order they were reached. Sorting keeps the diagonals in place.
+    sort_rows(lower);
+    sort_rows(upper);
+}
+inline physics::sparse_lu::sparse_lu(const sparse_val& a) : sparse_lu(a.v) {
+    u = a.u;
+}
+
+inline int physics::sparse_lu::size() const { return row_order.size(); }
+
+inline physics::matrix physics::sparse_lu::solve(const matrix& b) const {
+    int n = size();
+    long work = lower.non_zeros() + upper.non_zeros();
+    return solve_each_column(b, n, work, [&](scalar* x) {
+        std::vector<scalar> y(n);
+        for(int k = 0; k < n; k++) y[k] = x[row_order[k]];
+
+        for(int j = 0; j < n; j++) {
+            for(int p = lower.row_starts[j] + 1; p < lower.row_starts[j + 1]; p++) y[lower.columns[p]] -= lower.values[p] * y[j];
+        }
+        for(int j = n - 1; j >= 0; j--) {
+            int diagonal = upper.row_starts[j + 1] - 1;
+            y[j] /= upper.values[diagonal];
+            for(int p = upper.row_starts[j]; p < diagonal; p++) y[upper.columns[p]] -= upper.values[p] * y[j];
+        }
+
+        for(int k = 0; k < n; k++) x[col_order[k]] = y[k];
+    });
+}
+inline physics::val physics::sparse_lu::solve(const val& b) const {
+    return val(solve(b.v), b.e, b.u / u);
+}
+
+
+inline physics::sparse_cholesky::sparse_cholesky(const sparse_matrix& a) : u() {
+    if(a.rows() != a.cols()) throw std::invalid_argument("Only square matrices can be factorized.");
+    int n = a.rows();
+    order = fill_reducing_order(a);
+    std::vector<int> position(n);
+    for(int k = 0; k < n; k++) position[order[k]] = k;
+
+    // Row k of c holds the lower triangle of P A P^T, which is column k of its upper triangle
+    triplets t(n, n);
+    for(int i = 0; i < n; i++) {
+        for(int p = a.row_starts[i]; p < a.row_starts[i + 1]; p++) {
+            int j = a.columns[p];
+            if(j > i) continue;
+            t.add(std::max(position[i], position[j]), std::min(position[i], position[j]), a.values[p]);
+        }
+    }
+    sparse_matrix c(t);
+
+    // Elimination tree, where the parent of column i is the first row below it in L's column i
+    std::vector<int> parent(n, -1), ancestor(n, -1);
+    for(int k = 0; k < n; k++) {
+        for(int p = c.row_starts[k]; p < c.row_starts[k + 1]; p++) {
+            for(int i = c.columns[p]; i != -1 && i < k;) {
+                int next = ancestor[i];
+                ancestor[i] = k;
+                if(next == -1) parent[i] = k;
+                i = next;
+            }
+        }
+    }
+
+    // Writes the columns of row k of L, other than the diagonal, to reached[top, n), each before its
+    // ancestors in the elimination tree, and returns top
+    std::vector<int> reached(n), path(n), mark(n, -1);
+    auto row_pattern = [&](int k) {
+        int top = n;
+        mark[k] = k;
+        for(int p = c.row_starts[k]; p < c.row_starts[k + 1]; p++) {
+            int length = 0;
+            for(int i = c.columns[p]; mark[i] != k; i = parent[i]) {
+                path[length++] = i;
+                mark[i] = k;
+            }
+            while(length > 0) reached[--top] = path[--length];
+        }
+        return top;
+    };
+
+    // Counts the entries of every column of L before filling them in
+    lower = sparse_matrix(n, n);
+    std::vector<int>& lp = lower.row_starts;
+    for(int k = 0; k < n; k++) {
+        lp[k + 1]++;
+        for(int t = row_pattern(k); t < n; t++) lp[reached[t] + 1]++;
+    }
+    std::partial_sum(lp.begin(), lp.end(), lp.begin());
+    lower.columns.resize(lp[n]);
+    lower.values.resize(lp[n]);
+
+    // Computes row k of L from the columns to its left, which are complete above row k
+    std::vector<int> next(lp.begin(), lp.end() - 1);
+    std::vector<scalar> x(n, 0);
+    for(int k = 0; k < n; k++) {
+        int top = row_pattern(k);
+        for(int p = c.row_starts[k]; p < c.row_starts[k + 1]; p++) x[c.columns[p]] = c.values[p];
+        scalar d = x[k];
+        x[k] = 0;
+
+        for(; top < n; top++) {
+            int i = reached[top];
+            scalar l = x[i] / lower.values[lp[i]];
+            x[i] = 0;
+            for(int p = lp[i] + 1; p < next[i]; p++) x[lower.columns[p]] -= lower.values[p] * l;
+            d -= l * l;
+            int p = next[i]++;
+            lower.columns[p] = k;
+            lower.values[p] = l;
+        }
+
+        if(!(d > 0)) throw std::invalid_argument("Matrix is not positive definite.");
+        int p = next[k]++;
+        lower.columns[p] = k;
+        lower.values[p] = std::sqrt(d);
+    }
+}
+inline physics::sparse_cholesky::sparse_cholesky(const sparse_val& a) : sparse_cholesky(a.v) {
+    u = a.u;
+}
+
+inline int physics::sparse_cholesky::size() const { return order.size(); }
+
+inline physics::matrix physics::sparse_cholesky::solve(const matrix& b) const {
+    int n = size();
+    const std::vector<int>& lp = lower.row_starts;
+    return solve_each_column(b, n, 2 * lower.non_zeros(), [&](scalar* x) {
+        std::vector<scalar> y(n);
+        for(int k = 0; k < n; k++) y[k] = x[order[k]];
+
+        // L y = P b by columns, then L^T z = y by rows of L^T, which are the same columns
+        for(int j = 0; j < n; j++) {
+            y[j] /= lower.values[lp[j]];
+            for(int p = lp[j] + 1; p < lp[j + 1]; p++) y[lower.columns[p]] -= lower.values[p] * y[j];
+        }
+        for(int j = n - 1; j >= 0; j--) {
+            for(int p = lp[j] + 1; p < lp[j + 1]; p++) y[j] -= lower.values[p] * y[lower.columns[p]];
+            y[j] /= lower.values[lp[j]];
+        }
+
+        for(int k = 0; k < n; k++) x[order[k]] = y[k];
+    });
+}
+inline physics::val physics::sparse_cholesky::solve(const val& b) const {
+    return val(solve(b.v), b.e, b.u / u);
+}
+
+
+inline physics::matrix physics::solve(const sparse_matrix& a, const matrix& b) { return sparse_lu(a).solve(b); }
+inline physics::val physics::solve(const sparse_val& a, const val& b) { return sparse_lu(a).solve(b); }
+
+
+// end --- sparse.cpp --- 
+
+
+
+// begin --- iterative.cpp --- 
+
+
+
+// begin --- iterative.h --- 
+
+#pragma once
+
+
+
+
+
+#include <functional>
+
+
+namespace physics {
+    // A linear map y = A x on vectors of n elements, for the iterative solvers.
+    // Operators made from a matrix or sparse_matrix refer to it, so it must outlive the operator.
+    class linear_operator {
+    public:
+        int n = 0;
+        std::function<void(const scalar*, scalar*)> apply; // Writes A x to y, both n elements long
+
+    public:
+        linear_operator();
+        linear_operator(const matrix& a);
+        linear_operator(const sparse_matrix& a);
+        linear_operator(int n, std::function<void(const scalar*, scalar*)> f);
+        // Wraps a function taking and returning vectors as matrices.
+        linear_operator(int n, std::function<matrix(const matrix&)> f);
+
+        int size() const;
+        bool empty() const;
+
+        // Returns A x as a row vector
+        matrix operator()(const matrix& x) const;
+    };
+
+    // Preconditioners, which approximate A^-1. They keep their own copy of what they need from A.
+    // Jacobi scales by the inverse of the diagonal.
+    linear_operator jacobi(const matrix& a);
+    linear_operator jacobi(const sparse_matrix& a);
+    // Symmetric successive over-relaxation, with 0 < omega < 2. Suits symmetric matrices.
+    linear_operator ssor(const sparse_matrix& a, scalar omega = 1);
+    // Cholesky factorization keeping only the pattern of the lower triangle of A, for symmetric positive definite A.
+    linear_operator incomplete_cholesky(const sparse_matrix& a);
+    // LU factorization keeping only the pattern of A.
+    linear_operator ilu0(const sparse_matrix& a);
+
+    // Outcome of an iterative solve
+    struct krylov_result {
+        matrix x; // Solution, as a row vector
+        int iterations = 0;
+        scalar residual = 0; // Norm of b - A x
+        bool converged = false; // Whether residual reached the tolerance
+    };
+
+    // Krylov solvers for A x = b, starting from x = 0. They stop when the norm of the residual b - A x
+    // is at most tolerance, or after max_iterations (0 for the size of the system).
+    // Preconditioners are applied on the right, so the residual is that of the original system.
+    // Conjugate gradients, for symmetric positive definite A.
+    krylov_result cg(const linear_operator& a, const matrix& b, scalar tolerance,
+                     const linear_operator& preconditioner = linear_operator(), int max_iterations = 0);
+    // BiCGSTAB, for general A.
+    krylov_result bicgstab(const linear_operator& a, const matrix& b, scalar tolerance,
+                           const linear_operator& preconditioner = linear_operator(), int max_iterations = 0);
+    // GMRES, restarted every restart iterations, for general A.
+    krylov_result gmres(const linear_operator& a, const matrix& b, scalar tolerance,
+                        const linear_operator& preconditioner = linear_operator(), int restart = 30, int max_iterations = 0);
+
+    // The same for values. The tolerance has the unit of b, and the result that of b divided by that of A.
+    // Throws if the solver doesn't converge.
+    val cg(const val& a, const val& b, const val& tolerance,
+           const linear_operator& preconditioner = linear_operator(), int max_iterations = 0);
+    val cg(const sparse_val& a, const val& b, const val& tolerance,
+           const linear_operator& preconditioner = linear_operator(), int max_iterations = 0);
+    val bicgstab(const val& a, const val& b, const val& tolerance,
+                 const linear_operator& preconditioner = linear_operator(), int max_iterations = 0);
+    val bicgstab(const sparse_val& a, const val& b, const val& tolerance,
+                 const linear_operator& preconditioner = linear_operator(), int max_iterations = 0);
+    val gmres(const val& a, const val& b, const val& tolerance,
+              const linear_operator& preconditioner = linear_operator(), int restart = 30, int max_iterations = 0);
+    val gmres(const sparse_val& a, const val& b, const val& tolerance,
+              const linear_operator& preconditioner = linear_operator(), int restart = 30, int max_iterations = 0);
+}
+
+
+// end --- iterative.h --- 
+
+
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+
+// Calls f(i) for every element, split across the thread pool for long vectors
+template <typename F>
+inline void for_each_element(int n, F f) {
+    physics::parallel_for(n, n, [&](int begin, int end) {
+        for(int i = begin; i < end; i++) f(i);
+    });
+}
+
+// Sums are taken in blocks of this many elements, and the block sums added in order,
+// so results don't depend on the number of threads.
+inline constexpr int reduction_block = 4096;
+
+// Sum of f(i) over [begin, end), kept in four partial sums so the loop vectorizes
+template <typename F>
+inline physics::scalar block_sum(int begin, int end, F& f) {
+    physics::scalar s[4] = {0, 0, 0, 0};
+    int i = begin;
+    for(; i + 4 <= end; i += 4) {
+        for(int k = 0; k < 4; k++) s[k] += f(i + k);
+    }
+    for(; i < end; i++) s[0] += f(i);
+    return (s[0] + s[1]) + (s[2] + s[3]);
+}
+
+// Calls f(i) for every element like for_each_element, and returns the sum of the results.
+// Updates and the inner products that follow them are done in one pass over memory.
+template <typename F>
+inline physics::scalar sum_each_element(int n, F f) {
+    int blocks = (n + reduction_block - 1) / reduction_block;
+    if(blocks <= 1) return block_sum(0, n, f);
+
+    std::vector<physics::scalar> sums(blocks);
+    physics::parallel_for(blocks, n, [&](int begin, int end) {
+        for(int b = begin; b < end; b++) sums[b] = block_sum(b * reduction_block, std::min(n, (b + 1) * reduction_block), f);
+    });
+    physics::scalar sum = 0;
+    for(physics::scalar s : sums) sum += s;
+    return sum;
+}
+
+inline physics::scalar block_dot(int n, const physics::scalar* x, const physics::scalar* y) {
+    auto f = [&](int i) { return x[i] * y[i]; };
+    return block_sum(0, n, f);
+}
+
+inline physics::scalar vector_dot(const std::vector<physics::scalar>& x, const std::vector<physics::scalar>& y) {
+    return sum_each_element(x.size(), [&](int i) { return x[i] * y[i]; });
+}
+
+inline physics::scalar vector_norm(const std::vector<physics::scalar>& x) {
+    return std::sqrt(vector_dot(x, x));
+}
+
+// Copies a vector of n elements out of a matrix of either shape
+inline std::vector<physics::scalar> as_vector(const physics::matrix& b, int n) {
+    if(!b.is_vector() || b.size() != n) throw std::invalid_argument("Incompatible matrices.");
+    return std::vector<physics::scalar>(b.row(0), b.row(0) + n);
+}
+
+inline physics::matrix as_row(const std::vector<physics::scalar>& x) {
+    physics::matrix out = physics::matrix::zeros(1, x.size());
+    std::copy(x.begin(), x.end(), out.row(0));
+    return out;
+}
+
+// Applies a preconditioner to x, writing the result to y, or returns x itself when there is none
+inline const std::vector<physics::scalar>& precondition(const physics::linear_operator& m, const std::vector<physics::scalar>& x, std::vector<physics::scalar>& y) {
+    if(m.empty()) return x;
+    m.apply(x.data(), y.data());
+    return y;
+}
+
+inline void check_operators(const physics::linear_operator& a, const physics::linear_operator& m) {
+    if(a.empty()) throw std::invalid_argument("Incompatible matrices.");
+    if(!m.empty() && m.size() != a.size()) throw std::invalid_argument("Incompatible matrices.");
+}
+
+// Positions of the diagonal entries of a square sparse matrix, which must all be stored
+inline std::vector<int> diagonal_positions(const physics::sparse_matrix& a) {
+    if(a.rows() != a.cols()) throw std::invalid_argument("Only square matrices can be factorized.");
+    std::vector<int> diagonal(a.rows());
+    for(int i = 0; i < a.rows(); i++) {
+        auto first = a.columns.begin() + a.row_starts[i];
+        auto last = a.columns.begin() + a.row_starts[i + 1];
+        auto p = std::lower_bound(first, last, i);
+        if(p == last || *p != i || a.values[p - a.columns.begin()] == 0) throw std::invalid_argument("Matrix is singular.");
+        diagonal[i] = p - a.columns.begin();
+    }
+    return diagonal;
+}
+
+
+inline physics::linear_operator::linear_operator() {}
+
+inline physics::linear_operator::linear_operator(const matrix& a) : n(a.rows()) {
+    if(!a.is_square()) throw std::invalid_argument("Only square matrices can be solved against.");
+    apply = [&a](const scalar* x, scalar* y) {
+        parallel_for(a.rows(), (long)a.rows() * a.cols(), [&](int begin, int end) {
+            for(int i = begin; i < end; i++) y[i] = block_dot(a.cols(), a.row(i), x);
+        });
+    };
+}
+
+inline physics::linear_operator::linear_operator(const sparse_matrix& a) : n(a.rows()) {
+    if(a.rows() != a.cols()) throw std::invalid_argument("Only square matrices can be solved against.");
+    apply = [&a](const scalar* x, scalar* y) {
+        parallel_for(a.rows(), a.non_zeros(), [&](int begin, int end) {
+            for(int i = begin; i < end; i++) {
+                scalar sum = 0;
+                for(int p = a.row_starts[i]; p < a.row_starts[i + 1]; p++) sum += a.values[p] * x[a.columns[p]];
+                y[i] = sum;
+            }
+        });
+    };
+}
+
+inline physics::linear_operator::linear_operator(int n, std::function<void(const scalar*, scalar*)> f) : n(n), apply(std::move(f)) {}
+
+inline physics::linear_operator::linear_operator(int n, std::function<matrix(const matrix&)> f) : n(n) {
+    apply = [n, f = std::move(f)](const scalar* x, scalar* y) {
+        matrix in = matrix::zeros(1, n);
+        std::copy(x, x + n, in.row(0));
+        std::vector<scalar> out = as_vector(f(in), n);
+        std::copy(out.begin(), out.end(), y);
+    };
+}
+
+inline int physics::linear_operator::size() const { return n; }
+inline bool physics::linear_operator::empty() const { return !apply; }
+
+inline physics::matrix physics::linear_operator::operator()(const matrix& x) const {
+    std::vector<scalar> in = as_vector(x, n), out(n);
+    apply(in.data(), out.data());
+    return as_row(out);
+}
+
+
+inline physics::linear_operator physics::jacobi(const matrix& a) {
+    if(!a.is_square()) throw std::invalid_argument("Only square matrices can be factorized.");
+    auto inverse_diagonal = std::make_shared<std::vector<scalar>>(a.rows());
+    for(int i = 0; i < a.rows(); i++) {
+        if(a(i, i) == 0) throw std::invalid_argument("Matrix is singular.");
+        (*inverse_diagonal)[i] = 1 / a(i, i);
+    }
+    return linear_operator(a.rows(), [inverse_diagonal](const scalar* x, scalar* y) {
+        const std::vector<scalar>& d = *inverse_diagonal;
+        for_each_element(d.size(), [&](int i) { y[i] = d[i] * x[i]; });
+    });
+}
+
+inline physics::linear_operator physics::jacobi(const sparse_matrix& a) {
+    std::vector<int> diagonal = diagonal_positions(a);
+    auto inverse_diagonal = std::make_shared<std::vector<scalar>>(a.rows());
+    for(int i = 0; i < a.rows(); i++) (*inverse_diagonal)[i] = 1 / a.values[diagonal[i]];
+    return linear_operator(a.rows(), [inverse_diagonal](const scalar* x, scalar* y) {
+        const std::vector<scalar>& d = *inverse_diagonal;
+        for_each_element(d.size(), [&](int i) { y[i] = d[i] * x[i]; });
+    });
+}
+
+inline physics::linear_operator physics::ssor(const sparse_matrix& a, scalar omega) {
+    if(omega <= 0 || omega >= 2) throw std::invalid_argument("Relaxation factor must be between 0 and 2.");
+    auto diagonal = std::make_shared<std::vector<int>>(diagonal_positions(a));
+    auto m = std::make_shared<sparse_matrix>(a);
+    // Divisions are replaced by products, which are shorter on the dependency chain of a triangular solve
+    auto inverse_diagonal = std::make_shared<std::vector<scalar>>(a.rows());
+    for(int i = 0; i < a.rows(); i++) (*inverse_diagonal)[i] = 1 / a.values[(*diagonal)[i]];
+
+    // M = (D + omega L) D^-1 (D + omega U) / (omega (2 - omega))
+    return linear_operator(a.rows(), [m, diagonal, inverse_diagonal, omega](const scalar* x, scalar* y) {
+        const sparse_matrix& a = *m;
+        const std::vector<int>& d = *diagonal;
+        const std::vector<scalar>& inverse = *inverse_diagonal;
+        int n = a.rows();
+        for(int i = 0; i < n; i++) {
+            scalar sum = 0;
+            for(int p = a.row_starts[i]; p < d[i]; p++) sum += a.values[p] * y[a.columns[p]];
+            y[i] = (x[i] - omega * sum) * inverse[i];
+        }
+        for(int i = n - 1; i >= 0; i--) {
+            scalar sum = 0;
+            for(int p = d[i] + 1; p < a.row_starts[i + 1]; p++) sum += a.values[p] * y[a.columns[p]];
+            y[i] -= omega * sum * inverse[i];
+        }
+        for_each_element(n, [&](int i) { y[i] *= omega * (2 - omega); });
+    });
+}
+
+inline physics::linear_operator physics::incomplete_cholesky(const sparse_matrix& a) {
+    if(a.rows() != a.cols()) throw std::invalid_argument("Only square matrices can be factorized.");
+    int n = a.rows();
+
+    // L in CSR form, with the diagonal last in each row
+    auto factor = std::make_shared<sparse_matrix>(n, n);
+    sparse_matrix& l = *factor;
+    for(int i = 0; i < n; i++) {
+        for(int p = a.row_starts[i]; p < a.row_starts[i + 1] && a.columns[p] <= i; p++) {
+            l.columns.push_back(a.columns[p]);
+            l.values.push_back(a.values[p]);
+        }
+        if(l.columns.empty() || l.columns.back() != i) throw std::invalid_argument("Matrix is not positive definite.");
+        l.row_starts[i + 1] = l.columns.size();
+    }
+
+    for(int i = 0; i < n; i++) {
+        for(int p = l.row_starts[i]; p < l.row_starts[i + 1]; p++) {
+            int j = l.columns[p];
+            // Subtracts the product of the rows of i and j left of column j, where both are stored
+            scalar sum = l.values[p];
+            int q = l.row_starts[i], r = l.row_starts[j], r_end = l.row_starts[j + 1] - 1;
+            while(q < p && r < r_end) {
+                if(l.columns[q] < l.columns[r]) q++;
+                else if(l.columns[q] > l.columns[r]) r++;
+                else sum -= l.values[q++] * l.values[r++];
+            }
+            if(j < i) l.values[p] = sum / l.values[r_end];
+            else if(sum <= 0) throw std::invalid_argument("Matrix is not positive definite.");
+            else l.values[p] = std::sqrt(sum);
+        }
+    }
+
+    // L^T is kept in CSR form too, so both solves read rows, and the diagonal is kept inverted
+    auto transposed = std::make_shared<sparse_matrix>(l.T());
+    auto inverse_diagonal = std::make_shared<std::vector<scalar>>(n);
+    for(int i = 0; i < n; i++) (*inverse_diagonal)[i] = 1 / l.values[l.row_starts[i + 1] - 1];
+
+    return linear_operator(n, [factor, transposed, inverse_diagonal](const scalar* x, scalar* y) {
+        const sparse_matrix& l = *factor;
+        const sparse_matrix& lt = *transposed;
+        const std::vector<scalar>& inverse = *inverse_diagonal;
+        int n = l.rows();
+        for(int i = 0; i < n; i++) {
+            scalar sum = 0;
+            for(int p = l.row_starts[i]; p < l.row_starts[i + 1] - 1; p++) sum += l.values[p] * y[l.columns[p]];
+            y[i] = (x[i] - sum) * inverse[i];
+        }
+        for(int i = n - 1; i >= 0; i--) {
+            scalar sum = 0;
+            for(int p = lt.row_starts[i] + 1; p < lt.row_starts[i + 1]; p++) sum += lt.values[p] * y[lt.columns[p]];
+            y[i] = (y[i] - sum) * inverse[i];
+        }
+    });
+}
+
+inline physics::linear_operator physics::ilu0(const sparse_matrix& a) {
+    auto diagonal = std::make_shared<std::vector<int>>(diagonal_positions(a));
+    auto factors = std::make_shared<sparse_matrix>(a);
+    sparse_matrix& lu = *factors;
+    const std::vector<int>& d = *diagonal;
+    int n = a.rows();
+
+    // Row i is eliminated by the rows above it, keeping only updates to entries it already stores
+    std::vector<int> position(n, -1);
+    for(int i = 0; i < n; i++) {
+        for(int p = lu.row_starts[i]; p < lu.row_starts[i + 1]; p++) position[lu.columns[p]] = p;
+        for(int p = lu.row_starts[i]; p < d[i]; p++) {
+            int k = lu.columns[p];
+            scalar factor = lu.values[p] /= lu.values[d[k]];
+            for(int q = d[k] + 1; q < lu.row_starts[k + 1]; q++) {
+                int target = position[lu.columns[q]];
+                if(target >= 0) lu.values[target] -= factor * lu.values[q];
+            }
+        }
+        if(lu.values[d[i]] == 0) throw std::invalid_argument("Matrix is singular.");
+        for(int p = lu.row_starts[i]; p < lu.row_starts[i + 1]; p++) position[lu.columns[p]] = -1;
+    }
+    // The diagonal of U is kept inverted
+    for(int i = 0; i < n; i++) lu.values[d[i]] = 1 / lu.values[d[i]];
+
+    return linear_operator(n, [factors, diagonal](const scalar* x, scalar* y) {
+        const sparse_matrix& lu = *factors;
+        const std::vector<int>& d = *diagonal;
+        int n = lu.rows();
+        for(int i = 0; i < n; i++) {
+            scalar sum = 0;
+            for(int p = lu.row_starts[i]; p < d[i]; p++) sum += lu.values[p] * y[lu.columns[p]];
+            y[i] = x[i] - sum;
+        }
+        for(int i = n - 1; i >= 0; i--) {
+            scalar sum = 0;
+            for(int p = d[i] + 1; p < lu.row_starts[i + 1]; p++) sum += lu.values[p] * y[lu.columns[p]];
+            y[i] = (y[i] - sum) * lu.values[d[i]];
+        }
+    });
+}
+
+
+inline physics::krylov_result physics::cg(const linear_operator& a, const matrix& b, scalar tolerance, const linear_operator& preconditioner, int max_iterations) {
+    check_operators(a, preconditioner);
+    int n = a.size();
+    if(max_iterations <= 0) max_iterations = n;
+    std::vector<scalar> r = as_vector(b, n), x(n, 0), z(n), p(n), q(n);
+
+    krylov_result result;
+    scalar rr = vector_dot(r, r);
+    result.residual = std::sqrt(rr);
+    p = precondition(preconditioner, r, z);
+    scalar rz = preconditioner.empty() ? rr : vector_dot(r, z);
+    while(result.residual > tolerance && result.iterations < max_iterations) {
+        a.apply(p.data(), q.data());
+        scalar alpha = rz / vector_dot(p, q);
+        rr = sum_each_element(n, [&](int i) {
+            x[i] += alpha * p[i];
+            r[i] -= alpha * q[i];
+            return r[i] * r[i];
+        });
+        result.iterations++;
+        result.residual = std::sqrt(rr);
+        if(result.residual <= tolerance) break;
+
+        const std::vector<scalar>& m_r = precondition(preconditioner, r, z);
+        scalar rz_next = preconditioner.empty() ? rr : vector_dot(r, m_r);
+        scalar beta = rz_next / rz;
+        rz = rz_next;
+        for_each_element(n, [&](int i) { p[i] = m_r[i] + beta * p[i]; });
+    }
+
+    result.converged = result.residual <= tolerance;
+    result.x = as_row(x);
+    return result;
+}
+
+inline physics::krylov_result physics::bicgstab(const linear_operator& a, const matrix& b, scalar tolerance, const linear_operator& preconditioner, int max_iterations) {
+    check_operators(a, preconditioner);
+    int n = a.size();
+    if(max_iterations <= 0) max_iterations = n;
+    std::vector<scalar> r = as_vector(b, n), x(n, 0), p(n, 0), v(n, 0), p_work(n), s_work(n), t(n);
+    const std::vector<scalar> r0 = r;
+    scalar rho = 1, alpha = 1, omega = 1;
+
+    krylov_result result;
+    result.residual = vector_norm(r);
+    while(result.residual > tolerance && result.iterations < max_iterations) {
+        scalar rho_next = vector_dot(r0, r);
+        if(rho_next == 0) break;
+        scalar beta = (rho_next / rho) * (alpha / omega);
+        rho = rho_next;
+        for_each_element(n, [&](int i) { p[i] = r[i] + beta * (p[i] - omega * v[i]); });
+
+        const std::vector<scalar>& p_hat = precondition(preconditioner, p, p_work);
+        a.apply(p_hat.data(), v.data());
+        alpha = rho / vector_dot(r0, v);
+        result.iterations++;
+        result.residual = std::sqrt(sum_each_element(n, [&](int i) {
+            r[i] -= alpha * v[i];
+            return r[i] * r[i];
+        }));
+        if(result.residual <= tolerance) {
+            for_each_element(n, [&](int i) { x[i] += alpha * p_hat[i]; });
+            break;
+        }
+
+        const std::vector<scalar>& s_hat = precondition(preconditioner, r, s_work);
+        a.apply(s_hat.data(), t.data());
+        omega = vector_dot(t, r) / vector_dot(t, t);
+        result.residual = std::sqrt(sum_each_element(n, [&](int i) {
+            x[i] += alpha * p_hat[i] + omega * s_hat[i];
+            r[i] -= omega * t[i];
+            return r[i] * r[i];
+        }));
+        if(omega == 0) break;
+    }
+
+    result.converged = result.residual <= tolerance;
+    result.x = as_row(x);
+    return result;
+}
+
+inline physics::krylov_result physics::gmres(const linear_operator& a, const matrix& b, scalar tolerance, const linear_operator& preconditioner, int restart, int max_iterations) {
+    check_operators(a, preconditioner);
+    int n = a.size();
+    if(max_iterations <= 0) max_iterations = n;
+    restart = std::max(1, std::min(restart, n));
+    const std::vector<scalar> rhs = as_vector(b, n);
+    std::vector<scalar> x(n, 0), r = rhs, z(n), w(n);
+
+    // Orthonormal basis of the Krylov space, and the Hessenberg matrix reduced to triangular by Givens rotations
+    std::vector<std::vector<scalar>> basis(restart + 1, std::vector<scalar>(n));
+    std::vector<std::vector<scalar>> h(restart + 1, std::vector<scalar>(restart));
+    std::vector<scalar> cosines(restart), sines(restart), g(restart + 1);
+
+    krylov_result result;
+    result.residual = vector_norm(r);
+    while(result.residual > tolerance && result.iterations < max_iterations) {
+        scalar beta = result.residual;
+        for_each_element(n, [&](int i) { basis[0][i] = r[i] / beta; });
+        std::fill(g.begin(), g.end(), 0);
+        g[0] = beta;
+
+        int k = 0;
+        while(k < restart && result.iterations < max_iterations) {
+            a.apply(precondition(preconditioner, basis[k], z).data(), w.data());
+            for(int j = 0; j <= k; j++) {
+                h[j][k] = vector_dot(w, basis[j]);
+                for_each_element(n, [&](int i) { w[i] -= h[j][k] * basis[j][i]; });
+            }
+            scalar norm = vector_norm(w);
+            if(norm != 0) for_each_element(n, [&](int i) { basis[k + 1][i] = w[i] / norm; });
+
+            for(int j = 0; j < k; j++) {
+                scalar upper = h[j][k];
+                h[j][k] = cosines[j] * upper + sines[j] * h[j + 1][k];
+                h[j + 1][k] = -sines[j] * upper + cosines[j] * h[j + 1][k];
+            }
+            scalar radius = std::hypot(h[k][k], norm);
+            cosines[k] = h[k][k] / radius;
+            sines[k] = norm / radius;
+            h[k][k] = radius;
+            g[k + 1] = -sines[k] * g[k];
+            g[k] *= cosines[k];
+
+            k++;
+            result.iterations++;
+            result.residual = std::abs(g[k]);
+            if(result.residual <= tolerance || norm == 0) break;
+        }
+
+        // x += M V y, where H y = g
+        std::vector<scalar> y(k);
+        for(int j = k - 1; j >= 0; j--) {
+            scalar sum = g[j];
+            for(int c = j + 1; c < k; c++) sum -= h[j][c] * y[c];
+            y[j] = sum / h[j][j];
+        }
+        std::fill(w.begin(), w.end(), 0);
+        for(int j = 0; j < k; j++) for_each_element(n, [&](int i) { w[i] += y[j] * basis[j][i]; });
+        const std::vector<scalar>& correction = precondition(preconditioner, w, z);
+        for_each_element(n, [&](int i) { x[i] += correction[i]; });
+
+        // Restarts from the true residual
+        if(result.residual > tolerance && result.iterations < max_iterations) {
+            a.apply(x.data(), r.data());
+            for_each_element(n, [&](int i) { r[i] = rhs[i] - r[i]; });
+            result.residual = vector_norm(r);
+        }
+    }
+
+    result.converged = result.residual <= tolerance;
+    result.x = as_row(x);
+    return result;
+}
+
+
+// Tolerance on the numbers in b.v
+inline physics::scalar scaled_tolerance(const physics::val& b, const physics::val& tolerance) {
+    if(tolerance.u != b.u) throw std::invalid_argument("Unit Error");
+    return std::abs(tolerance.v.first()) * physics::power_of_ten(tolerance.e - b.e);
+}
+
+inline physics::val solution(const physics::krylov_result& result, const physics::val& b, int e, const physics::unit& u) {
+    if(!result.converged) throw std::invalid_argument("Solver did not converge.");
+    return physics::val(result.x, b.e - e, b.u / u);
+}
+
+inline physics::val physics::cg(const val& a, const val& b, const val& tolerance, const linear_operator& preconditioner, int max_iterations) {
+    return solution(cg(linear_operator(a.v), b.v, scaled_tolerance(b, tolerance), preconditioner, max_iterations), b, a.e, a.u);
+}
+inline physics::val physics::cg(const sparse_val& a, const val& b, const val& tolerance, const linear_operator& preconditioner, int max_iterations) {
+    return solution(cg(linear_operator(a.v), b.v, scaled_tolerance(b, tolerance), preconditioner, max_iterations), b, 0, a.u);
+}
+
+inline physics::val physics::bicgstab(const val& a, const val& b, const val& tolerance, const linear_operator& preconditioner, int max_iterations) {
+    return solution(bicgstab(linear_operator(a.v), b.v, scaled_tolerance(b, tolerance), preconditioner, max_iterations), b, a.e, a.u);
+}
+inline physics::val physics::bicgstab(const sparse_val& a, const val& b, const val& tolerance, const linear_operator& preconditioner, int max_iterations) {
+    return solution(bicgstab(linear_operator(a.v), b.v, scaled_tolerance(b, tolerance), preconditioner, max_iterations), b, 0, a.u);
+}
+
+inline physics::val physics::gmres(const val& a, const val& b, const val& tolerance, const linear_operator& preconditioner, int restart, int max_iterations) {
+    return solution(gmres(linear_operator(a.v), b.v, scaled_tolerance(b, tolerance), preconditioner, restart, max_iterations), b, a.e, a.u);
+}
+inline physics::val physics::gmres(const sparse_val& a, const val& b, const val& tolerance, const linear_operator& preconditioner, int restart, int max_iterations) {
+    return solution(gmres(linear_operator(a.v), b.v, scaled_tolerance(b, tolerance), preconditioner, restart, max_iterations), b, 0, a.u);
+}
+
+
+// end --- iterative.cpp --- 
+
+
+
+// begin --- eigen.cpp --- 
+
+
+
+// begin --- eigen.h --- 
+
+#pragma once
+
+
+
+
+
+#include <vector>
+
+
+namespace physics {
+    // Eigendecomposition A = V diag(values) V^T of a symmetric matrix. Only the lower triangle of A is read.
+    // 3x3 matrices are diagonalized by Jacobi rotations. Larger ones are reduced to tridiagonal form by
+    // blocked Householder reflections, and the tridiagonal matrix is diagonalized by the implicit QL algorithm.
+    class symmetric_eigen {
+    public:
+        matrix values; // Eigenvalues in ascending order, as a row vector
+        matrix vectors; // Eigenvectors as the columns of an orthogonal matrix, in the order of the values
+        int8_t e; // Exponent of A
+        unit u; // Unit of A
+
+    public:
+        explicit symmetric_eigen(const matrix& a);
+        explicit symmetric_eigen(const val& a);
+
+        int size() const;
+
+        // Eigenvalues with the unit of A
+        val eigenvalues() const;
+    };
+
+    // Eigendecomposition of a symmetric 3x3 matrix, as above, without allocating.
+    struct eigen3 {
+        vec3 values;
+        mat3 vectors;
+    };
+
+    eigen3 symmetric_eigen3(const mat3& a);
+    // Diagonalizes every matrix of a batch, with the same results as one at a time. Matrices are
+    // diagonalized several at once, with each rotation vectorized across them, and split across the thread pool.
+    std::vector<eigen3> symmetric_eigen3(const std::vector<mat3>& a);
+
+    // Thin singular value decomposition A = left diag(values) right^T of an m x n matrix.
+    // With k = min(m, n), left is m x k and right is n x k, both with orthonormal columns.
+    // Computed by one-sided Jacobi rotations, which keeps small singular values accurate. The rotations
+    // of each round touch disjoint pairs of columns and run in parallel. Large matrices start from the
+    // eigenvectors of A^T A, so few sweeps are needed.
+    class svd {
+    public:
+        matrix left; // Left singular vectors as columns
+        matrix values; // Singular values in descending order, as a row vector
+        matrix right; // Right singular vectors as columns
+        int8_t e; // Exponent of A
+        unit u; // Unit of A
+
+    public:
+        explicit svd(const matrix& a);
+        explicit svd(const val& a);
+
+        // Singular values with the unit of A
+        val singular_values() const;
+
+        // Number of singular values above the rounding error of the largest one
+        int rank() const;
+    };
+}
+
+
+// end --- eigen.h --- 
+
 
 
-#include <cstdint>
-#include <map>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <numeric>
 #include <stdexcept>
-#include <math.h>
+#include <utility>
 
 
-std::map<int8_t, std::string> prefix_names {
-    {24, "Y"},
-    {21, "Z"},
-    {18, "E"},
-    {15, "P"},
-    {12, "T"},
-    {9, "G"},
-    {6, "M"},
-    {3, "k"},
-    {2, "h"},
-    {1, "dc"},
-    {-1, "d"},
-    {-2, "c"},
-    {-3, "m"},
-    {-6, "μ"},
-    {-9, "n"},
-    {-12, "p"},
-    {-15, "f"},
-    {-18, "a"},
-    {-21, "z"},
-    {-24, "y"},
-};
+// Width of the panels of the blocked tridiagonal reduction, and number of reflections applied together
+inline constexpr int tridiagonal_block = 32;
 
-inline physics::val::val(long double v) {
-    this->v = matrix(v);
-    this->e = 0;
-    this->u = unit();
-}
-inline physics::val::val(matrix v) {
-    this->v = v;
-    this->e = 0;
-    this->u = unit();
+// Columns of a row-major matrix updated together by the rotations of a QL sweep, so the rows they
+// touch stay in cache
+inline constexpr int rotation_block = 256;
+
+// Matrices diagonalized together by the batched 3x3 solver
+inline constexpr int eigen3_lanes = 8;
+
+// Smallest number of columns for which the SVD starts from the eigenvectors of A^T A
+inline constexpr int svd_preconditioning = 32;
+
+// Flips the sign of a vector so that its largest element is positive, which makes results repeatable
+inline void normalise_sign(physics::scalar* x, int n, int step) {
+    int largest = 0;
+    for(int i = 1; i < n; i++) {
+        if(std::abs(x[i * step]) > std::abs(x[largest * step])) largest = i;
+    }
+    if(x[largest * step] < 0) {
+        for(int i = 0; i < n; i++) x[i * step] = -x[i * step];
+    }
 }
-inline physics::val::val(matrix v, unit u) {
-    this->v = v;
-    this->e = 0;
-    this->u = u;
-    calculate_exponent();
+
+// Tangent of the Jacobi rotation angle that zeroes an off-diagonal element, given theta = cot(2 angle).
+// Returns the small root, so the rotation is at most 45 degrees. Where theta^2 overflows, the result is 0,
+// which is 1 / (2 theta) to working precision.
+inline physics::scalar jacobi_tangent(physics::scalar theta) {
+    physics::scalar x = std::abs(theta);
+    physics::scalar t = 1 / (x + std::sqrt(x * x + 1));
+    return theta < 0 ? -t : t;
 }
-inline physics::val::val(matrix v, int8_t e, unit u) {
-    this->v = v;
-    this->e = e;
-    this->u = u;
-    calculate_exponent();
+
+// Position of element (i, j) of a symmetric 3x3 matrix among its six distinct elements, diagonal first
+inline constexpr int symmetric3_index(int i, int j) { return i == j ? i : i + j + 2; }
+
+// Zeroes element (p, q) of a set of symmetric 3x3 matrices by Jacobi rotations, and applies them to the
+// columns of v. The matrices are stored element by element, so the loop over them vectorizes.
+// Inactive matrices get the identity rotation, which leaves them exactly as they were.
+template <int lanes, int p, int q>
+inline void jacobi_rotate(physics::scalar (&a)[6][lanes], physics::scalar (&v)[9][lanes], const bool (&active)[lanes]) {
+    constexpr int r = 3 - p - q;
+    physics::scalar* app = a[p];
+    physics::scalar* aqq = a[q];
+    physics::scalar* apq = a[symmetric3_index(p, q)];
+    physics::scalar* arp = a[symmetric3_index(r, p)];
+    physics::scalar* arq = a[symmetric3_index(r, q)];
+    for(int l = 0; l < lanes; l++) {
+        // theta is infinite or NaN when the element is already 0, and the result is then discarded
+        physics::scalar t = jacobi_tangent((aqq[l] - app[l]) / (2 * apq[l]));
+        t = active[l] && apq[l] != 0 ? t : 0;
+        physics::scalar c = 1 / std::sqrt(t * t + 1);
+        physics::scalar s = t * c;
+        physics::scalar tau = s / (1 + c);
+
+        physics::scalar h = t * apq[l];
+        app[l] -= h;
+        aqq[l] += h;
+        apq[l] = active[l] ? 0 : apq[l];
+
+        physics::scalar g = arp[l];
+        h = arq[l];
+        arp[l] = g - s * (h + g * tau);
+        arq[l] = h + s * (g - h * tau);
+        for(int i = 0; i < 3; i++) {
+            g = v[3 * i + p][l];
+            h = v[3 * i + q][l];
+            v[3 * i + p][l] = g - s * (h + g * tau);
+            v[3 * i + q][l] = h + s * (g - h * tau);
+        }
+    }
 }
 
-inline std::string physics::val::operator+(std::string x) const {
-    return (std::string)*this + x;
+// Diagonalizes count <= lanes symmetric 3x3 matrices by cyclic Jacobi sweeps, which converge quadratically,
+// in about four sweeps for doubles. Each matrix stops rotating once its off-diagonal part is negligible.
+template <int lanes>
+inline void symmetric_eigen3_lanes(const physics::mat3* in, physics::eigen3* out, int count) {
+    using physics::scalar;
+    const scalar eps = std::numeric_limits<scalar>::epsilon();
+    scalar a[6][lanes], v[9][lanes];
+    for(int l = 0; l < lanes; l++) {
+        // Unused lanes repeat the first matrix
+        const physics::mat3& m = in[l < count ? l : 0];
+        for(int i = 0; i < 3; i++) {
+            for(int j = 0; j <= i; j++) a[symmetric3_index(i, j)][l] = m(i, j);
+        }
+        for(int i = 0; i < 9; i++) v[i][l] = i % 4 == 0;
+    }
+
+    for(int sweep = 0; sweep < 32; sweep++) {
+        bool active[lanes];
+        bool any = false;
+        for(int l = 0; l < lanes; l++) {
+            scalar off = a[3][l] * a[3][l] + a[4][l] * a[4][l] + a[5][l] * a[5][l];
+            scalar diagonal = a[0][l] * a[0][l] + a[1][l] * a[1][l] + a[2][l] * a[2][l];
+            active[l] = off > eps * eps * diagonal && off != 0;
+            any = any || active[l];
+        }
+        if(!any) break;
+        jacobi_rotate<lanes, 0, 1>(a, v, active);
+        jacobi_rotate<lanes, 0, 2>(a, v, active);
+        jacobi_rotate<lanes, 1, 2>(a, v, active);
+    }
+
+    // Sorts the eigenvalues in ascending order, along with their vectors
+    for(int l = 0; l < count; l++) {
+        int order[3] = {0, 1, 2};
+        if(a[order[1]][l] < a[order[0]][l]) std::swap(order[0], order[1]);
+        if(a[order[2]][l] < a[order[1]][l]) std::swap(order[1], order[2]);
+        if(a[order[1]][l] < a[order[0]][l]) std::swap(order[0], order[1]);
+        for(int j = 0; j < 3; j++) {
+            out[l].values[j] = a[order[j]][l];
+            for(int i = 0; i < 3; i++) out[l].vectors(i, j) = v[3 * i + order[j]][l];
+            normalise_sign(out[l].vectors.data + j, 3, 3);
+        }
+    }
 }
-inline physics::val::operator std::string() const {
-    return (std::string)v + get_prefix() + (std::string)u;
+
+// Reduces the symmetric matrix t to tridiagonal form Q^T t Q with Householder reflections
+// H_k = I - tau[k] v v^T, where v is 1 at k + 1 and is stored in row k of t after it.
+// The diagonal goes to d and the subdiagonal to e.
+// Reflections are found a panel of columns at a time. Within a panel, the rest of the matrix is left as
+// it was and corrected for on the fly, and afterwards it is updated in one rank 2 * block product with gemm.
+inline void tridiagonalize(physics::matrix& t, std::vector<physics::scalar>& d, std::vector<physics::scalar>& e, std::vector<physics::scalar>& tau) {
+    using physics::scalar;
+    int n = t.rows();
+    if(n == 0) return;
+    const int block = tridiagonal_block;
+    // Reflection vectors and the matching columns of W of the panel, indexed by row of t
+    physics::matrix vs = physics::matrix::zeros(n, block), ws = physics::matrix::zeros(n, block);
+    std::vector<scalar> v(n), vw(block), vv(block);
+
+    for(int k0 = 0; k0 + 2 < n; k0 += block) {
+        int nb = std::min(block, n - 2 - k0);
+        for(int jj = 0; jj < nb; jj++) {
+            int i = k0 + jj;
+            scalar* row = t.row(i);
+            // Brings row i up to date with the reflections before it in the panel
+            for(int r = i; r < n; r++) {
+                scalar sum = 0;
+                for(int j = 0; j < jj; j++) sum += vs(r, j) * ws(i, j) + ws(r, j) * vs(i, j);
+                row[r] -= sum;
+            }
+            d[i] = row[i];
+
+            // Reflection taking column i below the diagonal, read from row i by symmetry, onto its first element
+            scalar* x = row + i + 1;
+            int m = n - i - 1;
+            scalar alpha = x[0], sigma = 0;
+            for(int r = 1; r < m; r++) sigma += x[r] * x[r];
+            if(sigma == 0) {
+                tau[i] = 0;
+                e[i] = alpha;
+                for(int r = i + 1; r < n; r++) vs(r, jj) = ws(r, jj) = 0;
+                continue;
+            }
+            scalar norm = std::sqrt(alpha * alpha + sigma);
+            scalar beta = alpha <= 0 ? norm : -norm;
+            tau[i] = (beta - alpha) / beta;
+            e[i] = beta;
+            scalar scale = 1 / (alpha - beta);
+            v[0] = 1;
+            for(int r = 1; r < m; r++) v[r] = x[r] *= scale;
+            for(int r = 0; r < m; r++) vs(i + 1 + r, jj) = v[r];
+
+            // w = tau A v - (tau^2 / 2) (v^T A v) v, with A brought up to date by subtracting V W^T + W V^T
+            // of the earlier reflections of the panel
+            std::fill(vw.begin(), vw.end(), 0);
+            std::fill(vv.begin(), vv.end(), 0);
+            for(int r = 0; r < m; r++) {
+                for(int j = 0; j < jj; j++) {
+                    vw[j] += ws(i + 1 + r, j) * v[r];
+                    vv[j] += vs(i + 1 + r, j) * v[r];
+                }
+            }
+            physics::parallel_for(m, (long)m * m, [&](int begin, int end) {
+                for(int r = begin; r < end; r++) {
+                    const scalar* a = t.row(i + 1 + r) + i + 1;
+                    scalar sum = 0;
+                    for(int c = 0; c < m; c++) sum += a[c] * v[c];
+                    for(int j = 0; j < jj; j++) sum -= vs(i + 1 + r, j) * vw[j] + ws(i + 1 + r, j) * vv[j];
+                    ws(i + 1 + r, jj) = tau[i] * sum;
+                }
+            });
+            scalar product = 0;
+            for(int r = 0; r < m; r++) product += ws(i + 1 + r, jj) * v[r];
+            scalar half = tau[i] * product / 2;
+            for(int r = 0; r < m; r++) ws(i + 1 + r, jj) -= half * v[r];
+        }
+
+        // A = A - V W^T - W V^T after the panel
+        int k1 = k0 + nb, m = n - k1;
+        physics::matrix vt = physics::matrix::zeros(nb, m), wt = physics::matrix::zeros(nb, m);
+        for(int r = 0; r < m; r++) {
+            for(int j = 0; j < nb; j++) {
+                vt(j, r) = vs(k1 + r, j);
+                wt(j, r) = ws(k1 + r, j);
+            }
+        }
+        physics::gemm_update(m, m, nb, -1, vs.row(k1), vs.stride, wt.row(0), wt.stride, t.row(k1) + k1, t.stride);
+        physics::gemm_update(m, m, nb, -1, ws.row(k1), ws.stride, vt.row(0), vt.stride, t.row(k1) + k1, t.stride);
+    }
+    if(n >= 2) {
+        d[n - 2] = t(n - 2, n - 2);
+        e[n - 2] = t(n - 1, n - 2);
+    }
+    d[n - 1] = t(n - 1, n - 1);
 }
-inline physics::val::operator int() const { return (int)v; }
-inline physics::val::operator float() const { return (float)v; }
-inline physics::val::operator double() const { return (double)v; }
-inline physics::val::operator long double() const { return (long double)v; }
-inline physics::val::operator unit() const { return u; }
 
-inline physics::val physics::val::operator+(val x) const {
-  if (u != x.u) throw std::invalid_argument("Unit Error");
-  int8_t exp = std::max(e, x.e);
-  return val(v * pow(10, e - exp) + x.v * pow(10, x.e - exp), exp, u);
+// Returns Q^T = H_(n-3) ... H_0 for the reflections left in t by tridiagonalize.
+// Blocks of reflections are applied together as I - V T^T V^T, with two gemm products each.
+inline physics::matrix reflections_transposed(const physics::matrix& t, const std::vector<physics::scalar>& tau) {
+    using physics::scalar;
+    int n = t.rows();
+    physics::matrix q = physics::matrix::identity(n);
+    // Multiplying by H_k on the right only touches rows and columns after k, so going from the last
+    // reflection down keeps the work to the trailing block
+    for(int k1 = n - 2; k1 > 0; k1 -= tridiagonal_block) {
+        int k0 = std::max(0, k1 - tridiagonal_block), nb = k1 - k0;
+        int first = k0 + 1, m = n - first;
+
+        // Reflection vectors as columns, and T, upper triangular, with H_k0 ... H_(k1-1) = I - V T V^T
+        physics::matrix vs = physics::matrix::zeros(m, nb), vt = physics::matrix::zeros(nb, m), tm = physics::matrix::zeros(nb, nb);
+        for(int j = 0; j < nb; j++) {
+            vs(j, j) = vt(j, j) = 1;
+            const scalar* stored = t.row(k0 + j) + k0 + j + 2;
+            for(int r = j + 1; r < m; r++) vs(r, j) = vt(j, r) = stored[r - j - 1];
+        }
+        std::vector<scalar> products(nb);
+        for(int j = 0; j < nb; j++) {
+            scalar tau_j = tau[k0 + j];
+            for(int i = 0; i < j; i++) {
+                products[i] = 0;
+                for(int r = j; r < m; r++) products[i] += vt(i, r) * vt(j, r);
+            }
+            for(int i = 0; i < j; i++) {
+                scalar sum = 0;
+                for(int c = i; c < j; c++) sum += tm(i, c) * products[c];
+                tm(i, j) = -tau_j * sum;
+            }
+            tm(j, j) = tau_j;
+        }
+
+        // Q = Q - (Q V) T^T V^T on the trailing block
+        physics::matrix y = physics::matrix::zeros(m, nb), yt = physics::matrix::zeros(m, nb);
+        physics::gemm(m, nb, m, q.row(first) + first, q.stride, vs.row(0), vs.stride, y.row(0), y.stride);
+        for(int r = 0; r < m; r++) {
+            for(int j = 0; j < nb; j++) {
+                scalar sum = 0;
+                for(int c = j; c < nb; c++) sum += y(r, c) * tm(j, c);
+                yt(r, j) = sum;
+            }
+        }
+        physics::gemm_update(m, m, nb, -1, yt.row(0), yt.stride, vt.row(0), vt.stride, q.row(first) + first, q.stride);
+    }
+    return q;
 }
-inline physics::val physics::val::operator-(val x) const {
-  if (u != x.u) throw std::invalid_argument("Unit Error");
-  int8_t exp = std::max(e, x.e);
-  return val(v * pow(10, e - exp) - x.v * pow(10, x.e - exp), exp, u);
+
+// Diagonalizes the symmetric tridiagonal matrix with diagonal d and subdiagonal e by the implicit QL
+// algorithm with Wilkinson shifts. The rotations are applied to the rows of zt.
+inline void tridiagonal_ql(std::vector<physics::scalar>& d, std::vector<physics::scalar>& e, physics::matrix& zt) {
+    const physics::scalar eps = std::numeric_limits<physics::scalar>::epsilon();
+    int n = d.size();
+    if(n == 0) return;
+    e[n - 1] = 0;
+    std::vector<physics::scalar> cosines(n), sines(n);
+
+    physics::scalar shift = 0, largest = 0;
+    for(int l = 0; l < n; l++) {
+        // Looks for a negligible subdiagonal element to split the matrix at
+        largest = std::max(largest, std::abs(d[l]) + std::abs(e[l]));
+        int m = l;
+        while(m < n - 1 && std::abs(e[m]) > eps * largest) m++;
+
+        for(int iterations = 0; m > l; iterations++) {
+            if(iterations == 60) throw std::invalid_argument("Eigenvalues did not converge.");
+            physics::scalar g = d[l];
+            physics::scalar p = (d[l + 1] - g) / (2 * e[l]);
+            physics::scalar r = std::hypot(p, (physics::scalar)1);
+            if(p < 0) r = -r;
+            d[l] = e[l] / (p + r);
+            d[l + 1] = e[l] * (p + r);
+            physics::scalar next = d[l + 1];
+            physics::scalar h = g - d[l];
+            for(int i = l + 2; i < n; i++) d[i] -= h;
+            shift += h;
+
+            p = d[m];
+            physics::scalar c = 1, c2 = 1, c3 = 1, s = 0, s2 = 0;
+            physics::scalar e_next = e[l + 1];
+            for(int i = m - 1; i >= l; i--) {
+                c3 = c2;
+                c2 = c;
+                s2 = s;
+                g = c * e[i];
+                h = c * p;
+                r = std::hypot(p, e[i]);
+                e[i + 1] = s * r;
+                s = e[i] / r;
+                c = p / r;
+                p = c * d[i] - s * g;
+                d[i + 1] = h + s * (c * g + s * d[i]);
+                cosines[i] = c;
+                sines[i] = s;
+            }
+            p = -s * s2 * c3 * e_next * e[l] / next;
+            e[l] = s * p;
+            d[l] = c * p;
+
+            // The rotations of the sweep are applied together, a block of columns at a time
+            physics::parallel_for(zt.cols(), 6L * (m - l) * zt.cols(), [&](int begin, int end) {
+                for(int c0 = begin; c0 < end; c0 += rotation_block) {
+                    int c1 = std::min(end, c0 + rotation_block);
+                    for(int i = m - 1; i >= l; i--) {
+                        physics::scalar ci = cosines[i], si = sines[i];
+                        physics::scalar* zi = zt.row(i);
+                        physics::scalar* zn = zt.row(i + 1);
+                        for(int k = c0; k < c1; k++) {
+                            physics::scalar x = zn[k];
+                            zn[k] = si * zi[k] + ci * x;
+                            zi[k] = ci * zi[k] - si * x;
+                        }
+                    }
+                }
+            });
+
+            if(std::abs(e[l]) <= eps * largest) break;
+        }
+        d[l] += shift;
+        e[l] = 0;
+    }
 }
-inline physics::val physics::val::operator*(val x) const { return val(v * x.v, e + x.e, u * x.u); }
-inline physics::val physics::val::operator*(unit x) const { return val(v, e, u * x); }
-inline physics::val physics::val::operator/(val x) const { return val(v / x.v, e - x.e, u / x.u); }
-inline physics::val physics::val::operator/(unit x) const { return val(v, e, u / x); }
-inline physics::val physics::val::operator^(double x) const { return val(v^x, e * x, u ^ x); }
 
-inline physics::val physics::val::operator+=(val x) {
-    *this = *this + x;
-    return *this;
+
+inline physics::symmetric_eigen::symmetric_eigen(const matrix& a) : e(0), u() {
+    if(!a.is_square()) throw std::invalid_argument("Only square matrices can be factorized.");
+    int n = a.rows();
+    if(n == 3) {
+        eigen3 result = symmetric_eigen3(mat3(a));
+        values = (matrix)result.values;
+        vectors = (matrix)result.vectors;
+        return;
+    }
+
+    // The upper triangle is filled in from the lower one
+    matrix t = a;
+    for(int i = 0; i < n; i++) {
+        for(int j = i + 1; j < n; j++) t(i, j) = t(j, i);
+    }
+    std::vector<scalar> d(n), e(n), tau(n);
+    tridiagonalize(t, d, e, tau);
+    matrix zt = reflections_transposed(t, tau);
+    tridiagonal_ql(d, e, zt);
+
+    std::vector<int> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](int x, int y) { return d[x] < d[y]; });
+    values = matrix::zeros(1, n);
+    vectors = matrix::zeros(n, n);
+    for(int j = 0; j < n; j++) {
+        values(0, j) = d[order[j]];
+        scalar* z = zt.row(order[j]);
+        normalise_sign(z, n, 1);
+        for(int i = 0; i < n; i++) vectors(i, j) = z[i];
+    }
 }
-inline physics::val physics::val::operator-=(val x) {
-    *this = *this - x;
-    return *this;
+
+inline physics::symmetric_eigen::symmetric_eigen(const val& a) : symmetric_eigen(a.v) {
+    e = a.e;
+    u = a.u;
 }
 
-inline bool physics::val::operator<(val x) const { return (e != x.e) ? e < x.e : (long double)v < (long double)x.v; }
-inline bool physics::val::operator>(val x) const { return (e != x.e) ? e > x.e : (long double)v > (long double)x.v; }
-inline bool physics::val::operator<=(val x) const { return (e != x.e) ? e <= x.e : (long double)v <= (long double)x.v; }
-inline bool physics::val::operator>=(val x) const { return (e != x.e) ? e >= x.e : (long double)v >= (long double)x.v; }
-inline bool physics::val::operator==(val x) const { return v == x.v && e == x.e && u == x.u; }
-inline bool physics::val::operator!=(val x) const { return v != x.v || e != x.e || u != x.u; }
+inline int physics::symmetric_eigen::size() const { return vectors.rows(); }
 
-inline physics::val physics::val::T() {
-    return val(v.T(), e, u);
-}
+inline physics::val physics::symmetric_eigen::eigenvalues() const { return val(values, e, u); }
 
-inline physics::val physics::operator*(val x, long double y) { return val((long double)x * y, x.e, (unit)x); }
-inline physics::val physics::operator*(long double x, val y) { return val((long double)y * x, y.e, (unit)y); }
-inline physics::val physics::operator/(val x, long double y) { return val((long double)x / y, x.e, (unit)x); }
-inline physics::val physics::operator/(long double x, val y) { return val((long double)y / x, -y.e, (unit)y); }
 
-inline physics::val physics::operator*(matrix x, unit y) { return val(x, y); }
-inline physics::val physics::operator/(matrix x, unit y) { return val(x, y^-1); }
-inline std::string physics::operator+(std::string x, val y) { return x + (std::string)y; }
-inline std::ostream& physics::operator<<(std::ostream &os, const val &v) {
-    os << (std::string)v;
-    return os;
+inline physics::eigen3 physics::symmetric_eigen3(const mat3& a) {
+    eigen3 out;
+    symmetric_eigen3_lanes<1>(&a, &out, 1);
+    return out;
 }
 
-inline physics::val physics::abs(physics::val v) { return val(abs(v.v), v.e, v.u); }
-inline physics::val physics::cross(val v1, val v2) { return val(cross(v1.v, v2.v), v1.e + v2.e, v1.u * v2.u); }
+inline std::vector<physics::eigen3> physics::symmetric_eigen3(const std::vector<mat3>& a) {
+    int n = a.size();
+    std::vector<eigen3> out(n);
+    int groups = (n + eigen3_lanes - 1) / eigen3_lanes;
+    parallel_for(groups, 200L * n, [&](int begin, int end) {
+        for(int g = begin; g < end; g++) {
+            int first = g * eigen3_lanes;
+            symmetric_eigen3_lanes<eigen3_lanes>(&a[first], &out[first], std::min(eigen3_lanes, n - first));
+        }
+    });
+    return out;
+}
 
-inline physics::val physics::operator""_Y(long double v) { return val(v, 24); }
-inline physics::val physics::operator""_Z(long double v) { return val(v, 21); }
-inline physics::val physics::operator""_E(long double v) { return val(v, 18); }
-inline physics::val physics::operator""_P(long double v) { return val(v, 15); }
-inline physics::val physics::operator""_T(long double v) { return val(v, 12); }
-inline physics::val physics::operator""_G(long double v) { return val(v, 9); }
-inline physics::val physics::operator""_M(long double v) { return val(v, 6); }
-inline physics::val physics::operator""_k(long double v) { return val(v, 3); }
-inline physics::val physics::operator""_h(long double v) { return val(v, 2); }
-inline physics::val physics::operator""_da(long double v) { return val(v, 1); }
-inline physics::val physics::operator""_d(long double v) { return val(v, -1); }
-inline physics::val physics::operator""_c(long double v) { return val(v, -2); }
-inline physics::val physics::operator""_m(long double v) { return val(v, -3); }
-inline physics::val physics::operator""_mu(long double v) { return val(v, -6); }
-inline physics::val physics::operator""_n(long double v) { return val(v, -9); }
-inline physics::val physics::operator""_p(long double v) { return val(v, -12); }
-inline physics::val physics::operator""_f(long double v) { return val(v, -15); }
-inline physics::val physics::operator""_a(long double v) { return val(v, -18); }
-inline physics::val physics::operator""_z(long double v) { return val(v, -21); }
-inline physics::val physics::operator""_y(long double v) { return val(v, -24); }
 
-inline void physics::val::calculate_exponent() {
-    if(v.rows() != 1 || v.cols() != 1) {
-        v *= pow(10,e);
-        e = 0;
-        return;
+// Makes rows i and j of w orthogonal by a rotation, applied to the same rows of vt.
+// Returns false if they already are to working precision, allowing for the rounding of their dot product.
+inline bool orthogonalize_rows(physics::matrix& w, physics::matrix& vt, int i, int j) {
+    physics::scalar* wi = w.row(i);
+    physics::scalar* wj = w.row(j);
+    physics::scalar alpha = 0, beta = 0, gamma = 0;
+    for(int k = 0; k < w.cols(); k++) {
+        alpha += wi[k] * wi[k];
+        beta += wj[k] * wj[k];
+        gamma += wi[k] * wj[k];
+    }
+    if(gamma == 0 || std::abs(gamma) <= std::sqrt((physics::scalar)w.cols()) * std::numeric_limits<physics::scalar>::epsilon() * std::sqrt(alpha * beta)) return false;
+
+    physics::scalar t = jacobi_tangent((beta - alpha) / (2 * gamma));
+    physics::scalar c = 1 / std::sqrt(t * t + 1);
+    physics::scalar s = t * c;
+    for(int k = 0; k < w.cols(); k++) {
+        physics::scalar x = wi[k], y = wj[k];
+        wi[k] = c * x - s * y;
+        wj[k] = s * x + c * y;
+    }
+    physics::scalar* vi = vt.row(i);
+    physics::scalar* vj = vt.row(j);
+    for(int k = 0; k < vt.cols(); k++) {
+        physics::scalar x = vi[k], y = vj[k];
+        vi[k] = c * x - s * y;
+        vj[k] = s * x + c * y;
+    }
+    return true;
+}
+
+inline physics::svd::svd(const matrix& a) : e(0), u() {
+    // The columns of the tall one of A and A^T are rotated until they are orthogonal. They are kept as the
+    // rows of w, so they are contiguous, and the rotations are accumulated in the rows of vt.
+    bool wide = a.rows() < a.cols();
+    matrix w = wide ? a : a.T();
+    int k = w.rows(), m = w.cols();
+    matrix vt = matrix::identity(k);
+    if(k >= svd_preconditioning) {
+        // Rotating by the eigenvectors of w w^T leaves the rows orthogonal up to rounding, so the sweeps
+        // only have to clean up
+        matrix et = symmetric_eigen(w * w.T()).vectors.T();
+        w = et * w;
+        vt = et;
     }
 
-    if((long double)abs(v) > 1) {
-        while((long double)abs(v) >= 10) {
-            e++;
-            v /= 10;
+    // Round-robin ordering: every round pairs each row with one other, so the pairs of a round are
+    // independent and run in parallel, and every pair meets once per sweep
+    int players = k + k % 2;
+    std::vector<int> ring(players);
+    std::iota(ring.begin(), ring.end(), 0);
+    for(int sweep = 0; sweep < 64; sweep++) {
+        std::atomic<bool> rotated(false);
+        for(int round = 0; round + 1 < players; round++) {
+            parallel_for(players / 2, (long)players * (3 * m + 2 * k), [&](int begin, int end) {
+                for(int p = begin; p < end; p++) {
+                    int i = ring[p], j = ring[players - 1 - p];
+                    if(i >= k || j >= k) continue;
+                    if(orthogonalize_rows(w, vt, std::min(i, j), std::max(i, j))) rotated = true;
+                }
+            });
+            std::rotate(ring.begin() + 1, ring.end() - 1, ring.end());
         }
+        if(!rotated) break;
+    }
+
+    std::vector<scalar> norms(k);
+    for(int j = 0; j < k; j++) {
+        scalar sum = 0;
+        for(int c = 0; c < m; c++) sum += w(j, c) * w(j, c);
+        norms[j] = std::sqrt(sum);
     }
-    else if((long double)abs(v) < 1.0) {
-        while((long double)abs(v) <= 1.0) {
-            e--;
-            v *= 10;
+    std::vector<int> order(k);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](int x, int y) { return norms[x] > norms[y]; });
+
+    // Rows of ut are the singular vectors of the tall side. Those of singular values at rounding level
+    // are mostly rounding error, so they are replaced below.
+    values = matrix::zeros(1, k);
+    matrix ut = matrix::zeros(k, m), other = matrix::zeros(k, k);
+    scalar negligible = k == 0 ? 0 : norms[order[0]] * std::max(k, m) * std::numeric_limits<scalar>::epsilon();
+    std::vector<bool> null(k);
+    for(int j = 0; j < k; j++) {
+        scalar norm = norms[order[j]];
+        values(0, j) = norm;
+        null[j] = norm <= negligible;
+        if(!null[j]) {
+            for(int c = 0; c < m; c++) ut(j, c) = w(order[j], c) / norm;
         }
+        std::copy(vt.row(order[j]), vt.row(order[j]) + k, other.row(j));
     }
 
-    if(e > 3 || e < -3) {
-        if(e % 3 == 1 || e % 3 == -2) {
-            e--;
-            v *= 10;
+    // Vectors of negligible singular values are completed to an orthonormal set. Each starts from the unit
+    // vector furthest from the rows set so far, whose squared distance is 1 minus its squared
+    // projections on them, so one with at least (m - rows) / m of its length left is always found.
+    auto is_set = [&](int q, int j) { return q != j && (q < j || !null[q]); };
+    for(int j = 0; j < k; j++) {
+        if(!null[j]) continue;
+        int best = 0;
+        scalar best_residual = -1;
+        for(int c = 0; c < m; c++) {
+            scalar residual = 1;
+            for(int q = 0; q < k; q++) {
+                if(is_set(q, j)) residual -= ut(q, c) * ut(q, c);
+            }
+            if(residual > best_residual) {
+                best = c;
+                best_residual = residual;
+            }
         }
-        if(e % 3 == 2|| e % 3 == -1) {
-            e++;
-            v /= 10;
+
+        scalar* u = ut.row(j);
+        std::fill(u, u + m, 0);
+        u[best] = 1;
+        for(int pass = 0; pass < 2; pass++) {
+            for(int q = 0; q < k; q++) {
+                if(!is_set(q, j)) continue;
+                scalar dot = 0;
+                for(int c = 0; c < m; c++) dot += ut(q, c) * u[c];
+                for(int c = 0; c < m; c++) u[c] -= dot * ut(q, c);
+            }
         }
+        scalar sum = 0;
+        for(int c = 0; c < m; c++) sum += u[c] * u[c];
+        for(int c = 0; c < m; c++) u[c] /= std::sqrt(sum);
     }
+
+    left = wide ? other.T() : ut.T();
+    right = wide ? ut.T() : other.T();
 }
 
-inline std::string physics::val::get_prefix() const {
-    if(e == 0) {
-        return u == unit() ? "" : " ";
-    };
-    if(u == unit() || (long double)std::abs(e) > 24) return "e" + std::to_string(e) + " ";
-    return " " + prefix_names[e];
+inline physics::svd::svd(const val& a) : svd(a.v) {
+    e = a.e;
+    u = a.u;
 }
 
-// end --- value.cpp --- 
+inline physics::val physics::svd::singular_values() const { return val(values, e, u); }
+
+inline int physics::svd::rank() const {
+    if(values.size() == 0) return 0;
+    scalar tolerance = values(0, 0) * std::max(left.rows(), right.rows()) * std::numeric_limits<scalar>::epsilon();
+    int count = 0;
+    for(int j = 0; j < values.size(); j++) count += values(0, j) > tolerance;
+    return count;
+}
 
 
+// end --- eigen.cpp --- 
 
-// begin --- unit.cpp --- 
 
 
+// begin --- sink.cpp --- 
+
 
-// begin --- superscript.h --- 
+
+// begin --- sink.h --- 
 
 #pragma once
 
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
 #include <string>
-#include <map>
+#include <string_view>
+#include <thread>
 
 
-namespace super {
-    std::map<char, std::string> supertable {
-        {'0', "\u2070"},
-        {'1', "\u00b9"},
-        {'2', "\u00b2"},
-        {'3', "\u00b3"},
-        {'4', "\u2074"},
-        {'5', "\u2075"},
-        {'6', "\u2076"},
-        {'7', "\u2077"},
-        {'8', "\u2078"},
-        {'9', "\u2079"},
-        {'+', "\u207A"},
-        {'-', "\u207B"}
-    };
+namespace physics {
+    // Collects output in a buffer and writes it to its target from a background thread.
+    // Writers only append to the buffer, so they never wait for I/O. The buffer is written out once it
+    // reaches flush_size bytes, and at least every flush_interval. Text is written in the order it was added.
+    class sink {
+    private:
+        std::FILE* file = nullptr;
+        bool owns_file = false;
+        std::string* memory = nullptr;
 
-    // Returns a string of exponent characters corresponding to the input char or int.
-    inline std::string super(char c) {
-        return supertable[c];
-    }
-    inline std::string super(int n) {
-        std::string out;
-        if(n < 0) {
-            out += "\u207B";
-            n *= -1;
-        }
+        std::string buffer;
+        long long added = 0;
+        long long written = 0;
+        bool flushing = false;
+        bool stopping = false;
 
-        for(char c : std::to_string(n)) {
-            out += super(c);
-        }
-        return out;
-    }
-};
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable done;
+        std::thread writer;
 
+    public:
+        // Default thresholds for writing the buffer out
+        static constexpr size_t default_flush_size = 1 << 16;
+        static constexpr std::chrono::milliseconds default_flush_interval{50};
 
+        const size_t flush_size;
+        const std::chrono::milliseconds flush_interval;
 
-// end --- superscript.h --- 
+        // Writes to an open stream, such as stdout. The stream is not closed.
+        explicit sink(std::FILE* file = stdout, size_t flush_size = default_flush_size, std::chrono::milliseconds flush_interval = default_flush_interval);
+        // Writes to a file, which is created or truncated.
+        explicit sink(const std::string& path, size_t flush_size = default_flush_size, std::chrono::milliseconds flush_interval = default_flush_interval);
+        // Appends to a string in memory. Read it only after flush() or once the sink is destroyed.
+        explicit sink(std::string* memory, size_t flush_size = default_flush_size, std::chrono::milliseconds flush_interval = default_flush_interval);
+        // Writes out everything still buffered.
+        ~sink();
 
+        sink(const sink&) = delete;
+        sink& operator=(const sink&) = delete;
 
+        // Adds text to the buffer.
+        void write(std::string_view text);
 
+        // Waits until everything added so far has been written to the target.
+        void flush();
 
-const std::string si_strings[7] = {"m","kg","s","A","K","cd","mol"};
-const std::map<physics::unit, std::string> si_derved_names {
-    { physics::HZ, "Hz" },
-    { physics::N, "N" },
-    { physics::J, "J" },
-    { physics::W, "W" },
-    { physics::PA, "Pa" },
-    { physics::V, "V" },
-    { physics::C, "C" },
-    { physics::OHM, "Ω" },
-    { physics::F, "F" },
-    { physics::H, "H" },
-    { physics::SIEMENS, "S" },
-    { physics::WB, "Wb" },
-    { physics::T, "T" }
-};
-const std::map<physics::unit, std::string> si_special_names {
-    { physics::J * physics::S, "Js" },
-    { physics::N * physics::S, "Ns" },
-    { physics::J / physics::K, "JK" + super::super(-1) },
-    { physics::J / (physics::KG * physics::K), "Jkg" + super::super(-1) + "K" + super::super(-1) },
-    { physics::C / physics::M, "Cm" + super::super(-1) },
-    { physics::C / (physics::M^2), "Cm" + super::super(-2) },
-    { physics::C / (physics::M^3), "Cm" + super::super(-3) },
-    { physics::T * physics::M, "Tm" },
-    { physics::A / (physics::V * physics::M), "AV" + super::super(-1) + "m" + super::super(-1) },
-    { physics::V / physics::M, "Vm" + super::super(-1) },
-    { physics::W / (physics::M^2), "Wm" + super::super(-2) }
-};
+        // Returns the sink that writes to standard output, which is used by print.
+        static sink& standard_output();
 
-inline physics::unit::unit(std::vector<int8_t> si_units) {
-    int size = si_units.size();
-    for(int i = 0; i < std::min(7, size); i++) {
-        si[i] = si_units[i];
-    }
+    private:
+        void start();
+        void work();
+        void output(const std::string& text);
+    };
 }
 
-inline physics::unit::operator std::string() const {
-    std::string output;
-
-    // Returns special names if present in map
-    if(si_special_names.count(*this) != 0) {
-        output = si_special_names.at(*this);
-        return output;
-    }
 
-    // Returns name of derived unit if present in map
-    if(si_derved_names.count(*this) != 0) {
-        output = si_derved_names.at(*this);
-        return output;
-    }
+// end --- sink.h --- 
 
-    // Constructs name from base units
-    for(int i = 0; i < 7; i++) {
-        int8_t u = si[i];
-        if(u != 0) {
-            output += si_strings[i];
-            if(u != 1) {
-                output += super::super(u);
-            }
-        }
-    }
-    return output;
-}
-inline physics::unit::operator std::vector<int8_t>() const {
-    return std::vector<int8_t>(std::begin(this->si), std::end(this->si));
-}
 
-inline physics::unit physics::unit::operator*(unit x) const {
-    std::vector<int8_t> si_units;
+#include <stdexcept>
 
-    for(int i = 0; i < 7; i++) {
-        si_units.push_back(si[i] + x.si[i]);
-    }
 
-    return unit(si_units);
+inline physics::sink::sink(std::FILE* file, size_t flush_size, std::chrono::milliseconds flush_interval)
+    : file(file), flush_size(flush_size), flush_interval(flush_interval) {
+    start();
+}
+inline physics::sink::sink(const std::string& path, size_t flush_size, std::chrono::milliseconds flush_interval)
+    : file(std::fopen(path.c_str(), "w")), owns_file(true), flush_size(flush_size), flush_interval(flush_interval) {
+    if(!file) throw std::invalid_argument("Could not open " + path + ".");
+    start();
+}
+inline physics::sink::sink(std::string* memory, size_t flush_size, std::chrono::milliseconds flush_interval)
+    : memory(memory), flush_size(flush_size), flush_interval(flush_interval) {
+    start();
 }
-inline physics::unit physics::unit::operator/(unit x) const {
-    std::vector<int8_t> si_units;
 
-    for(int i = 0; i < 7; i++) {
-        si_units.push_back(si[i] - x.si[i]);
+inline physics::sink::~sink() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
     }
-
-    return unit(si_units);
+    wake.notify_all();
+    writer.join();
+    if(owns_file) std::fclose(file);
 }
-inline physics::unit physics::unit::operator^(int x) const {
-    std::vector<int8_t> si_units;
 
-    for(int i = 0; i < 7; i++) {
-        si_units.push_back(si[i] * x);
+inline void physics::sink::write(std::string_view text) {
+    bool wake_writer;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        wake_writer = buffer.empty();
+        buffer.append(text.data(), text.size());
+        added += text.size();
+        wake_writer = wake_writer || buffer.size() >= flush_size;
     }
+    if(wake_writer) wake.notify_one();
+}
 
-    return unit(si_units);
+inline void physics::sink::flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    long long target = added;
+    if(written >= target) return;
+    flushing = true;
+    wake.notify_one();
+    done.wait(lock, [&]() { return written >= target; });
 }
 
-inline bool physics::unit::operator<(unit x) const {
-    return (std::vector<int8_t>)*this < (std::vector<int8_t>)x;
+inline physics::sink& physics::sink::standard_output() {
+    static sink out(stdout);
+    return out;
 }
-inline bool physics::unit::operator==(unit x) const {
-    return (std::vector<int8_t>)*this == (std::vector<int8_t>)x;
+
+inline void physics::sink::start() {
+    writer = std::thread([this]() { work(); });
 }
-inline bool physics::unit::operator!=(unit x) const {
-    return (std::vector<int8_t>)*this != (std::vector<int8_t>)x;
+
+inline void physics::sink::work() {
+    // Buffers are swapped rather than copied, so both keep their capacity
+    std::string batch;
+    std::unique_lock<std::mutex> lock(mutex);
+    while(true) {
+        // Sleeps until there is output, then lets it collect for up to flush_interval
+        wake.wait(lock, [this]() { return stopping || !buffer.empty(); });
+        wake.wait_for(lock, flush_interval, [this]() { return stopping || flushing || buffer.size() >= flush_size; });
+        flushing = false;
+        if(buffer.empty()) {
+            if(stopping) return;
+            continue;
+        }
+
+        batch.swap(buffer);
+        lock.unlock();
+        output(batch);
+        lock.lock();
+        written += batch.size();
+        batch.clear();
+        done.notify_all();
+    }
 }
 
-inline std::ostream& physics::operator<<(std::ostream& os, const unit& u) {
-    os << (std::string)u;
-    return os;
+inline void physics::sink::output(const std::string& text) {
+    if(memory) {
+        memory->append(text);
+        return;
+    }
+    std::fwrite(text.data(), 1, text.size(), file);
+    std::fflush(file);
 }
 
-// end --- unit.cpp --- 
+
+// end --- sink.cpp --- 
 
 
 
@@ -811,21 +5984,55 @@ inline std::ostream& physics::operator<<(std::ostream& os, const unit& u) {
 
 #pragma once
 
-#include <iostream>
+
+#include <ostream>
+#include <streambuf>
+#include <string>
 
 
 namespace physics {
-    inline void print() {
-        std::cout << std::endl;
+    // Stream buffer that appends everything written to it to a string.
+    class string_buffer : public std::streambuf {
+    public:
+        std::string text;
+
+    protected:
+        int_type overflow(int_type c) override {
+            if(c != traits_type::eof()) text += (char)c;
+            return c;
+        }
+        std::streamsize xsputn(const char* s, std::streamsize n) override {
+            text.append(s, n);
+            return n;
+        }
     };
 
-    template <typename T, typename... Types>
-    void print(T var1, Types...var2) {
-        std::cout << var1 << "\t";
-        print(var2...);
+    // Writes the arguments to a sink as one tab separated line.
+    template <typename... Types>
+    void print_to(sink& out, const Types&... vars) {
+        // The line is formatted in buffers kept per thread, and handed to the sink in a single write
+        thread_local string_buffer line;
+        thread_local std::ostream stream(&line);
+        line.text.clear();
+        ((stream << vars << "\t"), ...);
+        line.text += '\n';
+        out.write(line.text);
+    }
+
+    // Prints the arguments to standard output as one tab separated line.
+    // Output is buffered and written by a background thread, call flush() to wait until it is written.
+    template <typename... Types>
+    void print(const Types&... vars) {
+        print_to(sink::standard_output(), vars...);
+    }
+
+    // Waits until everything printed so far has been written.
+    inline void flush() {
+        sink::standard_output().flush();
     }
 }
 
+
 // end --- print.h --- 
 
 
@@ -833,6 +6040,8 @@ namespace physics {
 // begin --- constants.h --- 
 
 #pragma once
+
+
 #include <cmath>
 
 
@@ -842,85 +6051,265 @@ namespace physics {
     // Non-SI units
     namespace units {
         // Length
-        const val angstrom = 1e-10 * M; // Ångström
-        const val XU = 1.002'08e-13 * M; // X-unit
-        const val fermi = 1e-15 * M; // Fermi
-        const val AU = 1.495'978'70e11 * M; // Astronomical unit
-        const val lightyear = 9.460'55e15 * M; // Light-year
-        const val parsec = 3.0857e16 * M; // Parsec
+        inline const val angstrom = 1e-10 * M; // Ångström
+        inline const val XU = 1.002'08e-13 * M; // X-unit
+        inline const val fermi = 1e-15 * M; // Fermi
+        inline const val AU = 1.495'978'70e11 * M; // Astronomical unit
+        inline const val lightyear = 9.460'55e15 * M; // Light-year
+        inline const val parsec = 3.0857e16 * M; // Parsec
 
         // Area
-        const val barn = 1e-28 * M^2; // Barn
+        inline const val barn = 1e-28 * M^2; // Barn
 
         // Time
-        const val tropical_year = 31.556'925'974e6 * S; // Tropical year (solar year)
-        const val sidereal_year = 31.558'150e6 * S; // Sidereal year (stellar year)
-        const val calender_year = 31.536e6 * S; // Calender year
-        const val leap_year = 31.6224e6 * S; // Leap year
+        inline const val tropical_year = 31.556'925'974e6 * S; // Tropical year (solar year)
+        inline const val sidereal_year = 31.558'150e6 * S; // Sidereal year (stellar year)
+        inline const val calender_year = 31.536e6 * S; // Calender year
+        inline const val leap_year = 31.6224e6 * S; // Leap year
 
         // Speed
-        const val kmph = 1/3.6 * M/S; // Kilometers per hour
+        inline const val kmph = 1/3.6 * M/S; // Kilometers per hour
 
         // Energy
-        const val eV = 1.602'176'634e-19 * J; // Electron volt
-        const val kcal = 4184 * J; // Kilocalorie
+        inline const val eV = 1.602'176'634e-19 * J; // Electron volt
+        inline const val kcal = 4184 * J; // Kilocalorie
 
         // Pressure
-        const val atm = 1.013'25e5 * PA; // Atmosphere
+        inline const val atm = 1.013'25e5 * PA; // Atmosphere
 
         // Other
-        const val D = 3.33564e-30 * C * M; // Debye
+        inline const val D = 3.33564e-30 * C * M; // Debye
     }
 
     // Constants
     namespace constants {
         // Empty Space
-        const val c_0 = 2.997'924'58e8 * M/S; // Speed of light
-        const val mu_0 = 4 * M_PI * 1e-7 * (V*S)/(A*M); // Permeability
-        const val epsilon_0 = 8.854'187'817e-12 * (A*S)/(V*M); // Permittivity
+        inline const val c_0 = 2.997'924'58e8 * M/S; // Speed of light
+        inline const val mu_0 = 4 * M_PI * 1e-7 * (V*S)/(A*M); // Permeability
+        inline const val epsilon_0 = 8.854'187'817e-12 * (A*S)/(V*M); // Permittivity
 
         // Gravitation
-        const val G = 6.674'08e-11 * (N*(M^2))/(KG^2); // Gravitational constant
-        const val g = 9.806'65 * M/(S^2); // Acceleration of gravity at sea level
+        inline const val G = 6.674'08e-11 * (N*(M^2))/(KG^2); // Gravitational constant
+        inline const val g = 9.806'65 * M/(S^2); // Acceleration of gravity at sea level
 
         // Particle Masses
-        const val m_e = 9.109'383'56e-31 * KG; // Electron rest mass
-        const val m_mu = 1.883'531'59e-28 * KG; // Muon rest mass
-        const val m_p = 1.672'621'90e-27 * KG; // Proton rest mass
-        const val m_n = 1.674'927'47e-27 * KG; // Neutron rest mass
-        const val m_u = 1.660'539'04e-27 * KG; // Atomic mass constant
+        inline const val m_e = 9.109'383'56e-31 * KG; // Electron rest mass
+        inline const val m_mu = 1.883'531'59e-28 * KG; // Muon rest mass
+        inline const val m_p = 1.672'621'90e-27 * KG; // Proton rest mass
+        inline const val m_n = 1.674'927'47e-27 * KG; // Neutron rest mass
+        inline const val m_u = 1.660'539'04e-27 * KG; // Atomic mass constant
 
         // Atomic Quantities
-        const val r_e = 2.817'940'37e-15 * M; // Classical electron radius
-        const val a_0 = 5.29177219e-11 * M; // Bohr radius
-        const val lambda_e = 2.426'310'28e-12 * M; // Compton electron wavelength
-        const val lambda_p = 1.321'409'87e-15 * M; // Compton proton wavelength
-        const val E_H = 1.312'750e6 * J/MOL; // Hydrogen atom ground state energy
+        inline const val r_e = 2.817'940'37e-15 * M; // Classical electron radius
+        inline const val a_0 = 5.29177219e-11 * M; // Bohr radius
+        inline const val lambda_e = 2.426'310'28e-12 * M; // Compton electron wavelength
+        inline const val lambda_p = 1.321'409'87e-15 * M; // Compton proton wavelength
+        inline const val E_H = 1.312'750e6 * J/MOL; // Hydrogen atom ground state energy
 
         // Electric Charge and Magnetic Moment
-        const val e = 1.602'176'634e-19 * C; // Elementary charge
-        const val mu_B = 9.274'010'22e-24 * J/T; // Bohr magneton
-        const val mu_N = 5.050'783'82e-27 * J/T; // Nuclear magneton
-        const val mu_e = -9.284'7646e-24 * J/T; // Electron magnetic moment
-        const val mu_p = 1.410'606'787e-26 * J/T; // Proton magnetic moment
-        const val mu_n = -0.966'2365e-26 * J/T; // Neutron magnetic moment
-        const val mu_mu = -4.490'448'26 * J/T; // Muon magnetic moment
+        inline const val e = 1.602'176'634e-19 * C; // Elementary charge
+        inline const val mu_B = 9.274'010'22e-24 * J/T; // Bohr magneton
+        inline const val mu_N = 5.050'783'82e-27 * J/T; // Nuclear magneton
+        inline const val mu_e = -9.284'7646e-24 * J/T; // Electron magnetic moment
+        inline const val mu_p = 1.410'606'787e-26 * J/T; // Proton magnetic moment
+        inline const val mu_n = -0.966'2365e-26 * J/T; // Neutron magnetic moment
+        inline const val mu_mu = -4.490'448'26 * J/T; // Muon magnetic moment
 
         // Quantum Physics, Radiation
-        const val h = 6.626'070'15e-34 * J*S; // Planck constant
-        const val hbar = h / (2 * M_PI);
-        const val R_inf = 1.097'373'1569e7 / M; // Rydberg constant
-        const val alpha = 7.297'352'566e-3; // Fine-structure constant
-        const val sigma = 5.670'374e-8 * W/((M^2) * (K^4)); // Stefan-Boltzmann constant
-        const val k_B = 1.380'649e-23 * J/K; // Boltzmann constant
-        const val L = 2.443'004'45e-8 * (V^2)/(K^2); // Lorenz constant
+        inline const val h = 6.626'070'15e-34 * J*S; // Planck constant
+        inline const val hbar = h / (2 * M_PI);
+        inline const val R_inf = 1.097'373'1569e7 / M; // Rydberg constant
+        inline const val alpha = 7.297'352'566e-3; // Fine-structure constant
+        inline const val sigma = 5.670'374e-8 * W/((M^2) * (K^4)); // Stefan-Boltzmann constant
+        inline const val k_B = 1.380'649e-23 * J/K; // Boltzmann constant
+        inline const val L = 2.443'004'45e-8 * (V^2)/(K^2); // Lorenz constant
 
         // Quantities Related to Amount of Substance
-        const val N_A = 6.022'140'76e23 / MOL; // Avogadro constant
-        const val R = 8.314'462'618 * J/(MOL*K); // Molar gas constant
-        const val F = 9.648'533'212e4 * C/MOL; // Faraday constant
+        inline const val N_A = 6.022'140'76e23 / MOL; // Avogadro constant
+        inline const val R = 8.314'462'618 * J/(MOL*K); // Molar gas constant
+        inline const val F = 9.648'533'212e4 * C/MOL; // Faraday constant
     };
 };
 
 // end --- constants.h --- 
 
+
+
+// begin --- quantity.h --- 
+
+#pragma once
+
+
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+
+
+namespace physics {
+    // Represents a physical dimension at compile time.
+    // The template parameters are the exponents of each SI unit, in the same order as physics::unit.
+    template <int m, int kg, int s, int a, int k, int cd, int mol>
+    struct dimension {
+        // Conversions
+        constexpr explicit operator unit() const {
+            return unit(m, kg, s, a, k, cd, mol);
+        }
+    };
+
+    template <typename D1, typename D2> struct dimension_product;
+    template <int... x, int... y>
+    struct dimension_product<dimension<x...>, dimension<y...>> { typedef dimension<(x + y)...> type; };
+
+    template <typename D1, typename D2> struct dimension_quotient;
+    template <int... x, int... y>
+    struct dimension_quotient<dimension<x...>, dimension<y...>> { typedef dimension<(x - y)...> type; };
+
+    template <typename D, int n> struct dimension_power;
+    template <int... x, int n>
+    struct dimension_power<dimension<x...>, n> { typedef dimension<(x * n)...> type; };
+
+    // Dimensions
+    typedef dimension<0,0,0,0,0,0,0> Dimensionless;
+    typedef dimension<1,0,0,0,0,0,0> Length;
+    typedef dimension<0,1,0,0,0,0,0> Mass;
+    typedef dimension<0,0,1,0,0,0,0> Time;
+    typedef dimension<0,0,0,1,0,0,0> Current;
+    typedef dimension<0,0,0,0,1,0,0> Temperature;
+    typedef dimension<0,0,0,0,0,1,0> LuminousIntensity;
+    typedef dimension<0,0,0,0,0,0,1> Amount;
+
+    typedef dimension_quotient<Dimensionless, Time>::type Frequency;
+    typedef dimension_quotient<Length, Time>::type Velocity;
+    typedef dimension_quotient<Velocity, Time>::type Acceleration;
+    typedef dimension_product<Mass, Acceleration>::type Force;
+    typedef dimension_product<Force, Length>::type Energy;
+    typedef dimension_quotient<Energy, Time>::type Power;
+    typedef dimension_quotient<Force, dimension_power<Length, 2>::type>::type Pressure;
+    typedef dimension_product<Current, Time>::type Charge;
+    typedef dimension_quotient<Power, Current>::type Voltage;
+    typedef dimension_quotient<Voltage, Current>::type Resistance;
+
+
+    // Represents a physical value whose dimension is checked at compile time.
+    // Holds nothing but the value in SI base units, so sizeof(quantity<S, D>) == sizeof(S) and
+    // unit arithmetic produces no code. Adding quantities of different dimensions fails to compile.
+    template <typename Scalar, typename Dim>
+    class quantity {
+    private:
+        Scalar v;
+
+    public:
+        constexpr quantity() : v() {}
+        constexpr explicit quantity(Scalar value) : v(value) {}
+
+        // Converts a val, which must have the same unit.
+        explicit quantity(const val& x) {
+            if((unit)x != (unit)Dim()) throw std::invalid_argument("Unit Error");
+            v = (scalar)x.v * power_of_ten(x.e);
+        }
+
+        // Conversions
+        constexpr Scalar value() const { return v; }
+        explicit operator val() const { return val(matrix((scalar)v), (unit)Dim()); }
+
+        // Operators
+        constexpr quantity operator+(quantity x) const { return quantity(v + x.v); }
+        constexpr quantity operator-(quantity x) const { return quantity(v - x.v); }
+        constexpr quantity operator-() const { return quantity(-v); }
+        constexpr quantity operator*(Scalar x) const { return quantity(v * x); }
+        constexpr quantity operator/(Scalar x) const { return quantity(v / x); }
+
+        template <typename D>
+        constexpr quantity<Scalar, typename dimension_product<Dim, D>::type> operator*(quantity<Scalar, D> x) const {
+            return quantity<Scalar, typename dimension_product<Dim, D>::type>(v * x.value());
+        }
+        template <typename D>
+        constexpr quantity<Scalar, typename dimension_quotient<Dim, D>::type> operator/(quantity<Scalar, D> x) const {
+            return quantity<Scalar, typename dimension_quotient<Dim, D>::type>(v / x.value());
+        }
+
+        quantity& operator+=(quantity x) { v += x.v; return *this; }
+        quantity& operator-=(quantity x) { v -= x.v; return *this; }
+        quantity& operator*=(Scalar x) { v *= x; return *this; }
+        quantity& operator/=(Scalar x) { v /= x; return *this; }
+
+        constexpr bool operator<(quantity x) const { return v < x.v; }
+        constexpr bool operator>(quantity x) const { return v > x.v; }
+        constexpr bool operator<=(quantity x) const { return v <= x.v; }
+        constexpr bool operator>=(quantity x) const { return v >= x.v; }
+        constexpr bool operator==(quantity x) const { return v == x.v; }
+        constexpr bool operator!=(quantity x) const { return v != x.v; }
+    };
+
+    static_assert(sizeof(quantity<double, Length>) == sizeof(double), "quantity must not add storage");
+
+    // The scalar is taken from the quantity, so that 2 * q works for a quantity<double, D>
+    template <typename Scalar, typename Dim>
+    constexpr quantity<Scalar, Dim> operator*(typename std::common_type<Scalar>::type x, quantity<Scalar, Dim> q) { return q * x; }
+    template <typename Scalar, typename Dim>
+    constexpr quantity<Scalar, typename dimension_quotient<Dimensionless, Dim>::type> operator/(typename std::common_type<Scalar>::type x, quantity<Scalar, Dim> q) {
+        return quantity<Scalar, typename dimension_quotient<Dimensionless, Dim>::type>(x / q.value());
+    }
+
+    // Multiplying a number with a dimension creates a quantity, e.g. 2.0 * si::M
+    template <typename Scalar, int... x, typename = typename std::enable_if<std::is_arithmetic<Scalar>::value>::type>
+    constexpr quantity<Scalar, dimension<x...>> operator*(Scalar v, dimension<x...>) { return quantity<Scalar, dimension<x...>>(v); }
+    template <typename Scalar, int... x, typename = typename std::enable_if<std::is_arithmetic<Scalar>::value>::type>
+    constexpr quantity<Scalar, dimension<(-x)...>> operator/(Scalar v, dimension<x...>) { return quantity<Scalar, dimension<(-x)...>>(v); }
+    template <typename Scalar, typename Dim, int... x>
+    constexpr quantity<Scalar, typename dimension_product<Dim, dimension<x...>>::type> operator*(quantity<Scalar, Dim> q, dimension<x...> d) {
+        return q * (Scalar(1) * d);
+    }
+    template <typename Scalar, typename Dim, int... x>
+    constexpr quantity<Scalar, typename dimension_quotient<Dim, dimension<x...>>::type> operator/(quantity<Scalar, Dim> q, dimension<x...> d) {
+        return q / (Scalar(1) * d);
+    }
+
+    // Dimensions combine like units, e.g. si::KG * si::M / (si::S * si::S)
+    template <int... x, int... y>
+    constexpr dimension<(x + y)...> operator*(dimension<x...>, dimension<y...>) { return {}; }
+    template <int... x, int... y>
+    constexpr dimension<(x - y)...> operator/(dimension<x...>, dimension<y...>) { return {}; }
+
+    template <int n, typename Scalar, typename Dim>
+    constexpr quantity<Scalar, typename dimension_power<Dim, n>::type> power(quantity<Scalar, Dim> q) {
+        Scalar out = 1;
+        for(int i = 0; i < (n < 0 ? -n : n); i++) out *= q.value();
+        return quantity<Scalar, typename dimension_power<Dim, n>::type>(n < 0 ? 1 / out : out);
+    }
+
+    template <typename Scalar, typename Dim>
+    quantity<Scalar, Dim> abs(quantity<Scalar, Dim> q) { return quantity<Scalar, Dim>(std::abs(q.value())); }
+
+    // Compile time counterparts of the units in unit.h
+    namespace si {
+        // SI Units
+        constexpr Length M{}; // Metre
+        constexpr Mass KG{}; // Kilogram
+        constexpr Time S{}; // Second
+        constexpr Current A{}; // Ampere
+        constexpr Temperature K{}; // Kelvin
+        constexpr LuminousIntensity CD{}; // Candela
+        constexpr Amount MOL{}; // Mole
+
+        // Derived units
+        constexpr Frequency HZ{}; // Hertz
+        constexpr Force N{}; // Newton
+        constexpr Energy J{}; // Joule
+        constexpr Power W{}; // Watt
+        constexpr Pressure PA{}; // Pascal
+        constexpr Voltage V{}; // Volt
+        constexpr Charge C{}; // Coulomb
+        constexpr Resistance OHM{}; // Ohm
+        constexpr decltype(C / V) F{}; // Farad
+        constexpr decltype(OHM * S) H{}; // Henry
+        constexpr decltype(A / V) SIEMENS{}; // Siemens
+        constexpr decltype(V * S) WB{}; // Weber
+        constexpr decltype(WB / (M * M)) T{}; // Tesla
+    }
+}
+
+
+// end --- quantity.h --- 
+
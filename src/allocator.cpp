@@ -0,0 +1,141 @@
+#include "allocator.h"
+#include <algorithm>
+#include <new>
+#include <stdexcept>
+
+
+inline thread_local physics::allocator* thread_allocator = nullptr;
+
+inline std::atomic<long> heap_allocations(0);
+inline std::atomic<long> heap_bytes(0);
+inline std::atomic<long> arena_allocations(0);
+inline std::atomic<long> arena_bytes(0);
+
+inline physics::allocator* physics::current_allocator() { return thread_allocator; }
+
+inline physics::allocator* physics::set_allocator(allocator* a) {
+    allocator* previous = thread_allocator;
+    thread_allocator = a;
+    return previous;
+}
+
+inline physics::allocation_stats physics::allocation_report() {
+    allocation_stats stats;
+    stats.heap_allocations = heap_allocations.load(std::memory_order_relaxed);
+    stats.heap_bytes = heap_bytes.load(std::memory_order_relaxed);
+    stats.arena_allocations = arena_allocations.load(std::memory_order_relaxed);
+    stats.arena_bytes = arena_bytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+// Heap allocations of matrix storage, counted for allocation_report
+inline physics::scalar* heap_allocate(size_t n, std::align_val_t alignment = std::align_val_t(alignof(physics::scalar))) {
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    heap_bytes.fetch_add(n * sizeof(physics::scalar), std::memory_order_relaxed);
+    return static_cast<physics::scalar*>(::operator new(n * sizeof(physics::scalar), alignment));
+}
+
+inline void heap_deallocate(physics::scalar* p, std::align_val_t alignment = std::align_val_t(alignof(physics::scalar))) {
+    ::operator delete(p, alignment);
+}
+
+
+// Pieces start on cache lines, so they line up for SIMD loads like heap storage does
+inline constexpr size_t arena_alignment = 64;
+inline constexpr size_t arena_granule = std::max<size_t>(1, arena_alignment / sizeof(physics::scalar));
+inline constexpr size_t arena_first_chunk = 1 << 14;
+
+inline physics::arena_block::arena_block(size_t first_chunk) : next_chunk(first_chunk), references(1) {}
+
+inline physics::arena_block::~arena_block() {
+    for(chunk& c : chunks) heap_deallocate(c.data, std::align_val_t(arena_alignment));
+}
+
+inline physics::scalar* physics::arena_block::allocate(int n) {
+    size_t size = (n + arena_granule - 1) / arena_granule * arena_granule;
+
+    // Later chunks are tried before adding one, they are empty after a reset
+    while(current < chunks.size() && used + size > chunks[current].size) {
+        current++;
+        used = 0;
+    }
+    if(current == chunks.size()) {
+        size_t chunk_size = std::max(next_chunk, size);
+        chunks.push_back(chunk{heap_allocate(chunk_size, std::align_val_t(arena_alignment)), chunk_size});
+        next_chunk = 2 * chunk_size;
+        used = 0;
+    }
+
+    scalar* p = chunks[current].data + used;
+    used += size;
+    references.fetch_add(1, std::memory_order_relaxed);
+    arena_allocations.fetch_add(1, std::memory_order_relaxed);
+    arena_bytes.fetch_add(size * sizeof(scalar), std::memory_order_relaxed);
+    return p;
+}
+
+inline void physics::arena_block::deallocate(scalar*, int) {
+    release();
+}
+
+inline void physics::arena_block::release() {
+    if(references.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this;
+}
+
+
+inline physics::arena::arena() : block(new arena_block(arena_first_chunk)) {}
+
+inline physics::arena::~arena() {
+    block->release();
+}
+
+inline void physics::arena::reset() {
+    if(scopes != 0) throw std::invalid_argument("Arena is in use.");
+    // Only the arena holds the block, so nothing else can take a reference while it is rewound
+    if(block->references.load(std::memory_order_acquire) == 1) {
+        block->current = 0;
+        block->used = 0;
+        return;
+    }
+    size_t size = std::max(arena_first_chunk, capacity());
+    block->release();
+    block = new arena_block(size);
+}
+
+inline size_t physics::arena::capacity() const {
+    size_t total = 0;
+    for(const arena_block::chunk& c : block->chunks) total += c.size;
+    return total;
+}
+
+
+// Arena of the calling thread, used by arena_scopes without an argument
+inline physics::arena& thread_arena() {
+    thread_local physics::arena a;
+    return a;
+}
+
+inline physics::arena_scope::arena_scope() : arena_scope(thread_arena()) {}
+
+inline physics::arena_scope::arena_scope(arena& a) : a(a) {
+    // Whatever the last step left behind may have been freed since
+    if(a.scopes == 0) a.reset();
+    a.scopes++;
+    previous = set_allocator(a.block);
+}
+
+inline physics::arena_scope::~arena_scope() {
+    set_allocator(previous);
+    if(--a.scopes == 0) a.reset();
+}
+
+// Matrix storage comes from the thread's allocator, or the heap
+inline physics::scalar* physics::allocate_storage(allocator* a, int n) {
+    if(a) return a->allocate(n);
+    return heap_allocate(n);
+}
+
+inline void physics::deallocate_storage(allocator* a, scalar* p, int n) {
+    if(a) a->deallocate(p, n);
+    else heap_deallocate(p);
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "scalar.h"
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+
+namespace physics {
+    // Source of the storage of matrices too large to be stored inline.
+    // Each thread has a current allocator, which new matrices created on it draw from for as long as they
+    // live, and their storage goes back to the same allocator, whichever thread frees it.
+    // The default, nullptr, is the heap.
+    class allocator {
+    public:
+        virtual ~allocator() = default;
+
+        virtual scalar* allocate(int n) = 0;
+        // Called with the size passed to allocate. May be called from any thread.
+        virtual void deallocate(scalar* p, int n) = 0;
+    };
+
+    // Returns the current allocator of the calling thread.
+    allocator* current_allocator();
+    // Sets the current allocator of the calling thread, and returns the previous one.
+    allocator* set_allocator(allocator* a);
+
+    // Storage of n elements from an allocator, or the heap if it is nullptr
+    scalar* allocate_storage(allocator* a, int n);
+    void deallocate_storage(allocator* a, scalar* p, int n);
+
+    // Chunks an arena hands out consecutive pieces of, which are only given back all at once.
+    // Allocating is a pointer increment, and freeing a piece only counts it. Matrices allocated from a
+    // block refer to it rather than to its arena, and keep it alive after the arena has moved on to another
+    // block or been destroyed: the last one to let go frees it.
+    class arena_block : public allocator {
+    private:
+        struct chunk {
+            scalar* data;
+            size_t size;
+        };
+
+        std::vector<chunk> chunks;
+        size_t current = 0; // Chunk being allocated from
+        size_t used = 0; // Elements used in it
+        size_t next_chunk; // Size of the first chunk to add
+        std::atomic<long> references; // Pieces in use, plus one while the arena uses the block
+
+        friend class arena;
+
+        explicit arena_block(size_t first_chunk);
+        ~arena_block();
+
+    public:
+        arena_block(const arena_block&) = delete;
+        arena_block& operator=(const arena_block&) = delete;
+
+        scalar* allocate(int n) override;
+        void deallocate(scalar* p, int n) override;
+
+        // Drops a reference, freeing the block with the last one
+        void release();
+    };
+
+    // Source of short-lived matrix storage, used through arena_scope. Once it has grown to fit a repeated
+    // workload, it serves it without touching the heap.
+    // Only the thread using an arena may allocate from or reset it.
+    class arena {
+    private:
+        arena_block* block; // Block being allocated from
+        int scopes = 0; // Open arena_scopes
+
+        friend class arena_scope;
+
+    public:
+        arena();
+        ~arena();
+        arena(const arena&) = delete;
+        arena& operator=(const arena&) = delete;
+
+        // Makes all the storage of the arena available again, in O(1). If pieces are still in use, their
+        // block is left to them and the arena starts a new one of the same size.
+        // Throws if an arena_scope is using the arena.
+        void reset();
+        // Elements in the current block
+        size_t capacity() const;
+    };
+
+    // Makes the calling thread allocate from an arena until the scope ends, e.g. for one step of a
+    // simulation. Without an argument, the thread's own arena is used.
+    // The arena is reset when the outermost scope using it ends, so the step's temporaries cost no heap
+    // allocations once it has grown to fit them. Matrices created before the scope keep their storage, and
+    // copying or moving a result into them copies it there, so results can be kept across the reset. Matrices
+    // created within the scope that outlive it stay valid, but keep all the storage of their step alive and
+    // make the next step start a new block, so copy results out instead where possible.
+    class arena_scope {
+    private:
+        arena& a;
+        allocator* previous;
+
+    public:
+        arena_scope();
+        explicit arena_scope(arena& a);
+        ~arena_scope();
+        arena_scope(const arena_scope&) = delete;
+        arena_scope& operator=(const arena_scope&) = delete;
+    };
+
+    // Counts of the storage allocated for matrices since the program started, over all threads
+    struct allocation_stats {
+        long heap_allocations = 0; // Calls to the heap, including for arena chunks
+        long heap_bytes = 0;
+        long arena_allocations = 0; // Pieces handed out by arenas
+        long arena_bytes = 0;
+    };
+
+    allocation_stats allocation_report();
+}
@@ -0,0 +1,93 @@
+#include "buffer.h"
+#include "allocator.h"
+#include <algorithm>
+#include <utility>
+
+
+inline physics::buffer::buffer() : ptr(local), n(0), capacity(inline_capacity), home(current_allocator()), source(nullptr) {}
+inline physics::buffer::buffer(int size, scalar value) : buffer() {
+    assign(size, value);
+}
+inline physics::buffer::buffer(const scalar* first, const scalar* last) : buffer() {
+    allocate(last - first);
+    std::copy(first, last, ptr);
+}
+inline physics::buffer::buffer(const buffer& b) : buffer(b.begin(), b.end()) {}
+// A buffer moved into a new one takes over its storage, wherever it came from
+inline physics::buffer::buffer(buffer&& b) noexcept : buffer() {
+    home = b.is_inline() ? b.home : b.source;
+    *this = std::move(b);
+}
+inline physics::buffer::~buffer() {
+    release();
+}
+
+inline physics::buffer& physics::buffer::operator=(const buffer& b) {
+    if(this == &b) return *this;
+    allocate(b.n);
+    std::copy(b.begin(), b.end(), ptr);
+    return *this;
+}
+inline physics::buffer& physics::buffer::operator=(buffer&& b) noexcept {
+    if(this == &b) return *this;
+
+    // Allocated storage changes owner if it came from this buffer's allocator, otherwise it has to be copied,
+    // e.g. when a result from an arena is kept in a matrix created before the arena_scope
+    if(!b.is_inline() && b.source == home) {
+        release();
+        ptr = b.ptr;
+        source = b.source;
+        n = b.n;
+        capacity = b.capacity;
+        b.ptr = b.local;
+        b.source = nullptr;
+        b.capacity = inline_capacity;
+    }
+    else {
+        allocate(b.n);
+        std::copy(b.begin(), b.end(), ptr);
+    }
+    b.n = 0;
+    return *this;
+}
+
+inline int physics::buffer::size() const { return n; }
+inline bool physics::buffer::is_inline() const { return ptr == local; }
+inline physics::scalar* physics::buffer::data() { return ptr; }
+inline const physics::scalar* physics::buffer::data() const { return ptr; }
+
+inline physics::scalar& physics::buffer::operator[](int i) { return ptr[i]; }
+inline physics::scalar physics::buffer::operator[](int i) const { return ptr[i]; }
+
+inline physics::scalar* physics::buffer::begin() { return ptr; }
+inline physics::scalar* physics::buffer::end() { return ptr + n; }
+inline const physics::scalar* physics::buffer::begin() const { return ptr; }
+inline const physics::scalar* physics::buffer::end() const { return ptr + n; }
+
+inline void physics::buffer::assign(int size, scalar value) {
+    allocate(size);
+    std::fill(ptr, ptr + n, value);
+}
+
+// Makes room for size elements. Existing contents are not preserved.
+inline void physics::buffer::allocate(int size) {
+    if(size > capacity) {
+        release();
+        // The allocator the buffer was created under is only used while it is current, so it is alive and
+        // belongs to this thread
+        allocator* a = current_allocator();
+        if(a != home) a = nullptr;
+        ptr = allocate_storage(a, size);
+        source = a;
+        capacity = size;
+    }
+    n = size;
+}
+
+inline void physics::buffer::release() {
+    if(!is_inline()) deallocate_storage(source, ptr, capacity);
+    source = nullptr;
+    ptr = local;
+    capacity = inline_capacity;
+    n = 0;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "scalar.h"
+#include <cstddef>
+
+
+namespace physics {
+    class allocator;
+
+    // Contiguous array of elements with small buffer optimisation.
+    // Up to inline_capacity elements are stored inside the object itself, so scalars, 3D vectors
+    // and matrices up to 4x4 never touch the heap.
+    // Larger storage comes from the allocator that was current on the thread when the buffer was created,
+    // if it still is when the buffer grows, and from the heap otherwise. It always goes back where it came from.
+    class buffer {
+    public:
+        static const int inline_capacity = 16;
+
+    private:
+        scalar* ptr;
+        int n;
+        int capacity;
+        allocator* home; // Allocator current when the buffer was created. Only compared, it may be gone.
+        allocator* source; // Allocator holding the storage, nullptr for the heap
+        scalar local[inline_capacity];
+
+    public:
+        buffer();
+        explicit buffer(int size, scalar value = 0);
+        buffer(const scalar* first, const scalar* last);
+        buffer(const buffer& b);
+        buffer(buffer&& b) noexcept;
+        ~buffer();
+
+        buffer& operator=(const buffer& b);
+        buffer& operator=(buffer&& b) noexcept;
+
+        int size() const;
+        bool is_inline() const;
+        scalar* data();
+        const scalar* data() const;
+
+        scalar& operator[](int i);
+        scalar operator[](int i) const;
+
+        scalar* begin();
+        scalar* end();
+        const scalar* begin() const;
+        const scalar* end() const;
+
+        // Resizes to the given size, setting every element to value.
+        void assign(int size, scalar value);
+
+    private:
+        void allocate(int size);
+        void release();
+    };
+}
@@ -0,0 +1,413 @@
+#include "decomposition.h"
+#include "gemm.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+
+
+// Width of the panels factorized between the matrix products of the blocked algorithms
+inline constexpr int factorization_block = 64;
+
+// Returns b as a matrix of n rows, turning a vector of length n into a column
+inline physics::matrix as_columns(const physics::matrix& b, int n) {
+    if(b.rows() == n) return b;
+    if(b.is_vector() && b.size() == n) return b.T();
+    throw std::invalid_argument("Incompatible matrices.");
+}
+
+// Returns single columns as row vectors, like matrix products do
+inline physics::matrix as_result(physics::matrix x) {
+    if(x.cols() == 1) {
+        x.n_cols = x.stride = x.n_rows;
+        x.n_rows = 1;
+    }
+    return x;
+}
+
+// Solves rows [begin, end) of L X = B in place, once the rows before them have been subtracted
+inline void solve_lower_block(const physics::matrix& l, physics::matrix& x, int begin, int end, bool unit_diagonal) {
+    long work = (long)(end - begin) * (end - begin) * x.cols() / 2;
+    physics::parallel_for(x.cols(), work, [&](int c0, int c1) {
+        for(int i = begin; i < end; i++) {
+            const physics::scalar* li = l.row(i);
+            physics::scalar* xi = x.row(i);
+            for(int p = begin; p < i; p++) {
+                physics::scalar f = li[p];
+                const physics::scalar* xp = x.row(p);
+                for(int c = c0; c < c1; c++) xi[c] -= f * xp[c];
+            }
+            if(!unit_diagonal) {
+                for(int c = c0; c < c1; c++) xi[c] /= li[i];
+            }
+        }
+    });
+}
+
+// Solves rows [begin, end) of U X = B in place, once the rows after them have been subtracted
+inline void solve_upper_block(const physics::matrix& u, physics::matrix& x, int begin, int end) {
+    long work = (long)(end - begin) * (end - begin) * x.cols() / 2;
+    physics::parallel_for(x.cols(), work, [&](int c0, int c1) {
+        for(int i = end - 1; i >= begin; i--) {
+            const physics::scalar* ui = u.row(i);
+            physics::scalar* xi = x.row(i);
+            for(int p = i + 1; p < end; p++) {
+                physics::scalar f = ui[p];
+                const physics::scalar* xp = x.row(p);
+                for(int c = c0; c < c1; c++) xi[c] -= f * xp[c];
+            }
+            for(int c = c0; c < c1; c++) xi[c] /= ui[i];
+        }
+    });
+}
+
+// Solves L X = B in place. Many right-hand sides are solved in blocks of rows, leaving most of the work to gemm.
+inline void solve_lower_in_place(const physics::matrix& l, physics::matrix& x, bool unit_diagonal) {
+    int n = l.rows();
+    int block = x.cols() < 16 ? n : factorization_block;
+    for(int k0 = 0; k0 < n; k0 += block) {
+        int k1 = std::min(k0 + block, n);
+        solve_lower_block(l, x, k0, k1, unit_diagonal);
+        if(k1 < n) physics::gemm_update(n - k1, x.cols(), k1 - k0, -1, l.row(k1) + k0, l.stride, x.row(k0), x.stride, x.row(k1), x.stride);
+    }
+}
+
+// Solves U X = B in place, from the last block of rows up
+inline void solve_upper_in_place(const physics::matrix& u, physics::matrix& x) {
+    int n = u.rows();
+    int block = x.cols() < 16 ? n : factorization_block;
+    for(int k1 = n; k1 > 0; k1 -= block) {
+        int k0 = std::max(0, k1 - block);
+        solve_upper_block(u, x, k0, k1);
+        if(k0 > 0) physics::gemm_update(k0, x.cols(), k1 - k0, -1, u.row(0) + k0, u.stride, x.row(k0), x.stride, x.row(0), x.stride);
+    }
+}
+
+
+inline physics::lu::lu(matrix a) : factors(std::move(a)), pivots(factors.rows()), sign(1), e(0), u() {
+    if(!factors.is_square()) throw std::invalid_argument("Only square matrices can be factorized.");
+    int n = size();
+    matrix& f = factors;
+    std::iota(pivots.begin(), pivots.end(), 0);
+
+    for(int k0 = 0; k0 < n; k0 += factorization_block) {
+        int k1 = std::min(k0 + factorization_block, n);
+
+        // Factorizes the panel of columns [k0, k1), swapping whole rows
+        for(int j = k0; j < k1; j++) {
+            int p = j;
+            for(int i = j + 1; i < n; i++) {
+                if(std::abs(f(i, j)) > std::abs(f(p, j))) p = i;
+            }
+            if(p != j) {
+                std::swap_ranges(f.row(p), f.row(p) + n, f.row(j));
+                std::swap(pivots[p], pivots[j]);
+                sign = -sign;
+            }
+
+            scalar pivot = f(j, j);
+            if(pivot == 0) continue;
+            const scalar* fj = f.row(j);
+            for(int i = j + 1; i < n; i++) {
+                scalar* fi = f.row(i);
+                scalar l = fi[j] /= pivot;
+                for(int c = j + 1; c < k1; c++) fi[c] -= l * fj[c];
+            }
+        }
+        if(k1 == n) break;
+
+        // Rows of U right of the panel, U12 = L11^-1 A12
+        parallel_for(n - k1, (long)(n - k1) * (k1 - k0) * (k1 - k0) / 2, [&](int begin, int end) {
+            for(int i = k0 + 1; i < k1; i++) {
+                scalar* fi = f.row(i);
+                for(int p = k0; p < i; p++) {
+                    scalar l = fi[p];
+                    const scalar* fp = f.row(p);
+                    for(int c = k1 + begin; c < k1 + end; c++) fi[c] -= l * fp[c];
+                }
+            }
+        });
+
+        // Rest of the matrix, A22 -= L21 U12
+        gemm_update(n - k1, n - k1, k1 - k0, -1, f.row(k1) + k0, f.stride, f.row(k0) + k1, f.stride, f.row(k1) + k1, f.stride);
+    }
+}
+inline physics::lu::lu(const val& a) : lu(a.v) {
+    e = a.e;
+    u = a.u;
+}
+
+inline int physics::lu::size() const { return factors.rows(); }
+
+inline bool physics::lu::is_singular() const {
+    for(int i = 0; i < size(); i++) {
+        if(factors(i, i) == 0) return true;
+    }
+    return false;
+}
+
+inline physics::matrix physics::lu::solve(const matrix& b) const {
+    if(is_singular()) throw std::invalid_argument("Matrix is singular.");
+    matrix columns = as_columns(b, size());
+
+    matrix x = matrix::zeros(size(), columns.cols());
+    for(int i = 0; i < size(); i++) {
+        std::copy(columns.row(pivots[i]), columns.row(pivots[i]) + x.cols(), x.row(i));
+    }
+    solve_lower_in_place(factors, x, true);
+    solve_upper_in_place(factors, x);
+    return as_result(std::move(x));
+}
+inline physics::val physics::lu::solve(const val& b) const {
+    return val(solve(b.v), b.e - e, b.u / u);
+}
+
+inline physics::scalar physics::lu::det() const {
+    scalar out = sign;
+    for(int i = 0; i < size(); i++) out *= factors(i, i);
+    return out;
+}
+
+inline physics::matrix physics::lu::inverse() const {
+    if(is_singular()) throw std::invalid_argument("Matrix is singular.");
+
+    // Solves against the columns of P
+    matrix x = matrix::zeros(size(), size());
+    for(int i = 0; i < size(); i++) x(i, pivots[i]) = 1;
+    solve_lower_in_place(factors, x, true);
+    solve_upper_in_place(factors, x);
+    return x;
+}
+
+
+inline physics::cholesky::cholesky(matrix a) : factors(std::move(a)), e(0), u() {
+    if(!factors.is_square()) throw std::invalid_argument("Only square matrices can be factorized.");
+    int n = size();
+    matrix& l = factors;
+
+    for(int k0 = 0; k0 < n; k0 += factorization_block) {
+        int k1 = std::min(k0 + factorization_block, n);
+
+        // Factorizes the diagonal block
+        for(int j = k0; j < k1; j++) {
+            scalar* lj = l.row(j);
+            scalar d = lj[j];
+            for(int p = k0; p < j; p++) d -= lj[p] * lj[p];
+            if(!(d > 0)) throw std::invalid_argument("Matrix is not positive definite.");
+            lj[j] = std::sqrt(d);
+
+            for(int i = j + 1; i < k1; i++) {
+                scalar* li = l.row(i);
+                scalar s = li[j];
+                for(int p = k0; p < j; p++) s -= li[p] * lj[p];
+                li[j] = s / lj[j];
+            }
+        }
+        if(k1 == n) break;
+
+        // Columns below it, L21 = A21 L11^-T, one row at a time.
+        // Each row is solved against the columns of L11, which are the rows of its transpose.
+        int m = n - k1;
+        matrix diagonal = matrix::zeros(k1 - k0, k1 - k0); // L11^T
+        for(int i = k0; i < k1; i++) {
+            for(int j = k0; j <= i; j++) diagonal(j - k0, i - k0) = l(i, j);
+        }
+        parallel_for(m, (long)m * (k1 - k0) * (k1 - k0) / 2, [&](int begin, int end) {
+            for(int i = k1 + begin; i < k1 + end; i++) {
+                scalar* li = l.row(i) + k0;
+                for(int j = 0; j < k1 - k0; j++) {
+                    const scalar* dj = diagonal.row(j);
+                    scalar x = li[j] /= dj[j];
+                    for(int q = j + 1; q < k1 - k0; q++) li[q] -= x * dj[q];
+                }
+            }
+        });
+
+        // Lower half of the rest of the matrix, A22 -= L21 L21^T, in blocks of rows
+        matrix t = matrix::zeros(k1 - k0, m);
+        for(int i = 0; i < m; i++) {
+            for(int j = k0; j < k1; j++) t(j - k0, i) = l(k1 + i, j);
+        }
+        int blocks = (m + factorization_block - 1) / factorization_block;
+        parallel_for(blocks, (long)m * m * (k1 - k0) / 2, [&](int begin, int end) {
+            for(int r = begin; r < end; r++) {
+                int r0 = r * factorization_block;
+                int r1 = std::min(r0 + factorization_block, m);
+                gemm_update(r1 - r0, r1, k1 - k0, -1, l.row(k1 + r0) + k0, l.stride, t.row(0), t.stride, l.row(k1 + r0) + k1, l.stride);
+            }
+        });
+    }
+
+    // The upper triangle still holds A
+    for(int i = 0; i < n; i++) {
+        std::fill(l.row(i) + i + 1, l.row(i) + n, 0);
+    }
+    transposed = factors.T();
+}
+inline physics::cholesky::cholesky(const val& a) : cholesky(a.v) {
+    e = a.e;
+    u = a.u;
+}
+
+inline int physics::cholesky::size() const { return factors.rows(); }
+
+inline physics::matrix physics::cholesky::solve(const matrix& b) const {
+    matrix x = as_columns(b, size());
+    solve_lower_in_place(factors, x, false);
+    solve_upper_in_place(transposed, x);
+    return as_result(std::move(x));
+}
+inline physics::val physics::cholesky::solve(const val& b) const {
+    return val(solve(b.v), b.e - e, b.u / u);
+}
+
+inline physics::scalar physics::cholesky::det() const {
+    scalar out = 1;
+    for(int i = 0; i < size(); i++) out *= factors(i, i) * factors(i, i);
+    return out;
+}
+
+inline physics::matrix physics::cholesky::inverse() const {
+    matrix x = matrix::identity(size());
+    solve_lower_in_place(factors, x, false);
+    solve_upper_in_place(transposed, x);
+    return x;
+}
+
+
+inline physics::matrix physics::solve_lower(const matrix& l, const matrix& b, bool unit_diagonal) {
+    if(!l.is_square()) throw std::invalid_argument("Only square matrices can be solved against.");
+    matrix x = as_columns(b, l.rows());
+    solve_lower_in_place(l, x, unit_diagonal);
+    return as_result(std::move(x));
+}
+inline physics::matrix physics::solve_upper(const matrix& u, const matrix& b) {
+    if(!u.is_square()) throw std::invalid_argument("Only square matrices can be solved against.");
+    matrix x = as_columns(b, u.rows());
+    solve_upper_in_place(u, x);
+    return as_result(std::move(x));
+}
+
+inline physics::matrix physics::solve(const matrix& a, const matrix& b) { return lu(a).solve(b); }
+inline physics::val physics::solve(const val& a, const val& b) { return lu(a).solve(b); }
+
+inline physics::scalar physics::det(const matrix& a) { return lu(a).det(); }
+inline physics::val physics::det(const val& a) {
+    // Only scalars carry an exponent, so it is never multiplied by more than one row
+    int n = a.v.rows();
+    return val(det(a.v), a.e * n, a.u ^ n);
+}
+
+inline physics::matrix physics::inverse(const matrix& a) { return lu(a).inverse(); }
+inline physics::val physics::inverse(const val& a) { return val(inverse(a.v), -a.e, a.u ^ -1); }
+
+
+// Largest column sum of absolute values
+inline physics::scalar norm_1(const physics::matrix& a) {
+    std::vector<physics::scalar> sums(a.cols());
+    for(int i = 0; i < a.rows(); i++) {
+        const physics::scalar* r = a.row(i);
+        for(int j = 0; j < a.cols(); j++) sums[j] += std::abs(r[j]);
+    }
+    return sums.empty() ? 0 : *std::max_element(sums.begin(), sums.end());
+}
+
+// Coefficients of the [m/m] Pade approximants of exp for m = 3, 5, 7, 9 and 13, and the largest 1-norm
+// for which each is accurate to double precision
+inline constexpr double pade_3[] = {120, 60, 12, 1};
+inline constexpr double pade_5[] = {30240, 15120, 3360, 420, 30, 1};
+inline constexpr double pade_7[] = {17297280, 8648640, 1995840, 277200, 25200, 1512, 56, 1};
+inline constexpr double pade_9[] = {17643225600, 8821612800, 2075673600, 302702400, 30270240, 2162160, 110880, 3960, 90, 1};
+inline constexpr double pade_13[] = {64764752532480000, 32382376266240000, 7771770303897600, 1187353796428800,
+                                     129060195264000, 10559470521600, 670442572800, 33522128640, 1323241920,
+                                     40840800, 960960, 16380, 182, 1};
+inline constexpr double pade_limits[] = {1.495585217958292e-2, 2.539398330063230e-1, 9.504178996162932e-1,
+                                         2.097847961257068e0, 5.371920351148152e0};
+
+inline physics::matrix physics::expm(const matrix& a) {
+    if(!a.is_square()) throw std::invalid_argument("Exponentiation only possible for square matrices");
+    if(a.is_scalar()) return std::exp(a.first());
+    int n = a.rows();
+    matrix id = matrix::identity(n);
+    scalar norm = norm_1(a);
+
+    // exp(A) ~ (V - U)^-1 (V + U), with U and V the odd and even terms of the approximant
+    matrix u, v;
+    if(norm <= pade_limits[3]) {
+        int m = norm <= pade_limits[0] ? 3 : norm <= pade_limits[1] ? 5 : norm <= pade_limits[2] ? 7 : 9;
+        const double* b = m == 3 ? pade_3 : m == 5 ? pade_5 : m == 7 ? pade_7 : pade_9;
+        // Even powers of A
+        matrix a2 = a * a, power = a2;
+        matrix odd = (scalar)b[1] * id + (scalar)b[3] * power;
+        v = (scalar)b[0] * id + (scalar)b[2] * power;
+        for(int j = 4; j <= m; j += 2) {
+            power = power * a2;
+            odd += (scalar)b[j + 1] * power;
+            v += (scalar)b[j] * power;
+        }
+        u = a * odd;
+    }
+    else {
+        // A is scaled by 2^-s into the range of the degree 13 approximant, whose result is squared s times
+        int s = std::max(0, (int)std::ceil(std::log2(norm / pade_limits[4])));
+        matrix scaled = a * (scalar)std::ldexp(1.0, -s);
+        matrix a2 = scaled * scaled, a4 = a2 * a2, a6 = a4 * a2;
+        const double* b = pade_13;
+        matrix high = a6 * matrix((scalar)b[13] * a6 + (scalar)b[11] * a4 + (scalar)b[9] * a2);
+        u = scaled * matrix(high + (scalar)b[7] * a6 + (scalar)b[5] * a4 + (scalar)b[3] * a2 + (scalar)b[1] * id);
+        high = a6 * matrix((scalar)b[12] * a6 + (scalar)b[10] * a4 + (scalar)b[8] * a2);
+        v = high + (scalar)b[6] * a6 + (scalar)b[4] * a4 + (scalar)b[2] * a2 + (scalar)b[0] * id;
+
+        matrix r = solve(v - u, v + u);
+        for(int i = 0; i < s; i++) r = r * r;
+        return r;
+    }
+    return solve(v - u, v + u);
+}
+
+inline physics::val physics::expm(const val& a) {
+    if(a.u != unit()) throw std::invalid_argument("Unit Error");
+    return val(expm(a.e == 0 ? a.v : a.v * power_of_ten(a.e)), 0, unit());
+}
+
+inline physics::matrix physics::sqrtm(const matrix& a) {
+    if(!a.is_square()) throw std::invalid_argument("Exponentiation only possible for square matrices");
+    if(a.is_scalar()) return std::sqrt(a.first());
+    int n = a.rows();
+    matrix id = matrix::identity(n);
+
+    // Product form: X converges to A^1/2 and M to I. Scaling by |det M|^(-1/2n) evens out the
+    // eigenvalues of M, which speeds up the first steps.
+    matrix x = a, m = a;
+    const scalar tolerance = std::sqrt((scalar)n) * std::numeric_limits<scalar>::epsilon();
+    scalar last = std::numeric_limits<scalar>::infinity();
+    bool scaling = true;
+    for(int step = 0; step < 100; step++) {
+        lu f(m);
+        // Later steps only become singular for eigenvalues on the negative real axis
+        if(f.is_singular() && step == 0) throw std::invalid_argument("Matrix is singular.");
+        if(f.is_singular()) break;
+        matrix mi = f.inverse();
+        scalar mu = 1;
+        if(scaling) {
+            scalar log_det = 0;
+            for(int i = 0; i < n; i++) log_det += std::log(std::abs(f.factors(i, i)));
+            mu = std::exp(-log_det / (2 * n));
+        }
+        x = x * matrix(mu / 2 * id + 1 / (2 * mu) * mi);
+        m = matrix((scalar)0.5 * id + mu * mu / 4 * m + 1 / (4 * mu * mu) * mi);
+
+        scalar change = norm_1(m - id);
+        if(!std::isfinite(change)) break;
+        // Past the tolerance, or once rounding stops it improving
+        if(change <= tolerance || (!scaling && change >= last && change < std::sqrt(tolerance))) return x;
+        if(change < (scalar)0.01) scaling = false;
+        last = change;
+    }
+    throw std::invalid_argument("Square root did not converge.");
+}
+
+inline physics::val physics::sqrtm(const val& a) { return a ^ 0.5; }
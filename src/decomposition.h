@@ -0,0 +1,87 @@
+#pragma once
+
+#include "matrix.h"
+#include "unit.h"
+#include "value.h"
+#include <vector>
+
+
+namespace physics {
+    // LU factorization with partial pivoting, P A = L U, of a square matrix.
+    // Columns are factorized in panels and the rest of the matrix is updated with gemm, so large
+    // matrices are factorized cache-blocked and in parallel.
+    // A factorization can be kept to solve for any number of right-hand sides.
+    class lu {
+    public:
+        matrix factors; // L below the diagonal, with an implied diagonal of ones, and U on and above it
+        std::vector<int> pivots; // Row i of P A is row pivots[i] of A
+        int sign; // Determinant of P
+        int8_t e; // Exponent of A
+        unit u; // Unit of A
+
+    public:
+        explicit lu(matrix a);
+        explicit lu(const val& a);
+
+        int size() const;
+        bool is_singular() const;
+
+        // Solves A x = b for a vector b, or A X = B for every column of B.
+        // Vector results are returned as row vectors.
+        matrix solve(const matrix& b) const;
+        val solve(const val& b) const;
+
+        scalar det() const;
+        matrix inverse() const;
+    };
+
+    // Cholesky factorization A = L L^T of a symmetric positive definite matrix.
+    // Only the lower triangle of A is read. Blocked like lu, and about twice as fast.
+    class cholesky {
+    public:
+        matrix factors; // L on and below the diagonal, zeros above it
+        int8_t e; // Exponent of A
+        unit u; // Unit of A
+
+    private:
+        matrix transposed; // L^T, for solving against it row by row
+
+    public:
+        explicit cholesky(matrix a);
+        explicit cholesky(const val& a);
+
+        int size() const;
+
+        // Solves A x = b for a vector b, or A X = B for every column of B.
+        matrix solve(const matrix& b) const;
+        val solve(const val& b) const;
+
+        scalar det() const;
+        matrix inverse() const;
+    };
+
+    // Solves L x = b, or L X = B, where L is lower triangular. unit_diagonal treats its diagonal as ones.
+    matrix solve_lower(const matrix& l, const matrix& b, bool unit_diagonal = false);
+    // Solves U x = b, or U X = B, where U is upper triangular.
+    matrix solve_upper(const matrix& u, const matrix& b);
+
+    // Solves A x = b through an LU factorization. The result has the unit of b divided by that of A.
+    matrix solve(const matrix& a, const matrix& b);
+    val solve(const val& a, const val& b);
+
+    scalar det(const matrix& a);
+    val det(const val& a);
+
+    matrix inverse(const matrix& a);
+    val inverse(const val& a);
+
+    // Matrix exponential, by a Pade approximant with scaling and squaring (Higham, 2005), accurate to double
+    // precision. Values must be dimensionless, e.g. A t for a propagator of dx/dt = A x.
+    matrix expm(const matrix& a);
+    val expm(const val& a);
+
+    // Principal square root, for matrices with no eigenvalues on the closed negative real axis, by the
+    // scaled Denman-Beavers iteration. Values take the square root of their unit, which must exist.
+    matrix sqrtm(const matrix& a);
+    val sqrtm(const val& a);
+}
@@ -0,0 +1,554 @@
+#include "eigen.h"
+#include "gemm.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+
+
+// Width of the panels of the blocked tridiagonal reduction, and number of reflections applied together
+inline constexpr int tridiagonal_block = 32;
+
+// Columns of a row-major matrix updated together by the rotations of a QL sweep, so the rows they
+// touch stay in cache
+inline constexpr int rotation_block = 256;
+
+// Matrices diagonalized together by the batched 3x3 solver
+inline constexpr int eigen3_lanes = 8;
+
+// Smallest number of columns for which the SVD starts from the eigenvectors of A^T A
+inline constexpr int svd_preconditioning = 32;
+
+// Flips the sign of a vector so that its largest element is positive, which makes results repeatable
+inline void normalise_sign(physics::scalar* x, int n, int step) {
+    int largest = 0;
+    for(int i = 1; i < n; i++) {
+        if(std::abs(x[i * step]) > std::abs(x[largest * step])) largest = i;
+    }
+    if(x[largest * step] < 0) {
+        for(int i = 0; i < n; i++) x[i * step] = -x[i * step];
+    }
+}
+
+// Tangent of the Jacobi rotation angle that zeroes an off-diagonal element, given theta = cot(2 angle).
+// Returns the small root, so the rotation is at most 45 degrees. Where theta^2 overflows, the result is 0,
+// which is 1 / (2 theta) to working precision.
+inline physics::scalar jacobi_tangent(physics::scalar theta) {
+    physics::scalar x = std::abs(theta);
+    physics::scalar t = 1 / (x + std::sqrt(x * x + 1));
+    return theta < 0 ? -t : t;
+}
+
+// Position of element (i, j) of a symmetric 3x3 matrix among its six distinct elements, diagonal first
+inline constexpr int symmetric3_index(int i, int j) { return i == j ? i : i + j + 2; }
+
+// Zeroes element (p, q) of a set of symmetric 3x3 matrices by Jacobi rotations, and applies them to the
+// columns of v. The matrices are stored element by element, so the loop over them vectorizes.
+// Inactive matrices get the identity rotation, which leaves them exactly as they were.
+template <int lanes, int p, int q>
+inline void jacobi_rotate(physics::scalar (&a)[6][lanes], physics::scalar (&v)[9][lanes], const bool (&active)[lanes]) {
+    constexpr int r = 3 - p - q;
+    physics::scalar* app = a[p];
+    physics::scalar* aqq = a[q];
+    physics::scalar* apq = a[symmetric3_index(p, q)];
+    physics::scalar* arp = a[symmetric3_index(r, p)];
+    physics::scalar* arq = a[symmetric3_index(r, q)];
+    for(int l = 0; l < lanes; l++) {
+        // theta is infinite or NaN when the element is already 0, and the result is then discarded
+        physics::scalar t = jacobi_tangent((aqq[l] - app[l]) / (2 * apq[l]));
+        t = active[l] && apq[l] != 0 ? t : 0;
+        physics::scalar c = 1 / std::sqrt(t * t + 1);
+        physics::scalar s = t * c;
+        physics::scalar tau = s / (1 + c);
+
+        physics::scalar h = t * apq[l];
+        app[l] -= h;
+        aqq[l] += h;
+        apq[l] = active[l] ? 0 : apq[l];
+
+        physics::scalar g = arp[l];
+        h = arq[l];
+        arp[l] = g - s * (h + g * tau);
+        arq[l] = h + s * (g - h * tau);
+        for(int i = 0; i < 3; i++) {
+            g = v[3 * i + p][l];
+            h = v[3 * i + q][l];
+            v[3 * i + p][l] = g - s * (h + g * tau);
+            v[3 * i + q][l] = h + s * (g - h * tau);
+        }
+    }
+}
+
+// Diagonalizes count <= lanes symmetric 3x3 matrices by cyclic Jacobi sweeps, which converge quadratically,
+// in about four sweeps for doubles. Each matrix stops rotating once its off-diagonal part is negligible.
+template <int lanes>
+inline void symmetric_eigen3_lanes(const physics::mat3* in, physics::eigen3* out, int count) {
+    using physics::scalar;
+    const scalar eps = std::numeric_limits<scalar>::epsilon();
+    scalar a[6][lanes], v[9][lanes];
+    for(int l = 0; l < lanes; l++) {
+        // Unused lanes repeat the first matrix
+        const physics::mat3& m = in[l < count ? l : 0];
+        for(int i = 0; i < 3; i++) {
+            for(int j = 0; j <= i; j++) a[symmetric3_index(i, j)][l] = m(i, j);
+        }
+        for(int i = 0; i < 9; i++) v[i][l] = i % 4 == 0;
+    }
+
+    for(int sweep = 0; sweep < 32; sweep++) {
+        bool active[lanes];
+        bool any = false;
+        for(int l = 0; l < lanes; l++) {
+            scalar off = a[3][l] * a[3][l] + a[4][l] * a[4][l] + a[5][l] * a[5][l];
+            scalar diagonal = a[0][l] * a[0][l] + a[1][l] * a[1][l] + a[2][l] * a[2][l];
+            active[l] = off > eps * eps * diagonal && off != 0;
+            any = any || active[l];
+        }
+        if(!any) break;
+        jacobi_rotate<lanes, 0, 1>(a, v, active);
+        jacobi_rotate<lanes, 0, 2>(a, v, active);
+        jacobi_rotate<lanes, 1, 2>(a, v, active);
+    }
+
+    // Sorts the eigenvalues in ascending order, along with their vectors
+    for(int l = 0; l < count; l++) {
+        int order[3] = {0, 1, 2};
+        if(a[order[1]][l] < a[order[0]][l]) std::swap(order[0], order[1]);
+        if(a[order[2]][l] < a[order[1]][l]) std::swap(order[1], order[2]);
+        if(a[order[1]][l] < a[order[0]][l]) std::swap(order[0], order[1]);
+        for(int j = 0; j < 3; j++) {
+            out[l].values[j] = a[order[j]][l];
+            for(int i = 0; i < 3; i++) out[l].vectors(i, j) = v[3 * i + order[j]][l];
+            normalise_sign(out[l].vectors.data + j, 3, 3);
+        }
+    }
+}
+
+// Reduces the symmetric matrix t to tridiagonal form Q^T t Q with Householder reflections
+// H_k = I - tau[k] v v^T, where v is 1 at k + 1 and is stored in row k of t after it.
+// The diagonal goes to d and the subdiagonal to e.
+// Reflections are found a panel of columns at a time. Within a panel, the rest of the matrix is left as
+// it was and corrected for on the fly, and afterwards it is updated in one rank 2 * block product with gemm.
+inline void tridiagonalize(physics::matrix& t, std::vector<physics::scalar>& d, std::vector<physics::scalar>& e, std::vector<physics::scalar>& tau) {
+    using physics::scalar;
+    int n = t.rows();
+    if(n == 0) return;
+    const int block = tridiagonal_block;
+    // Reflection vectors and the matching columns of W of the panel, indexed by row of t
+    physics::matrix vs = physics::matrix::zeros(n, block), ws = physics::matrix::zeros(n, block);
+    std::vector<scalar> v(n), vw(block), vv(block);
+
+    for(int k0 = 0; k0 + 2 < n; k0 += block) {
+        int nb = std::min(block, n - 2 - k0);
+        for(int jj = 0; jj < nb; jj++) {
+            int i = k0 + jj;
+            scalar* row = t.row(i);
+            // Brings row i up to date with the reflections before it in the panel
+            for(int r = i; r < n; r++) {
+                scalar sum = 0;
+                for(int j = 0; j < jj; j++) sum += vs(r, j) * ws(i, j) + ws(r, j) * vs(i, j);
+                row[r] -= sum;
+            }
+            d[i] = row[i];
+
+            // Reflection taking column i below the diagonal, read from row i by symmetry, onto its first element
+            scalar* x = row + i + 1;
+            int m = n - i - 1;
+            scalar alpha = x[0], sigma = 0;
+            for(int r = 1; r < m; r++) sigma += x[r] * x[r];
+            if(sigma == 0) {
+                tau[i] = 0;
+                e[i] = alpha;
+                for(int r = i + 1; r < n; r++) vs(r, jj) = ws(r, jj) = 0;
+                continue;
+            }
+            scalar norm = std::sqrt(alpha * alpha + sigma);
+            scalar beta = alpha <= 0 ? norm : -norm;
+            tau[i] = (beta - alpha) / beta;
+            e[i] = beta;
+            scalar scale = 1 / (alpha - beta);
+            v[0] = 1;
+            for(int r = 1; r < m; r++) v[r] = x[r] *= scale;
+            for(int r = 0; r < m; r++) vs(i + 1 + r, jj) = v[r];
+
+            // w = tau A v - (tau^2 / 2) (v^T A v) v, with A brought up to date by subtracting V W^T + W V^T
+            // of the earlier reflections of the panel
+            std::fill(vw.begin(), vw.end(), 0);
+            std::fill(vv.begin(), vv.end(), 0);
+            for(int r = 0; r < m; r++) {
+                for(int j = 0; j < jj; j++) {
+                    vw[j] += ws(i + 1 + r, j) * v[r];
+                    vv[j] += vs(i + 1 + r, j) * v[r];
+                }
+            }
+            physics::parallel_for(m, (long)m * m, [&](int begin, int end) {
+                for(int r = begin; r < end; r++) {
+                    const scalar* a = t.row(i + 1 + r) + i + 1;
+                    scalar sum = 0;
+                    for(int c = 0; c < m; c++) sum += a[c] * v[c];
+                    for(int j = 0; j < jj; j++) sum -= vs(i + 1 + r, j) * vw[j] + ws(i + 1 + r, j) * vv[j];
+                    ws(i + 1 + r, jj) = tau[i] * sum;
+                }
+            });
+            scalar product = 0;
+            for(int r = 0; r < m; r++) product += ws(i + 1 + r, jj) * v[r];
+            scalar half = tau[i] * product / 2;
+            for(int r = 0; r < m; r++) ws(i + 1 + r, jj) -= half * v[r];
+        }
+
+        // A = A - V W^T - W V^T after the panel
+        int k1 = k0 + nb, m = n - k1;
+        physics::matrix vt = physics::matrix::zeros(nb, m), wt = physics::matrix::zeros(nb, m);
+        for(int r = 0; r < m; r++) {
+            for(int j = 0; j < nb; j++) {
+                vt(j, r) = vs(k1 + r, j);
+                wt(j, r) = ws(k1 + r, j);
+            }
+        }
+        physics::gemm_update(m, m, nb, -1, vs.row(k1), vs.stride, wt.row(0), wt.stride, t.row(k1) + k1, t.stride);
+        physics::gemm_update(m, m, nb, -1, ws.row(k1), ws.stride, vt.row(0), vt.stride, t.row(k1) + k1, t.stride);
+    }
+    if(n >= 2) {
+        d[n - 2] = t(n - 2, n - 2);
+        e[n - 2] = t(n - 1, n - 2);
+    }
+    d[n - 1] = t(n - 1, n - 1);
+}
+
+// Returns Q^T = H_(n-3) ... H_0 for the reflections left in t by tridiagonalize.
+// Blocks of reflections are applied together as I - V T^T V^T, with two gemm products each.
+inline physics::matrix reflections_transposed(const physics::matrix& t, const std::vector<physics::scalar>& tau) {
+    using physics::scalar;
+    int n = t.rows();
+    physics::matrix q = physics::matrix::identity(n);
+    // Multiplying by H_k on the right only touches rows and columns after k, so going from the last
+    // reflection down keeps the work to the trailing block
+    for(int k1 = n - 2; k1 > 0; k1 -= tridiagonal_block) {
+        int k0 = std::max(0, k1 - tridiagonal_block), nb = k1 - k0;
+        int first = k0 + 1, m = n - first;
+
+        // Reflection vectors as columns, and T, upper triangular, with H_k0 ... H_(k1-1) = I - V T V^T
+        physics::matrix vs = physics::matrix::zeros(m, nb), vt = physics::matrix::zeros(nb, m), tm = physics::matrix::zeros(nb, nb);
+        for(int j = 0; j < nb; j++) {
+            vs(j, j) = vt(j, j) = 1;
+            const scalar* stored = t.row(k0 + j) + k0 + j + 2;
+            for(int r = j + 1; r < m; r++) vs(r, j) = vt(j, r) = stored[r - j - 1];
+        }
+        std::vector<scalar> products(nb);
+        for(int j = 0; j < nb; j++) {
+            scalar tau_j = tau[k0 + j];
+            for(int i = 0; i < j; i++) {
+                products[i] = 0;
+                for(int r = j; r < m; r++) products[i] += vt(i, r) * vt(j, r);
+            }
+            for(int i = 0; i < j; i++) {
+                scalar sum = 0;
+                for(int c = i; c < j; c++) sum += tm(i, c) * products[c];
+                tm(i, j) = -tau_j * sum;
+            }
+            tm(j, j) = tau_j;
+        }
+
+        // Q = Q - (Q V) T^T V^T on the trailing block
+        physics::matrix y = physics::matrix::zeros(m, nb), yt = physics::matrix::zeros(m, nb);
+        physics::gemm(m, nb, m, q.row(first) + first, q.stride, vs.row(0), vs.stride, y.row(0), y.stride);
+        for(int r = 0; r < m; r++) {
+            for(int j = 0; j < nb; j++) {
+                scalar sum = 0;
+                for(int c = j; c < nb; c++) sum += y(r, c) * tm(j, c);
+                yt(r, j) = sum;
+            }
+        }
+        physics::gemm_update(m, m, nb, -1, yt.row(0), yt.stride, vt.row(0), vt.stride, q.row(first) + first, q.stride);
+    }
+    return q;
+}
+
+// Diagonalizes the symmetric tridiagonal matrix with diagonal d and subdiagonal e by the implicit QL
+// algorithm with Wilkinson shifts. The rotations are applied to the rows of zt.
+inline void tridiagonal_ql(std::vector<physics::scalar>& d, std::vector<physics::scalar>& e, physics::matrix& zt) {
+    const physics::scalar eps = std::numeric_limits<physics::scalar>::epsilon();
+    int n = d.size();
+    if(n == 0) return;
+    e[n - 1] = 0;
+    std::vector<physics::scalar> cosines(n), sines(n);
+
+    physics::scalar shift = 0, largest = 0;
+    for(int l = 0; l < n; l++) {
+        // Looks for a negligible subdiagonal element to split the matrix at
+        largest = std::max(largest, std::abs(d[l]) + std::abs(e[l]));
+        int m = l;
+        while(m < n - 1 && std::abs(e[m]) > eps * largest) m++;
+
+        for(int iterations = 0; m > l; iterations++) {
+            if(iterations == 60) throw std::invalid_argument("Eigenvalues did not converge.");
+            physics::scalar g = d[l];
+            physics::scalar p = (d[l + 1] - g) / (2 * e[l]);
+            physics::scalar r = std::hypot(p, (physics::scalar)1);
+            if(p < 0) r = -r;
+            d[l] = e[l] / (p + r);
+            d[l + 1] = e[l] * (p + r);
+            physics::scalar next = d[l + 1];
+            physics::scalar h = g - d[l];
+            for(int i = l + 2; i < n; i++) d[i] -= h;
+            shift += h;
+
+            p = d[m];
+            physics::scalar c = 1, c2 = 1, c3 = 1, s = 0, s2 = 0;
+            physics::scalar e_next = e[l + 1];
+            for(int i = m - 1; i >= l; i--) {
+                c3 = c2;
+                c2 = c;
+                s2 = s;
+                g = c * e[i];
+                h = c * p;
+                r = std::hypot(p, e[i]);
+                e[i + 1] = s * r;
+                s = e[i] / r;
+                c = p / r;
+                p = c * d[i] - s * g;
+                d[i + 1] = h + s * (c * g + s * d[i]);
+                cosines[i] = c;
+                sines[i] = s;
+            }
+            p = -s * s2 * c3 * e_next * e[l] / next;
+            e[l] = s * p;
+            d[l] = c * p;
+
+            // The rotations of the sweep are applied together, a block of columns at a time
+            physics::parallel_for(zt.cols(), 6L * (m - l) * zt.cols(), [&](int begin, int end) {
+                for(int c0 = begin; c0 < end; c0 += rotation_block) {
+                    int c1 = std::min(end, c0 + rotation_block);
+                    for(int i = m - 1; i >= l; i--) {
+                        physics::scalar ci = cosines[i], si = sines[i];
+                        physics::scalar* zi = zt.row(i);
+                        physics::scalar* zn = zt.row(i + 1);
+                        for(int k = c0; k < c1; k++) {
+                            physics::scalar x = zn[k];
+                            zn[k] = si * zi[k] + ci * x;
+                            zi[k] = ci * zi[k] - si * x;
+                        }
+                    }
+                }
+            });
+
+            if(std::abs(e[l]) <= eps * largest) break;
+        }
+        d[l] += shift;
+        e[l] = 0;
+    }
+}
+
+
+inline physics::symmetric_eigen::symmetric_eigen(const matrix& a) : e(0), u() {
+    if(!a.is_square()) throw std::invalid_argument("Only square matrices can be factorized.");
+    int n = a.rows();
+    if(n == 3) {
+        eigen3 result = symmetric_eigen3(mat3(a));
+        values = (matrix)result.values;
+        vectors = (matrix)result.vectors;
+        return;
+    }
+
+    // The upper triangle is filled in from the lower one
+    matrix t = a;
+    for(int i = 0; i < n; i++) {
+        for(int j = i + 1; j < n; j++) t(i, j) = t(j, i);
+    }
+    std::vector<scalar> d(n), e(n), tau(n);
+    tridiagonalize(t, d, e, tau);
+    matrix zt = reflections_transposed(t, tau);
+    tridiagonal_ql(d, e, zt);
+
+    std::vector<int> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](int x, int y) { return d[x] < d[y]; });
+    values = matrix::zeros(1, n);
+    vectors = matrix::zeros(n, n);
+    for(int j = 0; j < n; j++) {
+        values(0, j) = d[order[j]];
+        scalar* z = zt.row(order[j]);
+        normalise_sign(z, n, 1);
+        for(int i = 0; i < n; i++) vectors(i, j) = z[i];
+    }
+}
+
+inline physics::symmetric_eigen::symmetric_eigen(const val& a) : symmetric_eigen(a.v) {
+    e = a.e;
+    u = a.u;
+}
+
+inline int physics::symmetric_eigen::size() const { return vectors.rows(); }
+
+inline physics::val physics::symmetric_eigen::eigenvalues() const { return val(values, e, u); }
+
+
+inline physics::eigen3 physics::symmetric_eigen3(const mat3& a) {
+    eigen3 out;
+    symmetric_eigen3_lanes<1>(&a, &out, 1);
+    return out;
+}
+
+inline std::vector<physics::eigen3> physics::symmetric_eigen3(const std::vector<mat3>& a) {
+    int n = a.size();
+    std::vector<eigen3> out(n);
+    int groups = (n + eigen3_lanes - 1) / eigen3_lanes;
+    parallel_for(groups, 200L * n, [&](int begin, int end) {
+        for(int g = begin; g < end; g++) {
+            int first = g * eigen3_lanes;
+            symmetric_eigen3_lanes<eigen3_lanes>(&a[first], &out[first], std::min(eigen3_lanes, n - first));
+        }
+    });
+    return out;
+}
+
+
+// Makes rows i and j of w orthogonal by a rotation, applied to the same rows of vt.
+// Returns false if they already are to working precision, allowing for the rounding of their dot product.
+inline bool orthogonalize_rows(physics::matrix& w, physics::matrix& vt, int i, int j) {
+    physics::scalar* wi = w.row(i);
+    physics::scalar* wj = w.row(j);
+    physics::scalar alpha = 0, beta = 0, gamma = 0;
+    for(int k = 0; k < w.cols(); k++) {
+        alpha += wi[k] * wi[k];
+        beta += wj[k] * wj[k];
+        gamma += wi[k] * wj[k];
+    }
+    if(gamma == 0 || std::abs(gamma) <= std::sqrt((physics::scalar)w.cols()) * std::numeric_limits<physics::scalar>::epsilon() * std::sqrt(alpha * beta)) return false;
+
+    physics::scalar t = jacobi_tangent((beta - alpha) / (2 * gamma));
+    physics::scalar c = 1 / std::sqrt(t * t + 1);
+    physics::scalar s = t * c;
+    for(int k = 0; k < w.cols(); k++) {
+        physics::scalar x = wi[k], y = wj[k];
+        wi[k] = c * x - s * y;
+        wj[k] = s * x + c * y;
+    }
+    physics::scalar* vi = vt.row(i);
+    physics::scalar* vj = vt.row(j);
+    for(int k = 0; k < vt.cols(); k++) {
+        physics::scalar x = vi[k], y = vj[k];
+        vi[k] = c * x - s * y;
+        vj[k] = s * x + c * y;
+    }
+    return true;
+}
+
+inline physics::svd::svd(const matrix& a) : e(0), u() {
+    // The columns of the tall one of A and A^T are rotated until they are orthogonal. They are kept as the
+    // rows of w, so they are contiguous, and the rotations are accumulated in the rows of vt.
+    bool wide = a.rows() < a.cols();
+    matrix w = wide ? a : a.T();
+    int k = w.rows(), m = w.cols();
+    matrix vt = matrix::identity(k);
+    if(k >= svd_preconditioning) {
+        // Rotating by the eigenvectors of w w^T leaves the rows orthogonal up to rounding, so the sweeps
+        // only have to clean up
+        matrix et = symmetric_eigen(w * w.T()).vectors.T();
+        w = et * w;
+        vt = et;
+    }
+
+    // Round-robin ordering: every round pairs each row with one other, so the pairs of a round are
+    // independent and run in parallel, and every pair meets once per sweep
+    int players = k + k % 2;
+    std::vector<int> ring(players);
+    std::iota(ring.begin(), ring.end(), 0);
+    for(int sweep = 0; sweep < 64; sweep++) {
+        std::atomic<bool> rotated(false);
+        for(int round = 0; round + 1 < players; round++) {
+            parallel_for(players / 2, (long)players * (3 * m + 2 * k), [&](int begin, int end) {
+                for(int p = begin; p < end; p++) {
+                    int i = ring[p], j = ring[players - 1 - p];
+                    if(i >= k || j >= k) continue;
+                    if(orthogonalize_rows(w, vt, std::min(i, j), std::max(i, j))) rotated = true;
+                }
+            });
+            std::rotate(ring.begin() + 1, ring.end() - 1, ring.end());
+        }
+        if(!rotated) break;
+    }
+
+    std::vector<scalar> norms(k);
+    for(int j = 0; j < k; j++) {
+        scalar sum = 0;
+        for(int c = 0; c < m; c++) sum += w(j, c) * w(j, c);
+        norms[j] = std::sqrt(sum);
+    }
+    std::vector<int> order(k);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](int x, int y) { return norms[x] > norms[y]; });
+
+    // Rows of ut are the singular vectors of the tall side. Those of singular values at rounding level
+    // are mostly rounding error, so they are replaced below.
+    values = matrix::zeros(1, k);
+    matrix ut = matrix::zeros(k, m), other = matrix::zeros(k, k);
+    scalar negligible = k == 0 ? 0 : norms[order[0]] * std::max(k, m) * std::numeric_limits<scalar>::epsilon();
+    std::vector<bool> null(k);
+    for(int j = 0; j < k; j++) {
+        scalar norm = norms[order[j]];
+        values(0, j) = norm;
+        null[j] = norm <= negligible;
+        if(!null[j]) {
+            for(int c = 0; c < m; c++) ut(j, c) = w(order[j], c) / norm;
+        }
+        std::copy(vt.row(order[j]), vt.row(order[j]) + k, other.row(j));
+    }
+
+    // Vectors of negligible singular values are completed to an orthonormal set. Each starts from the unit
+    // vector furthest from the rows set so far, whose squared distance is 1 minus its squared
+    // projections on them, so one with at least (m - rows) / m of its length left is always found.
+    auto is_set = [&](int q, int j) { return q != j && (q < j || !null[q]); };
+    for(int j = 0; j < k; j++) {
+        if(!null[j]) continue;
+        int best = 0;
+        scalar best_residual = -1;
+        for(int c = 0; c < m; c++) {
+            scalar residual = 1;
+            for(int q = 0; q < k; q++) {
+                if(is_set(q, j)) residual -= ut(q, c) * ut(q, c);
+            }
+            if(residual > best_residual) {
+                best = c;
+                best_residual = residual;
+            }
+        }
+
+        scalar* u = ut.row(j);
+        std::fill(u, u + m, 0);
+        u[best] = 1;
+        for(int pass = 0; pass < 2; pass++) {
+            for(int q = 0; q < k; q++) {
+                if(!is_set(q, j)) continue;
+                scalar dot = 0;
+                for(int c = 0; c < m; c++) dot += ut(q, c) * u[c];
+                for(int c = 0; c < m; c++) u[c] -= dot * ut(q, c);
+            }
+        }
+        scalar sum = 0;
+        for(int c = 0; c < m; c++) sum += u[c] * u[c];
+        for(int c = 0; c < m; c++) u[c] /= std::sqrt(sum);
+    }
+
+    left = wide ? other.T() : ut.T();
+    right = wide ? ut.T() : other.T();
+}
+
+inline physics::svd::svd(const val& a) : svd(a.v) {
+    e = a.e;
+    u = a.u;
+}
+
+inline physics::val physics::svd::singular_values() const { return val(values, e, u); }
+
+inline int physics::svd::rank() const {
+    if(values.size() == 0) return 0;
+    scalar tolerance = values(0, 0) * std::max(left.rows(), right.rows()) * std::numeric_limits<scalar>::epsilon();
+    int count = 0;
+    for(int j = 0; j < values.size(); j++) count += values(0, j) > tolerance;
+    return count;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "fixed_matrix.h"
+#include "matrix.h"
+#include "unit.h"
+#include "value.h"
+#include <vector>
+
+
+namespace physics {
+    // Eigendecomposition A = V diag(values) V^T of a symmetric matrix. Only the lower triangle of A is read.
+    // 3x3 matrices are diagonalized by Jacobi rotations. Larger ones are reduced to tridiagonal form by
+    // blocked Householder reflections, and the tridiagonal matrix is diagonalized by the implicit QL algorithm.
+    class symmetric_eigen {
+    public:
+        matrix values; // Eigenvalues in ascending order, as a row vector
+        matrix vectors; // Eigenvectors as the columns of an orthogonal matrix, in the order of the values
+        int8_t e; // Exponent of A
+        unit u; // Unit of A
+
+    public:
+        explicit symmetric_eigen(const matrix& a);
+        explicit symmetric_eigen(const val& a);
+
+        int size() const;
+
+        // Eigenvalues with the unit of A
+        val eigenvalues() const;
+    };
+
+    // Eigendecomposition of a symmetric 3x3 matrix, as above, without allocating.
+    struct eigen3 {
+        vec3 values;
+        mat3 vectors;
+    };
+
+    eigen3 symmetric_eigen3(const mat3& a);
+    // Diagonalizes every matrix of a batch, with the same results as one at a time. Matrices are
+    // diagonalized several at once, with each rotation vectorized across them, and split across the thread pool.
+    std::vector<eigen3> symmetric_eigen3(const std::vector<mat3>& a);
+
+    // Thin singular value decomposition A = left diag(values) right^T of an m x n matrix.
+    // With k = min(m, n), left is m x k and right is n x k, both with orthonormal columns.
+    // Computed by one-sided Jacobi rotations, which keeps small singular values accurate. The rotations
+    // of each round touch disjoint pairs of columns and run in parallel. Large matrices start from the
+    // eigenvectors of A^T A, so few sweeps are needed.
+    class svd {
+    public:
+        matrix left; // Left singular vectors as columns
+        matrix values; // Singular values in descending order, as a row vector
+        matrix right; // Right singular vectors as columns
+        int8_t e; // Exponent of A
+        unit u; // Unit of A
+
+    public:
+        explicit svd(const matrix& a);
+        explicit svd(const val& a);
+
+        // Singular values with the unit of A
+        val singular_values() const;
+
+        // Number of singular values above the rounding error of the largest one
+        int rank() const;
+    };
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+#include "matrix.h"
+#include "thread_pool.h"
+#include "value.h"
+#include <algorithm>
+#include <math.h>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+
+namespace physics {
+    // Element-wise arithmetic on matrices and vals builds expressions instead of results.
+    // An expression is evaluated in one pass over the output when it is assigned to a matrix or val,
+    // so a formula like a + b * 2 - c allocates and normalises once rather than at every step.
+    // Expressions refer to their operands, so store them in a matrix or val rather than in auto variables.
+
+    template <typename E>
+    struct is_matrix_expression : std::integral_constant<bool, std::is_same<E, matrix>::value || std::is_base_of<matrix_expression, E>::value> {};
+
+    // Matrices are held by reference, nested expressions by value.
+    template <typename E> struct expression_operand { typedef E type; };
+    template <> struct expression_operand<matrix> { typedef const matrix& type; };
+
+    template <typename L, typename R>
+    struct matrix_sum : matrix_expression {
+        typename expression_operand<L>::type l;
+        typename expression_operand<R>::type r;
+
+        matrix_sum(const L& l, const R& r) : l(l), r(r) {
+            if(l.rows() != r.rows() || l.cols() != r.cols()) throw std::invalid_argument("Incompatible matrices.");
+        }
+        int rows() const { return l.rows(); }
+        int cols() const { return l.cols(); }
+        scalar operator()(int i, int j) const { return l(i, j) + r(i, j); }
+    };
+
+    template <typename L, typename R>
+    struct matrix_difference : matrix_expression {
+        typename expression_operand<L>::type l;
+        typename expression_operand<R>::type r;
+
+        matrix_difference(const L& l, const R& r) : l(l), r(r) {
+            if(l.rows() != r.rows() || l.cols() != r.cols()) throw std::invalid_argument("Incompatible matrices.");
+        }
+        int rows() const { return l.rows(); }
+        int cols() const { return l.cols(); }
+        scalar operator()(int i, int j) const { return l(i, j) - r(i, j); }
+    };
+
+    template <typename E>
+    struct matrix_scaled : matrix_expression {
+        typename expression_operand<E>::type e;
+        scalar x;
+
+        matrix_scaled(const E& e, scalar x) : e(e), x(x) {}
+        int rows() const { return e.rows(); }
+        int cols() const { return e.cols(); }
+        scalar operator()(int i, int j) const { return e(i, j) * x; }
+    };
+
+    // Transpose of a matrix, read in place. Products with it go straight to gemm, and it is only
+    // copied when stored in a matrix, by a blocked transpose.
+    struct matrix_transpose : matrix_expression {
+        const matrix& m;
+
+        explicit matrix_transpose(const matrix& m) : m(m) {}
+        int rows() const { return m.cols(); }
+        int cols() const { return m.rows(); }
+        scalar operator()(int i, int j) const { return m(j, i); }
+
+        // Transpose
+        const matrix& T() const { return m; }
+    };
+
+    // Whether an expression reads elements at other positions than the one it computes, in which case
+    // it can't be evaluated into one of its own operands
+    template <typename E> struct reads_across : std::false_type {};
+    template <> struct reads_across<matrix_transpose> : std::true_type {};
+    template <typename L, typename R> struct reads_across<matrix_sum<L, R>> : std::integral_constant<bool, reads_across<L>::value || reads_across<R>::value> {};
+    template <typename L, typename R> struct reads_across<matrix_difference<L, R>> : std::integral_constant<bool, reads_across<L>::value || reads_across<R>::value> {};
+    template <typename E> struct reads_across<matrix_scaled<E>> : reads_across<E> {};
+
+    // Writes every element of an expression to out, which must have the same size.
+    template <typename E>
+    void evaluate(const E& e, matrix& out) {
+        parallel_for(out.rows(), out.size(), [&](int begin, int end) {
+            for(int i = begin; i < end; i++) {
+                scalar* o = out.row(i);
+                for(int j = 0; j < out.cols(); j++) o[j] = e(i, j);
+            }
+        });
+    }
+
+    // Copies a transpose in square tiles, so both matrices are read and written a cache line at a time.
+    void evaluate(const matrix_transpose& e, matrix& out);
+
+    template <typename L, typename R, typename = typename std::enable_if<is_matrix_expression<L>::value && is_matrix_expression<R>::value>::type>
+    matrix_sum<L, R> operator+(const L& l, const R& r) { return matrix_sum<L, R>(l, r); }
+    template <typename L, typename R, typename = typename std::enable_if<is_matrix_expression<L>::value && is_matrix_expression<R>::value>::type>
+    matrix_difference<L, R> operator-(const L& l, const R& r) { return matrix_difference<L, R>(l, r); }
+    template <typename E, typename = typename std::enable_if<is_matrix_expression<E>::value>::type>
+    matrix_scaled<E> operator*(const E& e, scalar x) { return matrix_scaled<E>(e, x); }
+    template <typename E, typename = typename std::enable_if<is_matrix_expression<E>::value>::type>
+    matrix_scaled<E> operator*(scalar x, const E& e) { return matrix_scaled<E>(e, x); }
+    template <typename E, typename = typename std::enable_if<is_matrix_expression<E>::value>::type>
+    matrix_scaled<E> operator/(const E& e, scalar x) { return matrix_scaled<E>(e, 1/x); }
+
+    // Matrix products need their operands evaluated
+    template <typename L, typename R, typename = typename std::enable_if<is_matrix_expression<L>::value && is_matrix_expression<R>::value &&
+        !(std::is_same<L, matrix>::value && std::is_same<R, matrix>::value)>::type>
+    matrix operator*(const L& l, const R& r) { return matrix(l) * matrix(r); }
+    // except transposes, which gemm reads in place
+    matrix operator*(const matrix_transpose& l, const matrix& r);
+    matrix operator*(const matrix& l, const matrix_transpose& r);
+    matrix operator*(const matrix_transpose& l, const matrix_transpose& r);
+
+    template <typename E, typename = typename std::enable_if<std::is_base_of<matrix_expression, E>::value>::type>
+    std::ostream& operator<<(std::ostream& os, const E& e) { return os << matrix(e); }
+
+
+    // Represents a val whose matrix is an unevaluated expression.
+    // Sums, differences and scaling of vals combine units and exponents as they are built, and the
+    // matrix is computed and normalised once, when the expression is converted to a val.
+    template <typename E>
+    struct val_expr {
+        typename expression_operand<E>::type v; // Value
+        int e; // Exponent
+        unit u; // Unit
+
+        // Conversions
+        operator std::string() const { return (std::string)val(*this); }
+
+        // Operators
+        val operator*(const unit& x) const { return val(*this) * x; }
+        val operator/(const unit& x) const { return val(*this) / x; }
+    };
+
+    template <typename E>
+    val_expr<E> make_val_expr(const E& v, int e, unit u) { return val_expr<E>{v, e, u}; }
+
+    template <typename E> struct is_val_expression : std::false_type {};
+    template <> struct is_val_expression<val> : std::true_type {};
+    template <typename E> struct is_val_expression<val_expr<E>> : std::true_type {};
+
+    template <typename L, typename R, typename = typename std::enable_if<is_val_expression<L>::value && is_val_expression<R>::value>::type>
+    auto operator+(const L& x, const R& y) {
+        if(x.u != y.u) throw std::invalid_argument("Unit Error");
+#ifdef PHYSICS_RAW_SI
+        return make_val_expr(x.v + y.v, 0, x.u);
+#else
+        int exp = std::max<int>(x.e, y.e);
+        return make_val_expr(x.v * pow(10, x.e - exp) + y.v * pow(10, y.e - exp), exp, x.u);
+#endif
+    }
+    template <typename L, typename R, typename = typename std::enable_if<is_val_expression<L>::value && is_val_expression<R>::value>::type>
+    auto operator-(const L& x, const R& y) {
+        if(x.u != y.u) throw std::invalid_argument("Unit Error");
+#ifdef PHYSICS_RAW_SI
+        return make_val_expr(x.v - y.v, 0, x.u);
+#else
+        int exp = std::max<int>(x.e, y.e);
+        return make_val_expr(x.v * pow(10, x.e - exp) - y.v * pow(10, y.e - exp), exp, x.u);
+#endif
+    }
+    template <typename E, typename = typename std::enable_if<is_val_expression<E>::value>::type>
+    auto operator*(const E& x, scalar y) { return make_val_expr(x.v * y, x.e, x.u); }
+    template <typename E, typename = typename std::enable_if<is_val_expression<E>::value>::type>
+    auto operator*(scalar x, const E& y) { return make_val_expr(y.v * x, y.e, y.u); }
+    template <typename E, typename = typename std::enable_if<is_val_expression<E>::value>::type>
+    auto operator/(const E& x, scalar y) { return make_val_expr(x.v / y, x.e, x.u); }
+
+    template <typename E>
+    std::ostream& operator<<(std::ostream& os, const val_expr<E>& x) { return os << val(x); }
+}
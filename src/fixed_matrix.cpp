@@ -0,0 +1,152 @@
+#include "fixed_matrix.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+
+template <int R, int C>
+inline physics::scalar& physics::fixed_matrix<R, C>::operator()(int i, int j) { return data[i * C + j]; }
+template <int R, int C>
+inline physics::scalar physics::fixed_matrix<R, C>::operator()(int i, int j) const { return data[i * C + j]; }
+template <int R, int C>
+inline physics::scalar& physics::fixed_matrix<R, C>::operator[](int i) { return data[i]; }
+template <int R, int C>
+inline physics::scalar physics::fixed_matrix<R, C>::operator[](int i) const { return data[i]; }
+
+
+template <int R, int C>
+inline physics::fixed_matrix<R, C>::fixed_matrix() : data() {}
+
+template <int R, int C>
+inline physics::fixed_matrix<R, C>::fixed_matrix(std::initializer_list<scalar> values) : data() {
+    if((int)values.size() != R * C) throw std::invalid_argument("Incompatible matrices.");
+    std::copy(values.begin(), values.end(), data);
+}
+
+template <int R, int C>
+inline physics::fixed_matrix<R, C>::fixed_matrix(std::initializer_list<std::initializer_list<scalar>> values) : data() {
+    if((int)values.size() != R) throw std::invalid_argument("Incompatible matrices.");
+    int i = 0;
+    for(std::initializer_list<scalar> row : values) {
+        if((int)row.size() != C) throw std::invalid_argument("Incompatible matrices.");
+        std::copy(row.begin(), row.end(), data + i++ * C);
+    }
+}
+
+template <int R, int C>
+inline physics::fixed_matrix<R, C>::fixed_matrix(const matrix& m) {
+    // Vectors may be given in either orientation
+    bool vector = (R == 1 || C == 1) && m.is_vector() && m.size() == R * C;
+    if(!vector && (m.rows() != R || m.cols() != C)) throw std::invalid_argument("Incompatible matrices.");
+
+    for(int i = 0; i < m.rows(); i++) {
+        std::copy(m.row(i), m.row(i) + m.cols(), data + i * m.cols());
+    }
+}
+
+
+template <int R, int C>
+inline physics::fixed_matrix<R, C>::operator matrix() const {
+    matrix out = matrix::zeros(R, C);
+    std::copy(data, data + R * C, out.row(0));
+    return out;
+}
+
+
+template <int R, int C>
+inline physics::fixed_matrix<R, C> physics::fixed_matrix<R, C>::operator+(const fixed_matrix& m) const {
+    fixed_matrix out;
+    for(int i = 0; i < R * C; i++) out.data[i] = data[i] + m.data[i];
+    return out;
+}
+
+template <int R, int C>
+inline physics::fixed_matrix<R, C> physics::fixed_matrix<R, C>::operator-(const fixed_matrix& m) const {
+    fixed_matrix out;
+    for(int i = 0; i < R * C; i++) out.data[i] = data[i] - m.data[i];
+    return out;
+}
+
+template <int R, int C>
+inline physics::fixed_matrix<R, C> physics::fixed_matrix<R, C>::operator*(scalar x) const {
+    fixed_matrix out;
+    for(int i = 0; i < R * C; i++) out.data[i] = data[i] * x;
+    return out;
+}
+
+template <int R, int C>
+inline physics::fixed_matrix<R, C> physics::fixed_matrix<R, C>::operator/(scalar x) const {
+    return *this * (1/x);
+}
+
+
+template <int R, int C>
+inline bool physics::fixed_matrix<R, C>::operator==(const fixed_matrix& m) const {
+    return std::equal(data, data + R * C, m.data);
+}
+
+template <int R, int C>
+inline bool physics::fixed_matrix<R, C>::operator!=(const fixed_matrix& m) const {
+    return !(*this == m);
+}
+
+
+template <int R, int C>
+inline physics::fixed_matrix<C, R> physics::fixed_matrix<R, C>::T() const {
+    fixed_matrix<C, R> out;
+    for(int i = 0; i < R; i++) {
+        for(int j = 0; j < C; j++) {
+            out(j, i) = (*this)(i, j);
+        }
+    }
+    return out;
+}
+
+
+template <int R, int K, int C>
+inline physics::fixed_matrix<R, C> physics::operator*(const fixed_matrix<R, K>& a, const fixed_matrix<K, C>& b) {
+    fixed_matrix<R, C> out;
+    for(int i = 0; i < R; i++) {
+        for(int k = 0; k < K; k++) {
+            for(int j = 0; j < C; j++) {
+                out(i, j) += a(i, k) * b(k, j);
+            }
+        }
+    }
+    return out;
+}
+
+template <int N, typename>
+inline physics::fixed_matrix<1, N> physics::operator*(const fixed_matrix<N, N>& a, const fixed_matrix<1, N>& v) {
+    fixed_matrix<1, N> out;
+    for(int i = 0; i < N; i++) {
+        for(int k = 0; k < N; k++) {
+            out[i] += a(i, k) * v[k];
+        }
+    }
+    return out;
+}
+
+template <int R, int C>
+inline physics::fixed_matrix<R, C> physics::operator*(scalar x, const fixed_matrix<R, C>& m) {
+    return m * x;
+}
+
+
+template <int R, int C>
+inline physics::fixed_matrix<R, C> physics::abs(const fixed_matrix<R, C>& m) {
+    fixed_matrix<R, C> out;
+    for(int i = 0; i < R * C; i++) out[i] = std::abs(m[i]);
+    return out;
+}
+
+template <int R, int C>
+inline physics::fixed_matrix<R, C> physics::cross(const fixed_matrix<R, C>& a, const fixed_matrix<R, C>& b) {
+    static_assert((R == 1 || C == 1) && R * C == 3, "Cross product only possible for 3D vectors");
+
+    fixed_matrix<R, C> out;
+    out[0] = a[1] * b[2] - a[2] * b[1];
+    out[1] = a[2] * b[0] - a[0] * b[2];
+    out[2] = a[0] * b[1] - a[1] * b[0];
+    return out;
+}
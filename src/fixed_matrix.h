@@ -0,0 +1,66 @@
+#pragma once
+
+#include "matrix.h"
+#include <initializer_list>
+#include <type_traits>
+
+
+namespace physics {
+    // Represents a matrix whose size is known at compile time.
+    // Elements are stored inline in row-major order, so no operation allocates, and loops
+    // over the fixed bounds are unrolled by the compiler.
+    template <int R, int C>
+    struct fixed_matrix {
+    public:
+        scalar data[R * C];
+
+        static constexpr int rows() { return R; }
+        static constexpr int cols() { return C; }
+        static constexpr int size() { return R * C; }
+
+        scalar& operator()(int i, int j);
+        scalar operator()(int i, int j) const;
+        scalar& operator[](int i);
+        scalar operator[](int i) const;
+
+    public:
+        fixed_matrix();
+        fixed_matrix(std::initializer_list<scalar> values);
+        fixed_matrix(std::initializer_list<std::initializer_list<scalar>> values);
+        explicit fixed_matrix(const matrix& m);
+
+        // Conversions
+        operator matrix() const;
+
+        // Operators
+        fixed_matrix operator+(const fixed_matrix& m) const;
+        fixed_matrix operator-(const fixed_matrix& m) const;
+        fixed_matrix operator*(scalar x) const;
+        fixed_matrix operator/(scalar x) const;
+
+        bool operator==(const fixed_matrix& m) const;
+        bool operator!=(const fixed_matrix& m) const;
+
+        // Transpose
+        fixed_matrix<C, R> T() const;
+    };
+
+    template <int R, int K, int C>
+    fixed_matrix<R, C> operator*(const fixed_matrix<R, K>& a, const fixed_matrix<K, C>& b);
+    // Vectors are automatically transposed. A 1x1 matrix times a 1x1 matrix is the ordinary product above.
+    template <int N, typename = typename std::enable_if<(N > 1)>::type>
+    fixed_matrix<1, N> operator*(const fixed_matrix<N, N>& a, const fixed_matrix<1, N>& v);
+    template <int R, int C>
+    fixed_matrix<R, C> operator*(scalar x, const fixed_matrix<R, C>& m);
+
+    template <int R, int C>
+    fixed_matrix<R, C> abs(const fixed_matrix<R, C>& m);
+    template <int R, int C>
+    fixed_matrix<R, C> cross(const fixed_matrix<R, C>& a, const fixed_matrix<R, C>& b);
+
+    typedef fixed_matrix<1, 1> mat1;
+    typedef fixed_matrix<1, 3> vec3;
+    typedef fixed_matrix<3, 3> mat3;
+    typedef fixed_matrix<1, 4> vec4;
+    typedef fixed_matrix<4, 4> mat4;
+}
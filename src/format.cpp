@@ -0,0 +1,108 @@
+#include "format.h"
+#include "matrix.h"
+#include "value.h"
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+
+
+// Returns the SI prefix for a decimal exponent, or an empty string if it has none
+inline constexpr std::string_view prefix_name(int e) {
+    switch(e) {
+        case 24: return "Y";
+        case 21: return "Z";
+        case 18: return "E";
+        case 15: return "P";
+        case 12: return "T";
+        case 9: return "G";
+        case 6: return "M";
+        case 3: return "k";
+        case 2: return "h";
+        case 1: return "dc";
+        case -1: return "d";
+        case -2: return "c";
+        case -3: return "m";
+        case -6: return "μ";
+        case -9: return "n";
+        case -12: return "p";
+        case -15: return "f";
+        case -18: return "a";
+        case -21: return "z";
+        case -24: return "y";
+        default: return "";
+    }
+}
+
+// Appends text to out, unless an earlier piece did not fit
+inline void format_text(std::to_chars_result& out, char* last, std::string_view text) {
+    if(out.ec != std::errc()) return;
+    if(last - out.ptr < (long)text.size()) out = {last, std::errc::value_too_large};
+    else out.ptr = std::copy(text.begin(), text.end(), out.ptr);
+}
+
+inline void format_number(std::to_chars_result& out, char* last, physics::scalar x, int precision) {
+    if(out.ec != std::errc()) return;
+    if(precision < 0) out = std::to_chars(out.ptr, last, x);
+    else out = std::to_chars(out.ptr, last, x, std::chars_format::fixed, precision);
+}
+
+inline std::to_chars_result physics::to_chars(char* first, char* last, const matrix& m, int precision) {
+    std::to_chars_result out = {first, std::errc()};
+    if(m.rows() > 1) format_text(out, last, "[");
+    for(int i = 0; i < m.rows(); i++) {
+        if(m.cols() > 1) format_text(out, last, "[ ");
+        const scalar* r = m.row(i);
+        for(int j = 0; j < m.cols(); j++) {
+            format_number(out, last, r[j], precision);
+            format_text(out, last, " ");
+        }
+        if(m.cols() > 1) format_text(out, last, "]");
+    }
+    if(m.rows() > 1) format_text(out, last, "]");
+    return out;
+}
+
+inline std::to_chars_result physics::to_chars(char* first, char* last, const val& v, int precision) {
+#ifdef PHYSICS_RAW_SI
+    // Values are stored in SI units, so the prefix is only worked out here
+    if(v.v.is_scalar() && v.e == 0) {
+        val shown = v;
+        shown.normalise_exponent();
+        if(shown.e != 0) return to_chars(first, last, shown, precision);
+    }
+#endif
+
+    std::to_chars_result out = to_chars(first, last, v.v, precision);
+    bool dimensionless = v.u == unit();
+    if(v.e == 0) {
+        if(!dimensionless) format_text(out, last, " ");
+    }
+    else if(dimensionless || std::abs(v.e) > 24) {
+        format_text(out, last, "e");
+        if(out.ec == std::errc()) out = std::to_chars(out.ptr, last, (int)v.e);
+        format_text(out, last, " ");
+    }
+    else {
+        format_text(out, last, " ");
+        format_text(out, last, prefix_name(v.e));
+    }
+    format_text(out, last, v.u.name());
+    return out;
+}
+
+template <typename T>
+inline std::string_view physics::format(const T& x, int precision) {
+    // Grows until the text fits, and is reused by later calls
+    thread_local std::string buffer(256, '\0');
+    while(true) {
+        std::to_chars_result out = to_chars(buffer.data(), buffer.data() + buffer.size(), x, precision);
+        if(out.ec == std::errc()) return std::string_view(buffer.data(), out.ptr - buffer.data());
+        buffer.resize(buffer.size() * 2);
+    }
+}
+
+template <typename OutputIt, typename T>
+inline OutputIt physics::format_to(OutputIt out, const T& x, int precision) {
+    std::string_view text = format(x, precision);
+    return std::copy(text.begin(), text.end(), out);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "matrix.h"
+#include "value.h"
+#include <charconv>
+#include <string_view>
+
+
+namespace physics {
+    // Digits written after the decimal point by default, the same as std::to_string.
+    inline constexpr int default_precision = 6;
+
+    // Writes the text of a matrix or val to [first, last), like std::to_chars.
+    // precision is the number of digits after the decimal point. A negative precision writes the
+    // shortest text that reads back as the same number. Returns {last, std::errc::value_too_large}
+    // if the text does not fit.
+    std::to_chars_result to_chars(char* first, char* last, const matrix& m, int precision = default_precision);
+    std::to_chars_result to_chars(char* first, char* last, const val& v, int precision = default_precision);
+
+    // Returns the text of a matrix or val, formatted in a buffer owned by the calling thread.
+    // The view is valid until the next call on the same thread. Does not allocate once the buffer
+    // has grown to fit the longest text formatted on the thread.
+    template <typename T>
+    std::string_view format(const T& x, int precision = default_precision);
+
+    // Writes the text of a matrix or val to an output iterator and returns the iterator past the end.
+    template <typename OutputIt, typename T>
+    OutputIt format_to(OutputIt out, const T& x, int precision = default_precision);
+}
@@ -0,0 +1,299 @@
+#include "gemm.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <vector>
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#endif
+
+
+namespace physics {
+    namespace kernel {
+        // Register block (mr x nr) of the micro-kernel, and cache blocks of the packed panels.
+        // An mc x kc panel of a is sized for L2, a kc x nr sliver of b for L1.
+        template <typename T>
+        struct blocking {
+            static constexpr int mr = 4;
+            static constexpr int nr = 4;
+            static constexpr int mc = 64;
+            static constexpr int kc = 128;
+            static constexpr int nc = 1024;
+        };
+
+        // Computes the tile c += a * b from an mr wide panel of a and an nr wide panel of b.
+        template <typename T>
+        inline void micro_kernel(int kc, const T* a, const T* b, T* c, int ldc) {
+            const int mr = blocking<T>::mr;
+            const int nr = blocking<T>::nr;
+
+            T acc[mr][nr] = {};
+            for(int p = 0; p < kc; p++) {
+                for(int i = 0; i < mr; i++) {
+                    for(int j = 0; j < nr; j++) {
+                        acc[i][j] += a[i] * b[j];
+                    }
+                }
+                a += mr;
+                b += nr;
+            }
+
+            for(int i = 0; i < mr; i++) {
+                for(int j = 0; j < nr; j++) {
+                    c[i * ldc + j] += acc[i][j];
+                }
+            }
+        }
+
+        // Same as micro_kernel, keeping the tile in SIMD registers of type V.
+        template <typename V, typename T>
+        inline void simd_micro_kernel(int kc, const T* a, const T* b, T* c, int ldc) {
+            const int mr = blocking<T>::mr;
+            const int nv = blocking<T>::nr / V::width;
+
+            typename V::reg acc[mr][nv];
+            for(int i = 0; i < mr; i++) {
+                for(int v = 0; v < nv; v++) acc[i][v] = V::zero();
+            }
+
+            for(int p = 0; p < kc; p++) {
+                typename V::reg bv[nv];
+                for(int v = 0; v < nv; v++) bv[v] = V::load(b + v * V::width);
+                for(int i = 0; i < mr; i++) {
+                    typename V::reg ai = V::broadcast(a[i]);
+                    for(int v = 0; v < nv; v++) acc[i][v] = V::fma(ai, bv[v], acc[i][v]);
+                }
+                a += mr;
+                b += blocking<T>::nr;
+            }
+
+            for(int i = 0; i < mr; i++) {
+                for(int v = 0; v < nv; v++) {
+                    T* ci = c + i * ldc + v * V::width;
+                    V::store(ci, V::add(V::load(ci), acc[i][v]));
+                }
+            }
+        }
+
+#if defined(__AVX512F__)
+        struct simd_double {
+            typedef __m512d reg;
+            static constexpr int width = 8;
+            static reg zero() { return _mm512_setzero_pd(); }
+            static reg load(const double* p) { return _mm512_loadu_pd(p); }
+            static void store(double* p, reg x) { _mm512_storeu_pd(p, x); }
+            static reg broadcast(double x) { return _mm512_set1_pd(x); }
+            static reg add(reg x, reg y) { return _mm512_add_pd(x, y); }
+            static reg fma(reg x, reg y, reg z) { return _mm512_fmadd_pd(x, y, z); }
+        };
+        struct simd_float {
+            typedef __m512 reg;
+            static constexpr int width = 16;
+            static reg zero() { return _mm512_setzero_ps(); }
+            static reg load(const float* p) { return _mm512_loadu_ps(p); }
+            static void store(float* p, reg x) { _mm512_storeu_ps(p, x); }
+            static reg broadcast(float x) { return _mm512_set1_ps(x); }
+            static reg add(reg x, reg y) { return _mm512_add_ps(x, y); }
+            static reg fma(reg x, reg y, reg z) { return _mm512_fmadd_ps(x, y, z); }
+        };
+
+        template <> struct blocking<double> {
+            static constexpr int mr = 8, nr = 16, mc = 96, kc = 256, nc = 4096;
+        };
+        template <> struct blocking<float> {
+            static constexpr int mr = 8, nr = 32, mc = 96, kc = 384, nc = 4096;
+        };
+#define PHYSICS_GEMM_SIMD
+#elif defined(__AVX2__) && defined(__FMA__)
+        struct simd_double {
+            typedef __m256d reg;
+            static constexpr int width = 4;
+            static reg zero() { return _mm256_setzero_pd(); }
+            static reg load(const double* p) { return _mm256_loadu_pd(p); }
+            static void store(double* p, reg x) { _mm256_storeu_pd(p, x); }
+            static reg broadcast(double x) { return _mm256_set1_pd(x); }
+            static reg add(reg x, reg y) { return _mm256_add_pd(x, y); }
+            static reg fma(reg x, reg y, reg z) { return _mm256_fmadd_pd(x, y, z); }
+        };
+        struct simd_float {
+            typedef __m256 reg;
+            static constexpr int width = 8;
+            static reg zero() { return _mm256_setzero_ps(); }
+            static reg load(const float* p) { return _mm256_loadu_ps(p); }
+            static void store(float* p, reg x) { _mm256_storeu_ps(p, x); }
+            static reg broadcast(float x) { return _mm256_set1_ps(x); }
+            static reg add(reg x, reg y) { return _mm256_add_ps(x, y); }
+            static reg fma(reg x, reg y, reg z) { return _mm256_fmadd_ps(x, y, z); }
+        };
+
+        template <> struct blocking<double> {
+            static constexpr int mr = 6, nr = 8, mc = 72, kc = 256, nc = 4096;
+        };
+        template <> struct blocking<float> {
+            static constexpr int mr = 6, nr = 16, mc = 72, kc = 384, nc = 4096;
+        };
+#define PHYSICS_GEMM_SIMD
+#endif
+
+#ifdef PHYSICS_GEMM_SIMD
+#undef PHYSICS_GEMM_SIMD
+        template <>
+        inline void micro_kernel<double>(int kc, const double* a, const double* b, double* c, int ldc) {
+            simd_micro_kernel<simd_double>(kc, a, b, c, ldc);
+        }
+        template <>
+        inline void micro_kernel<float>(int kc, const float* a, const float* b, float* c, int ldc) {
+            simd_micro_kernel<simd_float>(kc, a, b, c, ldc);
+        }
+#endif
+
+        // Element (i, j) of an operand is at i * row_step + j * col_step, which reads transposes in place
+        struct operand {
+            const scalar* data;
+            int row_step;
+            int col_step;
+
+            operand(const scalar* data, int ld, bool transposed) : data(data), row_step(transposed ? 1 : ld), col_step(transposed ? ld : 1) {}
+            const scalar* at(int i, int j) const { return data + (long)i * row_step + (long)j * col_step; }
+            // The block starting at element (i, j)
+            operand from(int i, int j) const { operand o = *this; o.data = at(i, j); return o; }
+        };
+
+        // Copies an m x k block of alpha * a into panels of mr rows, each stored column by column.
+        // Rows past the end of the block are padded with zeros.
+        inline void pack_a(int m, int k, scalar alpha, operand a, scalar* out) {
+            const int mr = blocking<scalar>::mr;
+            for(int ir = 0; ir < m; ir += mr) {
+                int rows = std::min(mr, m - ir);
+                if(a.row_step == 1) {
+                    // Transposed: the rows of a panel are contiguous
+                    for(int p = 0; p < k; p++) {
+                        const scalar* ap = a.at(ir, p);
+                        for(int i = 0; i < rows; i++) *out++ = alpha * ap[i];
+                        for(int i = rows; i < mr; i++) *out++ = 0;
+                    }
+                    continue;
+                }
+                for(int p = 0; p < k; p++) {
+                    for(int i = 0; i < rows; i++) *out++ = alpha * *a.at(ir + i, p);
+                    for(int i = rows; i < mr; i++) *out++ = 0;
+                }
+            }
+        }
+
+        // Copies a k x n block of b into panels of nr columns, each stored row by row.
+        // Columns past the end of the block are padded with zeros.
+        inline void pack_b(int k, int n, operand b, scalar* out) {
+            const int nr = blocking<scalar>::nr;
+            for(int jr = 0; jr < n; jr += nr) {
+                int cols = std::min(nr, n - jr);
+                if(b.col_step != 1) {
+                    // Transposed: each column is contiguous, so the panel is written a column at a time
+                    for(int j = 0; j < cols; j++) {
+                        const scalar* bj = b.at(0, jr + j);
+                        for(int p = 0; p < k; p++) out[p * nr + j] = bj[p];
+                    }
+                    for(int p = 0; p < k; p++) {
+                        for(int j = cols; j < nr; j++) out[p * nr + j] = 0;
+                    }
+                    out += k * nr;
+                    continue;
+                }
+                for(int p = 0; p < k; p++) {
+                    const scalar* bp = b.at(p, jr);
+                    for(int j = 0; j < cols; j++) *out++ = bp[j];
+                    for(int j = cols; j < nr; j++) *out++ = 0;
+                }
+            }
+        }
+
+        // Accumulates c += alpha * a * b through packed panels.
+        inline void gemm_blocked(int m, int n, int k, scalar alpha, operand a, operand b, scalar* c, int ldc) {
+            typedef blocking<scalar> block;
+
+            // Packed panels are kept per thread between calls
+            thread_local std::vector<scalar> a_pack(block::mc * block::kc);
+            thread_local std::vector<scalar> b_pack(block::kc * block::nc);
+
+            for(int jc = 0; jc < n; jc += block::nc) {
+                int nc = std::min(block::nc, n - jc);
+                for(int pc = 0; pc < k; pc += block::kc) {
+                    int kc = std::min(block::kc, k - pc);
+                    pack_b(kc, nc, b.from(pc, jc), b_pack.data());
+
+                    for(int ic = 0; ic < m; ic += block::mc) {
+                        int mc = std::min(block::mc, m - ic);
+                        pack_a(mc, kc, alpha, a.from(ic, pc), a_pack.data());
+
+                        for(int jr = 0; jr < nc; jr += block::nr) {
+                            for(int ir = 0; ir < mc; ir += block::mr) {
+                                const scalar* ap = a_pack.data() + ir * kc;
+                                const scalar* bp = b_pack.data() + jr * kc;
+                                scalar* ct = c + (ic + ir) * ldc + jc + jr;
+
+                                // Edge tiles are computed into a full tile and copied out
+                                int rows = std::min(block::mr, mc - ir);
+                                int cols = std::min(block::nr, nc - jr);
+                                if(rows == block::mr && cols == block::nr) {
+                                    micro_kernel<scalar>(kc, ap, bp, ct, ldc);
+                                    continue;
+                                }
+
+                                scalar tile[block::mr * block::nr] = {};
+                                micro_kernel<scalar>(kc, ap, bp, tile, block::nr);
+                                for(int i = 0; i < rows; i++) {
+                                    for(int j = 0; j < cols; j++) ct[i * ldc + j] += tile[i * block::nr + j];
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+inline void physics::gemm(int m, int n, int k, const scalar* a, int lda, const scalar* b, int ldb, scalar* c, int ldc,
+                          bool transpose_a, bool transpose_b) {
+    for(int i = 0; i < m; i++) std::fill(c + i * ldc, c + i * ldc + n, 0);
+    gemm_update(m, n, k, 1, a, lda, b, ldb, c, ldc, transpose_a, transpose_b);
+}
+
+inline void physics::gemm_update(int m, int n, int k, scalar alpha, const scalar* a, int lda, const scalar* b, int ldb, scalar* c, int ldc,
+                                 bool transpose_a, bool transpose_b) {
+    typedef kernel::blocking<scalar> block;
+
+    if(m == 0 || n == 0 || k == 0) return;
+    kernel::operand ao(a, lda, transpose_a), bo(b, ldb, transpose_b);
+
+    // Packing does not pay off for small products
+    if((long)m * n * k <= 32 * 32 * 32) {
+        for(int i = 0; i < m; i++) {
+            scalar* ci = c + i * ldc;
+            if(transpose_b) {
+                // Columns of b are contiguous, so each element is a dot product
+                for(int j = 0; j < n; j++) {
+                    const scalar* bj = bo.at(0, j);
+                    scalar sum = 0;
+                    for(int p = 0; p < k; p++) sum += *ao.at(i, p) * bj[p];
+                    ci[j] += alpha * sum;
+                }
+                continue;
+            }
+            for(int p = 0; p < k; p++) {
+                scalar x = alpha * *ao.at(i, p);
+                const scalar* bp = bo.at(p, 0);
+                for(int j = 0; j < n; j++) ci[j] += x * bp[j];
+            }
+        }
+        return;
+    }
+
+    // Threads take whole mc row blocks, so every element is computed the same way on any number of threads
+    int blocks = (m + block::mc - 1) / block::mc;
+    parallel_for(blocks, (long)m * n * k, [&](int begin, int end) {
+        int row = begin * block::mc;
+        int rows = std::min(end * block::mc, m) - row;
+        kernel::gemm_blocked(rows, n, k, alpha, ao.from(row, 0), bo, c + row * ldc, ldc);
+    });
+}
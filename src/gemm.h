@@ -0,0 +1,20 @@
+#pragma once
+
+#include "scalar.h"
+
+
+namespace physics {
+    // Computes c = a * b, where a is m x k, b is k x n and c is m x n.
+    // All arrays are row-major, with lda, ldb and ldc the distances between the starts of their rows.
+    // Large products are cache-blocked into packed panels and computed by a register-blocked micro-kernel,
+    // which uses AVX2 or AVX-512 when scalar is double or float and the compiler targets them.
+    // Products above the parallel threshold are split across the shared thread pool by blocks of rows.
+    // With transpose_a, a is read as the transpose of the k x m array at a, and likewise b with transpose_b.
+    // Transposes cost nothing extra, as they are read while packing.
+    void gemm(int m, int n, int k, const scalar* a, int lda, const scalar* b, int ldb, scalar* c, int ldc,
+              bool transpose_a = false, bool transpose_b = false);
+
+    // Computes c += alpha * a * b, with the same layout as gemm.
+    void gemm_update(int m, int n, int k, scalar alpha, const scalar* a, int lda, const scalar* b, int ldb, scalar* c, int ldc,
+                     bool transpose_a = false, bool transpose_b = false);
+}
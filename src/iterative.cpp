@@ -0,0 +1,484 @@
+#include "iterative.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+
+// Calls f(i) for every element, split across the thread pool for long vectors
+template <typename F>
+inline void for_each_element(int n, F f) {
+    physics::parallel_for(n, n, [&](int begin, int end) {
+        for(int i = begin; i < end; i++) f(i);
+    });
+}
+
+// Sums are taken in blocks of this many elements, and the block sums added in order,
+// so results don't depend on the number of threads.
+inline constexpr int reduction_block = 4096;
+
+// Sum of f(i) over [begin, end), kept in four partial sums so the loop vectorizes
+template <typename F>
+inline physics::scalar block_sum(int begin, int end, F& f) {
+    physics::scalar s[4] = {0, 0, 0, 0};
+    int i = begin;
+    for(; i + 4 <= end; i += 4) {
+        for(int k = 0; k < 4; k++) s[k] += f(i + k);
+    }
+    for(; i < end; i++) s[0] += f(i);
+    return (s[0] + s[1]) + (s[2] + s[3]);
+}
+
+// Calls f(i) for every element like for_each_element, and returns the sum of the results.
+// Updates and the inner products that follow them are done in one pass over memory.
+template <typename F>
+inline physics::scalar sum_each_element(int n, F f) {
+    int blocks = (n + reduction_block - 1) / reduction_block;
+    if(blocks <= 1) return block_sum(0, n, f);
+
+    std::vector<physics::scalar> sums(blocks);
+    physics::parallel_for(blocks, n, [&](int begin, int end) {
+        for(int b = begin; b < end; b++) sums[b] = block_sum(b * reduction_block, std::min(n, (b + 1) * reduction_block), f);
+    });
+    physics::scalar sum = 0;
+    for(physics::scalar s : sums) sum += s;
+    return sum;
+}
+
+inline physics::scalar block_dot(int n, const physics::scalar* x, const physics::scalar* y) {
+    auto f = [&](int i) { return x[i] * y[i]; };
+    return block_sum(0, n, f);
+}
+
+inline physics::scalar vector_dot(const std::vector<physics::scalar>& x, const std::vector<physics::scalar>& y) {
+    return sum_each_element(x.size(), [&](int i) { return x[i] * y[i]; });
+}
+
+inline physics::scalar vector_norm(const std::vector<physics::scalar>& x) {
+    return std::sqrt(vector_dot(x, x));
+}
+
+// Copies a vector of n elements out of a matrix of either shape
+inline std::vector<physics::scalar> as_vector(const physics::matrix& b, int n) {
+    if(!b.is_vector() || b.size() != n) throw std::invalid_argument("Incompatible matrices.");
+    return std::vector<physics::scalar>(b.row(0), b.row(0) + n);
+}
+
+inline physics::matrix as_row(const std::vector<physics::scalar>& x) {
+    physics::matrix out = physics::matrix::zeros(1, x.size());
+    std::copy(x.begin(), x.end(), out.row(0));
+    return out;
+}
+
+// Applies a preconditioner to x, writing the result to y, or returns x itself when there is none
+inline const std::vector<physics::scalar>& precondition(const physics::linear_operator& m, const std::vector<physics::scalar>& x, std::vector<physics::scalar>& y) {
+    if(m.empty()) return x;
+    m.apply(x.data(), y.data());
+    return y;
+}
+
+inline void check_operators(const physics::linear_operator& a, const physics::linear_operator& m) {
+    if(a.empty()) throw std::invalid_argument("Incompatible matrices.");
+    if(!m.empty() && m.size() != a.size()) throw std::invalid_argument("Incompatible matrices.");
+}
+
+// Positions of the diagonal entries of a square sparse matrix, which must all be stored
+inline std::vector<int> diagonal_positions(const physics::sparse_matrix& a) {
+    if(a.rows() != a.cols()) throw std::invalid_argument("Only square matrices can be factorized.");
+    std::vector<int> diagonal(a.rows());
+    for(int i = 0; i < a.rows(); i++) {
+        auto first = a.columns.begin() + a.row_starts[i];
+        auto last = a.columns.begin() + a.row_starts[i + 1];
+        auto p = std::lower_bound(first, last, i);
+        if(p == last || *p != i || a.values[p - a.columns.begin()] == 0) throw std::invalid_argument("Matrix is singular.");
+        diagonal[i] = p - a.columns.begin();
+    }
+    return diagonal;
+}
+
+
+inline physics::linear_operator::linear_operator() {}
+
+inline physics::linear_operator::linear_operator(const matrix& a) : n(a.rows()) {
+    if(!a.is_square()) throw std::invalid_argument("Only square matrices can be solved against.");
+    apply = [&a](const scalar* x, scalar* y) {
+        parallel_for(a.rows(), (long)a.rows() * a.cols(), [&](int begin, int end) {
+            for(int i = begin; i < end; i++) y[i] = block_dot(a.cols(), a.row(i), x);
+        });
+    };
+}
+
+inline physics::linear_operator::linear_operator(const sparse_matrix& a) : n(a.rows()) {
+    if(a.rows() != a.cols()) throw std::invalid_argument("Only square matrices can be solved against.");
+    apply = [&a](const scalar* x, scalar* y) {
+        parallel_for(a.rows(), a.non_zeros(), [&](int begin, int end) {
+            for(int i = begin; i < end; i++) {
+                scalar sum = 0;
+                for(int p = a.row_starts[i]; p < a.row_starts[i + 1]; p++) sum += a.values[p] * x[a.columns[p]];
+                y[i] = sum;
+            }
+        });
+    };
+}
+
+inline physics::linear_operator::linear_operator(int n, std::function<void(const scalar*, scalar*)> f) : n(n), apply(std::move(f)) {}
+
+inline physics::linear_operator::linear_operator(int n, std::function<matrix(const matrix&)> f) : n(n) {
+    apply = [n, f = std::move(f)](const scalar* x, scalar* y) {
+        matrix in = matrix::zeros(1, n);
+        std::copy(x, x + n, in.row(0));
+        std::vector<scalar> out = as_vector(f(in), n);
+        std::copy(out.begin(), out.end(), y);
+    };
+}
+
+inline int physics::linear_operator::size() const { return n; }
+inline bool physics::linear_operator::empty() const { return !apply; }
+
+inline physics::matrix physics::linear_operator::operator()(const matrix& x) const {
+    std::vector<scalar> in = as_vector(x, n), out(n);
+    apply(in.data(), out.data());
+    return as_row(out);
+}
+
+
+inline physics::linear_operator physics::jacobi(const matrix& a) {
+    if(!a.is_square()) throw std::invalid_argument("Only square matrices can be factorized.");
+    auto inverse_diagonal = std::make_shared<std::vector<scalar>>(a.rows());
+    for(int i = 0; i < a.rows(); i++) {
+        if(a(i, i) == 0) throw std::invalid_argument("Matrix is singular.");
+        (*inverse_diagonal)[i] = 1 / a(i, i);
+    }
+    return linear_operator(a.rows(), [inverse_diagonal](const scalar* x, scalar* y) {
+        const std::vector<scalar>& d = *inverse_diagonal;
+        for_each_element(d.size(), [&](int i) { y[i] = d[i] * x[i]; });
+    });
+}
+
+inline physics::linear_operator physics::jacobi(const sparse_matrix& a) {
+    std::vector<int> diagonal = diagonal_positions(a);
+    auto inverse_diagonal = std::make_shared<std::vector<scalar>>(a.rows());
+    for(int i = 0; i < a.rows(); i++) (*inverse_diagonal)[i] = 1 / a.values[diagonal[i]];
+    return linear_operator(a.rows(), [inverse_diagonal](const scalar* x, scalar* y) {
+        const std::vector<scalar>& d = *inverse_diagonal;
+        for_each_element(d.size(), [&](int i) { y[i] = d[i] * x[i]; });
+    });
+}
+
+inline physics::linear_operator physics::ssor(const sparse_matrix& a, scalar omega) {
+    if(omega <= 0 || omega >= 2) throw std::invalid_argument("Relaxation factor must be between 0 and 2.");
+    auto diagonal = std::make_shared<std::vector<int>>(diagonal_positions(a));
+    auto m = std::make_shared<sparse_matrix>(a);
+    // Divisions are replaced by products, which are shorter on the dependency chain of a triangular solve
+    auto inverse_diagonal = std::make_shared<std::vector<scalar>>(a.rows());
+    for(int i = 0; i < a.rows(); i++) (*inverse_diagonal)[i] = 1 / a.values[(*diagonal)[i]];
+
+    // M = (D + omega L) D^-1 (D + omega U) / (omega (2 - omega))
+    return linear_operator(a.rows(), [m, diagonal, inverse_diagonal, omega](const scalar* x, scalar* y) {
+        const sparse_matrix& a = *m;
+        const std::vector<int>& d = *diagonal;
+        const std::vector<scalar>& inverse = *inverse_diagonal;
+        int n = a.rows();
+        for(int i = 0; i < n; i++) {
+            scalar sum = 0;
+            for(int p = a.row_starts[i]; p < d[i]; p++) sum += a.values[p] * y[a.columns[p]];
+            y[i] = (x[i] - omega * sum) * inverse[i];
+        }
+        for(int i = n - 1; i >= 0; i--) {
+            scalar sum = 0;
+            for(int p = d[i] + 1; p < a.row_starts[i + 1]; p++) sum += a.values[p] * y[a.columns[p]];
+            y[i] -= omega * sum * inverse[i];
+        }
+        for_each_element(n, [&](int i) { y[i] *= omega * (2 - omega); });
+    });
+}
+
+inline physics::linear_operator physics::incomplete_cholesky(const sparse_matrix& a) {
+    if(a.rows() != a.cols()) throw std::invalid_argument("Only square matrices can be factorized.");
+    int n = a.rows();
+
+    // L in CSR form, with the diagonal last in each row
+    auto factor = std::make_shared<sparse_matrix>(n, n);
+    sparse_matrix& l = *factor;
+    for(int i = 0; i < n; i++) {
+        for(int p = a.row_starts[i]; p < a.row_starts[i + 1] && a.columns[p] <= i; p++) {
+            l.columns.push_back(a.columns[p]);
+            l.values.push_back(a.values[p]);
+        }
+        if(l.columns.empty() || l.columns.back() != i) throw std::invalid_argument("Matrix is not positive definite.");
+        l.row_starts[i + 1] = l.columns.size();
+    }
+
+    for(int i = 0; i < n; i++) {
+        for(int p = l.row_starts[i]; p < l.row_starts[i + 1]; p++) {
+            int j = l.columns[p];
+            // Subtracts the product of the rows of i and j left of column j, where both are stored
+            scalar sum = l.values[p];
+            int q = l.row_starts[i], r = l.row_starts[j], r_end = l.row_starts[j + 1] - 1;
+            while(q < p && r < r_end) {
+                if(l.columns[q] < l.columns[r]) q++;
+                else if(l.columns[q] > l.columns[r]) r++;
+                else sum -= l.values[q++] * l.values[r++];
+            }
+            if(j < i) l.values[p] = sum / l.values[r_end];
+            else if(sum <= 0) throw std::invalid_argument("Matrix is not positive definite.");
+            else l.values[p] = std::sqrt(sum);
+        }
+    }
+
+    // L^T is kept in CSR form too, so both solves read rows, and the diagonal is kept inverted
+    auto transposed = std::make_shared<sparse_matrix>(l.T());
+    auto inverse_diagonal = std::make_shared<std::vector<scalar>>(n);
+    for(int i = 0; i < n; i++) (*inverse_diagonal)[i] = 1 / l.values[l.row_starts[i + 1] - 1];
+
+    return linear_operator(n, [factor, transposed, inverse_diagonal](const scalar* x, scalar* y) {
+        const sparse_matrix& l = *factor;
+        const sparse_matrix& lt = *transposed;
+        const std::vector<scalar>& inverse = *inverse_diagonal;
+        int n = l.rows();
+        for(int i = 0; i < n; i++) {
+            scalar sum = 0;
+            for(int p = l.row_starts[i]; p < l.row_starts[i + 1] - 1; p++) sum += l.values[p] * y[l.columns[p]];
+            y[i] = (x[i] - sum) * inverse[i];
+        }
+        for(int i = n - 1; i >= 0; i--) {
+            scalar sum = 0;
+            for(int p = lt.row_starts[i] + 1; p < lt.row_starts[i + 1]; p++) sum += lt.values[p] * y[lt.columns[p]];
+            y[i] = (y[i] - sum) * inverse[i];
+        }
+    });
+}
+
+inline physics::linear_operator physics::ilu0(const sparse_matrix& a) {
+    auto diagonal = std::make_shared<std::vector<int>>(diagonal_positions(a));
+    auto factors = std::make_shared<sparse_matrix>(a);
+    sparse_matrix& lu = *factors;
+    const std::vector<int>& d = *diagonal;
+    int n = a.rows();
+
+    // Row i is eliminated by the rows above it, keeping only updates to entries it already stores
+    std::vector<int> position(n, -1);
+    for(int i = 0; i < n; i++) {
+        for(int p = lu.row_starts[i]; p < lu.row_starts[i + 1]; p++) position[lu.columns[p]] = p;
+        for(int p = lu.row_starts[i]; p < d[i]; p++) {
+            int k = lu.columns[p];
+            scalar factor = lu.values[p] /= lu.values[d[k]];
+            for(int q = d[k] + 1; q < lu.row_starts[k + 1]; q++) {
+                int target = position[lu.columns[q]];
+                if(target >= 0) lu.values[target] -= factor * lu.values[q];
+            }
+        }
+        if(lu.values[d[i]] == 0) throw std::invalid_argument("Matrix is singular.");
+        for(int p = lu.row_starts[i]; p < lu.row_starts[i + 1]; p++) position[lu.columns[p]] = -1;
+    }
+    // The diagonal of U is kept inverted
+    for(int i = 0; i < n; i++) lu.values[d[i]] = 1 / lu.values[d[i]];
+
+    return linear_operator(n, [factors, diagonal](const scalar* x, scalar* y) {
+        const sparse_matrix& lu = *factors;
+        const std::vector<int>& d = *diagonal;
+        int n = lu.rows();
+        for(int i = 0; i < n; i++) {
+            scalar sum = 0;
+            for(int p = lu.row_starts[i]; p < d[i]; p++) sum += lu.values[p] * y[lu.columns[p]];
+            y[i] = x[i] - sum;
+        }
+        for(int i = n - 1; i >= 0; i--) {
+            scalar sum = 0;
+            for(int p = d[i] + 1; p < lu.row_starts[i + 1]; p++) sum += lu.values[p] * y[lu.columns[p]];
+            y[i] = (y[i] - sum) * lu.values[d[i]];
+        }
+    });
+}
+
+
+inline physics::krylov_result physics::cg(const linear_operator& a, const matrix& b, scalar tolerance, const linear_operator& preconditioner, int max_iterations) {
+    check_operators(a, preconditioner);
+    int n = a.size();
+    if(max_iterations <= 0) max_iterations = n;
+    std::vector<scalar> r = as_vector(b, n), x(n, 0), z(n), p(n), q(n);
+
+    krylov_result result;
+    scalar rr = vector_dot(r, r);
+    result.residual = std::sqrt(rr);
+    p = precondition(preconditioner, r, z);
+    scalar rz = preconditioner.empty() ? rr : vector_dot(r, z);
+    while(result.residual > tolerance && result.iterations < max_iterations) {
+        a.apply(p.data(), q.data());
+        scalar alpha = rz / vector_dot(p, q);
+        rr = sum_each_element(n, [&](int i) {
+            x[i] += alpha * p[i];
+            r[i] -= alpha * q[i];
+            return r[i] * r[i];
+        });
+        result.iterations++;
+        result.residual = std::sqrt(rr);
+        if(result.residual <= tolerance) break;
+
+        const std::vector<scalar>& m_r = precondition(preconditioner, r, z);
+        scalar rz_next = preconditioner.empty() ? rr : vector_dot(r, m_r);
+        scalar beta = rz_next / rz;
+        rz = rz_next;
+        for_each_element(n, [&](int i) { p[i] = m_r[i] + beta * p[i]; });
+    }
+
+    result.converged = result.residual <= tolerance;
+    result.x = as_row(x);
+    return result;
+}
+
+inline physics::krylov_result physics::bicgstab(const linear_operator& a, const matrix& b, scalar tolerance, const linear_operator& preconditioner, int max_iterations) {
+    check_operators(a, preconditioner);
+    int n = a.size();
+    if(max_iterations <= 0) max_iterations = n;
+    std::vector<scalar> r = as_vector(b, n), x(n, 0), p(n, 0), v(n, 0), p_work(n), s_work(n), t(n);
+    const std::vector<scalar> r0 = r;
+    scalar rho = 1, alpha = 1, omega = 1;
+
+    krylov_result result;
+    result.residual = vector_norm(r);
+    while(result.residual > tolerance && result.iterations < max_iterations) {
+        scalar rho_next = vector_dot(r0, r);
+        if(rho_next == 0) break;
+        scalar beta = (rho_next / rho) * (alpha / omega);
+        rho = rho_next;
+        for_each_element(n, [&](int i) { p[i] = r[i] + beta * (p[i] - omega * v[i]); });
+
+        const std::vector<scalar>& p_hat = precondition(preconditioner, p, p_work);
+        a.apply(p_hat.data(), v.data());
+        alpha = rho / vector_dot(r0, v);
+        result.iterations++;
+        result.residual = std::sqrt(sum_each_element(n, [&](int i) {
+            r[i] -= alpha * v[i];
+            return r[i] * r[i];
+        }));
+        if(result.residual <= tolerance) {
+            for_each_element(n, [&](int i) { x[i] += alpha * p_hat[i]; });
+            break;
+        }
+
+        const std::vector<scalar>& s_hat = precondition(preconditioner, r, s_work);
+        a.apply(s_hat.data(), t.data());
+        omega = vector_dot(t, r) / vector_dot(t, t);
+        result.residual = std::sqrt(sum_each_element(n, [&](int i) {
+            x[i] += alpha * p_hat[i] + omega * s_hat[i];
+            r[i] -= omega * t[i];
+            return r[i] * r[i];
+        }));
+        if(omega == 0) break;
+    }
+
+    result.converged = result.residual <= tolerance;
+    result.x = as_row(x);
+    return result;
+}
+
+inline physics::krylov_result physics::gmres(const linear_operator& a, const matrix& b, scalar tolerance, const linear_operator& preconditioner, int restart, int max_iterations) {
+    check_operators(a, preconditioner);
+    int n = a.size();
+    if(max_iterations <= 0) max_iterations = n;
+    restart = std::max(1, std::min(restart, n));
+    const std::vector<scalar> rhs = as_vector(b, n);
+    std::vector<scalar> x(n, 0), r = rhs, z(n), w(n);
+
+    // Orthonormal basis of the Krylov space, and the Hessenberg matrix reduced to triangular by Givens rotations
+    std::vector<std::vector<scalar>> basis(restart + 1, std::vector<scalar>(n));
+    std::vector<std::vector<scalar>> h(restart + 1, std::vector<scalar>(restart));
+    std::vector<scalar> cosines(restart), sines(restart), g(restart + 1);
+
+    krylov_result result;
+    result.residual = vector_norm(r);
+    while(result.residual > tolerance && result.iterations < max_iterations) {
+        scalar beta = result.residual;
+        for_each_element(n, [&](int i) { basis[0][i] = r[i] / beta; });
+        std::fill(g.begin(), g.end(), 0);
+        g[0] = beta;
+
+        int k = 0;
+        while(k < restart && result.iterations < max_iterations) {
+            a.apply(precondition(preconditioner, basis[k], z).data(), w.data());
+            for(int j = 0; j <= k; j++) {
+                h[j][k] = vector_dot(w, basis[j]);
+                for_each_element(n, [&](int i) { w[i] -= h[j][k] * basis[j][i]; });
+            }
+            scalar norm = vector_norm(w);
+            if(norm != 0) for_each_element(n, [&](int i) { basis[k + 1][i] = w[i] / norm; });
+
+            for(int j = 0; j < k; j++) {
+                scalar upper = h[j][k];
+                h[j][k] = cosines[j] * upper + sines[j] * h[j + 1][k];
+                h[j + 1][k] = -sines[j] * upper + cosines[j] * h[j + 1][k];
+            }
+            scalar radius = std::hypot(h[k][k], norm);
+            cosines[k] = h[k][k] / radius;
+            sines[k] = norm / radius;
+            h[k][k] = radius;
+            g[k + 1] = -sines[k] * g[k];
+            g[k] *= cosines[k];
+
+            k++;
+            result.iterations++;
+            result.residual = std::abs(g[k]);
+            if(result.residual <= tolerance || norm == 0) break;
+        }
+
+        // x += M V y, where H y = g
+        std::vector<scalar> y(k);
+        for(int j = k - 1; j >= 0; j--) {
+            scalar sum = g[j];
+            for(int c = j + 1; c < k; c++) sum -= h[j][c] * y[c];
+            y[j] = sum / h[j][j];
+        }
+        std::fill(w.begin(), w.end(), 0);
+        for(int j = 0; j < k; j++) for_each_element(n, [&](int i) { w[i] += y[j] * basis[j][i]; });
+        const std::vector<scalar>& correction = precondition(preconditioner, w, z);
+        for_each_element(n, [&](int i) { x[i] += correction[i]; });
+
+        // Restarts from the true residual
+        if(result.residual > tolerance && result.iterations < max_iterations) {
+            a.apply(x.data(), r.data());
+            for_each_element(n, [&](int i) { r[i] = rhs[i] - r[i]; });
+            result.residual = vector_norm(r);
+        }
+    }
+
+    result.converged = result.residual <= tolerance;
+    result.x = as_row(x);
+    return result;
+}
+
+
+// Tolerance on the numbers in b.v
+inline physics::scalar scaled_tolerance(const physics::val& b, const physics::val& tolerance) {
+    if(tolerance.u != b.u) throw std::invalid_argument("Unit Error");
+    return std::abs(tolerance.v.first()) * physics::power_of_ten(tolerance.e - b.e);
+}
+
+inline physics::val solution(const physics::krylov_result& result, const physics::val& b, int e, const physics::unit& u) {
+    if(!result.converged) throw std::invalid_argument("Solver did not converge.");
+    return physics::val(result.x, b.e - e, b.u / u);
+}
+
+inline physics::val physics::cg(const val& a, const val& b, const val& tolerance, const linear_operator& preconditioner, int max_iterations) {
+    return solution(cg(linear_operator(a.v), b.v, scaled_tolerance(b, tolerance), preconditioner, max_iterations), b, a.e, a.u);
+}
+inline physics::val physics::cg(const sparse_val& a, const val& b, const val& tolerance, const linear_operator& preconditioner, int max_iterations) {
+    return solution(cg(linear_operator(a.v), b.v, scaled_tolerance(b, tolerance), preconditioner, max_iterations), b, 0, a.u);
+}
+
+inline physics::val physics::bicgstab(const val& a, const val& b, const val& tolerance, const linear_operator& preconditioner, int max_iterations) {
+    return solution(bicgstab(linear_operator(a.v), b.v, scaled_tolerance(b, tolerance), preconditioner, max_iterations), b, a.e, a.u);
+}
+inline physics::val physics::bicgstab(const sparse_val& a, const val& b, const val& tolerance, const linear_operator& preconditioner, int max_iterations) {
+    return solution(bicgstab(linear_operator(a.v), b.v, scaled_tolerance(b, tolerance), preconditioner, max_iterations), b, 0, a.u);
+}
+
+inline physics::val physics::gmres(const val& a, const val& b, const val& tolerance, const linear_operator& preconditioner, int restart, int max_iterations) {
+    return solution(gmres(linear_operator(a.v), b.v, scaled_tolerance(b, tolerance), preconditioner, restart, max_iterations), b, a.e, a.u);
+}
+inline physics::val physics::gmres(const sparse_val& a, const val& b, const val& tolerance, const linear_operator& preconditioner, int restart, int max_iterations) {
+    return solution(gmres(linear_operator(a.v), b.v, scaled_tolerance(b, tolerance), preconditioner, restart, max_iterations), b, 0, a.u);
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "matrix.h"
+#include "sparse.h"
+#include "unit.h"
+#include "value.h"
+#include <functional>
+
+
+namespace physics {
+    // A linear map y = A x on vectors of n elements, for the iterative solvers.
+    // Operators made from a matrix or sparse_matrix refer to it, so it must outlive the operator.
+    class linear_operator {
+    public:
+        int n = 0;
+        std::function<void(const scalar*, scalar*)> apply; // Writes A x to y, both n elements long
+
+    public:
+        linear_operator();
+        linear_operator(const matrix& a);
+        linear_operator(const sparse_matrix& a);
+        linear_operator(int n, std::function<void(const scalar*, scalar*)> f);
+        // Wraps a function taking and returning vectors as matrices.
+        linear_operator(int n, std::function<matrix(const matrix&)> f);
+
+        int size() const;
+        bool empty() const;
+
+        // Returns A x as a row vector
+        matrix operator()(const matrix& x) const;
+    };
+
+    // Preconditioners, which approximate A^-1. They keep their own copy of what they need from A.
+    // Jacobi scales by the inverse of the diagonal.
+    linear_operator jacobi(const matrix& a);
+    linear_operator jacobi(const sparse_matrix& a);
+    // Symmetric successive over-relaxation, with 0 < omega < 2. Suits symmetric matrices.
+    linear_operator ssor(const sparse_matrix& a, scalar omega = 1);
+    // Cholesky factorization keeping only the pattern of the lower triangle of A, for symmetric positive definite A.
+    linear_operator incomplete_cholesky(const sparse_matrix& a);
+    // LU factorization keeping only the pattern of A.
+    linear_operator ilu0(const sparse_matrix& a);
+
+    // Outcome of an iterative solve
+    struct krylov_result {
+        matrix x; // Solution, as a row vector
+        int iterations = 0;
+        scalar residual = 0; // Norm of b - A x
+        bool converged = false; // Whether residual reached the tolerance
+    };
+
+    // Krylov solvers for A x = b, starting from x = 0. They stop when the norm of the residual b - A x
+    // is at most tolerance, or after max_iterations (0 for the size of the system).
+    // Preconditioners are applied on the right, so the residual is that of the original system.
+    // Conjugate gradients, for symmetric positive definite A.
+    krylov_result cg(const linear_operator& a, const matrix& b, scalar tolerance,
+                     const linear_operator& preconditioner = linear_operator(), int max_iterations = 0);
+    // BiCGSTAB, for general A.
+    krylov_result bicgstab(const linear_operator& a, const matrix& b, scalar tolerance,
+                           const linear_operator& preconditioner = linear_operator(), int max_iterations = 0);
+    // GMRES, restarted every restart iterations, for general A.
+    krylov_result gmres(const linear_operator& a, const matrix& b, scalar tolerance,
+                        const linear_operator& preconditioner = linear_operator(), int restart = 30, int max_iterations = 0);
+
+    // The same for values. The tolerance has the unit of b, and the result that of b divided by that of A.
+    // Throws if the solver doesn't converge.
+    val cg(const val& a, const val& b, const val& tolerance,
+           const linear_operator& preconditioner = linear_operator(), int max_iterations = 0);
+    val cg(const sparse_val& a, const val& b, const val& tolerance,
+           const linear_operator& preconditioner = linear_operator(), int max_iterations = 0);
+    val bicgstab(const val& a, const val& b, const val& tolerance,
+                 const linear_operator& preconditioner = linear_operator(), int max_iterations = 0);
+    val bicgstab(const sparse_val& a, const val& b, const val& tolerance,
+                 const linear_operator& preconditioner = linear_operator(), int max_iterations = 0);
+    val gmres(const val& a, const val& b, const val& tolerance,
+              const linear_operator& preconditioner = linear_operator(), int restart = 30, int max_iterations = 0);
+    val gmres(const sparse_val& a, const val& b, const val& tolerance,
+              const linear_operator& preconditioner = linear_operator(), int restart = 30, int max_iterations = 0);
+}
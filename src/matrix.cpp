@@ -1,40 +1,83 @@
 #include "matrix.h"
+#include "fixed_matrix.h"
+#include "decomposition.h"
+#include "expression.h"
+#include "format.h"
+#include "gemm.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cmath>
 #include <stdexcept>
+#include <utility>
 #include <math.h>
 
 
-inline int physics::matrix::rows() const { return data.size(); }
-inline int physics::matrix::cols() const { return data[0].size(); }
-inline long double physics::matrix::first() const { return data[0][0]; }
-inline int physics::matrix::size() const { return data.size() * data[0].size(); }
+inline int physics::matrix::rows() const { return n_rows; }
+inline int physics::matrix::cols() const { return n_cols; }
+inline physics::scalar physics::matrix::first() const { return data[0]; }
+inline int physics::matrix::size() const { return n_rows * n_cols; }
 
 inline bool physics::matrix::is_scalar() const { return rows() == 1 && cols() == 1; }
 inline bool physics::matrix::is_vector() const { return rows() == 1 || cols() == 1; }
 inline bool physics::matrix::is_square() const { return rows() == cols(); }
 
+inline physics::scalar& physics::matrix::operator()(int i, int j) { return data[i * stride + j]; }
+inline physics::scalar physics::matrix::operator()(int i, int j) const { return data[i * stride + j]; }
+inline physics::scalar* physics::matrix::row(int i) { return data.data() + i * stride; }
+inline const physics::scalar* physics::matrix::row(int i) const { return data.data() + i * stride; }
+
 
 inline physics::matrix::matrix() {}
-inline physics::matrix::matrix(long double value) { data.push_back({value}); }
-inline physics::matrix::matrix(std::vector<long double> values) { data.push_back({values}); }
-inline physics::matrix::matrix(std::vector<std::vector<long double>> values) { data = values; }
+inline physics::matrix::matrix(scalar value) : data(1, value), n_rows(1), n_cols(1), stride(1) {}
+inline physics::matrix::matrix(std::vector<scalar> values) : data(values.data(), values.data() + values.size()), n_rows(1) {
+    n_cols = stride = values.size();
+}
+inline physics::matrix::matrix(std::vector<std::vector<scalar>> values) {
+    n_rows = values.size();
+    n_cols = stride = n_rows > 0 ? values[0].size() : 0;
+    data.assign(n_rows * n_cols, 0);
+    for(int i = 0; i < n_rows; i++) {
+        if((int)values[i].size() != n_cols) throw std::invalid_argument("All rows of a matrix must have the same length.");
+        std::copy(values[i].begin(), values[i].end(), row(i));
+    }
+}
 
+template <typename E, typename>
+inline physics::matrix::matrix(const E& e) : data(e.rows() * e.cols()), n_rows(e.rows()), n_cols(e.cols()), stride(e.cols()) {
+    evaluate(e, *this);
+}
+
+template <typename E, typename>
+inline physics::matrix& physics::matrix::operator=(const E& e) {
+    // Elements only depend on the same position of their operands, so the expression may refer to this
+    // matrix, unless it contains a transpose
+    if(reads_across<E>::value || rows() != e.rows() || cols() != e.cols()) return *this = matrix(e);
+    evaluate(e, *this);
+    return *this;
+}
+
+inline physics::matrix physics::matrix::zeros(int rows, int cols) {
+    matrix out;
+    out.data.assign(rows * cols, 0);
+    out.n_rows = rows;
+    out.n_cols = cols;
+    out.stride = cols;
+    return out;
+}
+
+inline physics::matrix physics::matrix::identity(int n) {
+    matrix out = zeros(n, n);
+    for(int i = 0; i < n; i++) out(i, i) = 1;
+    return out;
+}
 
-inline std::string physics::matrix::operator+(std::string x) const {
+
+inline std::string physics::matrix::operator+(const std::string& x) const {
     return (std::string)*this + x;
 }
 
 inline physics::matrix::operator std::string() const {
-    std::string string;
-    if(rows() > 1) string = "[";
-    for(std::vector<long double> row : data) {
-        if(cols() > 1) string += "[ ";
-        for(long double value : row) {
-            string += std::to_string(value) + " ";
-        }
-        if(cols() > 1) string += "]";
-    }
-    if(rows() > 1) string += "]";
-    return string;
+    return std::string(format(*this));
 }
 
 inline physics::matrix::operator int() const { return (long double)*this; }
@@ -45,66 +88,35 @@ inline physics::matrix::operator long double() const {
     return first();
 }
 
-inline physics::matrix physics::matrix::operator+(matrix m) const {
-    if(rows() != m.rows() || cols() != m.cols()) throw std::invalid_argument("Incompatible matrices.");
-
-    matrix out;
-    for(int i = 0; i < data.size(); i++) {
-        std::vector<long double> newRow;
-        for(int j = 0; j < data[0].size(); j++) {
-            newRow.push_back(data[i][j] + m.data[i][j]);
-        }
-        out.data.push_back(newRow);
-    }
-    return out;
-}
-
-inline physics::matrix physics::matrix::operator-(matrix m) const {
-    return *this + -1 * m;
-}
-
-inline physics::matrix physics::matrix::operator*(long double x) const {
-    matrix out;
-    for(std::vector<long double> row : data) {
-        std::vector<long double> newRow;
-        for(long double value : row) {
-            newRow.push_back(value * x);
-        }
-        out.data.push_back(newRow);
-    }
-    return out;
-}
-
-inline physics::matrix physics::matrix::operator*(matrix x) const {
+inline physics::matrix physics::matrix::operator*(const matrix& x) const {
     // Multiplication by 1x1 matrix should be regarded as scalar multiplication
     if(x.is_scalar()) return *this * x.first();
     if(is_scalar()) return first() * x;
 
     // Automatically transpose vectors
-    if(x.is_vector() && cols() != x.rows()) x = x.T();
+    if(x.is_vector() && cols() != x.rows() && cols() == x.cols()) return *this * x.T();
 
     if(cols() != x.rows()) throw std::invalid_argument("Incompatible matrices.");
 
+    // Small products are dispatched to the unrolled fixed size kernels
     matrix out;
-    for(int i = 0; i < rows(); i++) {
-        std::vector<long double> newRow;
-        for(int j = 0; j < x.cols(); j++) {
-            long double sum = 0;
-            for(int k = 0; k < cols(); k++) {
-                sum += data[i][k] * x.data[k][j];
-            }
-            newRow.push_back(sum);
-        }
-        out.data.push_back(newRow);
+    if(rows() == 3 && cols() == 3 && x.cols() == 1) out = fixed_matrix<3, 3>(*this) * fixed_matrix<3, 1>(x);
+    else if(rows() == 3 && cols() == 3 && x.cols() == 3) out = fixed_matrix<3, 3>(*this) * fixed_matrix<3, 3>(x);
+    else if(rows() == 4 && cols() == 4 && x.cols() == 4) out = fixed_matrix<4, 4>(*this) * fixed_matrix<4, 4>(x);
+    else {
+        out = zeros(rows(), x.cols());
+        gemm(rows(), x.cols(), cols(), row(0), stride, x.row(0), x.stride, out.row(0), out.stride);
     }
-    return out.T();
-}
 
-inline physics::matrix physics::matrix::operator/(long double x) const {
-    return *this * (1/x);
+    // Vector results are returned as row vectors
+    if(out.cols() == 1) {
+        out.n_cols = out.stride = out.n_rows;
+        out.n_rows = 1;
+    }
+    return out;
 }
 
-inline physics::matrix physics::matrix::operator/(matrix m) const {
+inline physics::matrix physics::matrix::operator/(const matrix& m) const {
     if(!m.is_scalar()) throw std::invalid_argument("Dividing by matrix of size other than 1x1 is undefined.");
     return *this * (1/m.first());
 }
@@ -112,107 +124,156 @@ inline physics::matrix physics::matrix::operator/(matrix m) const {
 inline physics::matrix physics::matrix::operator^(double x) const {
     if(is_scalar()) return pow(first(), x);
     if(!is_square()) throw std::invalid_argument("Exponentiation only possible for square matrices");
-
-    matrix out = *this;
-    for(int i = 0; i < x-1; i++) {
-        out *= *this;
+    if(x != std::floor(x)) {
+        if(2 * x != std::floor(2 * x)) throw std::invalid_argument("Only integer and half-integer powers of matrices are defined.");
+        return sqrtm(*this) ^ (2 * x);
+    }
+    // Powers of 2^64 and up don't fit the bit loop below
+    if(std::abs(x) >= std::ldexp(1.0, 64)) throw std::invalid_argument("Matrix power out of range.");
+    if(x < 0) return inverse(*this) ^ -x;
+
+    // Binary exponentiation: the matrix is squared once per bit of x, and multiplied into the result for
+    // each set bit. Each product is written into a spare buffer, which then swaps places with its input.
+    int n = rows();
+    if(x == 0) return identity(n);
+    matrix base = *this, out, scratch = zeros(n, n);
+    bool started = false;
+    for(unsigned long long k = (unsigned long long)x; ; k >>= 1) {
+        if(k & 1) {
+            if(!started) out = base;
+            else {
+                gemm(n, n, n, out.row(0), out.stride, base.row(0), base.stride, scratch.row(0), scratch.stride);
+                std::swap(out, scratch);
+            }
+            started = true;
+        }
+        if(k == 1) return out;
+        gemm(n, n, n, base.row(0), base.stride, base.row(0), base.stride, scratch.row(0), scratch.stride);
+        std::swap(base, scratch);
     }
-    return out;
 }
 
 
-inline physics::matrix physics::matrix::operator+=(matrix m) {
+inline physics::matrix& physics::matrix::operator+=(const matrix& m) {
     *this = *this + m;
     return *this;
 }
 
-inline physics::matrix physics::matrix::operator-=(matrix m) {
+inline physics::matrix& physics::matrix::operator-=(const matrix& m) {
     *this = *this - m;
     return *this;
 }
 
-inline physics::matrix physics::matrix::operator*=(long double x) {
+inline physics::matrix& physics::matrix::operator*=(scalar x) {
     *this = *this * x;
     return *this;
 }
 
-inline physics::matrix physics::matrix::operator*=(matrix m) {
+inline physics::matrix& physics::matrix::operator*=(const matrix& m) {
     *this = *this * m;
     return *this;
 }
 
-inline physics::matrix physics::matrix::operator/=(long double x) {
+inline physics::matrix& physics::matrix::operator/=(scalar x) {
     *this = *this / x;
     return *this;
 }
 
 
-inline bool physics::matrix::operator==(matrix x) const {
+inline bool physics::matrix::operator==(const matrix& x) const {
     // Size check
     if(rows() != x.rows() || cols() != x.cols()) return false;
 
     // Value check
-    for(int i = 0; i < data.size(); i++) {
-        for(int j = 0; j < data.size(); j++) {
-            if(data[i][j] != x.data[i][j]) return false;
+    for(int i = 0; i < rows(); i++) {
+        const scalar* a = row(i);
+        const scalar* b = x.row(i);
+        for(int j = 0; j < cols(); j++) {
+            if(a[j] != b[j]) return false;
         }
     }
 
     return true;
 }
 
-inline bool physics::matrix::operator!=(matrix x) const {
+inline bool physics::matrix::operator!=(const matrix& x) const {
     return !(*this == x);
 }
 
 
-inline physics::matrix physics::matrix::T() const {
-    matrix out;
-    for(int i = 0; i < data[0].size(); i++) {
-        std::vector<long double> newRow;
-        for(int j = 0; j < data.size(); j++) {
-            newRow.push_back(data[j][i]);
+inline physics::matrix_transpose physics::matrix::T() const { return matrix_transpose(*this); }
+
+// Side of the tiles copied by a transpose. A tile of the input and one of the output fit in L1 together.
+inline constexpr int transpose_tile = 32;
+
+inline void physics::evaluate(const matrix_transpose& e, matrix& out) {
+    // Each thread writes its own rows of tiles of the output
+    int tiles = (out.rows() + transpose_tile - 1) / transpose_tile;
+    parallel_for(tiles, out.size(), [&](int begin, int end) {
+        for(int i0 = begin * transpose_tile; i0 < std::min(end * transpose_tile, out.rows()); i0 += transpose_tile) {
+            int i1 = std::min(i0 + transpose_tile, out.rows());
+            for(int j0 = 0; j0 < out.cols(); j0 += transpose_tile) {
+                int j1 = std::min(j0 + transpose_tile, out.cols());
+                for(int j = j0; j < j1; j++) {
+                    const scalar* a = e.m.row(j);
+                    for(int i = i0; i < i1; i++) out(i, j) = a[i];
+                }
+            }
         }
-        out.data.push_back(newRow);
+    });
+}
+
+// Computes a * b, reading either operand transposed in place
+inline physics::matrix transposed_product(const physics::matrix& a, bool transpose_a, const physics::matrix& b, bool transpose_b) {
+    // Scalars and vectors, which are transposed automatically, and small matrices go through the usual product
+    if(a.is_vector() || b.is_vector() || (a.size() <= physics::buffer::inline_capacity && b.size() <= physics::buffer::inline_capacity)) {
+        return (transpose_a ? physics::matrix(a.T()) : a) * (transpose_b ? physics::matrix(b.T()) : b);
     }
+    int m = transpose_a ? a.cols() : a.rows(), k = transpose_a ? a.rows() : a.cols();
+    int n = transpose_b ? b.rows() : b.cols();
+    if(k != (transpose_b ? b.cols() : b.rows())) throw std::invalid_argument("Incompatible matrices.");
+
+    physics::matrix out = physics::matrix::zeros(m, n);
+    physics::gemm(m, n, k, a.row(0), a.stride, b.row(0), b.stride, out.row(0), out.stride, transpose_a, transpose_b);
     return out;
 }
 
+inline physics::matrix physics::operator*(const matrix_transpose& l, const matrix& r) { return transposed_product(l.m, true, r, false); }
+inline physics::matrix physics::operator*(const matrix& l, const matrix_transpose& r) { return transposed_product(l, false, r.m, true); }
+inline physics::matrix physics::operator*(const matrix_transpose& l, const matrix_transpose& r) { return transposed_product(l.m, true, r.m, true); }
 
-inline physics::matrix physics::operator*(long double x, matrix m) {
-    return m * x;
-}
 
-inline std::string physics::operator+(std::string x, matrix m) {
+inline std::string physics::operator+(const std::string& x, const matrix& m) {
     return x + (std::string)m;
 }
 inline std::ostream& physics::operator<<(std::ostream &os, const matrix &m) {
-    os << (std::string)m;
+    os << format(m);
     return os;
 }
 
 inline physics::matrix physics::abs(matrix m) {
-    matrix out;
-    for(std::vector<long double> row : m.data) {
-        std::vector<long double> newRow;
-        for(long double value : row) {
-            newRow.push_back(std::abs(value));
+    parallel_for(m.rows(), m.size(), [&](int begin, int end) {
+        for(int i = begin; i < end; i++) {
+            scalar* r = m.row(i);
+            for(int j = 0; j < m.cols(); j++) {
+                r[j] = std::abs(r[j]);
+            }
         }
-        out.data.push_back(newRow);
-    }
-    return out;
+    });
+    return m;
 }
 
-inline physics::matrix physics::cross(matrix m1, matrix m2) {
+inline physics::matrix physics::cross(const matrix& m1, const matrix& m2) {
     if(!m1.is_vector() || !m2.is_vector() || m1.size() != 3 || m2.size() != 3) throw std::invalid_argument("Cross product only possible for 3D vectors");
 
-    std::vector<long double> result(3);
-    std::vector<long double> a = m1.rows() == 1 ? m1.data[0] : m1.T().data[0];
-    std::vector<long double> b = m2.rows() == 1 ? m2.data[0] : m2.T().data[0];
-
-    result[0] = a[1] * b[2] - a[2] * b[1];
-    result[1] = a[2] * b[0] - a[0] * b[2];
-    result[2] = a[0] * b[1] - a[1] * b[0];
+    // Read the components regardless of whether the vectors are rows or columns
+    auto at = [](const matrix& m, int k) { return m.rows() == 1 ? m(0, k) : m(k, 0); };
+    scalar a[3] = { at(m1, 0), at(m1, 1), at(m1, 2) };
+    scalar b[3] = { at(m2, 0), at(m2, 1), at(m2, 2) };
 
-    return matrix(result);
+    return matrix({
+        a[1] * b[2] - a[2] * b[1],
+        a[2] * b[0] - a[0] * b[2],
+        a[0] * b[1] - a[1] * b[0]
+    });
 }
\ No newline at end of file
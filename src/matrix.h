@@ -1,62 +1,95 @@
 #pragma once
 
+#include "buffer.h"
 #include <string>
+#include <type_traits>
 #include <vector>
 
 namespace physics {
+    // Base of the lazily evaluated element-wise matrix expressions in expression.h.
+    struct matrix_expression {};
+    struct matrix_transpose;
+    struct matrix_view;
 
+    // Represents a dense matrix.
+    // Elements are stored contiguously in row-major order, with row i starting at data[i * stride].
+    // Any number of threads may read the same matrix at once, but not while another thread modifies it.
     struct matrix {
     public:
-        std::vector<std::vector<long double>> data;
+        buffer data;
+        int n_rows = 0;
+        int n_cols = 0;
+        int stride = 0;
 
         int rows() const;
         int cols() const;
-        long double first() const;
+        scalar first() const;
         int size() const;
 
         bool is_scalar() const;
         bool is_vector() const;
         bool is_square() const;
 
+        // Element access
+        scalar& operator()(int i, int j);
+        scalar operator()(int i, int j) const;
+        scalar* row(int i);
+        const scalar* row(int i) const;
+
     public:
         matrix();
-        matrix(long double value);
-        matrix(std::vector<long double> values);
-        matrix(std::vector<std::vector<long double>> values);
+        matrix(scalar value);
+        matrix(std::vector<scalar> values);
+        matrix(std::vector<std::vector<scalar>> values);
+
+        // Evaluates an element-wise expression in a single pass.
+        template <typename E, typename = typename std::enable_if<std::is_base_of<matrix_expression, E>::value>::type>
+        matrix(const E& e);
+        template <typename E, typename = typename std::enable_if<std::is_base_of<matrix_expression, E>::value>::type>
+        matrix& operator=(const E& e);
+
+        // Returns a rows x cols matrix filled with zeros.
+        static matrix zeros(int rows, int cols);
+        // Returns the n x n identity matrix.
+        static matrix identity(int n);
 
-        std::string operator+(std::string x) const;
+        std::string operator+(const std::string& x) const;
         operator std::string() const;
         explicit operator int() const;
         explicit operator float() const;
         explicit operator double() const;
         explicit operator long double() const;
 
-        matrix operator+(matrix m) const;
-        matrix operator-(matrix m) const;
-        matrix operator*(long double x) const;
-        matrix operator*(matrix m) const;
-        matrix operator/(long double x) const;
-        matrix operator/(matrix m) const;
+        // Sums, differences and scaling are lazy, see expression.h
+        matrix operator*(const matrix& m) const;
+        matrix operator/(const matrix& m) const;
+        // Integer powers by repeated squaring. Negative powers are powers of the inverse, and half-integer
+        // ones powers of sqrtm.
         matrix operator^(double) const;
 
-        matrix operator+=(matrix m);
-        matrix operator-=(matrix m);
-        matrix operator*=(long double x);
-        matrix operator*=(matrix m);
-        matrix operator/=(long double x);
+        // Compound assignment updates the matrix in place
+        matrix& operator+=(const matrix& m);
+        matrix& operator-=(const matrix& m);
+        matrix& operator*=(scalar x);
+        matrix& operator*=(const matrix& m);
+        matrix& operator/=(scalar x);
 
-        bool operator==(matrix m) const;
-        bool operator!=(matrix m) const;
+        bool operator==(const matrix& m) const;
+        bool operator!=(const matrix& m) const;
 
-        // Transpose
-        matrix T() const;
-    };
+        // Transpose, as a view of this matrix, see expression.h
+        matrix_transpose T() const;
 
-    matrix operator*(long double x, matrix m);
+        // Writable views of part of this matrix, see view.h
+        matrix_view block(int i, int j, int rows, int cols);
+        matrix_view row_view(int i);
+        matrix_view column_view(int j);
+    };
 
-    std::string operator+(std::string x, matrix m);
+    std::string operator+(const std::string& x, const matrix& m);
     std::ostream& operator<<(std::ostream &os, const matrix &m);
 
+    // Takes m by value so that an expiring matrix is updated in place
     matrix abs(matrix m);
-    matrix cross(matrix m1, matrix m2);
-}
\ No newline at end of file
+    matrix cross(const matrix& m1, const matrix& m2);
+}
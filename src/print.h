@@ -1,16 +1,49 @@
 #pragma once
 
-#include <iostream>
+#include "sink.h"
+#include <ostream>
+#include <streambuf>
+#include <string>
 
 
 namespace physics {
-    inline void print() {
-        std::cout << std::endl;
+    // Stream buffer that appends everything written to it to a string.
+    class string_buffer : public std::streambuf {
+    public:
+        std::string text;
+
+    protected:
+        int_type overflow(int_type c) override {
+            if(c != traits_type::eof()) text += (char)c;
+            return c;
+        }
+        std::streamsize xsputn(const char* s, std::streamsize n) override {
+            text.append(s, n);
+            return n;
+        }
     };
 
-    template <typename T, typename... Types>
-    void print(T var1, Types...var2) {
-        std::cout << var1 << "\t";
-        print(var2...);
+    // Writes the arguments to a sink as one tab separated line.
+    template <typename... Types>
+    void print_to(sink& out, const Types&... vars) {
+        // The line is formatted in buffers kept per thread, and handed to the sink in a single write
+        thread_local string_buffer line;
+        thread_local std::ostream stream(&line);
+        line.text.clear();
+        ((stream << vars << "\t"), ...);
+        line.text += '\n';
+        out.write(line.text);
+    }
+
+    // Prints the arguments to standard output as one tab separated line.
+    // Output is buffered and written by a background thread, call flush() to wait until it is written.
+    template <typename... Types>
+    void print(const Types&... vars) {
+        print_to(sink::standard_output(), vars...);
+    }
+
+    // Waits until everything printed so far has been written.
+    inline void flush() {
+        sink::standard_output().flush();
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include "value.h"
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+
+
+namespace physics {
+    // Represents a physical dimension at compile time.
+    // The template parameters are the exponents of each SI unit, in the same order as physics::unit.
+    template <int m, int kg, int s, int a, int k, int cd, int mol>
+    struct dimension {
+        // Conversions
+        constexpr explicit operator unit() const {
+            return unit(m, kg, s, a, k, cd, mol);
+        }
+    };
+
+    template <typename D1, typename D2> struct dimension_product;
+    template <int... x, int... y>
+    struct dimension_product<dimension<x...>, dimension<y...>> { typedef dimension<(x + y)...> type; };
+
+    template <typename D1, typename D2> struct dimension_quotient;
+    template <int... x, int... y>
+    struct dimension_quotient<dimension<x...>, dimension<y...>> { typedef dimension<(x - y)...> type; };
+
+    template <typename D, int n> struct dimension_power;
+    template <int... x, int n>
+    struct dimension_power<dimension<x...>, n> { typedef dimension<(x * n)...> type; };
+
+    // Dimensions
+    typedef dimension<0,0,0,0,0,0,0> Dimensionless;
+    typedef dimension<1,0,0,0,0,0,0> Length;
+    typedef dimension<0,1,0,0,0,0,0> Mass;
+    typedef dimension<0,0,1,0,0,0,0> Time;
+    typedef dimension<0,0,0,1,0,0,0> Current;
+    typedef dimension<0,0,0,0,1,0,0> Temperature;
+    typedef dimension<0,0,0,0,0,1,0> LuminousIntensity;
+    typedef dimension<0,0,0,0,0,0,1> Amount;
+
+    typedef dimension_quotient<Dimensionless, Time>::type Frequency;
+    typedef dimension_quotient<Length, Time>::type Velocity;
+    typedef dimension_quotient<Velocity, Time>::type Acceleration;
+    typedef dimension_product<Mass, Acceleration>::type Force;
+    typedef dimension_product<Force, Length>::type Energy;
+    typedef dimension_quotient<Energy, Time>::type Power;
+    typedef dimension_quotient<Force, dimension_power<Length, 2>::type>::type Pressure;
+    typedef dimension_product<Current, Time>::type Charge;
+    typedef dimension_quotient<Power, Current>::type Voltage;
+    typedef dimension_quotient<Voltage, Current>::type Resistance;
+
+
+    // Represents a physical value whose dimension is checked at compile time.
+    // Holds nothing but the value in SI base units, so sizeof(quantity<S, D>) == sizeof(S) and
+    // unit arithmetic produces no code. Adding quantities of different dimensions fails to compile.
+    template <typename Scalar, typename Dim>
+    class quantity {
+    private:
+        Scalar v;
+
+    public:
+        constexpr quantity() : v() {}
+        constexpr explicit quantity(Scalar value) : v(value) {}
+
+        // Converts a val, which must have the same unit.
+        explicit quantity(const val& x) {
+            if((unit)x != (unit)Dim()) throw std::invalid_argument("Unit Error");
+            v = (scalar)x.v * power_of_ten(x.e);
+        }
+
+        // Conversions
+        constexpr Scalar value() const { return v; }
+        explicit operator val() const { return val(matrix((scalar)v), (unit)Dim()); }
+
+        // Operators
+        constexpr quantity operator+(quantity x) const { return quantity(v + x.v); }
+        constexpr quantity operator-(quantity x) const { return quantity(v - x.v); }
+        constexpr quantity operator-() const { return quantity(-v); }
+        constexpr quantity operator*(Scalar x) const { return quantity(v * x); }
+        constexpr quantity operator/(Scalar x) const { return quantity(v / x); }
+
+        template <typename D>
+        constexpr quantity<Scalar, typename dimension_product<Dim, D>::type> operator*(quantity<Scalar, D> x) const {
+            return quantity<Scalar, typename dimension_product<Dim, D>::type>(v * x.value());
+        }
+        template <typename D>
+        constexpr quantity<Scalar, typename dimension_quotient<Dim, D>::type> operator/(quantity<Scalar, D> x) const {
+            return quantity<Scalar, typename dimension_quotient<Dim, D>::type>(v / x.value());
+        }
+
+        quantity& operator+=(quantity x) { v += x.v; return *this; }
+        quantity& operator-=(quantity x) { v -= x.v; return *this; }
+        quantity& operator*=(Scalar x) { v *= x; return *this; }
+        quantity& operator/=(Scalar x) { v /= x; return *this; }
+
+        constexpr bool operator<(quantity x) const { return v < x.v; }
+        constexpr bool operator>(quantity x) const { return v > x.v; }
+        constexpr bool operator<=(quantity x) const { return v <= x.v; }
+        constexpr bool operator>=(quantity x) const { return v >= x.v; }
+        constexpr bool operator==(quantity x) const { return v == x.v; }
+        constexpr bool operator!=(quantity x) const { return v != x.v; }
+    };
+
+    static_assert(sizeof(quantity<double, Length>) == sizeof(double), "quantity must not add storage");
+
+    // The scalar is taken from the quantity, so that 2 * q works for a quantity<double, D>
+    template <typename Scalar, typename Dim>
+    constexpr quantity<Scalar, Dim> operator*(typename std::common_type<Scalar>::type x, quantity<Scalar, Dim> q) { return q * x; }
+    template <typename Scalar, typename Dim>
+    constexpr quantity<Scalar, typename dimension_quotient<Dimensionless, Dim>::type> operator/(typename std::common_type<Scalar>::type x, quantity<Scalar, Dim> q) {
+        return quantity<Scalar, typename dimension_quotient<Dimensionless, Dim>::type>(x / q.value());
+    }
+
+    // Multiplying a number with a dimension creates a quantity, e.g. 2.0 * si::M
+    template <typename Scalar, int... x, typename = typename std::enable_if<std::is_arithmetic<Scalar>::value>::type>
+    constexpr quantity<Scalar, dimension<x...>> operator*(Scalar v, dimension<x...>) { return quantity<Scalar, dimension<x...>>(v); }
+    template <typename Scalar, int... x, typename = typename std::enable_if<std::is_arithmetic<Scalar>::value>::type>
+    constexpr quantity<Scalar, dimension<(-x)...>> operator/(Scalar v, dimension<x...>) { return quantity<Scalar, dimension<(-x)...>>(v); }
+    template <typename Scalar, typename Dim, int... x>
+    constexpr quantity<Scalar, typename dimension_product<Dim, dimension<x...>>::type> operator*(quantity<Scalar, Dim> q, dimension<x...> d) {
+        return q * (Scalar(1) * d);
+    }
+    template <typename Scalar, typename Dim, int... x>
+    constexpr quantity<Scalar, typename dimension_quotient<Dim, dimension<x...>>::type> operator/(quantity<Scalar, Dim> q, dimension<x...> d) {
+        return q / (Scalar(1) * d);
+    }
+
+    // Dimensions combine like units, e.g. si::KG * si::M / (si::S * si::S)
+    template <int... x, int... y>
+    constexpr dimension<(x + y)...> operator*(dimension<x...>, dimension<y...>) { return {}; }
+    template <int... x, int... y>
+    constexpr dimension<(x - y)...> operator/(dimension<x...>, dimension<y...>) { return {}; }
+
+    template <int n, typename Scalar, typename Dim>
+    constexpr quantity<Scalar, typename dimension_power<Dim, n>::type> power(quantity<Scalar, Dim> q) {
+        Scalar out = 1;
+        for(int i = 0; i < (n < 0 ? -n : n); i++) out *= q.value();
+        return quantity<Scalar, typename dimension_power<Dim, n>::type>(n < 0 ? 1 / out : out);
+    }
+
+    template <typename Scalar, typename Dim>
+    quantity<Scalar, Dim> abs(quantity<Scalar, Dim> q) { return quantity<Scalar, Dim>(std::abs(q.value())); }
+
+    // Compile time counterparts of the units in unit.h
+    namespace si {
+        // SI Units
+        constexpr Length M{}; // Metre
+        constexpr Mass KG{}; // Kilogram
+        constexpr Time S{}; // Second
+        constexpr Current A{}; // Ampere
+        constexpr Temperature K{}; // Kelvin
+        constexpr LuminousIntensity CD{}; // Candela
+        constexpr Amount MOL{}; // Mole
+
+        // Derived units
+        constexpr Frequency HZ{}; // Hertz
+        constexpr Force N{}; // Newton
+        constexpr Energy J{}; // Joule
+        constexpr Power W{}; // Watt
+        constexpr Pressure PA{}; // Pascal
+        constexpr Voltage V{}; // Volt
+        constexpr Charge C{}; // Coulomb
+        constexpr Resistance OHM{}; // Ohm
+        constexpr decltype(C / V) F{}; // Farad
+        constexpr decltype(OHM * S) H{}; // Henry
+        constexpr decltype(A / V) SIEMENS{}; // Siemens
+        constexpr decltype(V * S) WB{}; // Weber
+        constexpr decltype(WB / (M * M)) T{}; // Tesla
+    }
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+
+// The floating point type used for all values, selected at build time.
+// Define PHYSICS_SCALAR as float, double or long double before including physics.h.
+// long double is the default; double and float allow the compiler to vectorise matrix loops.
+#ifndef PHYSICS_SCALAR
+#define PHYSICS_SCALAR long double
+#endif
+
+namespace physics {
+    typedef PHYSICS_SCALAR scalar;
+}
@@ -0,0 +1,90 @@
+#include "sink.h"
+#include <stdexcept>
+
+
+inline physics::sink::sink(std::FILE* file, size_t flush_size, std::chrono::milliseconds flush_interval)
+    : file(file), flush_size(flush_size), flush_interval(flush_interval) {
+    start();
+}
+inline physics::sink::sink(const std::string& path, size_t flush_size, std::chrono::milliseconds flush_interval)
+    : file(std::fopen(path.c_str(), "w")), owns_file(true), flush_size(flush_size), flush_interval(flush_interval) {
+    if(!file) throw std::invalid_argument("Could not open " + path + ".");
+    start();
+}
+inline physics::sink::sink(std::string* memory, size_t flush_size, std::chrono::milliseconds flush_interval)
+    : memory(memory), flush_size(flush_size), flush_interval(flush_interval) {
+    start();
+}
+
+inline physics::sink::~sink() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    writer.join();
+    if(owns_file) std::fclose(file);
+}
+
+inline void physics::sink::write(std::string_view text) {
+    bool wake_writer;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        wake_writer = buffer.empty();
+        buffer.append(text.data(), text.size());
+        added += text.size();
+        wake_writer = wake_writer || buffer.size() >= flush_size;
+    }
+    if(wake_writer) wake.notify_one();
+}
+
+inline void physics::sink::flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    long long target = added;
+    if(written >= target) return;
+    flushing = true;
+    wake.notify_one();
+    done.wait(lock, [&]() { return written >= target; });
+}
+
+inline physics::sink& physics::sink::standard_output() {
+    static sink out(stdout);
+    return out;
+}
+
+inline void physics::sink::start() {
+    writer = std::thread([this]() { work(); });
+}
+
+inline void physics::sink::work() {
+    // Buffers are swapped rather than copied, so both keep their capacity
+    std::string batch;
+    std::unique_lock<std::mutex> lock(mutex);
+    while(true) {
+        // Sleeps until there is output, then lets it collect for up to flush_interval
+        wake.wait(lock, [this]() { return stopping || !buffer.empty(); });
+        wake.wait_for(lock, flush_interval, [this]() { return stopping || flushing || buffer.size() >= flush_size; });
+        flushing = false;
+        if(buffer.empty()) {
+            if(stopping) return;
+            continue;
+        }
+
+        batch.swap(buffer);
+        lock.unlock();
+        output(batch);
+        lock.lock();
+        written += batch.size();
+        batch.clear();
+        done.notify_all();
+    }
+}
+
+inline void physics::sink::output(const std::string& text) {
+    if(memory) {
+        memory->append(text);
+        return;
+    }
+    std::fwrite(text.data(), 1, text.size(), file);
+    std::fflush(file);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+
+namespace physics {
+    // Collects output in a buffer and writes it to its target from a background thread.
+    // Writers only append to the buffer, so they never wait for I/O. The buffer is written out once it
+    // reaches flush_size bytes, and at least every flush_interval. Text is written in the order it was added.
+    class sink {
+    private:
+        std::FILE* file = nullptr;
+        bool owns_file = false;
+        std::string* memory = nullptr;
+
+        std::string buffer;
+        long long added = 0;
+        long long written = 0;
+        bool flushing = false;
+        bool stopping = false;
+
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable done;
+        std::thread writer;
+
+    public:
+        // Default thresholds for writing the buffer out
+        static constexpr size_t default_flush_size = 1 << 16;
+        static constexpr std::chrono::milliseconds default_flush_interval{50};
+
+        const size_t flush_size;
+        const std::chrono::milliseconds flush_interval;
+
+        // Writes to an open stream, such as stdout. The stream is not closed.
+        explicit sink(std::FILE* file = stdout, size_t flush_size = default_flush_size, std::chrono::milliseconds flush_interval = default_flush_interval);
+        // Writes to a file, which is created or truncated.
+        explicit sink(const std::string& path, size_t flush_size = default_flush_size, std::chrono::milliseconds flush_interval = default_flush_interval);
+        // Appends to a string in memory. Read it only after flush() or once the sink is destroyed.
+        explicit sink(std::string* memory, size_t flush_size = default_flush_size, std::chrono::milliseconds flush_interval = default_flush_interval);
+        // Writes out everything still buffered.
+        ~sink();
+
+        sink(const sink&) = delete;
+        sink& operator=(const sink&) = delete;
+
+        // Adds text to the buffer.
+        void write(std::string_view text);
+
+        // Waits until everything added so far has been written to the target.
+        void flush();
+
+        // Returns the sink that writes to standard output, which is used by print.
+        static sink& standard_output();
+
+    private:
+        void start();
+        void work();
+        void output(const std::string& text);
+    };
+}
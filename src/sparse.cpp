@@ -0,0 +1,628 @@
+#include "sparse.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <numeric>
+#include <set>
+#include <stdexcept>
+#include <utility>
+
+
+// Neighbours of every node in the graph of A + A^T, sorted
+inline std::vector<std::vector<int>> symmetric_graph(const physics::sparse_matrix& a) {
+    std::vector<std::vector<int>> adjacent(a.rows());
+    for(int i = 0; i < a.rows(); i++) {
+        for(int p = a.row_starts[i]; p < a.row_starts[i + 1]; p++) {
+            int j = a.columns[p];
+            if(i == j) continue;
+            adjacent[i].push_back(j);
+            adjacent[j].push_back(i);
+        }
+    }
+    for(std::vector<int>& x : adjacent) {
+        std::sort(x.begin(), x.end());
+        x.erase(std::unique(x.begin(), x.end()), x.end());
+    }
+    return adjacent;
+}
+
+// Appends nodes to order by minimum degree within the part of the graph they make up.
+// Eliminating a node joins its neighbours into a clique, so eliminating the node with the fewest
+// neighbours first keeps the fill-in small.
+// position[v] is the index of node v in nodes.
+inline void minimum_degree_order(const std::vector<std::vector<int>>& graph, const std::vector<int>& nodes, const std::vector<int>& part, const std::vector<int>& position, std::vector<int>& order) {
+    int id = part[nodes[0]];
+    int n = nodes.size();
+
+    // Neighbours are kept as sorted lists of graph nodes
+    std::vector<std::vector<int>> adjacent(n);
+    std::set<std::pair<int, int>> queue; // Degree and position in nodes
+    for(int k = 0; k < n; k++) {
+        for(int w : graph[nodes[k]]) {
+            if(part[w] == id) adjacent[k].push_back(w);
+        }
+        queue.emplace(adjacent[k].size(), k);
+    }
+
+    std::vector<int> merged;
+    while(!queue.empty()) {
+        int v = queue.begin()->second;
+        queue.erase(queue.begin());
+        order.push_back(nodes[v]);
+
+        for(int node : adjacent[v]) {
+            int w = position[node];
+            std::vector<int>& neighbours = adjacent[w];
+            queue.erase({(int)neighbours.size(), w});
+            merged.clear();
+            std::set_union(neighbours.begin(), neighbours.end(), adjacent[v].begin(), adjacent[v].end(), std::back_inserter(merged));
+            merged.erase(std::remove_if(merged.begin(), merged.end(), [&](int x) { return x == nodes[v] || x == node; }), merged.end());
+            neighbours.swap(merged);
+            queue.emplace(neighbours.size(), w);
+        }
+        std::vector<int>().swap(adjacent[v]);
+    }
+}
+
+// Appends nodes to order by nested dissection. Each connected part is split in two by the middle level
+// of a breadth first search from a far away node, and both halves are ordered before the separator
+// between them, so eliminating one half doesn't fill in the other. Small parts are ordered by minimum degree.
+// part and position are kept for every node of the graph, with the part a node was last split into and
+// its index there.
+inline void nested_dissection_order(const std::vector<std::vector<int>>& graph, const std::vector<int>& nodes, std::vector<int>& part, int& parts, std::vector<int>& position, std::vector<int>& order) {
+    if(nodes.empty()) return;
+    int id = parts++;
+    for(size_t k = 0; k < nodes.size(); k++) {
+        part[nodes[k]] = id;
+        position[nodes[k]] = k;
+    }
+    if(nodes.size() <= 64) {
+        minimum_degree_order(graph, nodes, part, position, order);
+        return;
+    }
+
+    // Levels of a breadth first search from start over the nodes without a level yet, returning the
+    // depth of the last level
+    std::vector<int> level(nodes.size(), -1), queue;
+    auto search = [&](int start) {
+        queue.assign(1, start);
+        level[position[start]] = 0;
+        for(size_t q = 0; q < queue.size(); q++) {
+            int depth = level[position[queue[q]]];
+            for(int w : graph[queue[q]]) {
+                if(part[w] != id || level[position[w]] >= 0) continue;
+                level[position[w]] = depth + 1;
+                queue.push_back(w);
+            }
+        }
+        return level[position[queue.back()]];
+    };
+
+    // Connected components are ordered one after the other
+    int depth = search(nodes[0]);
+    if(queue.size() < nodes.size()) {
+        std::vector<std::vector<int>> components(1, queue);
+        for(size_t k = 0; k < nodes.size(); k++) {
+            if(level[k] >= 0) continue;
+            search(nodes[k]);
+            components.push_back(queue);
+        }
+        for(const std::vector<int>& component : components) nested_dissection_order(graph, component, part, parts, position, order);
+        return;
+    }
+
+    // Restarts from the far end, at its node with the fewest neighbours, while that gets deeper
+    int start = nodes[0];
+    for(int tries = 0; tries < 4; tries++) {
+        int far = queue.back();
+        for(auto q = queue.rbegin(); q != queue.rend() && level[position[*q]] == depth; q++) {
+            if(graph[*q].size() < graph[far].size()) far = *q;
+        }
+        std::fill(level.begin(), level.end(), -1);
+        int next = search(far);
+        if(next <= depth) {
+            std::fill(level.begin(), level.end(), -1);
+            search(start);
+            break;
+        }
+        start = far;
+        depth = next;
+    }
+    if(depth < 2) {
+        // Too tightly connected to split
+        minimum_degree_order(graph, nodes, part, position, order);
+        return;
+    }
+
+    // The separator is the level holding the middle node, but never the first or last level
+    std::vector<int> counts(depth + 1, 0);
+    for(int x : level) counts[x]++;
+    int middle = 0;
+    for(int below = 0; below + counts[middle] < (int)nodes.size() / 2; middle++) below += counts[middle];
+    middle = std::min(std::max(middle, 1), depth - 1);
+
+    std::vector<int> lower, upper, separator;
+    for(size_t k = 0; k < nodes.size(); k++) {
+        if(level[k] < middle) lower.push_back(nodes[k]);
+        else if(level[k] > middle) upper.push_back(nodes[k]);
+        else separator.push_back(nodes[k]);
+    }
+    nested_dissection_order(graph, lower, part, parts, position, order);
+    nested_dissection_order(graph, upper, part, parts, position, order);
+    order.insert(order.end(), separator.begin(), separator.end());
+}
+
+// Orders the rows and columns of a square matrix to reduce the fill-in of its factorization
+inline std::vector<int> fill_reducing_order(const physics::sparse_matrix& a) {
+    std::vector<std::vector<int>> graph = symmetric_graph(a);
+    std::vector<int> nodes(a.rows()), part(a.rows(), -1), position(a.rows()), order;
+    std::iota(nodes.begin(), nodes.end(), 0);
+    int parts = 0;
+    order.reserve(a.rows());
+    nested_dissection_order(graph, nodes, part, parts, position, order);
+    return order;
+}
+
+// Sorts the entries of every row of m by column
+inline void sort_rows(physics::sparse_matrix& m) {
+    std::vector<std::pair<int, physics::scalar>> entries;
+    for(int i = 0; i < m.rows(); i++) {
+        int first = m.row_starts[i];
+        entries.clear();
+        for(int p = first; p < m.row_starts[i + 1]; p++) entries.emplace_back(m.columns[p], m.values[p]);
+        std::sort(entries.begin(), entries.end(), [](const std::pair<int, physics::scalar>& x, const std::pair<int, physics::scalar>& y) { return x.first < y.first; });
+        for(size_t q = 0; q < entries.size(); q++) {
+            m.columns[first + q] = entries[q].first;
+            m.values[first + q] = entries[q].second;
+        }
+    }
+}
+
+// Calls solve_one on every right-hand side of b, each copied to a contiguous array of n values.
+// A vector b gives a row vector, and a matrix of n rows a matrix of the same size.
+template <typename F>
+inline physics::matrix solve_each_column(const physics::matrix& b, int n, long work, F solve_one) {
+    if(b.is_vector() && b.size() == n) {
+        physics::matrix x = b;
+        x.n_rows = 1;
+        x.n_cols = x.stride = n;
+        solve_one(x.row(0));
+        return x;
+    }
+    if(b.rows() != n) throw std::invalid_argument("Incompatible matrices.");
+
+    physics::matrix x = b;
+    physics::parallel_for(x.cols(), work * x.cols(), [&](int begin, int end) {
+        std::vector<physics::scalar> column(n);
+        for(int c = begin; c < end; c++) {
+            for(int i = 0; i < n; i++) column[i] = x(i, c);
+            solve_one(column.data());
+            for(int i = 0; i < n; i++) x(i, c) = column[i];
+        }
+    });
+    return x;
+}
+
+
+inline physics::triplets::triplets(int rows, int cols) : n_rows(rows), n_cols(cols) {}
+
+inline void physics::triplets::reserve(int entries) {
+    row_indices.reserve(entries);
+    col_indices.reserve(entries);
+    values.reserve(entries);
+}
+
+inline void physics::triplets::add(int i, int j, scalar x) {
+    if(i < 0 || i >= n_rows || j < 0 || j >= n_cols) throw std::invalid_argument("Index out of range.");
+    row_indices.push_back(i);
+    col_indices.push_back(j);
+    values.push_back(x);
+}
+
+
+inline int physics::sparse_matrix::rows() const { return n_rows; }
+inline int physics::sparse_matrix::cols() const { return n_cols; }
+inline int physics::sparse_matrix::non_zeros() const { return values.size(); }
+
+inline physics::scalar physics::sparse_matrix::operator()(int i, int j) const {
+    auto first = columns.begin() + row_starts[i];
+    auto last = columns.begin() + row_starts[i + 1];
+    auto it = std::lower_bound(first, last, j);
+    return it != last && *it == j ? values[it - columns.begin()] : 0;
+}
+
+
+inline physics::sparse_matrix::sparse_matrix() : row_starts(1, 0) {}
+inline physics::sparse_matrix::sparse_matrix(int rows, int cols) : n_rows(rows), n_cols(cols), row_starts(rows + 1, 0) {}
+
+inline physics::sparse_matrix::sparse_matrix(const triplets& t) : sparse_matrix(t.n_rows, t.n_cols) {
+    // Sorts the entries into rows
+    for(int i : t.row_indices) row_starts[i + 1]++;
+    std::partial_sum(row_starts.begin(), row_starts.end(), row_starts.begin());
+    std::vector<int> next(row_starts.begin(), row_starts.end() - 1);
+    std::vector<std::pair<int, scalar>> entries(t.values.size());
+    for(size_t p = 0; p < t.values.size(); p++) {
+        entries[next[t.row_indices[p]]++] = {t.col_indices[p], t.values[p]};
+    }
+
+    // Sorts every row by column, summing entries in the same place
+    columns.reserve(entries.size());
+    values.reserve(entries.size());
+    for(int i = 0; i < n_rows; i++) {
+        auto first = entries.begin() + row_starts[i];
+        auto last = entries.begin() + row_starts[i + 1];
+        std::sort(first, last, [](const std::pair<int, scalar>& x, const std::pair<int, scalar>& y) { return x.first < y.first; });
+
+        row_starts[i] = columns.size();
+        for(auto it = first; it != last; it++) {
+            if((int)columns.size() > row_starts[i] && columns.back() == it->first) {
+                values.back() += it->second;
+                continue;
+            }
+            columns.push_back(it->first);
+            values.push_back(it->second);
+        }
+    }
+    row_starts[n_rows] = columns.size();
+}
+
+inline physics::sparse_matrix::sparse_matrix(const matrix& m) : sparse_matrix(m.rows(), m.cols()) {
+    for(int i = 0; i < n_rows; i++) {
+        const scalar* r = m.row(i);
+        for(int j = 0; j < n_cols; j++) {
+            if(r[j] == 0) continue;
+            columns.push_back(j);
+            values.push_back(r[j]);
+        }
+        row_starts[i + 1] = columns.size();
+    }
+}
+
+inline physics::sparse_matrix physics::sparse_matrix::identity(int n) {
+    sparse_matrix out(n, n);
+    std::iota(out.row_starts.begin(), out.row_starts.end(), 0);
+    out.columns.resize(n);
+    std::iota(out.columns.begin(), out.columns.end(), 0);
+    out.values.assign(n, 1);
+    return out;
+}
+
+
+inline physics::sparse_matrix::operator matrix() const {
+    matrix out = matrix::zeros(n_rows, n_cols);
+    for(int i = 0; i < n_rows; i++) {
+        for(int p = row_starts[i]; p < row_starts[i + 1]; p++) out(i, columns[p]) = values[p];
+    }
+    return out;
+}
+
+
+inline physics::matrix physics::sparse_matrix::operator*(const matrix& x) const {
+    // Vectors are taken as columns, and both shapes are stored contiguously
+    if(x.is_vector() && x.size() == cols()) {
+        matrix out = matrix::zeros(1, rows());
+        const scalar* in = x.row(0);
+        scalar* result = out.row(0);
+        parallel_for(rows(), non_zeros(), [&](int begin, int end) {
+            for(int i = begin; i < end; i++) {
+                scalar sum = 0;
+                for(int p = row_starts[i]; p < row_starts[i + 1]; p++) sum += values[p] * in[columns[p]];
+                result[i] = sum;
+            }
+        });
+        return out;
+    }
+
+    if(x.rows() != cols()) throw std::invalid_argument("Incompatible matrices.");
+    matrix out = matrix::zeros(rows(), x.cols());
+    parallel_for(rows(), (long)non_zeros() * x.cols(), [&](int begin, int end) {
+        for(int i = begin; i < end; i++) {
+            scalar* result = out.row(i);
+            for(int p = row_starts[i]; p < row_starts[i + 1]; p++) {
+                scalar a = values[p];
+                const scalar* in = x.row(columns[p]);
+                for(int c = 0; c < x.cols(); c++) result[c] += a * in[c];
+            }
+        }
+    });
+    return out;
+}
+
+inline physics::sparse_matrix physics::sparse_matrix::operator*(scalar x) const {
+    sparse_matrix out = *this;
+    for(scalar& value : out.values) value *= x;
+    return out;
+}
+inline physics::sparse_matrix physics::sparse_matrix::operator/(scalar x) const {
+    return *this * (1 / x);
+}
+
+inline physics::sparse_matrix physics::sparse_matrix::T() const {
+    // Entries are counted into columns, and filled in row by row so every row of the transpose stays sorted
+    sparse_matrix out(n_cols, n_rows);
+    for(int j : columns) out.row_starts[j + 1]++;
+    std::partial_sum(out.row_starts.begin(), out.row_starts.end(), out.row_starts.begin());
+    out.columns.resize(non_zeros());
+    out.values.resize(non_zeros());
+
+    std::vector<int> next(out.row_starts.begin(), out.row_starts.end() - 1);
+    for(int i = 0; i < n_rows; i++) {
+        for(int p = row_starts[i]; p < row_starts[i + 1]; p++) {
+            int q = next[columns[p]]++;
+            out.columns[q] = i;
+            out.values[q] = values[p];
+        }
+    }
+    return out;
+}
+
+inline physics::sparse_matrix physics::operator*(scalar x, const sparse_matrix& m) { return m * x; }
+
+
+inline physics::sparse_val::sparse_val() {}
+inline physics::sparse_val::sparse_val(sparse_matrix v, unit u) : v(std::move(v)), u(u) {}
+
+inline physics::val physics::sparse_val::operator*(const val& x) const { return val(v * x.v, x.e, u * x.u); }
+inline physics::sparse_val physics::sparse_val::T() const { return sparse_val(v.T(), u); }
+
+inline physics::sparse_val physics::operator*(sparse_matrix m, const unit& u) { return sparse_val(std::move(m), u); }
+inline physics::sparse_val physics::operator/(sparse_matrix m, const unit& u) { return sparse_val(std::move(m), u ^ -1); }
+
+
+inline physics::sparse_lu::sparse_lu(const sparse_matrix& a) : u() {
+    if(a.rows() != a.cols()) throw std::invalid_argument("Only square matrices can be factorized.");
+    int n = a.rows();
+    sparse_matrix columns_of_a = a.T(); // A in CSC form
+    col_order = fill_reducing_order(a);
+
+    // Position of each row of A among the pivots, -1 until it is chosen
+    std::vector<int> pivot_of(n, -1);
+    lower = sparse_matrix(n, n);
+    upper = sparse_matrix(n, n);
+    std::vector<int>& lp = lower.row_starts;
+    std::vector<int>& li = lower.columns;
+    std::vector<scalar>& lx = lower.values;
+
+    std::vector<scalar> x(n, 0);
+    std::vector<int> reached(n), path(n), next_entry(n), mark(n, -1);
+    for(int k = 0; k < n; k++) {
+        lp[k] = li.size();
+        upper.row_starts[k] = upper.columns.size();
+        int col = col_order[k];
+
+        // Finds the rows of x = L \ A(:, col) by a depth first search from the rows of A(:, col) through
+        // the columns of L found so far. reached[top, n) lists every row before the rows it updates.
+        int top = n;
+        for(int p = columns_of_a.row_starts[col]; p < columns_of_a.row_starts[col + 1]; p++) {
+            int start = columns_of_a.columns[p];
+            if(mark[start] == k) continue;
+            int head = 0;
+            path[0] = start;
+            while(head >= 0) {
+                int j = path[head];
+                int column = pivot_of[j];
+                if(mark[j] != k) {
+                    mark[j] = k;
+                    next_entry[head] = column < 0 ? 0 : lp[column] + 1;
+                }
+                int end = column < 0 ? 0 : lp[column + 1];
+                bool done = true;
+                for(int q = next_entry[head]; q < end; q++) {
+                    if(mark[li[q]] == k) continue;
+                    next_entry[head] = q + 1;
+                    path[++head] = li[q];
+                    done = false;
+                    break;
+                }
+                if(done) {
+                    head--;
+                    reached[--top] = j;
+                }
+            }
+        }
+
+        // Solves for x along the reached rows
+        for(int p = columns_of_a.row_starts[col]; p < columns_of_a.row_starts[col + 1]; p++) {
+            x[columns_of_a.columns[p]] = columns_of_a.values[p];
+        }
+        for(int t = top; t < n; t++) {
+            int j = reached[t];
+            int column = pivot_of[j];
+            if(column < 0) continue;
+            for(int q = lp[column] + 1; q < lp[column + 1]; q++) x[li[q]] -= lx[q] * x[j];
+        }
+
+        // Rows already pivoted go to U, the largest of the others becomes the pivot
+        int pivot_row = -1;
+        scalar largest = -1;
+        for(int t = top; t < n; t++) {
+            int j = reached[t];
+            if(pivot_of[j] < 0) {
+                if(std::abs(x[j]) > largest) {
+                    largest = std::abs(x[j]);
+                    pivot_row = j;
+                }
+                continue;
+            }
+            upper.columns.push_back(pivot_of[j]);
+            upper.values.push_back(x[j]);
+        }
+        if(pivot_row < 0 || largest == 0) throw std::invalid_argument("Matrix is singular.");
+        if(pivot_of[col] < 0 && std::abs(x[col]) >= largest / 10) pivot_row = col;
+
+        scalar pivot = x[pivot_row];
+        upper.columns.push_back(k);
+        upper.values.push_back(pivot);
+        pivot_of[pivot_row] = k;
+        li.push_back(pivot_row);
+        lx.push_back(1);
+        for(int t = top; t < n; t++) {
+            int j = reached[t];
+            if(pivot_of[j] < 0) {
+                li.push_back(j);
+                lx.push_back(x[j] / pivot);
+            }
+            x[j] = 0;
+        }
+    }
+    lp[n] = li.size();
+    upper.row_starts[n] = upper.columns.size();
+
+    // Rows of L were kept as rows of A while pivots were chosen
+    for(int& i : li) i = pivot_of[i];
+    row_order.resize(n);
+    for(int i = 0; i < n; i++) row_order[pivot_of[i]] = i;
+
+    // Rows within a column are in the order they were reached. Sorting keeps the diagonals in place.
+    sort_rows(lower);
+    sort_rows(upper);
+}
+inline physics::sparse_lu::sparse_lu(const sparse_val& a) : sparse_lu(a.v) {
+    u = a.u;
+}
+
+inline int physics::sparse_lu::size() const { return row_order.size(); }
+
+inline physics::matrix physics::sparse_lu::solve(const matrix& b) const {
+    int n = size();
+    long work = lower.non_zeros() + upper.non_zeros();
+    return solve_each_column(b, n, work, [&](scalar* x) {
+        std::vector<scalar> y(n);
+        for(int k = 0; k < n; k++) y[k] = x[row_order[k]];
+
+        for(int j = 0; j < n; j++) {
+            for(int p = lower.row_starts[j] + 1; p < lower.row_starts[j + 1]; p++) y[lower.columns[p]] -= lower.values[p] * y[j];
+        }
+        for(int j = n - 1; j >= 0; j--) {
+            int diagonal = upper.row_starts[j + 1] - 1;
+            y[j] /= upper.values[diagonal];
+            for(int p = upper.row_starts[j]; p < diagonal; p++) y[upper.columns[p]] -= upper.values[p] * y[j];
+        }
+
+        for(int k = 0; k < n; k++) x[col_order[k]] = y[k];
+    });
+}
+inline physics::val physics::sparse_lu::solve(const val& b) const {
+    return val(solve(b.v), b.e, b.u / u);
+}
+
+
+inline physics::sparse_cholesky::sparse_cholesky(const sparse_matrix& a) : u() {
+    if(a.rows() != a.cols()) throw std::invalid_argument("Only square matrices can be factorized.");
+    int n = a.rows();
+    order = fill_reducing_order(a);
+    std::vector<int> position(n);
+    for(int k = 0; k < n; k++) position[order[k]] = k;
+
+    // Row k of c holds the lower triangle of P A P^T, which is column k of its upper triangle
+    triplets t(n, n);
+    for(int i = 0; i < n; i++) {
+        for(int p = a.row_starts[i]; p < a.row_starts[i + 1]; p++) {
+            int j = a.columns[p];
+            if(j > i) continue;
+            t.add(std::max(position[i], position[j]), std::min(position[i], position[j]), a.values[p]);
+        }
+    }
+    sparse_matrix c(t);
+
+    // Elimination tree, where the parent of column i is the first row below it in L's column i
+    std::vector<int> parent(n, -1), ancestor(n, -1);
+    for(int k = 0; k < n; k++) {
+        for(int p = c.row_starts[k]; p < c.row_starts[k + 1]; p++) {
+            for(int i = c.columns[p]; i != -1 && i < k;) {
+                int next = ancestor[i];
+                ancestor[i] = k;
+                if(next == -1) parent[i] = k;
+                i = next;
+            }
+        }
+    }
+
+    // Writes the columns of row k of L, other than the diagonal, to reached[top, n), each before its
+    // ancestors in the elimination tree, and returns top
+    std::vector<int> reached(n), path(n), mark(n, -1);
+    auto row_pattern = [&](int k) {
+        int top = n;
+        mark[k] = k;
+        for(int p = c.row_starts[k]; p < c.row_starts[k + 1]; p++) {
+            int length = 0;
+            for(int i = c.columns[p]; mark[i] != k; i = parent[i]) {
+                path[length++] = i;
+                mark[i] = k;
+            }
+            while(length > 0) reached[--top] = path[--length];
+        }
+        return top;
+    };
+
+    // Counts the entries of every column of L before filling them in
+    lower = sparse_matrix(n, n);
+    std::vector<int>& lp = lower.row_starts;
+    for(int k = 0; k < n; k++) {
+        lp[k + 1]++;
+        for(int t = row_pattern(k); t < n; t++) lp[reached[t] + 1]++;
+    }
+    std::partial_sum(lp.begin(), lp.end(), lp.begin());
+    lower.columns.resize(lp[n]);
+    lower.values.resize(lp[n]);
+
+    // Computes row k of L from the columns to its left, which are complete above row k
+    std::vector<int> next(lp.begin(), lp.end() - 1);
+    std::vector<scalar> x(n, 0);
+    for(int k = 0; k < n; k++) {
+        int top = row_pattern(k);
+        for(int p = c.row_starts[k]; p < c.row_starts[k + 1]; p++) x[c.columns[p]] = c.values[p];
+        scalar d = x[k];
+        x[k] = 0;
+
+        for(; top < n; top++) {
+            int i = reached[top];
+            scalar l = x[i] / lower.values[lp[i]];
+            x[i] = 0;
+            for(int p = lp[i] + 1; p < next[i]; p++) x[lower.columns[p]] -= lower.values[p] * l;
+            d -= l * l;
+            int p = next[i]++;
+            lower.columns[p] = k;
+            lower.values[p] = l;
+        }
+
+        if(!(d > 0)) throw std::invalid_argument("Matrix is not positive definite.");
+        int p = next[k]++;
+        lower.columns[p] = k;
+        lower.values[p] = std::sqrt(d);
+    }
+}
+inline physics::sparse_cholesky::sparse_cholesky(const sparse_val& a) : sparse_cholesky(a.v) {
+    u = a.u;
+}
+
+inline int physics::sparse_cholesky::size() const { return order.size(); }
+
+inline physics::matrix physics::sparse_cholesky::solve(const matrix& b) const {
+    int n = size();
+    const std::vector<int>& lp = lower.row_starts;
+    return solve_each_column(b, n, 2 * lower.non_zeros(), [&](scalar* x) {
+        std::vector<scalar> y(n);
+        for(int k = 0; k < n; k++) y[k] = x[order[k]];
+
+        // L y = P b by columns, then L^T z = y by rows of L^T, which are the same columns
+        for(int j = 0; j < n; j++) {
+            y[j] /= lower.values[lp[j]];
+            for(int p = lp[j] + 1; p < lp[j + 1]; p++) y[lower.columns[p]] -= lower.values[p] * y[j];
+        }
+        for(int j = n - 1; j >= 0; j--) {
+            for(int p = lp[j] + 1; p < lp[j + 1]; p++) y[j] -= lower.values[p] * y[lower.columns[p]];
+            y[j] /= lower.values[lp[j]];
+        }
+
+        for(int k = 0; k < n; k++) x[order[k]] = y[k];
+    });
+}
+inline physics::val physics::sparse_cholesky::solve(const val& b) const {
+    return val(solve(b.v), b.e, b.u / u);
+}
+
+
+inline physics::matrix physics::solve(const sparse_matrix& a, const matrix& b) { return sparse_lu(a).solve(b); }
+inline physics::val physics::solve(const sparse_val& a, const val& b) { return sparse_lu(a).solve(b); }
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "matrix.h"
+#include "unit.h"
+#include "value.h"
+#include <vector>
+
+
+namespace physics {
+    // Entries of a sparse matrix collected in any order, to be compressed into a sparse_matrix.
+    // Entries added at the same position are summed, as when assembling stiffness matrices element by element.
+    struct triplets {
+    public:
+        int n_rows = 0;
+        int n_cols = 0;
+        std::vector<int> row_indices;
+        std::vector<int> col_indices;
+        std::vector<scalar> values;
+
+    public:
+        triplets(int rows, int cols);
+
+        void reserve(int entries);
+        void add(int i, int j, scalar x);
+    };
+
+    // Represents a sparse matrix in compressed sparse row (CSR) form.
+    // The entries of row i are at [row_starts[i], row_starts[i + 1]) in columns and values, sorted by column.
+    // The compressed sparse column (CSC) form of a matrix has the same arrays as the CSR form of its transpose.
+    struct sparse_matrix {
+    public:
+        int n_rows = 0;
+        int n_cols = 0;
+        std::vector<int> row_starts;
+        std::vector<int> columns;
+        std::vector<scalar> values;
+
+        int rows() const;
+        int cols() const;
+        int non_zeros() const;
+
+        // Element access, zero for entries that are not stored
+        scalar operator()(int i, int j) const;
+
+    public:
+        sparse_matrix();
+        sparse_matrix(int rows, int cols);
+        explicit sparse_matrix(const triplets& t);
+        // Stores the non-zero elements of m.
+        explicit sparse_matrix(const matrix& m);
+
+        static sparse_matrix identity(int n);
+
+        // Conversions
+        explicit operator matrix() const;
+
+        // Products with a vector, or with every column of a dense matrix, split across the thread pool by rows.
+        // Vector results are returned as row vectors.
+        matrix operator*(const matrix& x) const;
+        sparse_matrix operator*(scalar x) const;
+        sparse_matrix operator/(scalar x) const;
+
+        // Transpose
+        sparse_matrix T() const;
+    };
+
+    sparse_matrix operator*(scalar x, const sparse_matrix& m);
+
+    // A sparse matrix whose entries all have the same unit.
+    struct sparse_val {
+    public:
+        sparse_matrix v; // Values in SI units
+        unit u; // Unit
+
+    public:
+        sparse_val();
+        sparse_val(sparse_matrix v, unit u = unit());
+
+        val operator*(const val& x) const;
+        sparse_val T() const;
+    };
+
+    sparse_val operator*(sparse_matrix m, const unit& u);
+    sparse_val operator/(sparse_matrix m, const unit& u);
+
+    // Sparse LU factorization P A Q = L U of a square matrix.
+    // Columns are ordered by nested dissection of the pattern of A + A^T to reduce fill-in, and factorized
+    // left-looking one at a time (Gilbert-Peierls). Rows are pivoted, preferring the diagonal when it
+    // is at least a tenth of the largest candidate, so the ordering is kept for well-behaved matrices.
+    class sparse_lu {
+    public:
+        sparse_matrix lower; // L in CSC form (the CSR form of L^T), unit diagonal first in each column
+        sparse_matrix upper; // U in CSC form, diagonal last in each column
+        std::vector<int> row_order; // Row k of P A is row row_order[k] of A
+        std::vector<int> col_order; // Column k of A Q is column col_order[k] of A
+        unit u; // Unit of A
+
+    public:
+        explicit sparse_lu(const sparse_matrix& a);
+        explicit sparse_lu(const sparse_val& a);
+
+        int size() const;
+
+        // Solves A x = b for a vector b, or A X = B for every column of B.
+        matrix solve(const matrix& b) const;
+        val solve(const val& b) const;
+    };
+
+    // Sparse Cholesky factorization P A P^T = L L^T of a symmetric positive definite matrix.
+    // Only the lower triangle of A is read. Rows are ordered by nested dissection, and L is computed
+    // one row at a time along the elimination tree.
+    class sparse_cholesky {
+    public:
+        sparse_matrix lower; // L in CSC form (the CSR form of L^T), diagonal first in each column
+        std::vector<int> order; // Row k of P A P^T is row order[k] of A
+        unit u; // Unit of A
+
+    public:
+        explicit sparse_cholesky(const sparse_matrix& a);
+        explicit sparse_cholesky(const sparse_val& a);
+
+        int size() const;
+
+        // Solves A x = b for a vector b, or A X = B for every column of B.
+        matrix solve(const matrix& b) const;
+        val solve(const val& b) const;
+    };
+
+    // Solves A x = b through a sparse LU factorization. The result has the unit of b divided by that of A.
+    matrix solve(const sparse_matrix& a, const matrix& b);
+    val solve(const sparse_val& a, const val& b);
+}
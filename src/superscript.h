@@ -1,40 +1,36 @@
 #pragma once
 
 #include <string>
-#include <map>
+#include <string_view>
 
 
 namespace super {
-    inline std::map<char, std::string> supertable {
-        {'0', "\u2070"},
-        {'1', "\u00b9"},
-        {'2', "\u00b2"},
-        {'3', "\u00b3"},
-        {'4', "\u2074"},
-        {'5', "\u2075"},
-        {'6', "\u2076"},
-        {'7', "\u2077"},
-        {'8', "\u2078"},
-        {'9', "\u2079"},
-        {'+', "\u207A"},
-        {'-', "\u207B"}
+    // Superscript digits, indexed by digit
+    inline constexpr std::string_view superdigits[10] = {
+        "\u2070", "\u00b9", "\u00b2", "\u00b3", "\u2074", "\u2075", "\u2076", "\u2077", "\u2078", "\u2079"
     };
 
+    // Returns the superscript character corresponding to c, or an empty string if there is none.
+    inline constexpr std::string_view supertable(char c) {
+        if(c >= '0' && c <= '9') return superdigits[c - '0'];
+        if(c == '+') return "\u207A";
+        if(c == '-') return "\u207B";
+        return "";
+    }
+
     // Returns a string of exponent characters corresponding to the input char or int.
     inline std::string super(char c) {
-        return supertable[c];
+        return std::string(supertable(c));
     }
     inline std::string super(int n) {
         std::string out;
         if(n < 0) {
-            out += "\u207B";
+            out += supertable('-');
             n *= -1;
         }
-
         for(char c : std::to_string(n)) {
-            out += super(c);
+            out += superdigits[c - '0'];
         }
         return out;
     }
 };
-
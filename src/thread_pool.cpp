@@ -0,0 +1,204 @@
+#include "thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <optional>
+
+
+// Pool the current thread works for, and the index of its task queue in that pool
+inline thread_local const physics::thread_pool* current_pool = nullptr;
+inline thread_local int current_queue = 0;
+inline std::atomic<long> parallel_threshold(1 << 18);
+
+inline physics::thread_pool::thread_pool(int threads) : queued(0), sleeping(0), stopping(false) {
+    start(threads);
+}
+inline physics::thread_pool::~thread_pool() {
+    stop();
+}
+
+inline int physics::thread_pool::size() const { return workers.size() + 1; }
+
+inline void physics::thread_pool::resize(int threads) {
+    stop();
+    start(threads);
+}
+
+inline void physics::thread_pool::parallel_for(int n, const std::function<void(int, int)>& f) {
+    if(n <= 0) return;
+    if(size() == 1) {
+        f(0, n);
+        return;
+    }
+
+    job j;
+    j.f = &f;
+    j.grain = std::max(1, n / (4 * size()));
+    j.remaining = n;
+    j.failed = false;
+    run(task{&j, 0, n});
+
+    // Helps with any queued work until the job is done
+    while(j.remaining > 0) {
+        task t;
+        if(pop(t)) {
+            run(t);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        sleeping++;
+        wake.wait(lock, [&]() { return j.remaining == 0 || queued > 0; });
+        sleeping--;
+    }
+    if(j.error) std::rethrow_exception(j.error);
+}
+
+inline physics::thread_pool& physics::thread_pool::shared() {
+    static thread_pool pool;
+    return pool;
+}
+
+inline void physics::thread_pool::start(int threads) {
+    if(threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    stopping = false;
+    queues.clear();
+    for(int i = 0; i < threads; i++) queues.emplace_back(new task_queue());
+    for(int i = 1; i < threads; i++) workers.emplace_back([this, i]() { work(i); });
+}
+
+inline void physics::thread_pool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for(std::thread& worker : workers) worker.join();
+    workers.clear();
+}
+
+inline void physics::thread_pool::work(int index) {
+    current_pool = this;
+    current_queue = index;
+    while(true) {
+        task t;
+        if(pop(t)) {
+            run(t);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        sleeping++;
+        wake.wait(lock, [this]() { return stopping || queued > 0; });
+        sleeping--;
+        if(stopping) return;
+    }
+}
+
+inline int physics::thread_pool::queue_index() const {
+    return current_pool == this ? current_queue : 0;
+}
+
+inline void physics::thread_pool::push(const task& t) {
+    task_queue& q = *queues[queue_index()];
+    {
+        std::lock_guard<std::mutex> lock(q.mutex);
+        q.tasks.push_back(t);
+        queued++;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    if(sleeping > 0) wake.notify_one();
+}
+
+inline bool physics::thread_pool::pop(task& t) {
+    // Newest task of this thread first, which is the smallest and most likely in cache
+    int own = queue_index();
+    {
+        task_queue& q = *queues[own];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if(!q.tasks.empty()) {
+            t = q.tasks.back();
+            q.tasks.pop_back();
+            queued--;
+            return true;
+        }
+    }
+
+    // Otherwise the oldest, and largest, task of another thread
+    if(queued == 0) return false;
+    for(int i = 1; i < (int)queues.size(); i++) {
+        task_queue& q = *queues[(own + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if(!q.tasks.empty()) {
+            t = q.tasks.front();
+            q.tasks.pop_front();
+            queued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+inline void physics::thread_pool::run(task t) {
+    job& j = *t.owner;
+
+    // Leaves the upper half of large ranges for other threads to steal
+    while(t.end - t.begin > j.grain) {
+        int middle = t.begin + (t.end - t.begin) / 2;
+        push(task{&j, middle, t.end});
+        t.end = middle;
+    }
+    int n = t.end - t.begin;
+
+    if(!j.failed) {
+        try {
+            (*j.f)(t.begin, t.end);
+        }
+        catch(...) {
+            std::lock_guard<std::mutex> lock(j.error_mutex);
+            if(!j.error) j.error = std::current_exception();
+            j.failed = true;
+        }
+    }
+
+    // The job may be gone once the last range is counted
+    if(j.remaining.fetch_sub(n) == n) {
+        std::lock_guard<std::mutex> lock(mutex);
+        wake.notify_all();
+    }
+}
+
+
+inline void physics::set_threads(int threads) { thread_pool::shared().resize(threads); }
+inline int physics::get_threads() { return thread_pool::shared().size(); }
+
+inline void physics::set_parallel_threshold(long work) { parallel_threshold = work; }
+inline long physics::get_parallel_threshold() { return parallel_threshold; }
+
+template <typename F>
+inline void physics::parallel_for(int n, long work, F&& f) {
+    if(work < parallel_threshold) {
+        f(0, n);
+        return;
+    }
+    thread_pool::shared().parallel_for(n, std::ref(f));
+}
+
+template <typename F>
+inline void physics::parallel_for(int n, F&& f) {
+    thread_pool::shared().parallel_for(n, std::ref(f));
+}
+
+template <typename F>
+inline auto physics::parallel_map(int n, F&& f) -> std::vector<typename std::decay<decltype(f(0))>::type> {
+    typedef typename std::decay<decltype(f(0))>::type result;
+
+    // Results are collected out of order, so they are held in optionals until all are done
+    std::vector<std::optional<result>> results(std::max(n, 0));
+    thread_pool::shared().parallel_for(n, [&](int begin, int end) {
+        for(int i = begin; i < end; i++) results[i].emplace(f(i));
+    });
+
+    std::vector<result> out;
+    out.reserve(results.size());
+    for(std::optional<result>& x : results) out.push_back(std::move(*x));
+    return out;
+}
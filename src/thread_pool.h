@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+
+namespace physics {
+    // Pool of worker threads used to split large operations across cores.
+    // Every thread has its own deque of tasks. A thread works through its own deque from the back and
+    // steals from the front of the others when it runs out, so load balances without a central queue.
+    // The library owns one shared pool, and nested parallel loops run on the same threads.
+    class thread_pool {
+    private:
+        // A parallel_for call in progress
+        struct job {
+            const std::function<void(int, int)>* f;
+            int grain;
+            std::atomic<int> remaining;
+            std::atomic<bool> failed;
+            std::mutex error_mutex;
+            std::exception_ptr error;
+        };
+
+        // A range of a job waiting to run
+        struct task {
+            job* owner;
+            int begin;
+            int end;
+        };
+
+        // Tasks of one thread. Threads outside the pool share the first deque.
+        struct task_queue {
+            std::mutex mutex;
+            std::deque<task> tasks;
+        };
+
+        std::vector<std::thread> workers;
+        std::vector<std::unique_ptr<task_queue>> queues;
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::atomic<int> queued;
+        int sleeping;
+        bool stopping;
+
+    public:
+        explicit thread_pool(int threads = 0);
+        ~thread_pool();
+
+        // Number of threads working on a parallel_for, including the calling thread.
+        int size() const;
+
+        // Sets the number of threads. 0 uses one per hardware thread.
+        // Must not be called while the pool is running work.
+        void resize(int threads);
+
+        // Calls f(begin, end) on ranges covering [0, n) in parallel and waits for all of them.
+        // Ranges are halved, leaving the upper half for other threads to steal, down to about a quarter of an
+        // even share per thread.
+        // While waiting, the calling thread runs tasks itself. The first exception thrown by f is rethrown here,
+        // and ranges that have not started by then are skipped.
+        void parallel_for(int n, const std::function<void(int, int)>& f);
+
+        // Returns the pool shared by the library.
+        static thread_pool& shared();
+
+    private:
+        void start(int threads);
+        void stop();
+        void work(int index);
+
+        int queue_index() const;
+        void push(const task& t);
+        bool pop(task& t);
+        void run(task t);
+    };
+
+    // Sets the number of threads used by the library. 0 uses one per hardware thread.
+    void set_threads(int threads);
+    int get_threads();
+
+    // Operations doing less work than this run on the calling thread.
+    // Work is counted in elements for element-wise operations and in multiply-adds for products.
+    void set_parallel_threshold(long work);
+    long get_parallel_threshold();
+
+    // Runs f(begin, end) over [0, n) on the shared pool if work reaches the parallel threshold,
+    // and as a single call f(0, n) on the calling thread otherwise.
+    template <typename F>
+    void parallel_for(int n, long work, F&& f);
+
+    // Runs f(begin, end) over [0, n) on the shared pool.
+    template <typename F>
+    void parallel_for(int n, F&& f);
+
+    // Calls f(i) for every i in [0, n) on the shared pool and returns the results in order.
+    template <typename F>
+    auto parallel_map(int n, F&& f) -> std::vector<typename std::decay<decltype(f(0))>::type>;
+}
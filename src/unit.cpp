@@ -1,9 +1,31 @@
 #include "unit.h"
 #include "superscript.h"
+#include <algorithm>
+#include <array>
+#include <unordered_map>
 
 
-inline const std::string si_strings[7] = {"m","kg","s","A","K","cd","mol"};
-inline const std::map<physics::unit, std::string> si_derved_names {
+inline constexpr std::string_view si_strings[7] = {"m","kg","s","A","K","cd","mol"};
+
+struct unit_name {
+    physics::unit u;
+    std::string_view name;
+};
+
+// Names of units by their exponents. Special names come first and take precedence over derived ones.
+inline constexpr unit_name listed_unit_names[] = {
+    { physics::J * physics::S, "Js" },
+    { physics::N * physics::S, "Ns" },
+    { physics::J / physics::K, "JK\u207B\u00b9" },
+    { physics::J / (physics::KG * physics::K), "Jkg\u207B\u00b9K\u207B\u00b9" },
+    { physics::C / physics::M, "Cm\u207B\u00b9" },
+    { physics::C / (physics::M^2), "Cm\u207B\u00b2" },
+    { physics::C / (physics::M^3), "Cm\u207B\u00b3" },
+    { physics::T * physics::M, "Tm" },
+    { physics::A / (physics::V * physics::M), "AV\u207B\u00b9m\u207B\u00b9" },
+    { physics::V / physics::M, "Vm\u207B\u00b9" },
+    { physics::W / (physics::M^2), "Wm\u207B\u00b2" },
+
     { physics::HZ, "Hz" },
     { physics::N, "N" },
     { physics::J, "J" },
@@ -16,47 +38,53 @@ inline const std::map<physics::unit, std::string> si_derved_names {
     { physics::H, "H" },
     { physics::SIEMENS, "S" },
     { physics::WB, "Wb" },
-    { physics::T, "T" }
-};
-inline const std::map<physics::unit, std::string> si_special_names {
-    { physics::J * physics::S, "Js" },
-    { physics::N * physics::S, "Ns" },
-    { physics::J / physics::K, "JK" + super::super(-1) },
-    { physics::J / (physics::KG * physics::K), "Jkg" + super::super(-1) + "K" + super::super(-1) },
-    { physics::C / physics::M, "Cm" + super::super(-1) },
-    { physics::C / (physics::M^2), "Cm" + super::super(-2) },
-    { physics::C / (physics::M^3), "Cm" + super::super(-3) },
-    { physics::T * physics::M, "Tm" },
-    { physics::A / (physics::V * physics::M), "AV" + super::super(-1) + "m" + super::super(-1) },
-    { physics::V / physics::M, "Vm" + super::super(-1) },
-    { physics::W / (physics::M^2), "Wm" + super::super(-2) }
+    { physics::T, "T" },
+
+    { physics::unit(), "" }
 };
 
-inline physics::unit::unit(std::vector<int8_t> si_units) {
+// Slot of a unit in unit_names
+inline constexpr size_t unit_name_slot(const physics::unit& u) {
+    return ((uint64_t)u.hash() * 0x9E3779B97F4A7C15) >> 58;
+}
+
+// Hash table of indices into the names above, built at compile time with linear probing. Empty slots are -1.
+// A unit listed twice keeps its first name.
+inline constexpr auto unit_names = [] {
+    std::array<int8_t, 64> out{};
+    for(int8_t& slot : out) slot = -1;
+    for(size_t k = 0; k < std::size(listed_unit_names); k++) {
+        size_t i = unit_name_slot(listed_unit_names[k].u);
+        while(out[i] >= 0 && listed_unit_names[out[i]].u != listed_unit_names[k].u) i = (i + 1) % out.size();
+        if(out[i] < 0) out[i] = (int8_t)k;
+    }
+    return out;
+}();
+
+// Names built from base units are kept per thread, up to this many
+inline constexpr size_t max_built_unit_names = 4096;
+
+inline physics::unit::unit(const std::vector<int8_t>& si_units) : bits(0) {
     int size = si_units.size();
     for(int i = 0; i < std::min(7, size); i++) {
-        si[i] = si_units[i];
+        bits |= lane(si_units[i], i);
     }
 }
 
-inline physics::unit::operator std::string() const {
-    std::string output;
-
-    // Returns special names if present in map
-    if(si_special_names.count(*this) != 0) {
-        output = si_special_names.at(*this);
-        return output;
+inline std::string_view physics::unit::name() const {
+    for(size_t i = unit_name_slot(*this); unit_names[i] >= 0; i = (i + 1) % unit_names.size()) {
+        if(listed_unit_names[unit_names[i]].u == *this) return listed_unit_names[unit_names[i]].name;
     }
 
-    // Returns name of derived unit if present in map
-    if(si_derved_names.count(*this) != 0) {
-        output = si_derved_names.at(*this);
-        return output;
-    }
+    thread_local std::unordered_map<unit, std::string> built_names;
+    thread_local std::string uncached;
+    auto built = built_names.find(*this);
+    if(built != built_names.end()) return built->second;
 
     // Constructs name from base units
+    std::string output;
     for(int i = 0; i < 7; i++) {
-        int8_t u = si[i];
+        int8_t u = exponent(i);
         if(u != 0) {
             output += si_strings[i];
             if(u != 1) {
@@ -64,51 +92,22 @@ inline physics::unit::operator std::string() const {
             }
         }
     }
-    return output;
-}
-inline physics::unit::operator std::vector<int8_t>() const {
-    return std::vector<int8_t>(std::begin(this->si), std::end(this->si));
-}
-
-inline physics::unit physics::unit::operator*(unit x) const {
-    std::vector<int8_t> si_units;
 
-    for(int i = 0; i < 7; i++) {
-        si_units.push_back(si[i] + x.si[i]);
-    }
-
-    return unit(si_units);
+    if(built_names.size() < max_built_unit_names) return built_names.emplace(*this, std::move(output)).first->second;
+    uncached = std::move(output);
+    return uncached;
 }
-inline physics::unit physics::unit::operator/(unit x) const {
-    std::vector<int8_t> si_units;
-
-    for(int i = 0; i < 7; i++) {
-        si_units.push_back(si[i] - x.si[i]);
-    }
 
-    return unit(si_units);
-}
-inline physics::unit physics::unit::operator^(int x) const {
-    std::vector<int8_t> si_units;
-
-    for(int i = 0; i < 7; i++) {
-        si_units.push_back(si[i] * x);
-    }
-
-    return unit(si_units);
-}
-
-inline bool physics::unit::operator<(unit x) const {
-    return (std::vector<int8_t>)*this < (std::vector<int8_t>)x;
-}
-inline bool physics::unit::operator==(unit x) const {
-    return (std::vector<int8_t>)*this == (std::vector<int8_t>)x;
+inline physics::unit::operator std::string() const {
+    return std::string(name());
 }
-inline bool physics::unit::operator!=(unit x) const {
-    return (std::vector<int8_t>)*this != (std::vector<int8_t>)x;
+inline physics::unit::operator std::vector<int8_t>() const {
+    std::vector<int8_t> si_units(7);
+    for(int i = 0; i < 7; i++) si_units[i] = exponent(i);
+    return si_units;
 }
 
 inline std::ostream& physics::operator<<(std::ostream& os, const unit& u) {
-    os << (std::string)u;
+    os << u.name();
     return os;
 }
\ No newline at end of file
@@ -1,55 +1,96 @@
 #pragma once
 
+#include <cstdint>
+#include <functional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 
 namespace physics {
     // Represents a physical dimension.
-    // Holds an int8_t array with the exponents of each SI unit.
+    // Packs the int8_t exponents of each SI unit into one 64-bit word, with the exponent of unit i in
+    // byte 6 - i. Arithmetic works on all exponents at once, and comparisons are single word compares.
+    // Units hold no shared state, so they can be used from any number of threads at once.
     class unit {
     private:
-        int8_t si[7];
+        uint64_t bits;
+
+        static constexpr uint64_t high = 0x0080808080808080; // Sign bit of each exponent
+
+        static constexpr uint64_t lane(int exponent, int i) { return (uint64_t)(uint8_t)exponent << (8 * (6 - i)); }
+        static constexpr unit from_bits(uint64_t bits) { unit u; u.bits = bits; return u; }
 
     public:
-        explicit unit(std::vector<int8_t> si_units = {0,0,0,0,0,0,0});
+        constexpr unit() : bits(0) {}
+        constexpr unit(int m, int kg, int s, int a, int k, int cd, int mol)
+            : bits(lane(m, 0) | lane(kg, 1) | lane(s, 2) | lane(a, 3) | lane(k, 4) | lane(cd, 5) | lane(mol, 6)) {}
+        explicit unit(const std::vector<int8_t>& si_units);
+
+        // Exponent of SI unit i, in the order m, kg, s, A, K, cd, mol
+        constexpr int8_t exponent(int i) const { return (int8_t)(bits >> (8 * (6 - i))); }
+
+        // Returns the name of the unit, e.g. "N" or "ms⁻¹".
+        // Named units are looked up in a fixed table, and names built from base units are cached per thread.
+        // The view stays valid while the calling thread runs, or, once a thread has built 4096 names,
+        // until its next call.
+        std::string_view name() const;
 
         // Conversions
         operator std::string() const;
         explicit operator std::vector<int8_t>() const;
 
         // Operators
-        unit operator*(unit x) const;
-        unit operator/(unit x) const;
-        unit operator^(int x) const;
+        // Exponents are added and subtracted without carries crossing into their neighbours
+        constexpr unit operator*(const unit& x) const {
+            return from_bits(((bits & ~high) + (x.bits & ~high)) ^ ((bits ^ x.bits) & high));
+        }
+        constexpr unit operator/(const unit& x) const {
+            return from_bits(((bits | high) - (x.bits & ~high)) ^ ((bits ^ ~x.bits) & high));
+        }
+        constexpr unit operator^(int x) const {
+            uint64_t out = 0;
+            for(int i = 0; i < 7; i++) out |= lane(exponent(i) * x, i);
+            return from_bits(out);
+        }
 
-        bool operator<(unit x) const;
-        bool operator==(unit x) const;
-        bool operator!=(unit x) const;
+        // Flipping the sign bits orders units like their lists of exponents
+        constexpr bool operator<(const unit& x) const { return (bits ^ high) < (x.bits ^ high); }
+        constexpr bool operator==(const unit& x) const { return bits == x.bits; }
+        constexpr bool operator!=(const unit& x) const { return bits != x.bits; }
+
+        constexpr size_t hash() const { return (size_t)(bits ^ (bits >> 32)); }
     };
     std::ostream& operator<<(std::ostream& os, const unit& u);
 
     // SI Units
-    const unit M = unit(std::vector<int8_t>{1,0,0,0,0,0,0}); // Metre
-    const unit KG = unit(std::vector<int8_t>{0,1,0,0,0,0,0}); // Kilogram
-    const unit S = unit(std::vector<int8_t>{0,0,1,0,0,0,0}); // Second
-    const unit A = unit(std::vector<int8_t>{0,0,0,1,0,0,0}); // Ampere
-    const unit K = unit(std::vector<int8_t>{0,0,0,0,1,0,0}); // Kelvin
-    const unit CD = unit(std::vector<int8_t>{0,0,0,0,0,1,0}); // Candela
-    const unit MOL = unit(std::vector<int8_t>{0,0,0,0,0,0,1}); // Mole
+    inline constexpr unit M = unit(1,0,0,0,0,0,0); // Metre
+    inline constexpr unit KG = unit(0,1,0,0,0,0,0); // Kilogram
+    inline constexpr unit S = unit(0,0,1,0,0,0,0); // Second
+    inline constexpr unit A = unit(0,0,0,1,0,0,0); // Ampere
+    inline constexpr unit K = unit(0,0,0,0,1,0,0); // Kelvin
+    inline constexpr unit CD = unit(0,0,0,0,0,1,0); // Candela
+    inline constexpr unit MOL = unit(0,0,0,0,0,0,1); // Mole
 
     // Derived units
-    const unit HZ = S^-1; // Hertz
-    const unit N = KG * M / (S^2); // Newton
-    const unit J = N * M; // Joule
-    const unit W = J / S; // Watt
-    const unit PA = N / (M^2); // Pascal
-    const unit V = W / A; // Volt
-    const unit C = A * S; // Coulomb
-    const unit OHM = V / A; // Ohm
-    const unit F = C / V; // Farad
-    const unit H = OHM * S; // Henry
-    const unit SIEMENS = A / V; // Siemens
-    const unit WB = V * S; // Weber
-    const unit T = WB / (M^2); // Tesla
-}
\ No newline at end of file
+    inline constexpr unit HZ = S^-1; // Hertz
+    inline constexpr unit N = KG * M / (S^2); // Newton
+    inline constexpr unit J = N * M; // Joule
+    inline constexpr unit W = J / S; // Watt
+    inline constexpr unit PA = N / (M^2); // Pascal
+    inline constexpr unit V = W / A; // Volt
+    inline constexpr unit C = A * S; // Coulomb
+    inline constexpr unit OHM = V / A; // Ohm
+    inline constexpr unit F = C / V; // Farad
+    inline constexpr unit H = OHM * S; // Henry
+    inline constexpr unit SIEMENS = A / V; // Siemens
+    inline constexpr unit WB = V * S; // Weber
+    inline constexpr unit T = WB / (M^2); // Tesla
+}
+
+namespace std {
+    template <>
+    struct hash<physics::unit> {
+        size_t operator()(const physics::unit& u) const { return u.hash(); }
+    };
+}
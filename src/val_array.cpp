@@ -0,0 +1,211 @@
+#include "val_array.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+
+// Returns the value of a scalar val in SI units
+inline physics::scalar si_value(const physics::val& x) {
+    if(!x.v.is_scalar()) throw std::invalid_argument("Only scalar values can be used with a val_array.");
+    return x.v.first() * physics::power_of_ten(x.e);
+}
+
+// Computes out[i] = f(a[i]) for n elements, splitting large arrays across the thread pool
+template <typename F>
+inline void transform_values(int n, const physics::scalar* a, physics::scalar* out, F f) {
+    physics::parallel_for(n, n, [&](int begin, int end) {
+        for(int i = begin; i < end; i++) out[i] = f(a[i]);
+    });
+}
+
+// Computes out[i] = f(a[i], b[i]) for n elements
+template <typename F>
+inline void transform_values(int n, const physics::scalar* a, const physics::scalar* b, physics::scalar* out, F f) {
+    physics::parallel_for(n, n, [&](int begin, int end) {
+        for(int i = begin; i < end; i++) out[i] = f(a[i], b[i]);
+    });
+}
+
+inline void check_sizes(const physics::val_array& x, const physics::val_array& y) {
+    if(x.size() != y.size()) throw std::invalid_argument("Incompatible arrays.");
+}
+
+inline physics::val_array::val_array() {}
+inline physics::val_array::val_array(int size, unit u) : data(size), u(u) {}
+inline physics::val_array::val_array(const std::vector<scalar>& values, unit u) : data(values.data(), values.data() + values.size()), u(u) {}
+inline physics::val_array::val_array(const std::vector<val>& values) : data(values.size()) {
+    if(!values.empty()) u = values[0].u;
+    for(int i = 0; i < size(); i++) {
+        if(values[i].u != u) throw std::invalid_argument("Unit Error");
+        data[i] = si_value(values[i]);
+    }
+}
+
+inline int physics::val_array::size() const { return data.size(); }
+inline physics::val physics::val_array::operator[](int i) const { return val(matrix(data[i]), u); }
+
+inline physics::val_array::operator std::vector<val>() const {
+    std::vector<val> out;
+    out.reserve(size());
+    for(int i = 0; i < size(); i++) out.push_back((*this)[i]);
+    return out;
+}
+inline physics::val_array::operator val() const {
+    matrix m = matrix::zeros(1, size());
+    std::copy(data.begin(), data.end(), m.row(0));
+    return val(std::move(m), u);
+}
+
+inline physics::val_array physics::val_array::operator+(const val_array& x) const {
+    if(u != x.u) throw std::invalid_argument("Unit Error");
+    check_sizes(*this, x);
+    val_array out(size(), u);
+    transform_values(size(), data.data(), x.data.data(), out.data.data(), [](scalar a, scalar b) { return a + b; });
+    return out;
+}
+inline physics::val_array physics::val_array::operator-(const val_array& x) const {
+    if(u != x.u) throw std::invalid_argument("Unit Error");
+    check_sizes(*this, x);
+    val_array out(size(), u);
+    transform_values(size(), data.data(), x.data.data(), out.data.data(), [](scalar a, scalar b) { return a - b; });
+    return out;
+}
+inline physics::val_array physics::val_array::operator*(const val_array& x) const {
+    check_sizes(*this, x);
+    val_array out(size(), u * x.u);
+    transform_values(size(), data.data(), x.data.data(), out.data.data(), [](scalar a, scalar b) { return a * b; });
+    return out;
+}
+inline physics::val_array physics::val_array::operator/(const val_array& x) const {
+    check_sizes(*this, x);
+    val_array out(size(), u / x.u);
+    transform_values(size(), data.data(), x.data.data(), out.data.data(), [](scalar a, scalar b) { return a / b; });
+    return out;
+}
+
+inline physics::val_array physics::val_array::operator+(const val& x) const {
+    if(u != x.u) throw std::invalid_argument("Unit Error");
+    scalar b = si_value(x);
+    val_array out(size(), u);
+    transform_values(size(), data.data(), out.data.data(), [b](scalar a) { return a + b; });
+    return out;
+}
+inline physics::val_array physics::val_array::operator-(const val& x) const {
+    if(u != x.u) throw std::invalid_argument("Unit Error");
+    scalar b = si_value(x);
+    val_array out(size(), u);
+    transform_values(size(), data.data(), out.data.data(), [b](scalar a) { return a - b; });
+    return out;
+}
+inline physics::val_array physics::val_array::operator*(const val& x) const {
+    scalar b = si_value(x);
+    val_array out(size(), u * x.u);
+    transform_values(size(), data.data(), out.data.data(), [b](scalar a) { return a * b; });
+    return out;
+}
+inline physics::val_array physics::val_array::operator/(const val& x) const {
+    scalar b = 1 / si_value(x);
+    val_array out(size(), u / x.u);
+    transform_values(size(), data.data(), out.data.data(), [b](scalar a) { return a * b; });
+    return out;
+}
+
+inline physics::val_array physics::val_array::operator*(scalar x) const {
+    val_array out(size(), u);
+    transform_values(size(), data.data(), out.data.data(), [x](scalar a) { return a * x; });
+    return out;
+}
+inline physics::val_array physics::val_array::operator/(scalar x) const {
+    return *this * (1 / x);
+}
+inline physics::val_array physics::val_array::operator*(const unit& x) const {
+    val_array out = *this;
+    out.u = u * x;
+    return out;
+}
+inline physics::val_array physics::val_array::operator/(const unit& x) const {
+    val_array out = *this;
+    out.u = u / x;
+    return out;
+}
+
+inline physics::val_array& physics::val_array::operator+=(const val_array& x) {
+    if(u != x.u) throw std::invalid_argument("Unit Error");
+    check_sizes(*this, x);
+    transform_values(size(), data.data(), x.data.data(), data.data(), [](scalar a, scalar b) { return a + b; });
+    return *this;
+}
+inline physics::val_array& physics::val_array::operator-=(const val_array& x) {
+    if(u != x.u) throw std::invalid_argument("Unit Error");
+    check_sizes(*this, x);
+    transform_values(size(), data.data(), x.data.data(), data.data(), [](scalar a, scalar b) { return a - b; });
+    return *this;
+}
+inline physics::val_array& physics::val_array::operator+=(const val& x) {
+    if(u != x.u) throw std::invalid_argument("Unit Error");
+    scalar b = si_value(x);
+    transform_values(size(), data.data(), data.data(), [b](scalar a) { return a + b; });
+    return *this;
+}
+inline physics::val_array& physics::val_array::operator-=(const val& x) {
+    if(u != x.u) throw std::invalid_argument("Unit Error");
+    scalar b = si_value(x);
+    transform_values(size(), data.data(), data.data(), [b](scalar a) { return a - b; });
+    return *this;
+}
+inline physics::val_array& physics::val_array::operator*=(scalar x) {
+    transform_values(size(), data.data(), data.data(), [x](scalar a) { return a * x; });
+    return *this;
+}
+inline physics::val_array& physics::val_array::operator/=(scalar x) {
+    return *this *= 1 / x;
+}
+
+
+inline physics::val_array physics::operator+(const val& x, const val_array& y) { return y + x; }
+inline physics::val_array physics::operator-(const val& x, const val_array& y) {
+    if(x.u != y.u) throw std::invalid_argument("Unit Error");
+    scalar a = si_value(x);
+    val_array out(y.size(), y.u);
+    transform_values(y.size(), y.data.data(), out.data.data(), [a](scalar b) { return a - b; });
+    return out;
+}
+inline physics::val_array physics::operator*(const val& x, const val_array& y) { return y * x; }
+inline physics::val_array physics::operator/(const val& x, const val_array& y) {
+    scalar a = si_value(x);
+    val_array out(y.size(), x.u / y.u);
+    transform_values(y.size(), y.data.data(), out.data.data(), [a](scalar b) { return a / b; });
+    return out;
+}
+inline physics::val_array physics::operator*(scalar x, const val_array& y) { return y * x; }
+inline physics::val_array physics::operator/(scalar x, const val_array& y) {
+    val_array out(y.size(), unit() / y.u);
+    transform_values(y.size(), y.data.data(), out.data.data(), [x](scalar b) { return x / b; });
+    return out;
+}
+
+inline std::ostream& physics::operator<<(std::ostream& os, const val_array& x) {
+    os << (val)x;
+    return os;
+}
+
+template <typename F>
+inline physics::val_array physics::parallel_map(const val_array& x, F&& f) {
+    val_array out(x.size());
+    if(x.size() == 0) return out;
+
+    // The first result sets the unit the others are checked against
+    val first = f(x[0]);
+    out.u = first.u;
+    out.data[0] = si_value(first);
+    thread_pool::shared().parallel_for(x.size() - 1, [&](int begin, int end) {
+        for(int i = begin + 1; i <= end; i++) {
+            val result = f(x[i]);
+            if(result.u != out.u) throw std::invalid_argument("Unit Error");
+            out.data[i] = si_value(result);
+        }
+    });
+    return out;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "buffer.h"
+#include "unit.h"
+#include "value.h"
+#include <vector>
+
+
+namespace physics {
+    // Represents many scalar physical values with the same unit.
+    // The values are stored as plain SI numbers in one contiguous buffer, so every operation checks
+    // units once for the whole array and runs as a simple loop the compiler can vectorise.
+    class val_array {
+    public:
+        buffer data; // Values in SI units
+        unit u; // Unit
+
+    public:
+        val_array();
+        explicit val_array(int size, unit u = unit());
+        val_array(const std::vector<scalar>& values, unit u = unit());
+        // All values must be scalars with the same unit.
+        explicit val_array(const std::vector<val>& values);
+
+        int size() const;
+        val operator[](int i) const;
+
+        // Conversions
+        explicit operator std::vector<val>() const;
+        // Returns a 1xN vector value.
+        explicit operator val() const;
+
+        // Operators
+        val_array operator+(const val_array& x) const;
+        val_array operator-(const val_array& x) const;
+        val_array operator*(const val_array& x) const;
+        val_array operator/(const val_array& x) const;
+
+        val_array operator+(const val& x) const;
+        val_array operator-(const val& x) const;
+        val_array operator*(const val& x) const;
+        val_array operator/(const val& x) const;
+
+        val_array operator*(scalar x) const;
+        val_array operator/(scalar x) const;
+        val_array operator*(const unit& x) const;
+        val_array operator/(const unit& x) const;
+
+        // Compound assignment updates the array in place
+        val_array& operator+=(const val_array& x);
+        val_array& operator-=(const val_array& x);
+        val_array& operator+=(const val& x);
+        val_array& operator-=(const val& x);
+        val_array& operator*=(scalar x);
+        val_array& operator/=(scalar x);
+    };
+
+    // Additional operators
+    val_array operator+(const val& x, const val_array& y);
+    val_array operator-(const val& x, const val_array& y);
+    val_array operator*(const val& x, const val_array& y);
+    val_array operator/(const val& x, const val_array& y);
+    val_array operator*(scalar x, const val_array& y);
+    val_array operator/(scalar x, const val_array& y);
+
+    std::ostream& operator<<(std::ostream& os, const val_array& x);
+
+    // Calls f on every value of x on the shared thread pool and collects the results.
+    // f takes and returns a val, and its results must be scalar values with the same unit.
+    template <typename F>
+    val_array parallel_map(const val_array& x, F&& f);
+}
@@ -1,62 +1,48 @@
 #include "value.h"
 #include "matrix.h"
+#include "expression.h"
+#include "format.h"
+#include <cmath>
 #include <cstdint>
-#include <map>
 #include <stdexcept>
 #include <math.h>
+#include <utility>
 
 
-inline std::map<int8_t, std::string> prefix_names {
-    {24, "Y"},
-    {21, "Z"},
-    {18, "E"},
-    {15, "P"},
-    {12, "T"},
-    {9, "G"},
-    {6, "M"},
-    {3, "k"},
-    {2, "h"},
-    {1, "dc"},
-    {-1, "d"},
-    {-2, "c"},
-    {-3, "m"},
-    {-6, "μ"},
-    {-9, "n"},
-    {-12, "p"},
-    {-15, "f"},
-    {-18, "a"},
-    {-21, "z"},
-    {-24, "y"},
+// Powers of ten that are exact in a long double
+inline constexpr long double powers_of_ten[] = {
+    1e0L, 1e1L, 1e2L, 1e3L, 1e4L, 1e5L, 1e6L, 1e7L, 1e8L, 1e9L, 1e10L, 1e11L, 1e12L, 1e13L,
+    1e14L, 1e15L, 1e16L, 1e17L, 1e18L, 1e19L, 1e20L, 1e21L, 1e22L, 1e23L, 1e24L, 1e25L, 1e26L, 1e27L
 };
 
-inline physics::val::val(long double v) {
-    this->v = matrix(v);
-    this->e = 0;
-    this->u = unit();
+// Returns x / 10^n with a single rounding while |n| <= 27
+inline long double divide_by_power_of_ten(long double x, int n) {
+    const int last = 27;
+    while(n > last) { x /= powers_of_ten[last]; n -= last; }
+    while(n < -last) { x *= powers_of_ten[last]; n += last; }
+    return n >= 0 ? x / powers_of_ten[n] : x * powers_of_ten[-n];
 }
-inline physics::val::val(matrix v) {
-    this->v = v;
-    this->e = 0;
-    this->u = unit();
+
+inline physics::scalar physics::power_of_ten(int n) { return (scalar)divide_by_power_of_ten(1, -n); }
+
+inline physics::val::val(scalar v) : v(v), e(0), u() {}
+inline physics::val::val(matrix v) : v(std::move(v)), e(0), u() {}
+inline physics::val::val(matrix v, unit u) : v(std::move(v)), e(0), u(u) {
+    calculate_exponent();
 }
-inline physics::val::val(matrix v, unit u) {
-    this->v = v;
-    this->e = 0;
-    this->u = u;
+inline physics::val::val(matrix v, int8_t e, unit u) : v(std::move(v)), e(e), u(u) {
     calculate_exponent();
 }
-inline physics::val::val(matrix v, int8_t e, unit u) {
-    this->v = v;
-    this->e = e;
-    this->u = u;
+template <typename E>
+inline physics::val::val(const val_expr<E>& x) : v(x.v), e(x.e), u(x.u) {
     calculate_exponent();
 }
 
-inline std::string physics::val::operator+(std::string x) const {
+inline std::string physics::val::operator+(const std::string& x) const {
     return (std::string)*this + x;
 }
 inline physics::val::operator std::string() const {
-    return (std::string)v + get_prefix() + (std::string)u;
+    return std::string(format(*this));
 }
 inline physics::val::operator int() const { return (int)v; }
 inline physics::val::operator float() const { return (float)v; }
@@ -64,57 +50,66 @@ inline physics::val::operator double() const { return (double)v; }
 inline physics::val::operator long double() const { return (long double)v; }
 inline physics::val::operator unit() const { return u; }
 
-inline physics::val physics::val::operator+(val x) const {
-  if (u != x.u) throw std::invalid_argument("Unit Error");
-  int8_t exp = std::max(e, x.e);
-  return val(v * pow(10, e - exp) + x.v * pow(10, x.e - exp), exp, u);
-}
-inline physics::val physics::val::operator-(val x) const {
-  if (u != x.u) throw std::invalid_argument("Unit Error");
-  int8_t exp = std::max(e, x.e);
-  return val(v * pow(10, e - exp) - x.v * pow(10, x.e - exp), exp, u);
+inline physics::val physics::val::operator*(const unit& x) const & { return val(v, e, u * x); }
+inline physics::val physics::val::operator*(const unit& x) && { return val(std::move(v), e, u * x); }
+inline physics::val physics::val::operator/(const unit& x) const & { return val(v, e, u / x); }
+inline physics::val physics::val::operator/(const unit& x) && { return val(std::move(v), e, u / x); }
+inline physics::val physics::val::operator^(double x) const {
+    // Fractional powers need whole exponents in the unit, and move the fraction of the decimal exponent into v
+    int exponents[7];
+    for(int i = 0; i < 7; i++) {
+        double p = u.exponent(i) * x;
+        if(p != std::floor(p)) throw std::invalid_argument("Unit Error");
+        exponents[i] = (int)p;
+    }
+    unit power(exponents[0], exponents[1], exponents[2], exponents[3], exponents[4], exponents[5], exponents[6]);
+    double shift = e * x;
+    int whole = (int)std::floor(shift);
+    if(shift == whole) return val(v^x, whole, power);
+    return val((v^x) * (scalar)std::pow(10.0L, shift - whole), whole, power);
 }
-inline physics::val physics::val::operator*(val x) const { return val(v * x.v, e + x.e, u * x.u); }
-inline physics::val physics::val::operator*(unit x) const { return val(v, e, u * x); }
-inline physics::val physics::val::operator/(val x) const { return val(v / x.v, e - x.e, u / x.u); }
-inline physics::val physics::val::operator/(unit x) const { return val(v, e, u / x); }
-inline physics::val physics::val::operator^(double x) const { return val(v^x, e * x, u ^ x); }
-
-inline physics::val physics::val::operator+=(val x) {
-    *this = *this + x;
+
+inline physics::val& physics::val::operator+=(const val& x) {
+    // The sum is written straight into v, which it may refer to element by element
+    auto sum = *this + x;
+    v = sum.v;
+    e = sum.e;
+    calculate_exponent();
     return *this;
 }
-inline physics::val physics::val::operator-=(val x) {
-    *this = *this - x;
+inline physics::val& physics::val::operator-=(const val& x) {
+    auto difference = *this - x;
+    v = difference.v;
+    e = difference.e;
+    calculate_exponent();
     return *this;
 }
 
-inline bool physics::val::operator<(val x) const { return (e != x.e) ? e < x.e : (long double)v < (long double)x.v; }
-inline bool physics::val::operator>(val x) const { return (e != x.e) ? e > x.e : (long double)v > (long double)x.v; }
-inline bool physics::val::operator<=(val x) const { return (e != x.e) ? e <= x.e : (long double)v <= (long double)x.v; }
-inline bool physics::val::operator>=(val x) const { return (e != x.e) ? e >= x.e : (long double)v >= (long double)x.v; }
-inline bool physics::val::operator==(val x) const { return v == x.v && e == x.e && u == x.u; }
-inline bool physics::val::operator!=(val x) const { return v != x.v || e != x.e || u != x.u; }
+inline bool physics::val::operator<(const val& x) const { return (e != x.e) ? e < x.e : (scalar)v < (scalar)x.v; }
+inline bool physics::val::operator>(const val& x) const { return (e != x.e) ? e > x.e : (scalar)v > (scalar)x.v; }
+inline bool physics::val::operator<=(const val& x) const { return (e != x.e) ? e <= x.e : (scalar)v <= (scalar)x.v; }
+inline bool physics::val::operator>=(const val& x) const { return (e != x.e) ? e >= x.e : (scalar)v >= (scalar)x.v; }
+inline bool physics::val::operator==(const val& x) const { return v == x.v && e == x.e && u == x.u; }
+inline bool physics::val::operator!=(const val& x) const { return v != x.v || e != x.e || u != x.u; }
 
-inline physics::val physics::val::T() {
-    return val(v.T(), e, u);
+inline physics::val_expr<physics::matrix_transpose> physics::val::T() const {
+    return make_val_expr(v.T(), e, u);
 }
 
-inline physics::val physics::operator*(val x, long double y) { return val((long double)x * y, x.e, (unit)x); }
-inline physics::val physics::operator*(long double x, val y) { return val((long double)y * x, y.e, (unit)y); }
-inline physics::val physics::operator/(val x, long double y) { return val((long double)x / y, x.e, (unit)x); }
-inline physics::val physics::operator/(long double x, val y) { return val((long double)y / x, -y.e, (unit)y); }
+inline physics::val physics::operator*(const val& x, const val& y) { return val(x.v * y.v, x.e + y.e, x.u * y.u); }
+inline physics::val physics::operator/(const val& x, const val& y) { return val(x.v / y.v, x.e - y.e, x.u / y.u); }
+inline physics::val physics::operator/(scalar x, const val& y) { return val(x / (scalar)y.v, -y.e, y.u ^ -1); }
 
-inline physics::val physics::operator*(matrix x, unit y) { return val(x, y); }
-inline physics::val physics::operator/(matrix x, unit y) { return val(x, y^-1); }
-inline std::string physics::operator+(std::string x, val y) { return x + (std::string)y; }
+inline physics::val physics::operator*(matrix x, const unit& y) { return val(std::move(x), y); }
+inline physics::val physics::operator/(matrix x, const unit& y) { return val(std::move(x), y^-1); }
+inline std::string physics::operator+(const std::string& x, const val& y) { return x + (std::string)y; }
 inline std::ostream& physics::operator<<(std::ostream &os, const val &v) {
-    os << (std::string)v;
+    os << format(v);
     return os;
 }
 
-inline physics::val physics::abs(physics::val v) { return val(abs(v.v), v.e, v.u); }
-inline physics::val physics::cross(val v1, val v2) { return val(cross(v1.v, v2.v), v1.e + v2.e, v1.u * v2.u); }
+inline physics::val physics::abs(physics::val v) { return val(abs(std::move(v.v)), v.e, v.u); }
+inline physics::val physics::cross(const val& v1, const val& v2) { return val(cross(v1.v, v2.v), v1.e + v2.e, v1.u * v2.u); }
 
 inline physics::val physics::operator""_Y(long double v) { return val(v, 24); }
 inline physics::val physics::operator""_Z(long double v) { return val(v, 21); }
@@ -138,41 +133,39 @@ inline physics::val physics::operator""_z(long double v) { return val(v, -21); }
 inline physics::val physics::operator""_y(long double v) { return val(v, -24); }
 
 inline void physics::val::calculate_exponent() {
+#ifdef PHYSICS_RAW_SI
+    // Values are kept in SI units, the prefix is only worked out when printing
+    if(e != 0) v *= power_of_ten(e);
+    e = 0;
+#else
+    normalise_exponent();
+#endif
+}
+
+inline void physics::val::normalise_exponent() {
     if(v.rows() != 1 || v.cols() != 1) {
-        v *= pow(10,e);
+        if(e != 0) v *= power_of_ten(e);
         e = 0;
         return;
     }
 
-    if((long double)abs(v) > 1) {
-        while((long double)abs(v) >= 10) {
-            e++;
-            v /= 10;
-        }
-    }
-    else if((long double)abs(v) < 1.0) {
-        while((long double)abs(v) <= 1.0) {
-            e--;
-            v *= 10;
-        }
+    scalar x = v.first();
+    if(x == 0) e = 0;
+    if(x == 0 || !std::isfinite(x)) return;
+
+    // Moves x into [1, 10), correcting for rounding in log10
+    int shift = std::floor(std::log10(std::abs((long double)x)));
+    long double mantissa = divide_by_power_of_ten(x, shift);
+    if(std::abs(mantissa) >= 10) shift++;
+    else if(std::abs(mantissa) < 1) shift--;
+
+    // Exponents beyond milli and kilo are rounded to a multiple of three
+    int exponent = e + shift;
+    if(exponent > 3 || exponent < -3) {
+        if(exponent % 3 == 1 || exponent % 3 == -2) exponent--;
+        else if(exponent % 3 == 2 || exponent % 3 == -1) exponent++;
     }
 
-    if(e > 3 || e < -3) {
-        if(e % 3 == 1 || e % 3 == -2) {
-            e--;
-            v *= 10;
-        }
-        if(e % 3 == 2|| e % 3 == -1) {
-            e++;
-            v /= 10;
-        }
-    }
+    v(0, 0) = divide_by_power_of_ten(x, exponent - e);
+    e = exponent;
 }
-
-inline std::string physics::val::get_prefix() const {
-    if(e == 0) {
-        return u == unit() ? "" : " ";
-    };
-    if(u == unit() || (long double)std::abs(e) > 24) return "e" + std::to_string(e) + " ";
-    return " " + prefix_names[e];
-}
\ No newline at end of file
@@ -2,10 +2,18 @@
 
 #include "unit.h"
 #include "matrix.h"
+#include <charconv>
 
 
 namespace physics {
+    template <typename E> struct val_expr;
+    class val_view;
+
     // Represents a physical value with dimension.
+    // The value is stored as a mantissa and a decimal exponent matching an SI prefix.
+    // Define PHYSICS_RAW_SI to store plain SI values instead (e is always 0): the prefix is then
+    // only worked out when printing, and arithmetic on vals needs no rescaling.
+    // Like matrices, vals may be read by any number of threads at once, including printing them.
     class val {
     public:
         matrix v; // Value
@@ -13,13 +21,17 @@ namespace physics {
         unit u; // Unit
 
     public:
-        val(long double v);
+        val(scalar v);
         val(matrix v);
         val(matrix v, unit u = unit());
         val(matrix v, int8_t e, unit u = unit());
 
+        // Evaluates a lazy sum, difference or scaling of vals, see expression.h
+        template <typename E>
+        val(const val_expr<E>& x);
+
         // Conversions
-        std::string operator+(std::string x) const;
+        std::string operator+(const std::string& x) const;
         operator std::string() const;
         explicit operator int() const;
         explicit operator float() const;
@@ -28,46 +40,57 @@ namespace physics {
         explicit operator unit() const;
 
         // Operators
-        val operator+(val x) const;
-        val operator-(val x) const;
-        val operator*(val x) const;
-        val operator*(unit x) const;
-        val operator/(val x) const;
-        val operator/(unit x) const;
+        // Sums, differences and scaling are lazy, see expression.h
+        // Expiring vals hand their matrix over to the result
+        val operator*(const unit& x) const &;
+        val operator*(const unit& x) &&;
+        val operator/(const unit& x) const &;
+        val operator/(const unit& x) &&;
         val operator^(double x) const;
 
-        val operator+=(val x);
-        val operator-=(val x);
+        // Compound assignment updates the value in place
+        val& operator+=(const val& x);
+        val& operator-=(const val& x);
+
+        bool operator<(const val& x) const;
+        bool operator>(const val& x) const;
+        bool operator<=(const val& x) const;
+        bool operator>=(const val& x) const;
+        bool operator==(const val& x) const;
+        bool operator!=(const val& x) const;
 
-        bool operator<(val x) const;
-        bool operator>(val x) const;
-        bool operator<=(val x) const;
-        bool operator>=(val x) const;
-        bool operator==(val x) const;
-        bool operator!=(val x) const;
+        // Transpose, as a view of this value's matrix, see expression.h
+        val_expr<matrix_transpose> T() const;
 
-        // Transpose
-        val T();
+        // Writable views of part of this value, see view.h
+        val_view block(int i, int j, int rows, int cols);
+        val_view row_view(int i);
+        val_view column_view(int j);
 
     private:
         void calculate_exponent();
-        std::string get_prefix() const;
+        void normalise_exponent();
+
+        friend std::to_chars_result to_chars(char* first, char* last, const val& v, int precision);
     };
 
     // Additional operators
-    val operator*(val x, long double y);
-    val operator*(long double x, val y);
-    val operator/(val x, long double y);
-    val operator/(long double x, val y);
+    val operator*(const val& x, const val& y);
+    val operator/(const val& x, const val& y);
+    val operator/(scalar x, const val& y);
 
     // Conversion operators
-    val operator*(matrix x, unit y);
-    val operator/(matrix x, unit y);
-    std::string operator+(std::string x, val y);
+    val operator*(matrix x, const unit& y);
+    val operator/(matrix x, const unit& y);
+    std::string operator+(const std::string& x, const val& y);
     std::ostream& operator<<(std::ostream& os, const val& v);
 
     val abs(val v);
-    val cross(val v1, val v2);
+    val cross(const val& v1, const val& v2);
+
+    // 10^n, looked up in a table of exact powers and rounded once. Scaling by it gives the same
+    // results as converting between prefixes of a val.
+    scalar power_of_ten(int n);
 
     // Suffixes
     val operator ""_Y(long double); // Yotta
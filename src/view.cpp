@@ -0,0 +1,218 @@
+#include "view.h"
+#include "gemm.h"
+#include "thread_pool.h"
+#include <functional>
+#include <stdexcept>
+#include <utility>
+
+
+inline int physics::matrix_view::rows() const { return n_rows; }
+inline int physics::matrix_view::cols() const { return n_cols; }
+inline int physics::matrix_view::size() const { return n_rows * n_cols; }
+
+inline physics::scalar& physics::matrix_view::operator()(int i, int j) const { return data[(long)i * row_step + (long)j * col_step]; }
+
+
+inline physics::matrix_view::matrix_view(matrix& m) : data(m.size() == 0 ? nullptr : m.row(0)), n_rows(m.rows()), n_cols(m.cols()), row_step(m.stride), col_step(1) {}
+
+inline physics::matrix_view::matrix_view(scalar* data, int rows, int cols, int row_step, int col_step)
+    : data(data), n_rows(rows), n_cols(cols), row_step(row_step), col_step(col_step) {}
+
+
+// Writes every element of an expression into a view of the same size, each thread taking its own rows
+template <typename E>
+inline void assign_view(const physics::matrix_view& out, const E& e) {
+    if(out.rows() != e.rows() || out.cols() != e.cols()) throw std::invalid_argument("Incompatible matrices.");
+    physics::parallel_for(out.rows(), out.size(), [&](int begin, int end) {
+        for(int i = begin; i < end; i++) {
+            for(int j = 0; j < out.cols(); j++) out(i, j) = e(i, j);
+        }
+    });
+}
+
+// First and last element a view refers to, whatever the signs of its steps
+inline std::pair<const physics::scalar*, const physics::scalar*> view_range(const physics::matrix_view& v) {
+    long low = 0, high = 0;
+    (v.row_step < 0 ? low : high) += (long)(v.n_rows - 1) * v.row_step;
+    (v.col_step < 0 ? low : high) += (long)(v.n_cols - 1) * v.col_step;
+    return {v.data + low, v.data + high};
+}
+
+// Whether writing the elements of out in place could change an element of an operand before it is read.
+// Operands laid out exactly like out only read the element being written, others must not share memory with it.
+template <typename L, typename R>
+bool view_aliases(const physics::matrix_view& out, const physics::matrix_sum<L, R>& e);
+template <typename L, typename R>
+bool view_aliases(const physics::matrix_view& out, const physics::matrix_difference<L, R>& e);
+template <typename E>
+bool view_aliases(const physics::matrix_view& out, const physics::matrix_scaled<E>& e);
+
+inline bool view_aliases(const physics::matrix_view& out, const physics::matrix_view& v) {
+    if(out.size() == 0 || v.size() == 0) return false;
+    if(v.data == out.data && v.row_step == out.row_step && v.col_step == out.col_step) return false;
+    auto a = view_range(out), b = view_range(v);
+    std::less<const physics::scalar*> before;
+    return !(before(a.second, b.first) || before(b.second, a.first));
+}
+inline bool view_aliases(const physics::matrix_view& out, const physics::matrix& m) {
+    return view_aliases(out, physics::matrix_view(const_cast<physics::matrix&>(m)));
+}
+inline bool view_aliases(const physics::matrix_view& out, const physics::matrix_transpose& t) {
+    return view_aliases(out, physics::matrix_view(const_cast<physics::matrix&>(t.m)).T());
+}
+template <typename L, typename R>
+inline bool view_aliases(const physics::matrix_view& out, const physics::matrix_sum<L, R>& e) { return view_aliases(out, e.l) || view_aliases(out, e.r); }
+template <typename L, typename R>
+inline bool view_aliases(const physics::matrix_view& out, const physics::matrix_difference<L, R>& e) { return view_aliases(out, e.l) || view_aliases(out, e.r); }
+template <typename E>
+inline bool view_aliases(const physics::matrix_view& out, const physics::matrix_scaled<E>& e) { return view_aliases(out, e.e); }
+
+// Writes an expression into a view, through a temporary if it reads the view's memory at other positions
+template <typename E>
+inline void update_view(const physics::matrix_view& out, const E& e) {
+    if(view_aliases(out, e)) assign_view(out, physics::matrix(e));
+    else assign_view(out, e);
+}
+
+inline physics::matrix_view& physics::matrix_view::operator=(const matrix_view& x) {
+    update_view(*this, x);
+    return *this;
+}
+
+inline physics::matrix_view& physics::matrix_view::operator=(const matrix& x) {
+    update_view(*this, x);
+    return *this;
+}
+
+template <typename E, typename>
+inline physics::matrix_view& physics::matrix_view::operator=(const E& e) {
+    update_view(*this, e);
+    return *this;
+}
+
+inline physics::matrix_view& physics::matrix_view::operator=(scalar x) {
+    for(int i = 0; i < rows(); i++) {
+        for(int j = 0; j < cols(); j++) (*this)(i, j) = x;
+    }
+    return *this;
+}
+
+// The view itself only reads the element being written, so these work in place unless x overlaps it
+inline physics::matrix_view& physics::matrix_view::operator+=(const matrix& x) {
+    update_view(*this, *this + x);
+    return *this;
+}
+inline physics::matrix_view& physics::matrix_view::operator-=(const matrix& x) {
+    update_view(*this, *this - x);
+    return *this;
+}
+inline physics::matrix_view& physics::matrix_view::operator*=(scalar x) {
+    assign_view(*this, *this * x);
+    return *this;
+}
+inline physics::matrix_view& physics::matrix_view::operator/=(scalar x) {
+    assign_view(*this, *this / x);
+    return *this;
+}
+
+
+inline physics::matrix_view physics::matrix_view::block(int i, int j, int rows, int cols) const {
+    if(i < 0 || j < 0 || rows < 0 || cols < 0 || i + rows > n_rows || j + cols > n_cols) throw std::invalid_argument("Index out of range.");
+    return matrix_view(&(*this)(i, j), rows, cols, row_step, col_step);
+}
+
+inline physics::matrix_view physics::matrix_view::row_view(int i) const { return block(i, 0, 1, n_cols); }
+inline physics::matrix_view physics::matrix_view::column_view(int j) const { return block(0, j, n_rows, 1); }
+
+inline physics::matrix_view physics::matrix_view::slice(int first, int count, int step) const {
+    if(n_rows != 1 && n_cols != 1) throw std::invalid_argument("Only vectors can be sliced.");
+    // Element k of a vector view, whichever way it lies
+    int element_step = n_rows == 1 ? col_step : row_step;
+    if(first < 0 || count < 0 || step < 1 || (count > 0 && first + (count - 1) * step >= size())) throw std::invalid_argument("Index out of range.");
+    if(n_rows == 1) return matrix_view(data + (long)first * element_step, 1, count, row_step, step * element_step);
+    return matrix_view(data + (long)first * element_step, count, 1, step * element_step, col_step);
+}
+
+inline physics::matrix_view physics::matrix_view::T() const { return matrix_view(data, n_cols, n_rows, col_step, row_step); }
+
+
+// A view as an operand of gemm: row-major if its rows are contiguous, transposed if its columns are
+inline bool gemm_operand(const physics::matrix_view& v, int& ld, bool& transposed) {
+    if(v.col_step == 1) {
+        ld = v.row_step;
+        transposed = false;
+        return true;
+    }
+    if(v.row_step == 1) {
+        ld = v.col_step;
+        transposed = true;
+        return true;
+    }
+    return false;
+}
+
+inline physics::matrix physics::operator*(const matrix_view& l, const matrix_view& r) {
+    int lda, ldb;
+    bool transpose_a, transpose_b;
+    // Scalars and vectors, which are transposed automatically, and small views go through the usual product
+    bool small = l.size() <= buffer::inline_capacity && r.size() <= buffer::inline_capacity;
+    if(small || l.rows() == 1 || l.cols() == 1 || r.rows() == 1 || r.cols() == 1 ||
+       !gemm_operand(l, lda, transpose_a) || !gemm_operand(r, ldb, transpose_b)) return matrix(l) * matrix(r);
+    if(l.cols() != r.rows()) throw std::invalid_argument("Incompatible matrices.");
+
+    matrix out = matrix::zeros(l.rows(), r.cols());
+    gemm(l.rows(), r.cols(), l.cols(), l.data, lda, r.data, ldb, out.row(0), out.stride, transpose_a, transpose_b);
+    return out;
+}
+
+// The matrix is only read through the view
+inline physics::matrix physics::operator*(const matrix& l, const matrix_view& r) { return matrix_view(const_cast<matrix&>(l)) * r; }
+inline physics::matrix physics::operator*(const matrix_view& l, const matrix& r) { return l * matrix_view(const_cast<matrix&>(r)); }
+
+
+inline physics::val_view::val_view(val& x) : v(x.v), e(x.e), u(x.u) {}
+inline physics::val_view::val_view(matrix_view v, unit u) : v(v), e(0), u(u) {}
+inline physics::val_view::val_view(matrix_view v, int8_t e, unit u) : v(v), e(e), u(u) {}
+
+inline physics::val_view::operator val() const { return val(matrix(v), e, u); }
+
+inline physics::val physics::val_view::operator*(const unit& x) const { return val(matrix(v), e, u * x); }
+inline physics::val physics::val_view::operator/(const unit& x) const { return val(matrix(v), e, u / x); }
+
+inline physics::val_view& physics::val_view::operator=(const val_view& x) { return *this = (val)x; }
+
+inline physics::val_view& physics::val_view::operator=(const val& x) {
+    if(x.u != u) throw std::invalid_argument("Unit Error");
+    if(x.e == e) v = x.v;
+    else v = x.v * power_of_ten(x.e - e);
+    return *this;
+}
+
+inline physics::val_view& physics::val_view::operator+=(const val& x) { return *this = *this + x; }
+inline physics::val_view& physics::val_view::operator-=(const val& x) { return *this = *this - x; }
+inline physics::val_view& physics::val_view::operator*=(scalar x) {
+    v *= x;
+    return *this;
+}
+inline physics::val_view& physics::val_view::operator/=(scalar x) {
+    v /= x;
+    return *this;
+}
+
+inline physics::val_view physics::val_view::block(int i, int j, int rows, int cols) const { return val_view(v.block(i, j, rows, cols), e, u); }
+inline physics::val_view physics::val_view::row_view(int i) const { return val_view(v.row_view(i), e, u); }
+inline physics::val_view physics::val_view::column_view(int j) const { return val_view(v.column_view(j), e, u); }
+inline physics::val_view physics::val_view::slice(int first, int count, int step) const { return val_view(v.slice(first, count, step), e, u); }
+inline physics::val_view physics::val_view::T() const { return val_view(v.T(), e, u); }
+
+inline std::ostream& physics::operator<<(std::ostream& os, const val_view& v) { return os << (val)v; }
+
+
+// Views of matrices and values
+inline physics::matrix_view physics::matrix::block(int i, int j, int rows, int cols) { return matrix_view(*this).block(i, j, rows, cols); }
+inline physics::matrix_view physics::matrix::row_view(int i) { return matrix_view(*this).row_view(i); }
+inline physics::matrix_view physics::matrix::column_view(int j) { return matrix_view(*this).column_view(j); }
+
+inline physics::val_view physics::val::block(int i, int j, int rows, int cols) { return val_view(*this).block(i, j, rows, cols); }
+inline physics::val_view physics::val::row_view(int i) { return val_view(*this).row_view(i); }
+inline physics::val_view physics::val::column_view(int j) { return val_view(*this).column_view(j); }
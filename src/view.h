@@ -0,0 +1,112 @@
+#pragma once
+
+#include "expression.h"
+#include "matrix.h"
+#include "unit.h"
+#include "value.h"
+#include <ostream>
+
+
+namespace physics {
+    // Refers to elements of a matrix, or of any array, without owning them.
+    // Element (i, j) is at data[i * row_step + j * col_step], so rows, columns, blocks, transposes and
+    // strided slices are all views of the same kind. A view is an expression, so it can be used in any
+    // formula, and assigning to it writes the elements it refers to in place.
+    // Views don't keep their matrix alive, and are invalidated when it is resized or reassigned.
+    // Copying a view gives another view of the same elements.
+    struct matrix_view : matrix_expression {
+    public:
+        scalar* data;
+        int n_rows;
+        int n_cols;
+        int row_step;
+        int col_step;
+
+        int rows() const;
+        int cols() const;
+        int size() const;
+
+        // Element access
+        scalar& operator()(int i, int j) const;
+
+    public:
+        explicit matrix_view(matrix& m);
+        // Wraps an array owned elsewhere, e.g. a memory-mapped file or another library's buffer
+        matrix_view(scalar* data, int rows, int cols, int row_step, int col_step = 1);
+        matrix_view(const matrix_view& v) = default;
+
+        // Writes the elements of x, which must have the same size, into the viewed ones.
+        // They are written element by element unless x reads memory the view refers to at other positions,
+        // like an overlapping block or transpose, in which case x is evaluated before anything is written.
+        matrix_view& operator=(const matrix_view& x);
+        matrix_view& operator=(const matrix& x);
+        template <typename E, typename = typename std::enable_if<std::is_base_of<matrix_expression, E>::value>::type>
+        matrix_view& operator=(const E& e);
+        matrix_view& operator=(scalar x);
+
+        // Compound assignment updates the viewed elements in place
+        matrix_view& operator+=(const matrix& x);
+        matrix_view& operator-=(const matrix& x);
+        matrix_view& operator*=(scalar x);
+        matrix_view& operator/=(scalar x);
+
+        // Views of part of this view
+        matrix_view block(int i, int j, int rows, int cols) const;
+        matrix_view row_view(int i) const;
+        matrix_view column_view(int j) const;
+        // count elements of a vector view, starting at first and step elements apart
+        matrix_view slice(int first, int count, int step = 1) const;
+
+        // Transpose, by swapping the steps
+        matrix_view T() const;
+    };
+
+    template <> struct reads_across<matrix_view> : std::true_type {};
+
+    // Products of views that are row-major or transposed go straight to gemm, others are copied first
+    matrix operator*(const matrix_view& l, const matrix_view& r);
+    matrix operator*(const matrix& l, const matrix_view& r);
+    matrix operator*(const matrix_view& l, const matrix& r);
+
+    // Refers to elements of a value without owning them, like matrix_view, along with its exponent and unit.
+    // Writing to it checks the unit, and scales to the exponent of the viewed value, which it keeps.
+    class val_view {
+    public:
+        matrix_view v; // Value
+        int8_t e; // Exponent
+        unit u; // Unit
+
+    public:
+        explicit val_view(val& x);
+        // Views of plain numbers, in SI units unless e is given
+        val_view(matrix_view v, unit u = unit());
+        val_view(matrix_view v, int8_t e, unit u);
+
+        // Conversions
+        operator val() const;
+
+        // Operators
+        val operator*(const unit& x) const;
+        val operator/(const unit& x) const;
+
+        // Writes a value with the same unit into the viewed elements
+        val_view& operator=(const val_view& x);
+        val_view& operator=(const val& x);
+        val_view& operator+=(const val& x);
+        val_view& operator-=(const val& x);
+        val_view& operator*=(scalar x);
+        val_view& operator/=(scalar x);
+
+        // Views of part of this view
+        val_view block(int i, int j, int rows, int cols) const;
+        val_view row_view(int i) const;
+        val_view column_view(int j) const;
+        val_view slice(int first, int count, int step = 1) const;
+        val_view T() const;
+    };
+
+    // Views take part in lazy formulas of vals like vals do
+    template <> struct is_val_expression<val_view> : std::true_type {};
+
+    std::ostream& operator<<(std::ostream& os, const val_view& v);
+}
@@ -0,0 +1,85 @@
+// Matrices outliving the arena_scope or the thread they were created in.
+// g++ -std=c++17 -O1 -g -fsanitize=address -pthread -I.. arena_lifetime.cpp -o arena_lifetime && ./arena_lifetime
+#include "physics.h"
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+using namespace physics;
+
+int failures = 0;
+
+void check(bool ok, const char* what) {
+    if(!ok) {
+        std::printf("FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+int main() {
+    // An empty matrix created in a scope, grown after the block it was created under is gone
+    {
+        std::vector<matrix> keep;
+        keep.reserve(2);
+        { arena_scope s; keep.emplace_back(); }
+        { arena_scope s; keep.push_back(matrix::zeros(100, 100)); }
+        keep.pop_back();
+        keep[0] = matrix::zeros(50, 50);
+        keep[0](49, 49) = 1;
+        check(keep[0].rows() == 50 && keep[0](49, 49) == 1, "growing a matrix created in an earlier scope");
+    }
+
+    // Same, without reserving, so the vector moves its elements while they hold arena storage
+    {
+        std::vector<matrix> keep;
+        { arena_scope s; keep.emplace_back(); }
+        { arena_scope s; keep.push_back(matrix::zeros(100, 100)); }
+        keep.pop_back();
+        keep[0] = matrix::zeros(50, 50);
+        check(keep[0].size() == 2500, "growing a matrix moved out of a scope");
+    }
+
+    // A matrix created in one thread's scope, grown and freed on other threads while that scope is open
+    {
+        std::vector<matrix> made(4);
+        arena_scope s;
+        for(matrix& m : made) m = matrix();
+        std::vector<std::thread> threads;
+        for(matrix& m : made) threads.emplace_back([&m] { m = matrix::identity(64) * (scalar)2; });
+        for(std::thread& t : threads) t.join();
+        for(matrix& m : made) check(m(63, 63) == 2, "growing a matrix on another thread");
+        made.clear();
+    }
+
+    // Storage from a thread's arena kept after the thread has exited
+    {
+        std::vector<matrix> from_thread;
+        std::thread t([&] {
+            arena_scope s;
+            matrix m = matrix::identity(30) * (scalar)3;
+            from_thread.push_back(std::move(m));
+        });
+        t.join();
+        check(from_thread[0](5, 5) == 3, "reading storage of an exited thread's arena");
+        from_thread[0] = matrix::zeros(40, 40);
+        check(from_thread[0].size() == 1600, "replacing storage of an exited thread's arena");
+    }
+
+    // A kept matrix doesn't make later steps grow the arena
+    {
+        arena a;
+        std::vector<matrix> kept;
+        size_t capacity = 0;
+        for(int step = 0; step < 12; step++) {
+            arena_scope s(a);
+            matrix big = matrix::identity(200) + matrix::identity(200);
+            matrix product = big * big;
+            if(step == 0) kept.push_back(matrix::identity(40) + matrix::identity(40));
+            if(step == 2) capacity = a.capacity();
+            if(step > 2) check(a.capacity() == capacity, "arena capacity with a kept matrix");
+        }
+    }
+
+    if(failures == 0) std::printf("OK\n");
+    return failures != 0;
+}
@@ -0,0 +1,94 @@
+// Checks val's constant time exponent normalisation against the decade loop it replaced and against
+// the correctly rounded mantissa, on log-uniform values in 1e-30..1e30. Needs GCC or Clang for __float128.
+// g++ -std=c++17 -O2 -I.. exponent.cpp -o exponent && ./exponent
+#include "physics.h"
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <type_traits>
+
+using namespace physics;
+
+// The loop calculate_exponent used before, one decade at a time, on a scalar instead of a 1x1 matrix.
+// It never ends for 0, and turns powers of ten below 1 into 10 times the next lower exponent.
+void decade_loop(long double& v, int& e) {
+    if(std::abs(v) > 1) {
+        while(std::abs(v) >= 10) {
+            e++;
+            v /= 10;
+        }
+    }
+    else if(std::abs(v) < 1.0) {
+        while(std::abs(v) <= 1.0) {
+            e--;
+            v *= 10;
+        }
+    }
+
+    if(e > 3 || e < -3) {
+        if(e % 3 == 1 || e % 3 == -2) {
+            e--;
+            v *= 10;
+        }
+        if(e % 3 == 2 || e % 3 == -1) {
+            e++;
+            v /= 10;
+        }
+    }
+}
+
+// x / 10^e rounded once, powers of ten up to 10^48 being exact in __float128
+long double reference_mantissa(long double x, int e) {
+    __float128 p = 1;
+    for(int i = 0; i < std::abs(e); i++) p *= 10;
+    __float128 m = e >= 0 ? (__float128)x / p : (__float128)x * p;
+    return (long double)m;
+}
+
+int main() {
+    static_assert(std::is_same<scalar, long double>::value, "Built for the default long double scalar");
+    std::mt19937_64 rng(1);
+    std::uniform_real_distribution<long double> exponent(-30, 30);
+
+    const int samples = 100000;
+    int exponent_mismatches = 0, mantissa_mismatches = 0, loop_matches = 0, loop_compared = 0;
+    for(int i = 0; i < samples; i++) {
+        long double x = std::pow(10.0L, exponent(rng));
+        if(i % 2) x = -x;
+        val normalised(matrix(x), M);
+        long double mantissa = normalised.v.first();
+        int e = normalised.e;
+
+        long double loop_value = x;
+        int loop_e = 0;
+        decade_loop(loop_value, loop_e);
+        bool power_of_ten_below_one = std::abs(x) < 1 && std::abs(mantissa) == 1;
+        if(!power_of_ten_below_one && loop_e != e) exponent_mismatches++;
+
+        // Beyond 10^27 the table is applied in two steps, so only prefixes up to yotta are exact
+        if(std::abs(e) <= 27) {
+            long double reference = reference_mantissa(x, e);
+            if(mantissa != reference) mantissa_mismatches++;
+            if(loop_e == e) {
+                loop_compared++;
+                loop_matches += loop_value == reference;
+            }
+        }
+    }
+
+    // Values the loop got wrong, and special values
+    bool special = true;
+    val zero(matrix(0.0L), M), tenth(matrix(0.1L), M), infinite(matrix(INFINITY), M);
+    special &= zero.e == 0 && zero.v.first() == 0;
+    special &= tenth.e == -1 && tenth.v.first() == 1;
+    special &= std::isinf((long double)infinite.v.first());
+
+    std::printf("exponent differs from the decade loop: %d of %d\n", exponent_mismatches, samples);
+    std::printf("mantissa differs from x / 10^e rounded once: %d\n", mantissa_mismatches);
+    std::printf("decade loop mantissa equal to it: %d of %d\n", loop_matches, loop_compared);
+    std::printf("zero, 0.1 and infinity: %s\n", special ? "ok" : "wrong");
+
+    bool ok = exponent_mismatches == 0 && mantissa_mismatches == 0 && special;
+    std::printf("%s\n", ok ? "OK" : "FAILED");
+    return !ok;
+}